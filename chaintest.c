@@ -0,0 +1,147 @@
+/*
+ * chaintest.c
+ *
+ * Copyright (C) 2026, Mozilla Corporation.
+ * For conditions of distribution and use, see the accompanying README.ijg
+ * file.
+ *
+ * This program verifies that the chained memory destination manager
+ * (jpeg_chain_dest()) produces the same JPEG image as jpeg_mem_dest(), for
+ * various chunk sizes and when the same JPEG object is reused with a different
+ * chunk size.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include "jpeglib.h"
+#include "jerror.h"
+
+
+#define WIDTH  227
+#define HEIGHT  149
+
+#define THROW(msg) { \
+  printf("ERROR in line %d: %s\n", __LINE__, msg); \
+  retval = -1;  goto bailout; \
+}
+
+
+struct my_error_mgr {
+  struct jpeg_error_mgr pub;
+  jmp_buf setjmp_buffer;
+};
+
+typedef struct my_error_mgr *my_error_ptr;
+
+static void my_error_exit(j_common_ptr cinfo)
+{
+  my_error_ptr myerr = (my_error_ptr)cinfo->err;
+
+  longjmp(myerr->setjmp_buffer, 1);
+}
+
+static void my_output_message(j_common_ptr cinfo)
+{
+}
+
+
+static unsigned char image[HEIGHT][WIDTH * 3];
+static unsigned char *refbuf = NULL;
+static unsigned long refsize = 0;
+
+
+static void compress(j_compress_ptr cinfo)
+{
+  JSAMPROW row;
+
+  cinfo->image_width = WIDTH;
+  cinfo->image_height = HEIGHT;
+  cinfo->input_components = 3;
+  cinfo->in_color_space = JCS_RGB;
+  jpeg_set_defaults(cinfo);
+  jpeg_set_quality(cinfo, 90, TRUE);
+  jpeg_start_compress(cinfo, TRUE);
+  while (cinfo->next_scanline < cinfo->image_height) {
+    row = image[cinfo->next_scanline];
+    jpeg_write_scanlines(cinfo, &row, 1);
+  }
+  jpeg_finish_compress(cinfo);
+}
+
+
+int main(void)
+{
+  /* Shrinking the chunk size reuses the pooled chunks, and growing it
+     allocates new ones. */
+  static const size_t chunk_sizes[] = { 4096, 7, 1, 7, 0, 4096 };
+  struct jpeg_compress_struct cinfo;
+  struct my_error_mgr jerr;
+  char msg[JMSG_LENGTH_MAX];
+  const jpeg_output_chunk *chunks;
+  size_t offset, chunk_size;
+  int i, j, num_chunks, x, y;
+  volatile int retval = 0, step = 0;
+
+  for (y = 0; y < HEIGHT; y++) {
+    for (x = 0; x < WIDTH * 3; x++)
+      image[y][x] = (unsigned char)((x * 7 + y * 13 + (x ^ y)) & 0xFF);
+  }
+
+  cinfo.err = jpeg_std_error(&jerr.pub);
+  jerr.pub.error_exit = my_error_exit;
+  jerr.pub.output_message = my_output_message;
+  if (setjmp(jerr.setjmp_buffer)) {
+    /* Only the chained destination manager checks are expected to fail. */
+    if (step == 1 && jerr.pub.msg_code == JERR_NO_CHAIN_DEST) {
+      jpeg_destroy_compress(&cinfo);
+      jpeg_create_compress(&cinfo);
+      step = 2;
+    } else {
+      (*jerr.pub.format_message) ((j_common_ptr)&cinfo, msg);
+      printf("ERROR: %s\n", msg);
+      retval = -1;  goto bailout;
+    }
+  }
+
+  if (step == 0) {
+    jpeg_create_compress(&cinfo);
+    jpeg_mem_dest(&cinfo, &refbuf, &refsize);
+    compress(&cinfo);
+
+    /* Requesting the chunks of a different destination manager must fail. */
+    step = 1;
+    jpeg_get_output_chunks(&cinfo, &chunks);
+    THROW("jpeg_get_output_chunks() accepted a memory destination");
+  }
+
+  for (i = 0; i < (int)(sizeof(chunk_sizes) / sizeof(size_t)); i++) {
+    chunk_size = chunk_sizes[i] ? chunk_sizes[i] : 65536;
+    printf("Chunk size %lu ... ", (unsigned long)chunk_size);
+
+    jpeg_chain_dest(&cinfo, chunk_sizes[i]);
+    compress(&cinfo);
+    num_chunks = jpeg_get_output_chunks(&cinfo, &chunks);
+    if (num_chunks != (int)((refsize + chunk_size - 1) / chunk_size))
+      THROW("Incorrect number of chunks");
+
+    for (j = 0, offset = 0; j < num_chunks; j++) {
+      if (j < num_chunks - 1 ? chunks[j].size != chunk_size :
+          chunks[j].size < 1 || chunks[j].size > chunk_size)
+        THROW("Incorrect chunk size");
+      if (offset + chunks[j].size > refsize ||
+          memcmp(chunks[j].data, refbuf + offset, chunks[j].size))
+        THROW("Chunked JPEG image differs from jpeg_mem_dest() output");
+      offset += chunks[j].size;
+    }
+    if (offset != refsize)
+      THROW("Chunked JPEG image has the wrong size");
+    printf("Passed.\n");
+  }
+
+bailout:
+  jpeg_destroy_compress(&cinfo);
+  free(refbuf);
+  return retval;
+}
@@ -239,6 +239,8 @@ usage(void)
 #endif
   fprintf(stderr, "  -revert        Revert to standard defaults (instead of mozjpeg defaults)\n");
   fprintf(stderr, "  -fastcrush     Disable progressive scan optimization\n");
+  fprintf(stderr, "  -estimate-scans  Estimate candidate scan sizes during progressive scan\n");
+  fprintf(stderr, "                 optimization rather than encoding the candidate scans\n");
   fprintf(stderr, "  -dc-scan-opt   DC scan optimization mode\n");
   fprintf(stderr, "                 - 0 One scan for all components\n");
   fprintf(stderr, "                 - 1 One scan per component (default)\n");
@@ -300,6 +302,7 @@ usage(void)
   fprintf(stderr, "  -memdst        Compress to memory instead of file (useful for benchmarking)\n");
   fprintf(stderr, "  -report        Report compression progress\n");
   fprintf(stderr, "  -strict        Treat all warnings as fatal\n");
+  fprintf(stderr, "  -threads N     Use up to N threads for compression (default is 1)\n");
   fprintf(stderr, "  -verbose  or  -debug   Emit debug output\n");
   fprintf(stderr, "  -version       Print version information and exit\n");
   fprintf(stderr, "Switches for wizards:\n");
@@ -430,6 +433,9 @@ parse_switches(j_compress_ptr cinfo, int argc, char **argv,
     } else if (keymatch(arg, "fastcrush", 4)) {
       jpeg_c_set_bool_param(cinfo, JBOOLEAN_OPTIMIZE_SCANS, FALSE);
 
+    } else if (keymatch(arg, "estimate-scans", 3)) {
+      jpeg_c_set_bool_param(cinfo, JBOOLEAN_ESTIMATE_SCANS, TRUE);
+
     } else if (keymatch(arg, "grayscale", 2) || keymatch(arg, "greyscale",2)) {
       /* Force a monochrome JPEG file to be generated. */
       jpeg_set_colorspace(cinfo, JCS_GRAYSCALE);
@@ -652,6 +658,16 @@ parse_switches(j_compress_ptr cinfo, int argc, char **argv,
     } else if (keymatch(arg, "strict", 2)) {
       strict = TRUE;
 
+    } else if (keymatch(arg, "threads", 2)) {
+      /* Maximum number of threads used by the encoder. */
+      int val;
+
+      if (++argn >= argc)       /* advance to next argument */
+        usage();
+      if (sscanf(argv[argn], "%d", &val) != 1 || val < 1)
+        usage();
+      jpeg_c_set_int_param(cinfo, JINT_NUM_THREADS, val);
+
     } else if (keymatch(arg, "targa", 1)) {
       /* Input file is Targa format. */
       is_targa = TRUE;
@@ -0,0 +1,27 @@
+# Runs jpegtran in -batch or -stream mode and checks its exit status, which
+# reports whether any of the images failed.  In stream mode, the
+# length-prefixed images are read from INPUT and written to OUTPUT.
+
+if(NOT DEFINED JPEGTRAN)
+  message(FATAL_ERROR "JPEGTRAN must be specified")
+endif()
+
+if(NOT DEFINED ARGS)
+  message(FATAL_ERROR "ARGS must be specified")
+endif()
+
+if(NOT DEFINED STATUS)
+  message(FATAL_ERROR "STATUS must be specified")
+endif()
+
+separate_arguments(ARGS)
+if(DEFINED INPUT)
+  execute_process(COMMAND ${JPEGTRAN} ${ARGS} INPUT_FILE ${INPUT}
+    OUTPUT_FILE ${OUTPUT} RESULT_VARIABLE RESULT)
+else()
+  execute_process(COMMAND ${JPEGTRAN} ${ARGS} RESULT_VARIABLE RESULT)
+endif()
+
+if(NOT RESULT STREQUAL STATUS)
+  message(FATAL_ERROR "jpegtran exited with status ${RESULT} (expected ${STATUS}).")
+endif()
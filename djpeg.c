@@ -84,6 +84,7 @@ static IMAGE_FORMATS requested_fmt;
 
 static const char *progname;    /* program name for error messages */
 static char *icc_filename;      /* for -icc switch */
+static char *saveindex_filename; /* for -saveindex switch */
 static JDIMENSION max_scans;    /* for -maxscans switch */
 static char *outfilename;       /* for -outfile switch */
 static boolean memsrc;          /* for -memsrc switch */
@@ -156,6 +157,7 @@ usage(void)
   fprintf(stderr, "  -dither ordered  Use ordered dithering when quantizing colors\n");
   fprintf(stderr, "                   [legacy feature]\n");
   fprintf(stderr, "  -icc FILE      Extract ICC profile to FILE\n");
+  fprintf(stderr, "  -loadindex FILE  Use decode index in FILE to skip to the region of interest\n");
 #ifdef QUANT_2PASS_SUPPORTED
   fprintf(stderr, "  -map FILE      Quantize to colors used in named image file [legacy feature]\n");
 #endif
@@ -165,13 +167,16 @@ usage(void)
 #endif
   fprintf(stderr, "  -maxmemory N   Maximum memory to use (in kbytes)\n");
   fprintf(stderr, "  -maxscans N    Maximum number of scans to allow in input file\n");
+  fprintf(stderr, "  -scanbudget N  Stop reading a progressive image after N scans (preview)\n");
   fprintf(stderr, "  -outfile name  Specify name for output file\n");
   fprintf(stderr, "  -memsrc        Load input file into memory before decompressing\n");
   fprintf(stderr, "  -report        Report decompression progress\n");
+  fprintf(stderr, "  -saveindex FILE  Save decode index (for use with -loadindex) to FILE\n");
   fprintf(stderr, "  -skip Y0,Y1    Decompress all rows except those between Y0 and Y1 (inclusive)\n");
   fprintf(stderr, "  -crop WxH+X+Y  Decompress only a rectangular subregion of the image\n");
   fprintf(stderr, "                 [requires PBMPLUS (PPM/PGM), GIF, or Targa output format]\n");
   fprintf(stderr, "  -strict        Treat all warnings as fatal\n");
+  fprintf(stderr, "  -threads N     Use up to N threads for decompression (default is 1)\n");
   fprintf(stderr, "  -verbose  or  -debug   Emit debug output\n");
   fprintf(stderr, "  -version       Print version information and exit\n");
   exit(EXIT_FAILURE);
@@ -196,6 +201,7 @@ parse_switches(j_decompress_ptr cinfo, int argc, char **argv,
   /* Set up default JPEG parameters. */
   requested_fmt = DEFAULT_FMT;  /* set default output file format */
   icc_filename = NULL;
+  saveindex_filename = NULL;
   max_scans = 0;
   outfilename = NULL;
   memsrc = FALSE;
@@ -321,6 +327,41 @@ parse_switches(j_decompress_ptr cinfo, int argc, char **argv,
       jpeg_save_markers(cinfo, JPEG_APP0 + 2, 0xFFFF);
 #endif
 
+    } else if (keymatch(arg, "loadindex", 2)) {
+      /* Load decode index from a file. */
+      if (++argn >= argc)       /* advance to next argument */
+        usage();
+      memsrc = TRUE;
+      if (for_real) {           /* requires jpeg_read_header() */
+        FILE *index_file;
+        JOCTET *index_data = NULL;
+        unsigned int index_len = 0;
+        size_t nbytes;
+
+        if ((index_file = fopen(argv[argn], READ_BINARY)) == NULL) {
+          fprintf(stderr, "%s: can't open %s\n", progname, argv[argn]);
+          exit(EXIT_FAILURE);
+        }
+        do {
+          index_data = (JOCTET *)realloc(index_data,
+                                         index_len + INPUT_BUF_SIZE);
+          if (index_data == NULL) {
+            fprintf(stderr, "%s: memory allocation failure\n", progname);
+            exit(EXIT_FAILURE);
+          }
+          nbytes = fread(&index_data[index_len], 1, INPUT_BUF_SIZE,
+                         index_file);
+          index_len += (unsigned int)nbytes;
+        } while (nbytes == INPUT_BUF_SIZE);
+        if (ferror(index_file)) {
+          fprintf(stderr, "%s: can't read from %s\n", progname, argv[argn]);
+          exit(EXIT_FAILURE);
+        }
+        fclose(index_file);
+        jpeg_load_decode_index(cinfo, index_data, index_len);
+        free(index_data);
+      }
+
     } else if (keymatch(arg, "map", 3)) {
       /* Quantize to a color map taken from an input file. */
       if (++argn >= argc)       /* advance to next argument */
@@ -363,6 +404,16 @@ parse_switches(j_decompress_ptr cinfo, int argc, char **argv,
       if (sscanf(argv[argn], "%u", &max_scans) != 1)
         usage();
 
+    } else if (keymatch(arg, "scanbudget", 5)) {
+      /* Maximum number of progressive scans to decode. */
+      int val;
+
+      if (++argn >= argc)       /* advance to next argument */
+        usage();
+      if (sscanf(argv[argn], "%d", &val) != 1 || val < 1)
+        usage();
+      jpeg_d_set_int_param(cinfo, JINT_SCAN_BUDGET, val);
+
     } else if (keymatch(arg, "nosmooth", 3)) {
       /* Suppress fancy upsampling */
       cinfo->do_fancy_upsampling = FALSE;
@@ -392,6 +443,15 @@ parse_switches(j_decompress_ptr cinfo, int argc, char **argv,
     } else if (keymatch(arg, "report", 2)) {
       report = TRUE;
 
+    } else if (keymatch(arg, "saveindex", 2)) {
+      /* Save decode index to a file. */
+      if (++argn >= argc)       /* advance to next argument */
+        usage();
+      saveindex_filename = argv[argn];
+      memsrc = TRUE;
+      jpeg_d_set_int_param(cinfo, JINT_CHECKPOINT_INTERVAL, 16);
+      jpeg_d_set_bool_param(cinfo, JBOOLEAN_RECORD_DECODE_INDEX, TRUE);
+
     } else if (keymatch(arg, "scale", 1)) {
       /* Scale the output image by a fraction M/N. */
       if (++argn >= argc)       /* advance to next argument */
@@ -410,6 +470,8 @@ parse_switches(j_decompress_ptr cinfo, int argc, char **argv,
       skip = TRUE;
       skip_start = temp_start;
       skip_end = temp_end;
+      /* Allow the decoder to seek past the skipped rows. */
+      jpeg_d_set_int_param(cinfo, JINT_CHECKPOINT_INTERVAL, 16);
 
     } else if (keymatch(arg, "crop", 2)) {
       int temp_width = -1, temp_height = -1, temp_x = -1, temp_y = -1;
@@ -426,10 +488,22 @@ parse_switches(j_decompress_ptr cinfo, int argc, char **argv,
       crop_height = temp_height;
       crop_x = temp_x;
       crop_y = temp_y;
+      /* Allow the decoder to seek past the MCUs outside of the region. */
+      jpeg_d_set_int_param(cinfo, JINT_CHECKPOINT_INTERVAL, 16);
 
     } else if (keymatch(arg, "strict", 2)) {
       strict = TRUE;
 
+    } else if (keymatch(arg, "threads", 2)) {
+      /* Maximum number of threads used by the decoder. */
+      int val;
+
+      if (++argn >= argc)       /* advance to next argument */
+        usage();
+      if (sscanf(argv[argn], "%d", &val) != 1 || val < 1)
+        usage();
+      jpeg_d_set_int_param(cinfo, JINT_NUM_THREADS, val);
+
     } else if (keymatch(arg, "targa", 1)) {
       /* Targa output format. */
       requested_fmt = FMT_TARGA;
@@ -917,6 +991,31 @@ main(int argc, char **argv)
       fprintf(stderr, "%s: no ICC profile data in JPEG file\n", progname);
   }
 
+  if (saveindex_filename != NULL) {
+    FILE *index_file;
+    JOCTET *index_data;
+    unsigned int index_len;
+
+    if (jpeg_save_decode_index(&cinfo, &index_data, &index_len)) {
+      if ((index_file = fopen(saveindex_filename, WRITE_BINARY)) == NULL) {
+        fprintf(stderr, "%s: can't open %s\n", progname, saveindex_filename);
+        free(index_data);
+        exit(EXIT_FAILURE);
+      }
+      if (fwrite(index_data, index_len, 1, index_file) < 1) {
+        fprintf(stderr, "%s: can't write decode index to %s\n", progname,
+                saveindex_filename);
+        free(index_data);
+        fclose(index_file);
+        exit(EXIT_FAILURE);
+      }
+      free(index_data);
+      fclose(index_file);
+    } else
+      fprintf(stderr, "%s: no decode index available for JPEG file\n",
+              progname);
+  }
+
   /* Finish decompression and release memory.
    * I must do it in this order because output module has allocated memory
    * of lifespan JPOOL_IMAGE; it needs to finish before releasing memory.
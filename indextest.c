@@ -0,0 +1,238 @@
+/*
+ * indextest.c
+ *
+ * Copyright (C) 2026, Mozilla Corporation.
+ * For conditions of distribution and use, see the accompanying README.ijg
+ * file.
+ *
+ * This program verifies that a decode index saved with
+ * jpeg_save_decode_index() is used by jpeg_skip_scanlines() to resume decoding
+ * within a scan that has no restart markers, and that an index that does not
+ * match the image (because it is truncated or was saved from a different
+ * image) is rejected with a warning rather than used.
+ *
+ * Usage: indextest <JPEG file> <different JPEG file with the same dimensions>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include "jpeglib.h"
+#include "jerror.h"
+
+
+#define SKIP_START  20
+#define SKIP_END  130
+
+#define THROW(msg) { \
+  printf("ERROR in line %d: %s\n", __LINE__, msg); \
+  retval = -1;  goto bailout; \
+}
+
+
+struct my_error_mgr {
+  struct jpeg_error_mgr pub;
+  jmp_buf setjmp_buffer;
+  int last_warning;
+};
+
+typedef struct my_error_mgr *my_error_ptr;
+
+static void my_error_exit(j_common_ptr cinfo)
+{
+  my_error_ptr myerr = (my_error_ptr)cinfo->err;
+
+  (*cinfo->err->output_message) (cinfo);
+  longjmp(myerr->setjmp_buffer, 1);
+}
+
+static void my_emit_message(j_common_ptr cinfo, int msg_level)
+{
+  my_error_ptr myerr = (my_error_ptr)cinfo->err;
+
+  if (msg_level < 0) {
+    myerr->pub.num_warnings++;
+    myerr->last_warning = myerr->pub.msg_code;
+  }
+}
+
+
+static unsigned char *load_file(const char *filename, unsigned long *size)
+{
+  FILE *file;
+  unsigned char *buf = NULL;
+  long len;
+
+  if ((file = fopen(filename, "rb")) == NULL ||
+      fseek(file, 0, SEEK_END) != 0 || (len = ftell(file)) <= 0 ||
+      fseek(file, 0, SEEK_SET) != 0 ||
+      (buf = (unsigned char *)malloc(len)) == NULL ||
+      fread(buf, 1, len, file) != (size_t)len) {
+    printf("ERROR: Could not read %s\n", filename);
+    free(buf);
+    buf = NULL;
+  } else
+    *size = (unsigned long)len;
+  if (file) fclose(file);
+  return buf;
+}
+
+
+/*
+ * Decompress a JPEG image, either in full (recording a decode index, which is
+ * returned in *index_out) or skipping rows SKIP_START through SKIP_END (using
+ * the given decode index, if any.)  Returns the number of warnings, or -1 if
+ * an error occurred.
+ */
+
+static int decompress(unsigned char *jpeg_buf, unsigned long jpeg_size,
+                      const JOCTET *index, unsigned int index_len,
+                      JOCTET **index_out, unsigned int *index_out_len,
+                      unsigned char **image_out, size_t *image_size,
+                      int *last_warning)
+{
+  struct jpeg_decompress_struct cinfo;
+  struct my_error_mgr jerr;
+  unsigned char *volatile image = NULL;
+  JSAMPROW row;
+  size_t row_size;
+  JDIMENSION num_rows;
+
+  cinfo.err = jpeg_std_error(&jerr.pub);
+  jerr.pub.error_exit = my_error_exit;
+  jerr.pub.emit_message = my_emit_message;
+  jerr.last_warning = 0;
+  if (setjmp(jerr.setjmp_buffer)) {
+    jpeg_destroy_decompress(&cinfo);
+    free(image);
+    return -1;
+  }
+
+  jpeg_create_decompress(&cinfo);
+  jpeg_mem_src(&cinfo, jpeg_buf, jpeg_size);
+  jpeg_d_set_int_param(&cinfo, JINT_CHECKPOINT_INTERVAL, 16);
+  if (index_out)
+    jpeg_d_set_bool_param(&cinfo, JBOOLEAN_RECORD_DECODE_INDEX, TRUE);
+  jpeg_read_header(&cinfo, TRUE);
+  if (index)
+    jpeg_load_decode_index(&cinfo, index, index_len);
+  cinfo.dct_method = JDCT_ISLOW;
+  jpeg_start_decompress(&cinfo);
+
+  row_size = (size_t)cinfo.output_width * cinfo.output_components;
+  num_rows = cinfo.output_height;
+  if (!index_out)
+    num_rows -= SKIP_END - SKIP_START + 1;
+  if ((image = (unsigned char *)malloc(row_size * num_rows)) == NULL)
+    ERREXIT1(&cinfo, JERR_OUT_OF_MEMORY, 0);
+  *image_size = row_size * num_rows;
+
+  for (num_rows = 0; cinfo.output_scanline < cinfo.output_height;
+       num_rows++) {
+    if (!index_out && cinfo.output_scanline == SKIP_START)
+      jpeg_skip_scanlines(&cinfo, SKIP_END - SKIP_START + 1);
+    row = image + row_size * num_rows;
+    jpeg_read_scanlines(&cinfo, &row, 1);
+  }
+
+  if (index_out &&
+      !jpeg_save_decode_index(&cinfo, index_out, index_out_len)) {
+    printf("ERROR: No decode index was recorded\n");
+    jpeg_destroy_decompress(&cinfo);
+    free(image);
+    return -1;
+  }
+  jpeg_finish_decompress(&cinfo);
+  jpeg_destroy_decompress(&cinfo);
+
+  *image_out = image;
+  *last_warning = jerr.last_warning;
+  return (int)jerr.pub.num_warnings;
+}
+
+
+int main(int argc, char **argv)
+{
+  unsigned char *jpeg_buf = NULL, *other_buf = NULL;
+  unsigned long jpeg_size = 0, other_size = 0;
+  JOCTET *index = NULL, *other_index = NULL;
+  unsigned int index_len = 0, other_index_len = 0, i;
+  unsigned char *full = NULL, *ref = NULL, *out = NULL;
+  size_t full_size, ref_size, out_size;
+  int retval = 0, last_warning;
+
+  if (argc < 3) {
+    printf("USAGE: %s <JPEG file> <different JPEG file>\n", argv[0]);
+    return 1;
+  }
+  if ((jpeg_buf = load_file(argv[1], &jpeg_size)) == NULL ||
+      (other_buf = load_file(argv[2], &other_size)) == NULL) {
+    retval = -1;  goto bailout;
+  }
+
+  if (decompress(jpeg_buf, jpeg_size, NULL, 0, &index, &index_len, &full,
+                 &full_size, &last_warning) != 0 ||
+      decompress(other_buf, other_size, NULL, 0, &other_index,
+                 &other_index_len, &out, &out_size, &last_warning) != 0)
+    THROW("Could not record a decode index");
+  free(out);  out = NULL;
+  if (decompress(jpeg_buf, jpeg_size, NULL, 0, NULL, NULL, &ref, &ref_size,
+                 &last_warning) != 0)
+    THROW("Could not decompress without a decode index");
+
+  printf("Matching index ... ");
+  if (decompress(jpeg_buf, jpeg_size, index, index_len, NULL, NULL, &out,
+                 &out_size, &last_warning) != 0)
+    THROW("Matching decode index was rejected");
+  if (out_size != ref_size || memcmp(out, ref, ref_size))
+    THROW("Skipping with a decode index produced a different image");
+  free(out);  out = NULL;
+  printf("Passed.\n");
+
+  /* Changing the DC predictions in every checkpoint must change the output,
+     which proves that the skip resumes decoding at a checkpoint.  The index
+     has a 40-byte header, followed by a 17-byte entry (offset, bit position,
+     and three DC predictions) for each checkpoint. */
+  printf("Modified index ... ");
+  for (i = 40; i + 17 <= index_len; i += 17)
+    index[i + 8] ^= 0x10;
+  if (decompress(jpeg_buf, jpeg_size, index, index_len, NULL, NULL, &out,
+                 &out_size, &last_warning) != 0)
+    THROW("Modified decode index was rejected");
+  if (out_size == ref_size && !memcmp(out, ref, ref_size))
+    THROW("Decode index was not used");
+  free(out);  out = NULL;
+  for (i = 40; i + 17 <= index_len; i += 17)
+    index[i + 8] ^= 0x10;
+  printf("Passed.\n");
+
+  printf("Truncated index ... ");
+  if (decompress(jpeg_buf, jpeg_size, index, index_len - 1, NULL, NULL, &out,
+                 &out_size, &last_warning) != 1 ||
+      last_warning != JWRN_BAD_DECODE_INDEX)
+    THROW("Truncated decode index was not rejected");
+  if (out_size != ref_size || memcmp(out, ref, ref_size))
+    THROW("Truncated decode index changed the image");
+  free(out);  out = NULL;
+  printf("Passed.\n");
+
+  printf("Index from a different image ... ");
+  if (decompress(jpeg_buf, jpeg_size, other_index, other_index_len, NULL,
+                 NULL, &out, &out_size, &last_warning) != 1 ||
+      last_warning != JWRN_BAD_DECODE_INDEX)
+    THROW("Decode index from a different image was not rejected");
+  if (out_size != ref_size || memcmp(out, ref, ref_size))
+    THROW("Decode index from a different image changed the image");
+  printf("Passed.\n");
+
+bailout:
+  free(jpeg_buf);
+  free(other_buf);
+  free(index);
+  free(other_index);
+  free(full);
+  free(ref);
+  free(out);
+  return retval;
+}
@@ -928,6 +928,104 @@ public final class TJ {
    * </ul>
    */
   public static final int PARAM_MAXPIXELS = 24;
+  /**
+   * Number of threads [lossy compression, decompression, and lossless
+   * transformation]
+   *
+   * <p>If this parameter is greater than 1, then the packed-pixel compression
+   * methods split the image into horizontal stripes and compress the stripes
+   * in parallel.  Each stripe begins with a restart marker, so the JPEG image
+   * is identical to the image that would be generated by compressing serially
+   * with {@link #PARAM_RESTARTROWS} set to the stripe height (or to the value
+   * of {@link #PARAM_RESTARTROWS}, if it is set and the stripe height is a
+   * multiple of it.)  If {@link #PARAM_OPTIMIZE} is set, then the Huffman
+   * statistics of all stripes are merged, so the Huffman tables are still
+   * optimal for the whole image.  This has no effect with progressive,
+   * arithmetic, or lossless JPEG compression, if
+   * {@link #PARAM_RESTARTBLOCKS} is set, or if the image is too small to be
+   * split into at least two stripes.
+   *
+   * <p>The packed-pixel decompression methods use the restart markers in a
+   * sequential Huffman-coded JPEG image to decompress horizontal stripes of
+   * the image in parallel, if the restart interval is a whole number of MCU
+   * rows.  (Images compressed with this parameter, or with
+   * {@link #PARAM_RESTARTROWS}, meet that requirement.)  The decompressed
+   * image is identical to the image that would be decompressed serially.  This
+   * has no effect if a cropping region is specified or if the JPEG image does
+   * not have at least two restart intervals.  If a sequential Huffman-coded
+   * JPEG image has no restart markers, then the decompression methods instead
+   * split the entropy-coded data at arbitrary byte offsets, decode the pieces
+   * speculatively in parallel, and resynchronize them, which also yields an
+   * identical decompressed image.
+   *
+   * <p>The lossless transform methods rotate, flip, transpose, or crop
+   * horizontal bands of the DCT coefficients in parallel.  The transformed
+   * JPEG images are identical to the images that would be generated serially.
+   *
+   * <p>This parameter has no effect if TurboJPEG was built without thread
+   * support.
+   *
+   * <p><b>Value</b>
+   * <ul>
+   * <li> maximum number of threads that the compression, decompression, and
+   * transform methods will use <i>[default: <code>1</code>]</i>
+   * </ul>
+   */
+  public static final int PARAM_NUMTHREADS = 25;
+  /**
+   * Warm compression context [compression only]
+   *
+   * <p>If this parameter is set, then the memory used to compress an image is
+   * retained by the TurboJPEG instance and reused for the next image, and the
+   * Huffman encoding tables and quantization divisors derived from the
+   * Huffman and quantization tables are retained and reused as long as the
+   * tables do not change.  This reduces the per-image setup overhead when
+   * compressing a series of images with the same dimensions and parameters,
+   * such as thumbnails or video frames.  The JPEG images are identical to the
+   * images that would be generated without this parameter.  The memory used
+   * to compress one image is retained until the next image is compressed or
+   * the instance is closed.
+   *
+   * <p><b>Value</b>
+   * <ul>
+   * <li> <code>0</code> <i>[default]</i> Release the working memory after each
+   * image.
+   * <li> <code>1</code> Retain the working memory and derived tables across
+   * images.
+   * </ul>
+   */
+  public static final int PARAM_WARMCONTEXT = 26;
+  /**
+   * Progressive scan budget [lossy decompression only]
+   *
+   * <p>If this parameter is set, then the decompression methods stop reading a
+   * progressive JPEG image after the specified number of scans, as if the
+   * image ended there, and estimate the missing AC coefficients using block
+   * smoothing.  This produces a low-quality preview of the image from a
+   * prefix of the JPEG image, without parsing the remaining scans.  Use
+   * {@link #PARAM_BYTESREAD} to determine how much of the JPEG image was read.
+   * Unlike {@link #PARAM_SCANLIMIT}, exceeding the budget is not an error.
+   * This parameter has no effect on single-scan JPEG images.
+   *
+   * <p><b>Value</b>
+   * <ul>
+   * <li> maximum number of progressive JPEG scans that the decompression
+   * methods will decode <i>[default: <code>0</code> (no limit)]</i>
+   * </ul>
+   */
+  public static final int PARAM_SCANBUDGET = 27;
+  /**
+   * Number of JPEG bytes read [decompression only, read-only]
+   *
+   * <p><b>Value</b>
+   * <ul>
+   * <li> the number of bytes of the JPEG image that were read by the most
+   * recent successful call to one of the decompression methods.  This is less
+   * than the size of the JPEG image if {@link #PARAM_SCANBUDGET} caused the
+   * decompression methods to stop reading early.
+   * </ul>
+   */
+  public static final int PARAM_BYTESREAD = 28;
 
 
   /**
@@ -229,6 +229,14 @@ public class TJDecompressor implements Closeable {
    * JPEG images (see {@link TJ#PARAM_LOSSLESS}), since the IDCT algorithm is
    * not used with those images.  Note also that {@link TJ#PARAM_FASTDCT} is
    * ignored when decompression scaling is enabled.
+   * <p>
+   * Any scaling factor smaller than 1/8 (such as 1/16 or 3/64) can also be
+   * specified when decompressing a lossy JPEG image into a packed-pixel image
+   * without cropping.  In that case, the JPEG image is reconstructed at 1/8
+   * scale from its DC coefficients alone (which allows the AC scans of a
+   * progressive JPEG image to be skipped), and each pixel in the destination
+   * image is the average of the pixels that it covers in the 1/8-scale image.
+   * This is useful for generating thumbnails.
    */
   @SuppressWarnings("checkstyle:HiddenField")
   public void setScalingFactor(TJScalingFactor scalingFactor) {
@@ -242,7 +250,9 @@ public class TJDecompressor implements Closeable {
           scalingFactor.getDenom() == sf[i].getDenom())
         break;
     }
-    if (i >= sf.length)
+    if (i >= sf.length &&
+        (scalingFactor.getNum() < 1 ||
+         (long)scalingFactor.getNum() * 8 >= scalingFactor.getDenom()))
       throw new IllegalArgumentException("Unsupported scaling factor");
 
     this.scalingFactor = scalingFactor;
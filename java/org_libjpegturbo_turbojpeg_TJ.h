@@ -111,6 +111,14 @@ extern "C" {
 #define org_libjpegturbo_turbojpeg_TJ_PARAM_MAXMEMORY 23L
 #undef org_libjpegturbo_turbojpeg_TJ_PARAM_MAXPIXELS
 #define org_libjpegturbo_turbojpeg_TJ_PARAM_MAXPIXELS 24L
+#undef org_libjpegturbo_turbojpeg_TJ_PARAM_NUMTHREADS
+#define org_libjpegturbo_turbojpeg_TJ_PARAM_NUMTHREADS 25L
+#undef org_libjpegturbo_turbojpeg_TJ_PARAM_WARMCONTEXT
+#define org_libjpegturbo_turbojpeg_TJ_PARAM_WARMCONTEXT 26L
+#undef org_libjpegturbo_turbojpeg_TJ_PARAM_SCANBUDGET
+#define org_libjpegturbo_turbojpeg_TJ_PARAM_SCANBUDGET 27L
+#undef org_libjpegturbo_turbojpeg_TJ_PARAM_BYTESREAD
+#define org_libjpegturbo_turbojpeg_TJ_PARAM_BYTESREAD 28L
 #undef org_libjpegturbo_turbojpeg_TJ_FLAG_BOTTOMUP
 #define org_libjpegturbo_turbojpeg_TJ_FLAG_BOTTOMUP 2L
 #undef org_libjpegturbo_turbojpeg_TJ_FLAG_FASTUPSAMPLE
@@ -103,6 +103,7 @@ jpeg_CreateCompress(j_compress_ptr cinfo, int version, size_t structsize)
       (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
                                   sizeof(my_comp_master));
   memset(cinfo->master, 0, sizeof(my_comp_master));
+  cinfo->master->num_threads = 1;
 
   #if BITS_IN_JSAMPLE == 8
   cinfo->master->compress_profile = JCP_MAX_COMPRESSION;
@@ -22,6 +22,13 @@
 #define JPEG_INTERNALS
 #include "jinclude.h"
 #include "jpeglib.h"
+#ifdef WITH_SIMD
+#include "jsimd.h"
+#else
+#include "jchuff.h"             /* Declarations shared with jc*huff.c */
+#endif
+#include "jpeg_nbits.h"
+#include <limits.h>
 #include <math.h>
 
 /* Expanded entropy encoder object for arithmetic encoding. */
@@ -29,6 +36,10 @@
 typedef struct {
   struct jpeg_entropy_encoder pub; /* public fields */
 
+  /* Pointer to routine to prepare the AC coefficients of a block */
+  int (*AC_prepare) (const JCOEF *block, const int *jpeg_natural_order_start,
+                     int Sl, int Al, UJCOEF *absvalues, size_t *bits);
+
   JLONG c; /* C register, base of coding interval, layout as in sec. D.1.3 */
   JLONG a;               /* A register, normalized size of coding interval */
   JLONG sc;        /* counter for stacked 0xFF values which might overflow */
@@ -117,6 +128,19 @@ typedef arith_entropy_encoder *arith_entropy_ptr;
 #define IRIGHT_SHIFT(x, shft)   ((x) >> (shft))
 #endif
 
+#define PAD(v, p)  ((v + (p) - 1) & (~((p) - 1)))
+
+/* Accessors for the bitmaps computed by AC_prepare().  bits[] holds a bitmap
+ * of the nonzero coefficients followed by a bitmap of the coefficients that
+ * are not negative, each of which occupies 64 bits.
+ */
+
+#define BITS_IN_SIZE_T  (SIZEOF_SIZE_T * 8)
+#define AC_BIT(bits, k) \
+  (((bits)[(k) / BITS_IN_SIZE_T] >> ((k) % BITS_IN_SIZE_T)) & 1)
+#define AC_IS_NEGATIVE(bits, k) \
+  (AC_BIT(bits, (k) + DCTSIZE2) ^ 1)
+
 
 LOCAL(void)
 emit_byte(int val, j_compress_ptr cinfo)
@@ -231,7 +255,7 @@ arith_encode(j_compress_ptr cinfo, unsigned char *st, int val)
   register arith_entropy_ptr e = (arith_entropy_ptr)cinfo->entropy;
   register unsigned char nl, nm;
   register JLONG qe, temp;
-  register int sv;
+  register int sv, n;
 
   /* Fetch values from our compact representation of Table D.2:
    * Qe values and probability estimation state machine
@@ -268,11 +292,17 @@ arith_encode(j_compress_ptr cinfo, unsigned char *st, int val)
     *st = (sv & 0x80) ^ nm;     /* Estimate_after_MPS */
   }
 
-  /* Renormalization & data output per section D.1.6 */
+  /* Renormalization & data output per section D.1.6.  Rather than shifting
+   * one bit at a time, shift by as many bits as are needed to normalize A, up
+   * to the next byte boundary.
+   */
   do {
-    e->a <<= 1;
-    e->c <<= 1;
-    if (--e->ct == 0) {
+    n = 16 - JPEG_NBITS_NONZERO((unsigned int)e->a);
+    if (n > e->ct)
+      n = e->ct;
+    e->a <<= n;
+    e->c <<= n;
+    if ((e->ct -= n) == 0) {
       /* Another byte is ready for output */
       temp = e->c >> 19;
       if (temp > 0xFF) {
@@ -363,6 +393,113 @@ emit_restart(j_compress_ptr cinfo, int restart_num)
 }
 
 
+/*
+ * Prepare the coefficients Ss..Se of a block for AC encoding.  This computes
+ * the absolute values of the coefficients in zigzag order, after the point
+ * transform by Al, along with bitmaps of the nonzero coefficients and of
+ * their signs.  The interface is the same as that of
+ * encode_mcu_AC_refine_prepare() in jcphuff.c, so the SIMD implementation of
+ * that function can be used instead.  The return value of that function (the
+ * index of the last coefficient whose absolute value is 1) is not used here,
+ * so this function returns 0.
+ *
+ * Unlike the SIMD implementation, this function stops at the last nonzero
+ * coefficient, which it finds first, so it does no more work than the
+ * encoders would do without it.  absvalues[] is undefined after that
+ * coefficient.
+ */
+
+#define COMPUTE_ABSVALUES_AC(Sl) { \
+  for (k = 0; k < Sl; k++) { \
+    temp = block[jpeg_natural_order_start[k]]; \
+    /* We must apply the point transform by Al.  For AC coefficients this \
+     * is an integer division with rounding towards 0.  To do this portably \
+     * in C, we shift after obtaining the absolute value. \
+     */ \
+    temp2 = temp >> (CHAR_BIT * sizeof(int) - 1); \
+    temp ^= temp2; \
+    temp -= temp2;              /* temp is abs value of input */ \
+    temp >>= Al;                /* apply the point transform */ \
+    zerobits |= ((size_t)(temp != 0)) << k; \
+    signbits |= ((size_t)(temp2 + 1)) << k; \
+    absvalues[k] = (UJCOEF)temp; \
+  } \
+}
+
+METHODDEF(int)
+encode_mcu_AC_prepare(const JCOEF *block,
+                      const int *jpeg_natural_order_start, int Sl, int Al,
+                      UJCOEF *absvalues, size_t *bits)
+{
+  register int k, temp, temp2;
+  size_t zerobits = 0U, signbits = 0U;
+  int Sl0;
+
+  /* Establish EOB (end-of-block) index */
+  for (; Sl > 0; Sl--) {
+    temp = block[jpeg_natural_order_start[Sl - 1]];
+    if (temp < 0)
+      temp = -temp;
+    if (temp >> Al)
+      break;
+  }
+
+  Sl0 = Sl;
+#if SIZEOF_SIZE_T == 4
+  if (Sl0 > 32)
+    Sl0 = 32;
+#endif
+
+  COMPUTE_ABSVALUES_AC(Sl0);
+
+  bits[0] = zerobits;
+#if SIZEOF_SIZE_T == 8
+  bits[1] = signbits;
+#else
+  bits[2] = signbits;
+
+  zerobits = 0U;
+  signbits = 0U;
+
+  if (Sl > 32) {
+    Sl -= 32;
+    jpeg_natural_order_start += 32;
+    absvalues += 32;
+
+    COMPUTE_ABSVALUES_AC(Sl);
+  }
+
+  bits[1] = zerobits;
+  bits[3] = signbits;
+#endif
+
+  return 0;
+}
+
+
+/*
+ * Return the number of coefficients up to and including the last nonzero
+ * coefficient in a bitmap computed by AC_prepare(), or 0 if all of the
+ * coefficients are zero.
+ */
+
+LOCAL(int)
+find_eob(const size_t *bits)
+{
+  int k;
+  unsigned int chunk;
+
+  for (k = DCTSIZE2 - 16; k >= 0; k -= 16) {
+    chunk = (unsigned int)(bits[k / BITS_IN_SIZE_T] >> (k % BITS_IN_SIZE_T)) &
+            0xFFFF;
+    if (chunk)
+      return k + JPEG_NBITS_NONZERO(chunk);
+  }
+
+  return 0;
+}
+
+
 /*
  * MCU encoding for DC initial scan (either spectral selection,
  * or first pass of successive approximation).
@@ -467,6 +604,10 @@ encode_mcu_AC_first(j_compress_ptr cinfo, JBLOCKROW *MCU_data)
   unsigned char *st;
   int tbl, k, ke;
   int v, v2, m;
+  int Ss = cinfo->Ss;
+  UJCOEF absvalues_unaligned[DCTSIZE2 + 15];
+  UJCOEF *absvalues;
+  size_t bits[16 / SIZEOF_SIZE_T];
 
   /* Emit restart marker if needed */
   if (cinfo->restart_interval) {
@@ -485,40 +626,28 @@ encode_mcu_AC_first(j_compress_ptr cinfo, JBLOCKROW *MCU_data)
 
   /* Sections F.1.4.2 & F.1.4.4.2: Encoding of AC coefficients */
 
-  /* Establish EOB (end-of-block) index */
-  for (ke = cinfo->Se; ke > 0; ke--)
-    /* We must apply the point transform by Al.  For AC coefficients this
-     * is an integer division with rounding towards 0.  To do this portably
-     * in C, we shift after obtaining the absolute value.
-     */
-    if ((v = (*block)[jpeg_natural_order[ke]]) >= 0) {
-      if (v >>= cinfo->Al) break;
-    } else {
-      v = -v;
-      if (v >>= cinfo->Al) break;
-    }
+  /* Apply the point transform by Al and establish EOB (end-of-block) index */
+#ifdef WITH_SIMD
+  absvalues = (UJCOEF *)PAD((JUINTPTR)absvalues_unaligned, 16);
+#else
+  absvalues = absvalues_unaligned;
+#endif
+  (*entropy->AC_prepare) (*block, jpeg_natural_order + Ss, cinfo->Se - Ss + 1,
+                          cinfo->Al, absvalues, bits);
+  ke = Ss - 1 + find_eob(bits);
 
   /* Figure F.5: Encode_AC_Coefficients */
-  for (k = cinfo->Ss; k <= ke; k++) {
+  for (k = Ss; k <= ke; k++) {
     st = entropy->ac_stats[tbl] + 3 * (k - 1);
     arith_encode(cinfo, st, 0);         /* EOB decision */
-    for (;;) {
-      if ((v = (*block)[jpeg_natural_order[k]]) >= 0) {
-        if (v >>= cinfo->Al) {
-          arith_encode(cinfo, st + 1, 1);
-          arith_encode(cinfo, entropy->fixed_bin, 0);
-          break;
-        }
-      } else {
-        v = -v;
-        if (v >>= cinfo->Al) {
-          arith_encode(cinfo, st + 1, 1);
-          arith_encode(cinfo, entropy->fixed_bin, 1);
-          break;
-        }
-      }
+    while ((v = absvalues[k - Ss]) == 0) {
       arith_encode(cinfo, st + 1, 0);  st += 3;  k++;
     }
+    arith_encode(cinfo, st + 1, 1);
+    if (AC_IS_NEGATIVE(bits, k - Ss))
+      arith_encode(cinfo, entropy->fixed_bin, 1);
+    else
+      arith_encode(cinfo, entropy->fixed_bin, 0);
     st += 2;
     /* Figure F.8: Encoding the magnitude category of v */
     m = 0;
@@ -601,6 +730,10 @@ encode_mcu_AC_refine(j_compress_ptr cinfo, JBLOCKROW *MCU_data)
   unsigned char *st;
   int tbl, k, ke, kex;
   int v;
+  int Ss = cinfo->Ss;
+  UJCOEF absvalues_unaligned[DCTSIZE2 + 15];
+  UJCOEF *absvalues;
+  size_t bits[16 / SIZEOF_SIZE_T];
 
   /* Emit restart marker if needed */
   if (cinfo->restart_interval) {
@@ -619,58 +752,40 @@ encode_mcu_AC_refine(j_compress_ptr cinfo, JBLOCKROW *MCU_data)
 
   /* Section G.1.3.3: Encoding of AC coefficients */
 
-  /* Establish EOB (end-of-block) index */
-  for (ke = cinfo->Se; ke > 0; ke--)
-    /* We must apply the point transform by Al.  For AC coefficients this
-     * is an integer division with rounding towards 0.  To do this portably
-     * in C, we shift after obtaining the absolute value.
-     */
-    if ((v = (*block)[jpeg_natural_order[ke]]) >= 0) {
-      if (v >>= cinfo->Al) break;
-    } else {
-      v = -v;
-      if (v >>= cinfo->Al) break;
-    }
+  /* Apply the point transform by Al and establish EOB (end-of-block) index */
+#ifdef WITH_SIMD
+  absvalues = (UJCOEF *)PAD((JUINTPTR)absvalues_unaligned, 16);
+#else
+  absvalues = absvalues_unaligned;
+#endif
+  (*entropy->AC_prepare) (*block, jpeg_natural_order + Ss, cinfo->Se - Ss + 1,
+                          cinfo->Al, absvalues, bits);
+  ke = Ss - 1 + find_eob(bits);
 
-  /* Establish EOBx (previous stage end-of-block) index */
-  for (kex = ke; kex > 0; kex--)
-    if ((v = (*block)[jpeg_natural_order[kex]]) >= 0) {
-      if (v >>= cinfo->Ah) break;
-    } else {
-      v = -v;
-      if (v >>= cinfo->Ah) break;
-    }
+  /* Establish EOBx (previous stage end-of-block) index.  Since Ah = Al + 1,
+   * the coefficients that were nonzero in the previous stage are those whose
+   * absolute value after the point transform by Al is greater than 1.
+   */
+  for (kex = ke; kex >= Ss; kex--)
+    if (absvalues[kex - Ss] > 1) break;
 
   /* Figure G.10: Encode_AC_Coefficients_SA */
-  for (k = cinfo->Ss; k <= ke; k++) {
+  for (k = Ss; k <= ke; k++) {
     st = entropy->ac_stats[tbl] + 3 * (k - 1);
     if (k > kex)
       arith_encode(cinfo, st, 0);       /* EOB decision */
-    for (;;) {
-      if ((v = (*block)[jpeg_natural_order[k]]) >= 0) {
-        if (v >>= cinfo->Al) {
-          if (v >> 1)                   /* previously nonzero coef */
-            arith_encode(cinfo, st + 2, (v & 1));
-          else {                        /* newly nonzero coef */
-            arith_encode(cinfo, st + 1, 1);
-            arith_encode(cinfo, entropy->fixed_bin, 0);
-          }
-          break;
-        }
-      } else {
-        v = -v;
-        if (v >>= cinfo->Al) {
-          if (v >> 1)                   /* previously nonzero coef */
-            arith_encode(cinfo, st + 2, (v & 1));
-          else {                        /* newly nonzero coef */
-            arith_encode(cinfo, st + 1, 1);
-            arith_encode(cinfo, entropy->fixed_bin, 1);
-          }
-          break;
-        }
-      }
+    while ((v = absvalues[k - Ss]) == 0) {
       arith_encode(cinfo, st + 1, 0);  st += 3;  k++;
     }
+    if (v >> 1)                         /* previously nonzero coef */
+      arith_encode(cinfo, st + 2, (v & 1));
+    else {                              /* newly nonzero coef */
+      arith_encode(cinfo, st + 1, 1);
+      if (AC_IS_NEGATIVE(bits, k - Ss))
+        arith_encode(cinfo, entropy->fixed_bin, 1);
+      else
+        arith_encode(cinfo, entropy->fixed_bin, 0);
+    }
   }
   /* Encode EOB decision only if k <= cinfo->Se */
   if (k <= cinfo->Se) {
@@ -695,6 +810,15 @@ encode_mcu(j_compress_ptr cinfo, JBLOCKROW *MCU_data)
   unsigned char *st;
   int blkn, ci, tbl, k, ke;
   int v, v2, m;
+  UJCOEF absvalues_unaligned[DCTSIZE2 + 15];
+  UJCOEF *absvalues;
+  size_t bits[16 / SIZEOF_SIZE_T];
+
+#ifdef WITH_SIMD
+  absvalues = (UJCOEF *)PAD((JUINTPTR)absvalues_unaligned, 16);
+#else
+  absvalues = absvalues_unaligned;
+#endif
 
   /* Emit restart marker if needed */
   if (cinfo->restart_interval) {
@@ -769,25 +893,24 @@ encode_mcu(j_compress_ptr cinfo, JBLOCKROW *MCU_data)
     tbl = compptr->ac_tbl_no;
 
     /* Establish EOB (end-of-block) index */
-    for (ke = DCTSIZE2 - 1; ke > 0; ke--)
-      if ((*block)[jpeg_natural_order[ke]]) break;
+    (*entropy->AC_prepare) (*block, jpeg_natural_order + 1, DCTSIZE2 - 1, 0,
+                            absvalues, bits);
+    ke = find_eob(bits);
 
     /* Figure F.5: Encode_AC_Coefficients */
     for (k = 1; k <= ke; k++) {
       st = entropy->ac_stats[tbl] + 3 * (k - 1);
       arith_encode(cinfo, st, 0);       /* EOB decision */
-      while ((v = (*block)[jpeg_natural_order[k]]) == 0) {
+      while ((v = absvalues[k - 1]) == 0) {
         arith_encode(cinfo, st + 1, 0);  st += 3;  k++;
       }
       arith_encode(cinfo, st + 1, 1);
       /* Figure F.6: Encoding nonzero value v */
       /* Figure F.7: Encoding the sign of v */
-      if (v > 0) {
-        arith_encode(cinfo, entropy->fixed_bin, 0);
-      } else {
-        v = -v;
+      if (AC_IS_NEGATIVE(bits, k - 1))
         arith_encode(cinfo, entropy->fixed_bin, 1);
-      }
+      else
+        arith_encode(cinfo, entropy->fixed_bin, 0);
       st += 2;
       /* Figure F.8: Encoding the magnitude category of v */
       m = 0;
@@ -929,6 +1052,12 @@ jinit_arith_encoder(j_compress_ptr cinfo)
   cinfo->entropy = (struct jpeg_entropy_encoder *)entropy;
   entropy->pub.start_pass = start_pass;
   entropy->pub.finish_pass = finish_pass;
+#ifdef WITH_SIMD
+  if (jsimd_can_encode_mcu_AC_refine_prepare())
+    entropy->AC_prepare = jsimd_encode_mcu_AC_refine_prepare;
+  else
+#endif
+    entropy->AC_prepare = encode_mcu_AC_prepare;
 
   /* Mark tables unallocated */
   for (i = 0; i < NUM_ARITH_TBLS; i++) {
@@ -19,6 +19,7 @@
 #include "jpeglib.h"
 #include "jsamplecomp.h"
 #include "jchuff.h"
+#include "jthread.h"
 
 /* We use a full-image coefficient buffer when doing Huffman optimization,
  * and also for writing multiple-scan JPEG files.  In all cases, the DCT
@@ -58,6 +59,11 @@ typedef struct {
   /* when using trellis quantization, need to keep a copy of all unquantized coefficients */
   jvirt_barray_ptr whole_image_uq[MAX_COMPONENTS];
 
+  /* state for multithreaded trellis passes */
+  boolean trellis_rows_done;    /* TRUE if all rows were already requantized */
+  JBLOCKARRAY *trellis_rows;    /* virtual buffer rows for each iMCU row */
+  double *trellis_norms;        /* per-worker trellis statistics */
+
 } my_coef_controller;
 
 typedef my_coef_controller *my_coef_ptr;
@@ -353,41 +359,276 @@ compress_first_pass(j_compress_ptr cinfo, _JSAMPIMAGE input_buf)
 }
 
 #if BITS_IN_JSAMPLE == 8
-METHODDEF(boolean)
-compress_trellis_pass (j_compress_ptr cinfo, JSAMPIMAGE input_buf)
+
+/* Entropy coder statistics used to estimate rates during trellis
+ * quantization of one component
+ */
+typedef struct {
+  c_derived_tbl dctbl;
+  c_derived_tbl actbl;
+#ifdef C_ARITH_CODING_SUPPORTED
+  arith_rates arith_r;
+#endif
+} trellis_tables;
+
+/* State shared by the workers of a parallel trellis pass */
+typedef struct {
+  j_compress_ptr cinfo;
+  trellis_tables *tables;       /* one per component in scan */
+  JBLOCKARRAY *rows;            /* buffer and buffer_dst for each iMCU row
+                                   and component in scan */
+  double *norms;                /* norm_src and norm_coef for each worker */
+} trellis_job;
+
+
+LOCAL(void)
+prepare_trellis_tables(j_compress_ptr cinfo, jpeg_component_info *compptr,
+                       trellis_tables *tables)
+{
+  c_derived_tbl *dctbl = &tables->dctbl;
+  c_derived_tbl *actbl = &tables->actbl;
+
+#ifdef C_ARITH_CODING_SUPPORTED
+  if (cinfo->arith_code)
+    jget_arith_rates(cinfo, compptr->dc_tbl_no, compptr->ac_tbl_no,
+                     &tables->arith_r);
+  else
+#endif
+  {
+    jpeg_make_c_derived_tbl(cinfo, TRUE, compptr->dc_tbl_no, &dctbl);
+    jpeg_make_c_derived_tbl(cinfo, FALSE, compptr->ac_tbl_no, &actbl);
+  }
+}
+
+
+/*
+ * Requantize the blocks of one component in one iMCU row.  The DC predictor
+ * is reset at the start of each iMCU row, and the "above" block row is taken
+ * from the same iMCU row, so different iMCU rows can be processed in any
+ * order.
+ */
+
+LOCAL(void)
+trellis_quantize_row(j_compress_ptr cinfo, jpeg_component_info *compptr,
+                     JDIMENSION iMCU_row, JBLOCKARRAY buffer,
+                     JBLOCKARRAY buffer_dst, trellis_tables *tables,
+                     double *norm_src, double *norm_coef, int worker)
 {
-  my_coef_ptr coef = (my_coef_ptr) cinfo->coef;
   JDIMENSION last_iMCU_row = cinfo->total_iMCU_rows - 1;
   JDIMENSION blocks_across, MCUs_across, MCUindex;
-  int bi, ci, h_samp_factor, block_row, block_rows, ndummy;
+  int bi, h_samp_factor, block_row, block_rows, ndummy;
   JCOEF lastDC;
-  jpeg_component_info *compptr;
-  JBLOCKARRAY buffer;
   JBLOCKROW thisblockrow, lastblockrow;
-  JBLOCKARRAY buffer_dst;
 
-  for (ci = 0; ci < cinfo->comps_in_scan; ci++) {
-    c_derived_tbl dctbl_data;
-    c_derived_tbl *dctbl = &dctbl_data;
-    c_derived_tbl actbl_data;
-    c_derived_tbl *actbl = &actbl_data;
-    
-#ifdef C_ARITH_CODING_SUPPORTED
-    arith_rates arith_r_data;
-    arith_rates *arith_r = &arith_r_data;
-#endif
-    
-    compptr = cinfo->cur_comp_info[ci];
+  /* Count non-dummy DCT block rows in this iMCU row. */
+  if (iMCU_row < last_iMCU_row)
+    block_rows = compptr->v_samp_factor;
+  else {
+    /* NB: can't use last_row_height here, since may not be set! */
+    block_rows = (int) (compptr->height_in_blocks % compptr->v_samp_factor);
+    if (block_rows == 0) block_rows = compptr->v_samp_factor;
+  }
+  blocks_across = compptr->width_in_blocks;
+  h_samp_factor = compptr->h_samp_factor;
+  /* Count number of dummy blocks to be added at the right margin. */
+  ndummy = (int) (blocks_across % h_samp_factor);
+  if (ndummy > 0)
+    ndummy = h_samp_factor - ndummy;
 
+  lastDC = 0;
+
+  /* Perform DCT for all non-dummy blocks in this iMCU row.  Each call
+   * on forward_DCT processes a complete horizontal row of DCT blocks.
+   */
+  for (block_row = 0; block_row < block_rows; block_row++) {
+    thisblockrow = buffer[block_row];
+    lastblockrow = (block_row > 0) ? buffer[block_row-1] : NULL;
 #ifdef C_ARITH_CODING_SUPPORTED
     if (cinfo->arith_code)
-      jget_arith_rates(cinfo, compptr->dc_tbl_no, compptr->ac_tbl_no, arith_r);
+      quantize_trellis_arith(cinfo, &tables->arith_r, thisblockrow,
+                             buffer_dst[block_row], blocks_across,
+                             cinfo->quant_tbl_ptrs[compptr->quant_tbl_no],
+                             norm_src, norm_coef,
+                             &lastDC, lastblockrow, buffer_dst[block_row-1],
+                             worker);
     else
 #endif
-    {
-      jpeg_make_c_derived_tbl(cinfo, TRUE, compptr->dc_tbl_no, &dctbl);
-      jpeg_make_c_derived_tbl(cinfo, FALSE, compptr->ac_tbl_no, &actbl);
+      quantize_trellis(cinfo, &tables->dctbl, &tables->actbl, thisblockrow,
+                       buffer_dst[block_row], blocks_across,
+                       cinfo->quant_tbl_ptrs[compptr->quant_tbl_no],
+                       norm_src, norm_coef,
+                       &lastDC, lastblockrow, buffer_dst[block_row-1],
+                       worker);
+
+    if (ndummy > 0) {
+      /* Create dummy blocks at the right edge of the image. */
+      thisblockrow += blocks_across; /* => first dummy block */
+      jzero_far((void *) thisblockrow, ndummy * sizeof(JBLOCK));
+      lastDC = thisblockrow[-1][0];
+      for (bi = 0; bi < ndummy; bi++) {
+        thisblockrow[bi][0] = lastDC;
+      }
+    }
+  }
+  /* If at end of image, create dummy block rows as needed.
+   * The tricky part here is that within each MCU, we want the DC values
+   * of the dummy blocks to match the last real block's DC value.
+   * This squeezes a few more bytes out of the resulting file...
+   */
+  if (iMCU_row == last_iMCU_row) {
+    blocks_across += ndummy;  /* include lower right corner */
+    MCUs_across = blocks_across / h_samp_factor;
+    for (block_row = block_rows; block_row < compptr->v_samp_factor;
+         block_row++) {
+      thisblockrow = buffer[block_row];
+      lastblockrow = buffer[block_row-1];
+      jzero_far((void *) thisblockrow,
+                (size_t) (blocks_across * sizeof(JBLOCK)));
+      for (MCUindex = 0; MCUindex < MCUs_across; MCUindex++) {
+        lastDC = lastblockrow[h_samp_factor-1][0];
+        for (bi = 0; bi < h_samp_factor; bi++) {
+          thisblockrow[bi][0] = lastDC;
+        }
+        thisblockrow += h_samp_factor; /* advance to next MCU in row */
+        lastblockrow += h_samp_factor;
+      }
+    }
+  }
+}
+
+
+/*
+ * Requantize all components of one iMCU row on behalf of a worker thread.
+ * The trellis statistics are accumulated into the worker's private sums.
+ */
+
+METHODDEF(void)
+trellis_row_task(void *arg, int task, int worker)
+{
+  trellis_job *job = (trellis_job *)arg;
+  j_compress_ptr cinfo = job->cinfo;
+  double *norms = job->norms + worker * 2 * NUM_QUANT_TBLS * DCTSIZE2;
+  JBLOCKARRAY *rows = job->rows + task * 2 * cinfo->comps_in_scan;
+  jpeg_component_info *compptr;
+  int ci;
+
+  for (ci = 0; ci < cinfo->comps_in_scan; ci++) {
+    compptr = cinfo->cur_comp_info[ci];
+    trellis_quantize_row(cinfo, compptr, (JDIMENSION)task, rows[2 * ci],
+                         rows[2 * ci + 1], &job->tables[ci],
+                         norms + compptr->quant_tbl_no * DCTSIZE2,
+                         norms + (NUM_QUANT_TBLS + compptr->quant_tbl_no) *
+                                 DCTSIZE2, worker);
+  }
+}
+
+
+/*
+ * Requantize every iMCU row of the current trellis pass at once, spreading
+ * the rows across worker threads.  Returns FALSE if this isn't possible, in
+ * which case the rows are processed one at a time as usual.
+ *
+ * The per-worker trellis statistics are sums of integer products, which are
+ * exact in double precision, so adding them to the master sums after the
+ * fact yields the same result as the serial pass.
+ */
+
+LOCAL(boolean)
+trellis_pass_parallel(j_compress_ptr cinfo)
+{
+  my_coef_ptr coef = (my_coef_ptr) cinfo->coef;
+  trellis_tables tables[MAX_COMPS_IN_SCAN];
+  trellis_job job;
+  jpeg_component_info *compptr;
+  JDIMENSION iMCU_row;
+  int ci, i, w, num_workers;
+
+  /* The forward DCT module allocates one trellis workspace for each of these
+   * workers.
+   */
+  num_workers = jthread_clamp_workers(cinfo->master->num_threads,
+                                      (int)cinfo->total_iMCU_rows);
+  if (num_workers < 2)
+    return FALSE;
+  /* Concurrent access to a virtual array is safe only if it never swaps. */
+  if (!jmem_virt_arrays_resident((j_common_ptr)cinfo))
+    return FALSE;
+
+  if (coef->trellis_rows == NULL) {
+    coef->trellis_rows = (JBLOCKARRAY *)
+      (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                  (size_t)cinfo->total_iMCU_rows *
+                                  2 * MAX_COMPS_IN_SCAN * sizeof(JBLOCKARRAY));
+    coef->trellis_norms = (double *)
+      (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                  (size_t)num_workers * 2 * NUM_QUANT_TBLS *
+                                  DCTSIZE2 * sizeof(double));
+  }
+
+  /* Align the virtual buffers up front, since that can't be done by more
+   * than one thread at a time.
+   */
+  for (ci = 0; ci < cinfo->comps_in_scan; ci++) {
+    compptr = cinfo->cur_comp_info[ci];
+    prepare_trellis_tables(cinfo, compptr, &tables[ci]);
+    for (iMCU_row = 0; iMCU_row < cinfo->total_iMCU_rows; iMCU_row++) {
+      JBLOCKARRAY *rows = coef->trellis_rows +
+                          iMCU_row * 2 * cinfo->comps_in_scan;
+
+      rows[2 * ci] = (*cinfo->mem->access_virt_barray)
+        ((j_common_ptr) cinfo, coef->whole_image[compptr->component_index],
+         iMCU_row * compptr->v_samp_factor,
+         (JDIMENSION)compptr->v_samp_factor, TRUE);
+      rows[2 * ci + 1] = (*cinfo->mem->access_virt_barray)
+        ((j_common_ptr) cinfo, coef->whole_image_uq[compptr->component_index],
+         iMCU_row * compptr->v_samp_factor,
+         (JDIMENSION)compptr->v_samp_factor, TRUE);
+    }
+  }
+  for (i = 0; i < num_workers * 2 * NUM_QUANT_TBLS * DCTSIZE2; i++)
+    coef->trellis_norms[i] = 0.0;
+
+  job.cinfo = cinfo;
+  job.tables = tables;
+  job.rows = coef->trellis_rows;
+  job.norms = coef->trellis_norms;
+  num_workers = jthread_run(&job, trellis_row_task,
+                            (int)cinfo->total_iMCU_rows, num_workers);
+
+  for (w = 0; w < num_workers; w++) {
+    double *norms = coef->trellis_norms + w * 2 * NUM_QUANT_TBLS * DCTSIZE2;
+
+    for (ci = 0; ci < NUM_QUANT_TBLS; ci++) {
+      for (i = 0; i < DCTSIZE2; i++) {
+        cinfo->master->norm_src[ci][i] += norms[ci * DCTSIZE2 + i];
+        cinfo->master->norm_coef[ci][i] +=
+          norms[(NUM_QUANT_TBLS + ci) * DCTSIZE2 + i];
+      }
     }
+  }
+  return TRUE;
+}
+
+
+METHODDEF(boolean)
+compress_trellis_pass (j_compress_ptr cinfo, JSAMPIMAGE input_buf)
+{
+  my_coef_ptr coef = (my_coef_ptr) cinfo->coef;
+  int ci;
+  jpeg_component_info *compptr;
+  JBLOCKARRAY buffer;
+  JBLOCKARRAY buffer_dst;
+
+  /* With multiple threads, all rows are requantized by the first call. */
+  if (coef->iMCU_row_num == 0)
+    coef->trellis_rows_done = cinfo->master->num_threads > 1 &&
+                              trellis_pass_parallel(cinfo);
+
+  for (ci = 0; ci < cinfo->comps_in_scan && !coef->trellis_rows_done; ci++) {
+    trellis_tables tables;
+
+    compptr = cinfo->cur_comp_info[ci];
+    prepare_trellis_tables(cinfo, compptr, &tables);
 
     /* Align the virtual buffer for this component. */
     buffer = (*cinfo->mem->access_virt_barray)
@@ -399,81 +640,11 @@ compress_trellis_pass (j_compress_ptr cinfo, JSAMPIMAGE input_buf)
     ((j_common_ptr) cinfo, coef->whole_image_uq[compptr->component_index],
      coef->iMCU_row_num * compptr->v_samp_factor,
      (JDIMENSION)compptr->v_samp_factor, TRUE);
-    
-    /* Count non-dummy DCT block rows in this iMCU row. */
-    if (coef->iMCU_row_num < last_iMCU_row)
-      block_rows = compptr->v_samp_factor;
-    else {
-      /* NB: can't use last_row_height here, since may not be set! */
-      block_rows = (int) (compptr->height_in_blocks % compptr->v_samp_factor);
-      if (block_rows == 0) block_rows = compptr->v_samp_factor;
-    }
-    blocks_across = compptr->width_in_blocks;
-    h_samp_factor = compptr->h_samp_factor;
-    /* Count number of dummy blocks to be added at the right margin. */
-    ndummy = (int) (blocks_across % h_samp_factor);
-    if (ndummy > 0)
-      ndummy = h_samp_factor - ndummy;
-    
-    lastDC = 0;
 
-    /* Perform DCT for all non-dummy blocks in this iMCU row.  Each call
-     * on forward_DCT processes a complete horizontal row of DCT blocks.
-     */
-    for (block_row = 0; block_row < block_rows; block_row++) {
-      thisblockrow = buffer[block_row];
-      lastblockrow = (block_row > 0) ? buffer[block_row-1] : NULL;
-#ifdef C_ARITH_CODING_SUPPORTED
-      if (cinfo->arith_code)
-        quantize_trellis_arith(cinfo, arith_r, thisblockrow,
-                               buffer_dst[block_row], blocks_across,
-                               cinfo->quant_tbl_ptrs[compptr->quant_tbl_no],
-                               cinfo->master->norm_src[compptr->quant_tbl_no],
-                               cinfo->master->norm_coef[compptr->quant_tbl_no],
-                               &lastDC, lastblockrow, buffer_dst[block_row-1]);
-      else
-#endif
-        quantize_trellis(cinfo, dctbl, actbl, thisblockrow,
-                         buffer_dst[block_row], blocks_across,
-                         cinfo->quant_tbl_ptrs[compptr->quant_tbl_no],
+    trellis_quantize_row(cinfo, compptr, coef->iMCU_row_num, buffer,
+                         buffer_dst, &tables,
                          cinfo->master->norm_src[compptr->quant_tbl_no],
-                         cinfo->master->norm_coef[compptr->quant_tbl_no],
-                         &lastDC, lastblockrow, buffer_dst[block_row-1]);
-      
-      if (ndummy > 0) {
-        /* Create dummy blocks at the right edge of the image. */
-        thisblockrow += blocks_across; /* => first dummy block */
-        jzero_far((void *) thisblockrow, ndummy * sizeof(JBLOCK));
-        lastDC = thisblockrow[-1][0];
-        for (bi = 0; bi < ndummy; bi++) {
-          thisblockrow[bi][0] = lastDC;
-        }
-      }
-    }
-    /* If at end of image, create dummy block rows as needed.
-     * The tricky part here is that within each MCU, we want the DC values
-     * of the dummy blocks to match the last real block's DC value.
-     * This squeezes a few more bytes out of the resulting file...
-     */
-    if (coef->iMCU_row_num == last_iMCU_row) {
-      blocks_across += ndummy;  /* include lower right corner */
-      MCUs_across = blocks_across / h_samp_factor;
-      for (block_row = block_rows; block_row < compptr->v_samp_factor;
-           block_row++) {
-        thisblockrow = buffer[block_row];
-        lastblockrow = buffer[block_row-1];
-        jzero_far((void *) thisblockrow,
-                  (size_t) (blocks_across * sizeof(JBLOCK)));
-        for (MCUindex = 0; MCUindex < MCUs_across; MCUindex++) {
-          lastDC = lastblockrow[h_samp_factor-1][0];
-          for (bi = 0; bi < h_samp_factor; bi++) {
-            thisblockrow[bi][0] = lastDC;
-          }
-          thisblockrow += h_samp_factor; /* advance to next MCU in row */
-          lastblockrow += h_samp_factor;
-        }
-      }
-    }
+                         cinfo->master->norm_coef[compptr->quant_tbl_no], 0);
   }
 
   /* NB: compress_output will increment iMCU_row_num if successful.
@@ -617,3 +788,26 @@ _jinit_c_coef_controller(j_compress_ptr cinfo, boolean need_full_buffer)
     coef->whole_image[0] = NULL; /* flag for no virtual arrays */
   }
 }
+
+
+/*
+ * Initialize a coefficient buffer controller that reads the full-image
+ * buffer of another compressor instance.  This is used by the parallel scan
+ * optimization trials, each of which needs its own pass state but shares the
+ * (fully resident and read-only) coefficient arrays of the parent.
+ */
+
+GLOBAL(void)
+_jinit_c_coef_clone(j_compress_ptr cinfo, j_compress_ptr src)
+{
+  my_coef_ptr coef;
+
+  if (cinfo->data_precision != BITS_IN_JSAMPLE)
+    ERREXIT1(cinfo, JERR_BAD_PRECISION, cinfo->data_precision);
+
+  coef = (my_coef_ptr)
+    (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                sizeof(my_coef_controller));
+  memcpy(coef, src->coef, sizeof(my_coef_controller));
+  cinfo->coef = (struct jpeg_c_coef_controller *)coef;
+}
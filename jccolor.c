@@ -664,9 +664,9 @@ _jinit_color_converter(j_compress_ptr cinfo)
     if (cinfo->num_components != 3)
       ERREXIT(cinfo, JERR_BAD_J_COLORSPACE);
     if (IsExtRGB(cinfo->in_color_space)) {
-#ifdef WITH_SIMD
-      if (jsimd_can_rgb_ycc())
-        cconvert->pub._color_convert = jsimd_rgb_ycc_convert;
+#if defined(WITH_SIMD) || defined(WITH_SIMD12)
+      if (_jsimd_can_rgb_ycc())
+        cconvert->pub._color_convert = _jsimd_rgb_ycc_convert;
       else
 #endif
       {
@@ -22,8 +22,10 @@
 #include "jpeglib.h"
 #include "jdct.h"               /* Private declarations for DCT subsystem */
 #include "jsimddct.h"
-#include "jchuff.h"
+#include "jsimd.h"
+#include "jchuff.h"             /* Declarations shared with jc*huff.c */
 #include "jpeg_nbits.h"
+#include "jthread.h"
 #include <assert.h>
 #include <math.h>
 
@@ -47,9 +49,47 @@ typedef void (*quantize_method_ptr) (JCOEFPTR coef_block, DCTELEM *divisors,
 typedef void (*float_quantize_method_ptr) (JCOEFPTR coef_block,
                                            FAST_FLOAT *divisors,
                                            FAST_FLOAT *workspace);
+typedef int (*trellis_search_method_ptr) (const char *ehufsi, const int *runs,
+                                          const float *run_cost, int num_runs,
+                                          const float *candidate_dist,
+                                          int num_candidates);
 
 METHODDEF(void) quantize(JCOEFPTR, DCTELEM *, DCTELEM *);
 
+#define DC_TRELLIS_MAX_CANDIDATES 9
+
+/* Scratch arrays used by quantize_trellis() and quantize_trellis_arith(),
+ * sized for the widest component
+ */
+typedef struct {
+  float *accumulated_zero_block_cost;
+  float *accumulated_block_cost;
+  int *block_run_start;
+  int *requires_eob;
+  float *accumulated_dc_cost[DC_TRELLIS_MAX_CANDIDATES];
+  int *dc_cost_backtrack[DC_TRELLIS_MAX_CANDIDATES];
+  JCOEF *dc_candidate[DC_TRELLIS_MAX_CANDIDATES];
+  int *dc_context[DC_TRELLIS_MAX_CANDIDATES];
+} trellis_workspace;
+
+/* When the warm context is enabled, the divisors for each quantization table
+ * slot are kept in the permanent pool along with the table and DCT method from
+ * which they were computed, so that encoding a series of images with the same
+ * quantization tables does not compute them again.
+ */
+typedef struct {
+  boolean valid;                /* TRUE if the entry has been filled in */
+  J_DCT_METHOD dct_method;
+  UINT16 quantval[DCTSIZE2];
+#if BITS_IN_JSAMPLE == 8 && defined(WITH_SIMD)
+  boolean simd_quantize;        /* FALSE if the divisors require quantize() */
+#endif
+  DCTELEM divisors[DCTSIZE2 * 4];
+#ifdef DCT_FLOAT_SUPPORTED
+  FAST_FLOAT float_divisors[DCTSIZE2];
+#endif
+} divisor_cache_entry;
+
 typedef struct {
   struct jpeg_forward_dct pub;  /* public fields */
 
@@ -77,6 +117,13 @@ typedef struct {
   FAST_FLOAT *float_divisors[NUM_QUANT_TBLS];
   FAST_FLOAT *float_workspace;
 #endif
+
+  /* Trellis quantization scratch space, one per worker thread */
+  trellis_workspace *trellis_ws;
+  int num_trellis_ws;
+
+  /* Rate/distortion search for one AC coefficient (Huffman trellis only) */
+  trellis_search_method_ptr trellis_search;
 } my_fdct_controller;
 
 typedef my_fdct_controller *my_fdct_ptr;
@@ -232,6 +279,87 @@ compute_reciprocal(UINT16 divisor, DCTELEM *dtbl)
 #endif
 
 
+#if BITS_IN_JSAMPLE == 8
+
+/*
+ * Allocate the trellis quantization scratch space.  This is done once per
+ * image, so that quantize_trellis() need not allocate memory for each block
+ * row.  Multithreaded trellis passes need one workspace per worker.
+ */
+
+LOCAL(void)
+alloc_trellis_workspace(j_compress_ptr cinfo)
+{
+  my_fdct_ptr fdct = (my_fdct_ptr)cinfo->fdct;
+  JDIMENSION max_blocks = 0;
+  size_t ws_size;
+  char *ptr;
+  int ci, w, i;
+  jpeg_component_info *compptr;
+
+  for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
+       ci++, compptr++)
+    max_blocks = MAX(max_blocks, compptr->width_in_blocks);
+
+  /* This must agree with the worker count used by jccoefct.c */
+  fdct->num_trellis_ws =
+    jthread_clamp_workers(cinfo->master->num_threads,
+                          (int)cinfo->total_iMCU_rows);
+  fdct->trellis_ws = (trellis_workspace *)
+    (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                fdct->num_trellis_ws *
+                                sizeof(trellis_workspace));
+  memset(fdct->trellis_ws, 0, fdct->num_trellis_ws * sizeof(trellis_workspace));
+
+  ws_size = 0;
+  if (cinfo->master->trellis_eob_opt)
+    ws_size += (max_blocks + 1) * (2 * sizeof(float) + 2 * sizeof(int));
+  if (cinfo->master->trellis_quant_dc) {
+    ws_size += max_blocks * (sizeof(float) + sizeof(int) + sizeof(JCOEF)) *
+               DC_TRELLIS_MAX_CANDIDATES;
+    if (cinfo->arith_code)
+      ws_size += max_blocks * sizeof(int) * DC_TRELLIS_MAX_CANDIDATES;
+  }
+  if (ws_size == 0)
+    return;
+
+  for (w = 0; w < fdct->num_trellis_ws; w++) {
+    trellis_workspace *ws = &fdct->trellis_ws[w];
+
+    ptr = (char *)
+      (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_IMAGE, ws_size);
+    /* 4-byte types first, so that every array is suitably aligned */
+    if (cinfo->master->trellis_eob_opt) {
+      ws->accumulated_zero_block_cost = (float *)ptr;
+      ptr += (max_blocks + 1) * sizeof(float);
+      ws->accumulated_block_cost = (float *)ptr;
+      ptr += (max_blocks + 1) * sizeof(float);
+      ws->block_run_start = (int *)ptr;
+      ptr += (max_blocks + 1) * sizeof(int);
+      ws->requires_eob = (int *)ptr;
+      ptr += (max_blocks + 1) * sizeof(int);
+    }
+    if (cinfo->master->trellis_quant_dc) {
+      for (i = 0; i < DC_TRELLIS_MAX_CANDIDATES; i++) {
+        ws->accumulated_dc_cost[i] = (float *)ptr;
+        ptr += max_blocks * sizeof(float);
+        ws->dc_cost_backtrack[i] = (int *)ptr;
+        ptr += max_blocks * sizeof(int);
+        if (cinfo->arith_code) {
+          ws->dc_context[i] = (int *)ptr;
+          ptr += max_blocks * sizeof(int);
+        }
+      }
+      for (i = 0; i < DC_TRELLIS_MAX_CANDIDATES; i++) {
+        ws->dc_candidate[i] = (JCOEF *)ptr;
+        ptr += max_blocks * sizeof(JCOEF);
+      }
+    }
+  }
+}
+
+#endif
+
 /*
  * Initialize for a processing pass.
  * Verify that all referenced Q-tables are present, and set up
@@ -249,6 +377,23 @@ start_pass_fdctmgr(j_compress_ptr cinfo)
   jpeg_component_info *compptr;
   JQUANT_TBL *qtbl;
   DCTELEM *dtbl;
+  divisor_cache_entry *cache = NULL, *entry = NULL;
+#if BITS_IN_JSAMPLE == 8 && defined(WITH_SIMD)
+  boolean simd_quantize;
+#endif
+
+  if (cinfo->master->warm_context) {
+    void **pcache = &cinfo->master->divisor_cache[BITS_IN_JSAMPLE == 12];
+
+    if (*pcache == NULL) {
+      *pcache = (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo,
+                                            JPOOL_PERMANENT,
+                                            NUM_QUANT_TBLS *
+                                            sizeof(divisor_cache_entry));
+      memset(*pcache, 0, NUM_QUANT_TBLS * sizeof(divisor_cache_entry));
+    }
+    cache = (divisor_cache_entry *)(*pcache);
+  }
 
   for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
        ci++, compptr++) {
@@ -258,6 +403,28 @@ start_pass_fdctmgr(j_compress_ptr cinfo)
         cinfo->quant_tbl_ptrs[qtblno] == NULL)
       ERREXIT1(cinfo, JERR_NO_QUANT_TABLE, qtblno);
     qtbl = cinfo->quant_tbl_ptrs[qtblno];
+#if BITS_IN_JSAMPLE == 8 && defined(WITH_SIMD)
+    simd_quantize = TRUE;
+#endif
+    /* Use the retained divisors if the table and DCT method haven't changed.
+     * Otherwise, compute the divisors in place.
+     */
+    if (cache != NULL) {
+      entry = &cache[qtblno];
+      fdct->divisors[qtblno] = entry->divisors;
+#ifdef DCT_FLOAT_SUPPORTED
+      fdct->float_divisors[qtblno] = entry->float_divisors;
+#endif
+      if (entry->valid && entry->dct_method == cinfo->dct_method &&
+          !memcmp(entry->quantval, qtbl->quantval, sizeof(entry->quantval))) {
+#if BITS_IN_JSAMPLE == 8 && defined(WITH_SIMD)
+        if (!entry->simd_quantize && fdct->quantize == jsimd_quantize)
+          fdct->quantize = quantize;
+#endif
+        continue;
+      }
+      entry->valid = FALSE;
+    }
     /* Compute divisors for this quant table */
     /* We may do this more than once for same table, but it's not a big deal */
     switch (cinfo->dct_method) {
@@ -275,9 +442,8 @@ start_pass_fdctmgr(j_compress_ptr cinfo)
       for (i = 0; i < DCTSIZE2; i++) {
 #if BITS_IN_JSAMPLE == 8
 #ifdef WITH_SIMD
-        if (!compute_reciprocal(qtbl->quantval[i] << 3, &dtbl[i]) &&
-            fdct->quantize == jsimd_quantize)
-          fdct->quantize = quantize;
+        if (!compute_reciprocal(qtbl->quantval[i] << 3, &dtbl[i]))
+          simd_quantize = FALSE;
 #else
         compute_reciprocal(qtbl->quantval[i] << 3, &dtbl[i]);
 #endif
@@ -322,9 +488,8 @@ start_pass_fdctmgr(j_compress_ptr cinfo)
           if (!compute_reciprocal(
                 DESCALE(MULTIPLY16V16((JLONG)qtbl->quantval[i],
                                       (JLONG)aanscales[i]),
-                        CONST_BITS - 3), &dtbl[i]) &&
-              fdct->quantize == jsimd_quantize)
-            fdct->quantize = quantize;
+                        CONST_BITS - 3), &dtbl[i]))
+            simd_quantize = FALSE;
 #else
           compute_reciprocal(
             DESCALE(MULTIPLY16V16((JLONG)qtbl->quantval[i],
@@ -381,7 +546,25 @@ start_pass_fdctmgr(j_compress_ptr cinfo)
       ERREXIT(cinfo, JERR_NOT_COMPILED);
       break;
     }
+#if BITS_IN_JSAMPLE == 8 && defined(WITH_SIMD)
+    if (!simd_quantize && fdct->quantize == jsimd_quantize)
+      fdct->quantize = quantize;
+#endif
+
+    if (entry != NULL) {
+      entry->dct_method = cinfo->dct_method;
+      memcpy(entry->quantval, qtbl->quantval, sizeof(entry->quantval));
+#if BITS_IN_JSAMPLE == 8 && defined(WITH_SIMD)
+      entry->simd_quantize = simd_quantize;
+#endif
+      entry->valid = TRUE;
+    }
   }
+
+#if BITS_IN_JSAMPLE == 8
+  if (cinfo->master->trellis_quant && fdct->trellis_ws == NULL)
+    alloc_trellis_workspace(cinfo);
+#endif
 }
 
 METHODDEF(float)
@@ -412,33 +595,19 @@ catmull_rom(const DCTELEM value1, const DCTELEM value2, const DCTELEM value3, co
      Edges with white are similar to waveform clipping, and anti-clipping algorithms can turn square waves
      into softer ones that compress better.
 
+  overshoot_max_runs() replaces each run of maximum-valued samples (in zigzag order) with a curve
+  that overshoots the maximum.  sum and maxsample_count are the sum of the samples in the block and
+  the number of maximum-valued samples, which preprocess_deringing() computes for every block.
  */
-METHODDEF(void)
-preprocess_deringing(DCTELEM *data, const JQUANT_TBL *quantization_table)
+LOCAL(void)
+overshoot_max_runs(DCTELEM *data, const JQUANT_TBL *quantization_table,
+                   int sum, int maxsample_count)
 {
   const DCTELEM maxsample = 255 - CENTERJSAMPLE;
   const int size = DCTSIZE * DCTSIZE;
-
-  /* Decoders don't handle overflow of DC very well, so calculate
-     maximum overflow that is safe to do without increasing DC out of range */
-  int sum = 0;
-  int maxsample_count = 0;
   int i;
   DCTELEM maxovershoot;
   int n;
-  
-  for(i=0; i < size; i++) {
-    sum += data[i];
-    if (data[i] >= maxsample) {
-      maxsample_count++;
-    }
-  }
-
-  /* If nothing reaches max value there's nothing to overshoot
-     and if the block is completely flat, it's already the best case. */
-  if (!maxsample_count || maxsample_count == size) {
-    return;
-  }
 
   /* Too much overshoot is not good: increased amplitude will cost bits, and the cost is proportional to quantization (here using DC quant as a rough guide). */
   maxovershoot = maxsample + MIN(MIN(31, 2*quantization_table->quantval[0]), (maxsample * size - sum) / maxsample_count);
@@ -497,20 +666,17 @@ preprocess_deringing(DCTELEM *data, const JQUANT_TBL *quantization_table)
   while(n < size);
 }
 
-/*
-  Float version of preprocess_deringing()
- */
 METHODDEF(void)
-float_preprocess_deringing(FAST_FLOAT *data, const JQUANT_TBL *quantization_table)
+preprocess_deringing(DCTELEM *data, const JQUANT_TBL *quantization_table)
 {
-  const FAST_FLOAT maxsample = 255 - CENTERJSAMPLE;
+  const DCTELEM maxsample = 255 - CENTERJSAMPLE;
   const int size = DCTSIZE * DCTSIZE;
 
-  FAST_FLOAT sum = 0;
+  /* Decoders don't handle overflow of DC very well, so calculate
+     maximum overflow that is safe to do without increasing DC out of range */
+  int sum = 0;
   int maxsample_count = 0;
   int i;
-  int n;
-  FAST_FLOAT maxovershoot;
   
   for(i=0; i < size; i++) {
     sum += data[i];
@@ -519,10 +685,50 @@ float_preprocess_deringing(FAST_FLOAT *data, const JQUANT_TBL *quantization_tabl
     }
   }
 
+  /* If nothing reaches max value there's nothing to overshoot
+     and if the block is completely flat, it's already the best case. */
   if (!maxsample_count || maxsample_count == size) {
     return;
   }
 
+  overshoot_max_runs(data, quantization_table, sum, maxsample_count);
+}
+
+#ifdef WITH_SIMD
+/*
+  Same as preprocess_deringing(), but the maximum-valued samples are counted
+  and the block is summed using SIMD instructions.  Only the blocks that are
+  partly at the maximum value (typically the edges of a white background)
+  reach the scalar code.
+ */
+METHODDEF(void)
+preprocess_deringing_simd(DCTELEM *data,
+                          const JQUANT_TBL *quantization_table)
+{
+  int sum;
+  int maxsample_count = jsimd_preprocess_deringing(data, &sum);
+
+  if (!maxsample_count || maxsample_count == DCTSIZE2)
+    return;
+
+  overshoot_max_runs(data, quantization_table, sum, maxsample_count);
+}
+#endif
+
+/*
+  Float version of overshoot_max_runs()
+ */
+LOCAL(void)
+float_overshoot_max_runs(FAST_FLOAT *data,
+                         const JQUANT_TBL *quantization_table,
+                         FAST_FLOAT sum, int maxsample_count)
+{
+  const FAST_FLOAT maxsample = 255 - CENTERJSAMPLE;
+  const int size = DCTSIZE * DCTSIZE;
+  int i;
+  int n;
+  FAST_FLOAT maxovershoot;
+
   maxovershoot = maxsample + MIN(MIN(31, 2*quantization_table->quantval[0]), (maxsample * size - sum) / maxsample_count);
 
   n = 0;
@@ -569,6 +775,52 @@ float_preprocess_deringing(FAST_FLOAT *data, const JQUANT_TBL *quantization_tabl
   while(n < size);
 }
 
+/*
+  Float version of preprocess_deringing()
+ */
+METHODDEF(void)
+float_preprocess_deringing(FAST_FLOAT *data, const JQUANT_TBL *quantization_table)
+{
+  const FAST_FLOAT maxsample = 255 - CENTERJSAMPLE;
+  const int size = DCTSIZE * DCTSIZE;
+
+  FAST_FLOAT sum = 0;
+  int maxsample_count = 0;
+  int i;
+  
+  for(i=0; i < size; i++) {
+    sum += data[i];
+    if (data[i] >= maxsample) {
+      maxsample_count++;
+    }
+  }
+
+  if (!maxsample_count || maxsample_count == size) {
+    return;
+  }
+
+  float_overshoot_max_runs(data, quantization_table, sum, maxsample_count);
+}
+
+#ifdef WITH_SIMD
+/*
+  Float version of preprocess_deringing_simd().  The samples are whole
+  numbers, so their sum is exact regardless of the order of the additions.
+ */
+METHODDEF(void)
+float_preprocess_deringing_simd(FAST_FLOAT *data,
+                                const JQUANT_TBL *quantization_table)
+{
+  FAST_FLOAT sum;
+  int maxsample_count = jsimd_preprocess_deringing_float(data, &sum);
+
+  if (!maxsample_count || maxsample_count == DCTSIZE2)
+    return;
+
+  float_overshoot_max_runs(data, quantization_table, sum, maxsample_count);
+}
+#endif
+
 /*
  * Load data into workspace, applying unsigned->signed conversion.
  */
@@ -925,19 +1177,65 @@ static const float jpeg_lambda_weights_csf_luma[64] = {
   0.43454f, 0.42146f, 0.34609f, 0.24072f, 0.15975f, 0.10701f, 0.07558f, 0.05875f,
 };
 
-#define DC_TRELLIS_MAX_CANDIDATES 9
-
 LOCAL(int) get_num_dc_trellis_candidates(int dc_quantval) {
   /* Higher qualities can tolerate higher DC distortion */
   return MIN(DC_TRELLIS_MAX_CANDIDATES, (2 + 60 / dc_quantval)|1);
 }
 
 #if BITS_IN_JSAMPLE == 8
+
+/*
+ * Find the cheapest way to code one AC coefficient, given the possible starts
+ * of the zero run that precedes it and the candidate values for it.
+ *
+ * runs[2*r] is the offset in ehufsi[] of the run that begins at run start r
+ * (16 times the run length modulo 16), and runs[2*r+1] is the number of bits
+ * spent on ZRL codes for that run.  run_cost[r] is the accumulated cost up to
+ * run start r plus the distortion of zeroing the coefficients in the run.
+ * Candidate k has k+1 magnitude bits and distortion candidate_dist[k].
+ *
+ * Returns (r << 4) + k for the cheapest combination, or -1 if none costs less
+ * than 1e38.  Ties go to the lowest r and then the lowest k, which is the order
+ * in which the combinations are visited here.  The SIMD implementations must
+ * return the same result (there is no tolerance): they evaluate each cost with
+ * the same single-precision operations in the same order, so only the search
+ * order differs.
+ */
+
+METHODDEF(int)
+trellis_search(const char *ehufsi, const int *runs, const float *run_cost,
+               int num_runs, const float *candidate_dist, int num_candidates)
+{
+  float best_cost = 1e38;
+  float cost;
+  int best = -1;
+  int r, k;
+
+  for (r = 0; r < num_runs; r++) {
+    for (k = 0; k < num_candidates; k++) {
+      int coef_bits = ehufsi[runs[2 * r] + k + 1];
+      if (coef_bits == 0)
+        continue;
+
+      cost = (coef_bits + k + 1 + runs[2 * r + 1]) + candidate_dist[k];
+      cost += run_cost[r];
+
+      if (cost < best_cost) {
+        best_cost = cost;
+        best = (r << 4) + k;
+      }
+    }
+  }
+  return best;
+}
+
 GLOBAL(void)
 quantize_trellis(j_compress_ptr cinfo, c_derived_tbl *dctbl, c_derived_tbl *actbl, JBLOCKROW coef_blocks, JBLOCKROW src, JDIMENSION num_blocks,
                  JQUANT_TBL * qtbl, double *norm_src, double *norm_coef, JCOEF *last_dc_val,
-                 JBLOCKROW coef_blocks_above, JBLOCKROW src_above)
+                 JBLOCKROW coef_blocks_above, JBLOCKROW src_above, int worker)
 {
+  my_fdct_ptr fdct = (my_fdct_ptr)cinfo->fdct;
+  trellis_workspace *ws = &fdct->trellis_ws[worker];
   int i, j, k, l;
   float accumulated_zero_dist[DCTSIZE2];
   float accumulated_cost[DCTSIZE2];
@@ -963,8 +1261,12 @@ quantize_trellis(j_compress_ptr cinfo, c_derived_tbl *dctbl, c_derived_tbl *actb
   float best_cost_skip;
   float cost;
   int zero_run;
-  int run_bits;
   int rate;
+  int runs[2 * DCTSIZE2];
+  float run_cost[DCTSIZE2];
+  int run_origin[DCTSIZE2];
+  int num_runs;
+  int best;
   float *accumulated_dc_cost[DC_TRELLIS_MAX_CANDIDATES];
   int *dc_cost_backtrack[DC_TRELLIS_MAX_CANDIDATES];
   JCOEF *dc_candidate[DC_TRELLIS_MAX_CANDIDATES];
@@ -979,16 +1281,10 @@ quantize_trellis(j_compress_ptr cinfo, c_derived_tbl *dctbl, c_derived_tbl *actb
   if (Se < Ss)
     return;
   if (cinfo->master->trellis_eob_opt) {
-    accumulated_zero_block_cost = (float *)malloc((num_blocks + 1) * sizeof(float));
-    accumulated_block_cost = (float *)malloc((num_blocks + 1) * sizeof(float));
-    block_run_start = (int *)malloc(num_blocks * sizeof(int));
-    requires_eob = (int *)malloc((num_blocks + 1) * sizeof(int));
-    if (!accumulated_zero_block_cost ||
-        !accumulated_block_cost ||
-        !block_run_start ||
-        !requires_eob) {
-      ERREXIT(cinfo, JERR_OUT_OF_MEMORY);
-    }
+    accumulated_zero_block_cost = ws->accumulated_zero_block_cost;
+    accumulated_block_cost = ws->accumulated_block_cost;
+    block_run_start = ws->block_run_start;
+    requires_eob = ws->requires_eob;
 
     accumulated_zero_block_cost[0] = 0;
     accumulated_block_cost[0] = 0;
@@ -997,14 +1293,9 @@ quantize_trellis(j_compress_ptr cinfo, c_derived_tbl *dctbl, c_derived_tbl *actb
   
   if (cinfo->master->trellis_quant_dc) {
     for (i = 0; i < dc_trellis_candidates; i++) {
-      accumulated_dc_cost[i] = (float *)malloc(num_blocks * sizeof(float));
-      dc_cost_backtrack[i] = (int *)malloc(num_blocks * sizeof(int));
-      dc_candidate[i] = (JCOEF *)malloc(num_blocks * sizeof(JCOEF));
-      if (!accumulated_dc_cost[i] ||
-          !dc_cost_backtrack[i] ||
-          !dc_candidate[i]) {
-        ERREXIT(cinfo, JERR_OUT_OF_MEMORY);
-      }
+      accumulated_dc_cost[i] = ws->accumulated_dc_cost[i];
+      dc_cost_backtrack[i] = ws->dc_cost_backtrack[i];
+      dc_candidate[i] = ws->dc_candidate[i];
     }
   }
   
@@ -1154,6 +1445,8 @@ quantize_trellis(j_compress_ptr cinfo, c_derived_tbl *dctbl, c_derived_tbl *actb
       
       accumulated_cost[i] = 1e38;
       
+      /* Gather the possible starts of the preceding zero run */
+      num_runs = 0;
       for (j = Ss-1; j < i; j++) {
         int zz = jpeg_natural_order[j];
         if (j != Ss-1 && coef_blocks[bi][zz] == 0)
@@ -1163,24 +1456,25 @@ quantize_trellis(j_compress_ptr cinfo, c_derived_tbl *dctbl, c_derived_tbl *actb
         if ((zero_run >> 4) && actbl->ehufsi[0xf0] == 0)
           continue;
         
-        run_bits = (zero_run >> 4) * actbl->ehufsi[0xf0];
-        zero_run &= 15;
+        runs[2 * num_runs] = 16 * (zero_run & 15);
+        runs[2 * num_runs + 1] = (zero_run >> 4) * actbl->ehufsi[0xf0];
+        run_cost[num_runs] = accumulated_zero_dist[i-1] - accumulated_zero_dist[j] + accumulated_cost[j];
+        run_origin[num_runs++] = j;
+      }
 
-        for (k = 0; k < num_candidates; k++) {
-          int coef_bits = actbl->ehufsi[16 * zero_run + candidate_bits[k]];
-          if (coef_bits == 0)
-            continue;
-          
-          rate = coef_bits + candidate_bits[k] + run_bits;
-          cost = rate + candidate_dist[k];
-          cost += accumulated_zero_dist[i-1] - accumulated_zero_dist[j] + accumulated_cost[j];
-          
-          if (cost < accumulated_cost[i]) {
-            coef_blocks[bi][z] = (candidate[k] ^ sign) - sign;
-            accumulated_cost[i] = cost;
-            run_start[i] = j;
-          }
-        }
+      best = (*fdct->trellis_search) (actbl->ehufsi, runs, run_cost, num_runs,
+                                      candidate_dist, num_candidates);
+      if (best >= 0) {
+        j = best >> 4;
+        k = best & 15;
+        rate = actbl->ehufsi[runs[2 * j] + candidate_bits[k]] +
+               candidate_bits[k] + runs[2 * j + 1];
+        cost = rate + candidate_dist[k];
+        cost += run_cost[j];
+
+        coef_blocks[bi][z] = (candidate[k] ^ sign) - sign;
+        accumulated_cost[i] = cost;
+        run_start[i] = run_origin[j];
       }
     }
     
@@ -1290,10 +1584,6 @@ quantize_trellis(j_compress_ptr cinfo, c_derived_tbl *dctbl, c_derived_tbl *actb
       last_block = block_run_start[bi]-1;
       bi--;
     }
-    free(accumulated_zero_block_cost);
-    free(accumulated_block_cost);
-    free(block_run_start);
-    free(requires_eob);
   }
   
   if (cinfo->master->trellis_q_opt) {
@@ -1318,12 +1608,6 @@ quantize_trellis(j_compress_ptr cinfo, c_derived_tbl *dctbl, c_derived_tbl *actb
 
     /* Save DC predictor */
     *last_dc_val = coef_blocks[num_blocks-1][0];
-
-    for (i = 0; i < dc_trellis_candidates; i++) {
-      free(accumulated_dc_cost[i]);
-      free(dc_cost_backtrack[i]);
-      free(dc_candidate[i]);
-    }
   }
 
 }
@@ -1333,8 +1617,10 @@ quantize_trellis(j_compress_ptr cinfo, c_derived_tbl *dctbl, c_derived_tbl *actb
 GLOBAL(void)
 quantize_trellis_arith(j_compress_ptr cinfo, arith_rates *r, JBLOCKROW coef_blocks, JBLOCKROW src, JDIMENSION num_blocks,
                  JQUANT_TBL * qtbl, double *norm_src, double *norm_coef, JCOEF *last_dc_val,
-                 JBLOCKROW coef_blocks_above, JBLOCKROW src_above)
+                 JBLOCKROW coef_blocks_above, JBLOCKROW src_above, int worker)
 {
+  my_fdct_ptr fdct = (my_fdct_ptr)cinfo->fdct;
+  trellis_workspace *ws = &fdct->trellis_ws[worker];
   int i, j, k, l;
   float accumulated_zero_dist[DCTSIZE2];
   float accumulated_cost[DCTSIZE2];
@@ -1371,16 +1657,10 @@ quantize_trellis_arith(j_compress_ptr cinfo, arith_rates *r, JBLOCKROW coef_bloc
   
   if (cinfo->master->trellis_quant_dc) {
     for (i = 0; i < dc_trellis_candidates; i++) {
-      accumulated_dc_cost[i] = (float *)malloc(num_blocks * sizeof(float));
-      dc_cost_backtrack[i] = (int *)malloc(num_blocks * sizeof(int));
-      dc_candidate[i] = (JCOEF *)malloc(num_blocks * sizeof(JCOEF));
-      dc_context[i] = (int *)malloc(num_blocks * sizeof(int));
-      if (!accumulated_dc_cost[i] ||
-          !dc_cost_backtrack[i] ||
-          !dc_candidate[i] ||
-          !dc_context[i]) {
-        ERREXIT(cinfo, JERR_OUT_OF_MEMORY);
-      }
+      accumulated_dc_cost[i] = ws->accumulated_dc_cost[i];
+      dc_cost_backtrack[i] = ws->dc_cost_backtrack[i];
+      dc_candidate[i] = ws->dc_candidate[i];
+      dc_context[i] = ws->dc_context[i];
     }
   }
   
@@ -1656,13 +1936,6 @@ quantize_trellis_arith(j_compress_ptr cinfo, arith_rates *r, JBLOCKROW coef_bloc
     
     /* Save DC predictor */
     *last_dc_val = coef_blocks[num_blocks-1][0];
-    
-    for (i = 0; i < dc_trellis_candidates; i++) {
-      free(accumulated_dc_cost[i]);
-      free(dc_cost_backtrack[i]);
-      free(dc_candidate[i]);
-      free(dc_context[i]);
-    }
   }
 }
 #endif
@@ -1743,7 +2016,12 @@ _jinit_forward_dct(j_compress_ptr cinfo)
       fdct->convsamp = convsamp;
 
     if (cinfo->master->overshoot_deringing) {
-      fdct->preprocess = preprocess_deringing;
+#ifdef WITH_SIMD
+      if (jsimd_can_preprocess_deringing())
+        fdct->preprocess = preprocess_deringing_simd;
+      else
+#endif
+        fdct->preprocess = preprocess_deringing;
     } else {
       fdct->preprocess = NULL;
     }
@@ -1766,7 +2044,12 @@ _jinit_forward_dct(j_compress_ptr cinfo)
       fdct->float_convsamp = convsamp_float;
 
     if (cinfo->master->overshoot_deringing) {
-      fdct->float_preprocess = float_preprocess_deringing;
+#ifdef WITH_SIMD
+      if (jsimd_can_preprocess_deringing_float())
+        fdct->float_preprocess = float_preprocess_deringing_simd;
+      else
+#endif
+        fdct->float_preprocess = float_preprocess_deringing;
     } else {
       fdct->float_preprocess = NULL;
     }
@@ -1803,4 +2086,46 @@ _jinit_forward_dct(j_compress_ptr cinfo)
     fdct->float_divisors[i] = NULL;
 #endif
   }
+  fdct->trellis_ws = NULL;
+
+#if BITS_IN_JSAMPLE == 8
+#ifdef WITH_SIMD
+  if (jsimd_can_trellis_search())
+    fdct->trellis_search = jsimd_trellis_search;
+  else
+#endif
+    fdct->trellis_search = trellis_search;
+#endif
+}
+
+#if BITS_IN_JSAMPLE == 8
+
+/*
+ * Initialize an FDCT manager that does no DCT at all.  The transcoder
+ * (jctrans.c) uses this when requantizing coefficients, so that it can call
+ * quantize_trellis() on dequantized coefficients instead of FDCT output.
+ * Only the trellis quantization state is set up.
+ */
+
+GLOBAL(void)
+jinit_trellis_quantizer(j_compress_ptr cinfo)
+{
+  my_fdct_ptr fdct;
+
+  fdct = (my_fdct_ptr)
+    (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                sizeof(my_fdct_controller));
+  memset(fdct, 0, sizeof(my_fdct_controller));
+  cinfo->fdct = (struct jpeg_forward_dct *)fdct;
+
+#ifdef WITH_SIMD
+  if (jsimd_can_trellis_search())
+    fdct->trellis_search = jsimd_trellis_search;
+  else
+#endif
+    fdct->trellis_search = trellis_search;
+
+  alloc_trellis_workspace(cinfo);
 }
+
+#endif
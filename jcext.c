@@ -27,7 +27,12 @@ jpeg_c_bool_param_supported (const j_compress_ptr cinfo, J_BOOLEAN_PARAM param)
   case JBOOLEAN_USE_SCANS_IN_TRELLIS:
   case JBOOLEAN_TRELLIS_Q_OPT:
   case JBOOLEAN_OVERSHOOT_DERINGING:
+  case JBOOLEAN_ESTIMATE_SCANS:
+  case JBOOLEAN_WARM_CONTEXT:
+  case JBOOLEAN_TRANSCODE_REQUANTIZE:
     return TRUE;
+  case JBOOLEAN_RECORD_DECODE_INDEX: /* decompression only */
+    break;
   }
 
   return FALSE;
@@ -63,6 +68,16 @@ jpeg_c_set_bool_param (j_compress_ptr cinfo, J_BOOLEAN_PARAM param,
   case JBOOLEAN_OVERSHOOT_DERINGING:
     cinfo->master->overshoot_deringing = value;
     break;
+  case JBOOLEAN_ESTIMATE_SCANS:
+    cinfo->master->estimate_scans = value;
+    break;
+  case JBOOLEAN_WARM_CONTEXT:
+    cinfo->master->warm_context = value;
+    jmem_retain_image_pool((j_common_ptr)cinfo, value);
+    break;
+  case JBOOLEAN_TRANSCODE_REQUANTIZE:
+    cinfo->master->transcode_requantize = value;
+    break;
   default:
     ERREXIT(cinfo, JERR_BAD_PARAM);
   }
@@ -89,6 +104,12 @@ jpeg_c_get_bool_param (const j_compress_ptr cinfo, J_BOOLEAN_PARAM param)
     return cinfo->master->trellis_q_opt;
   case JBOOLEAN_OVERSHOOT_DERINGING:
     return cinfo->master->overshoot_deringing;
+  case JBOOLEAN_ESTIMATE_SCANS:
+    return cinfo->master->estimate_scans;
+  case JBOOLEAN_WARM_CONTEXT:
+    return cinfo->master->warm_context;
+  case JBOOLEAN_TRANSCODE_REQUANTIZE:
+    return cinfo->master->transcode_requantize;
   default:
     ERREXIT(cinfo, JERR_BAD_PARAM);
   }
@@ -157,7 +178,11 @@ jpeg_c_int_param_supported (const j_compress_ptr cinfo, J_INT_PARAM param)
   case JINT_TRELLIS_NUM_LOOPS:
   case JINT_BASE_QUANT_TBL_IDX:
   case JINT_DC_SCAN_OPT_MODE:
+  case JINT_NUM_THREADS:
     return TRUE;
+  case JINT_SCAN_BUDGET:        /* decompression only */
+  case JINT_CHECKPOINT_INTERVAL:
+    break;
   }
 
   return FALSE;
@@ -191,6 +216,11 @@ jpeg_c_set_int_param (j_compress_ptr cinfo, J_INT_PARAM param, int value)
   case JINT_DC_SCAN_OPT_MODE:
     cinfo->master->dc_scan_opt_mode = value;
     break;
+  case JINT_NUM_THREADS:
+    if (value < 1)
+      ERREXIT(cinfo, JERR_BAD_PARAM_VALUE);
+    cinfo->master->num_threads = value;
+    break;
   default:
     ERREXIT(cinfo, JERR_BAD_PARAM);
   }
@@ -211,6 +241,8 @@ jpeg_c_get_int_param (const j_compress_ptr cinfo, J_INT_PARAM param)
     return cinfo->master->quant_tbl_master_idx;
   case JINT_DC_SCAN_OPT_MODE:
     return cinfo->master->dc_scan_opt_mode;
+  case JINT_NUM_THREADS:
+    return cinfo->master->num_threads;
   default:
     ERREXIT(cinfo, JERR_BAD_PARAM);
   }
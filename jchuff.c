@@ -221,6 +221,26 @@ start_pass_huff(j_compress_ptr cinfo, boolean gather_statistics)
 }
 
 
+/*
+ * When the warm context is enabled, the most recently derived table for each
+ * Huffman table slot is retained in the permanent pool, so that encoding a
+ * series of images with the same tables does not derive them again.
+ */
+
+typedef struct {
+  boolean valid;                /* TRUE if the entry has been filled in */
+  boolean lossless;             /* value of cinfo->master->lossless */
+  UINT8 bits[17];               /* copy of the source table definition */
+  UINT8 huffval[256];
+  c_derived_tbl dtbl;
+} huff_tbl_cache_entry;
+
+typedef struct {
+  huff_tbl_cache_entry dc[NUM_HUFF_TBLS];
+  huff_tbl_cache_entry ac[NUM_HUFF_TBLS];
+} huff_tbl_cache;
+
+
 /*
  * Compute the derived values for a Huffman table.
  * This routine also performs some validation checks on the table.
@@ -238,6 +258,7 @@ jpeg_make_c_derived_tbl(j_compress_ptr cinfo, boolean isDC, int tblno,
   char huffsize[257];
   unsigned int huffcode[257];
   unsigned int code;
+  huff_tbl_cache_entry *entry = NULL;
 
   /* Note that huffsize[] and huffcode[] are filled in code-length order,
    * paralleling the order of the symbols themselves in htbl->huffval[].
@@ -258,6 +279,30 @@ jpeg_make_c_derived_tbl(j_compress_ptr cinfo, boolean isDC, int tblno,
                                   sizeof(c_derived_tbl));
   dtbl = *pdtbl;
 
+  /* Use the retained table if the table definition hasn't changed */
+  if (cinfo->master->warm_context) {
+    huff_tbl_cache *cache = (huff_tbl_cache *)cinfo->master->huff_tbl_cache;
+
+    if (cache == NULL) {
+      cache = (huff_tbl_cache *)
+        (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
+                                    sizeof(huff_tbl_cache));
+      memset(cache, 0, sizeof(huff_tbl_cache));
+      cinfo->master->huff_tbl_cache = (void *)cache;
+    }
+    entry = isDC ? &cache->dc[tblno] : &cache->ac[tblno];
+    if (entry->valid && entry->lossless == cinfo->master->lossless &&
+        !memcmp(entry->bits, htbl->bits, sizeof(entry->bits))) {
+      for (p = 0, l = 1; l <= 16; l++)
+        p += htbl->bits[l];
+      if (!memcmp(entry->huffval, htbl->huffval, p)) {
+        memcpy(dtbl, &entry->dtbl, sizeof(c_derived_tbl));
+        return;
+      }
+    }
+    entry->valid = FALSE;
+  }
+
   /* Figure C.1: make table of Huffman code length for each symbol */
 
   p = 0;
@@ -315,6 +360,14 @@ jpeg_make_c_derived_tbl(j_compress_ptr cinfo, boolean isDC, int tblno,
     dtbl->ehufco[i] = huffcode[p];
     dtbl->ehufsi[i] = huffsize[p];
   }
+
+  if (entry != NULL) {
+    entry->lossless = cinfo->master->lossless;
+    memcpy(entry->bits, htbl->bits, sizeof(entry->bits));
+    memcpy(entry->huffval, htbl->huffval, lastp);
+    memcpy(&entry->dtbl, dtbl, sizeof(c_derived_tbl));
+    entry->valid = TRUE;
+  }
 }
 
 
@@ -1148,6 +1201,27 @@ finish_pass_gather(j_compress_ptr cinfo)
 }
 
 
+
+
+/*
+ * Return the symbol frequency counts that are being gathered for the given
+ * Huffman table during a statistics-gathering pass, or NULL if the current
+ * scan does not use the table.  The counts can be modified before the pass is
+ * finished, which allows several compressors that encode different parts of
+ * the same image to merge their statistics and generate identical tables.
+ */
+
+GLOBAL(long *)
+jpeg_huff_stats(j_compress_ptr cinfo, boolean isDC, int tblno)
+{
+  huff_entropy_ptr entropy = (huff_entropy_ptr)cinfo->entropy;
+
+  if (tblno < 0 || tblno >= NUM_HUFF_TBLS ||
+      entropy->pub.finish_pass != finish_pass_gather)
+    return NULL;
+  return isDC ? entropy->dc_count_ptrs[tblno] : entropy->ac_count_ptrs[tblno];
+}
+
 #endif /* ENTROPY_OPT_SUPPORTED */
 
 
@@ -14,6 +14,9 @@
  * progressive encoder (jcphuff.c).  No other modules need to see these.
  */
 
+#ifndef JCHUFF_H
+#define JCHUFF_H
+
 /* The legal range of a DCT coefficient is
  *  -1024 .. +1023  for 8-bit data;
  * -16384 .. +16383 for 12-bit data.
@@ -44,6 +47,11 @@ EXTERN(void) jpeg_make_c_derived_tbl(j_compress_ptr cinfo, boolean isDC,
 EXTERN(void) quantize_trellis
         (j_compress_ptr cinfo, c_derived_tbl *dctbl, c_derived_tbl *actbl, JBLOCKROW coef_blocks, JBLOCKROW src, JDIMENSION num_blocks,
                  JQUANT_TBL * qtbl, double *norm_src, double *norm_coef, JCOEF *last_dc_val,
-         JBLOCKROW coef_blocks_above, JBLOCKROW src_above);
+         JBLOCKROW coef_blocks_above, JBLOCKROW src_above, int worker);
 EXTERN(void) jpeg_gen_optimal_table(j_compress_ptr cinfo, JHUFF_TBL *htbl,
                                     long freq[]);
+
+/* Access the statistics of a statistics-gathering pass */
+EXTERN(long *) jpeg_huff_stats(j_compress_ptr cinfo, boolean isDC, int tblno);
+
+#endif /* JCHUFF_H */
@@ -18,6 +18,7 @@
 #include "jinclude.h"
 #include "jpeglib.h"
 #include "jlossls.h"
+#include "jsimd.h"
 
 #ifdef C_LOSSLESS_SUPPORTED
 
@@ -182,6 +183,33 @@ jpeg_difference7(j_compress_ptr cinfo, int ci,
   (void)(Rc);
 }
 
+#if defined(WITH_SIMD) || defined(WITH_SIMD12) || defined(WITH_SIMD16)
+
+/*
+ * SIMD differencer for the second and subsequent rows in a scan or restart
+ * interval.  The SIMD routine differences the row using the predictor
+ * specified in the scan header, so we need only account for the restart
+ * interval here.
+ */
+
+METHODDEF(void)
+jpeg_difference_simd(j_compress_ptr cinfo, int ci,
+                     _JSAMPROW input_buf, _JSAMPROW prev_row,
+                     JDIFFROW diff_buf, JDIMENSION width)
+{
+  lossless_comp_ptr losslessc = (lossless_comp_ptr)cinfo->fdct;
+
+  _jsimd_difference(cinfo, input_buf, prev_row, diff_buf, width);
+
+  /* Account for restart interval (no-op if not using restarts) */
+  if (cinfo->restart_interval) {
+    if (--losslessc->restart_rows_to_go[ci] == 0)
+      reset_predictor(cinfo, ci);
+  }
+}
+
+#endif
+
 
 /*
  * Differencer for the first row in a scan or restart interval.  The first
@@ -206,6 +234,12 @@ jpeg_difference_first_row(j_compress_ptr cinfo, int ci,
    * for a new restart interval.
    */
   if (!restart) {
+#if defined(WITH_SIMD) || defined(WITH_SIMD12) || defined(WITH_SIMD16)
+    if (_jsimd_can_difference()) {
+      losslessc->predict_difference[ci] = jpeg_difference_simd;
+      return;
+    }
+#endif
     switch (cinfo->Ss) {
     case 1:
       losslessc->predict_difference[ci] = jpeg_difference1;
@@ -281,9 +315,14 @@ start_pass_lossless(j_compress_ptr cinfo)
   int ci;
 
   /* Set scaler function based on Pt */
-  if (cinfo->Al)
-    losslessc->scaler_scale = simple_downscale;
-  else
+  if (cinfo->Al) {
+#if defined(WITH_SIMD) || defined(WITH_SIMD12) || defined(WITH_SIMD16)
+    if (_jsimd_can_downscale())
+      losslessc->scaler_scale = _jsimd_downscale;
+    else
+#endif
+      losslessc->scaler_scale = simple_downscale;
+  } else
     losslessc->scaler_scale = noscale;
 
   /* Check that the restart interval is an integer multiple of the number
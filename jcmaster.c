@@ -25,6 +25,8 @@
 #include "jcmaster.h"
 #include "jmemsys.h"
 #include "jconfigint.h"
+#include "jthread.h"
+#include <setjmp.h>
 
 
 /*
@@ -770,6 +772,104 @@ copy_buffer (j_compress_ptr cinfo, int scan_idx)
   cinfo->dest->free_in_buffer -= size;
 }
 
+/*
+ * Release the buffer of a candidate scan as soon as the search has determined
+ * that it will not be part of the output, so that only the winning scans (and
+ * the LSB refinement scans that they may need) are held in memory.
+ */
+
+LOCAL(void)
+free_scan_buffer (j_compress_ptr cinfo, int scan_idx)
+{
+  my_master_ptr master = (my_master_ptr) cinfo->master;
+
+  if (master->scan_buffer[scan_idx]) {
+    free(master->scan_buffer[scan_idx]);
+    master->scan_buffer[scan_idx] = NULL;
+  }
+}
+
+/*
+ * List the candidate scans that make up the output, in output order, once the
+ * search has finished.  Returns the number of scans.
+ */
+
+LOCAL(int)
+get_selected_scans (j_compress_ptr cinfo, int *scans)
+{
+  my_master_ptr master = (my_master_ptr) cinfo->master;
+
+  int base_scan_idx = 0;
+  int luma_freq_split_scan_start = cinfo->master->num_scans_luma_dc +
+                                   3 * cinfo->master->Al_max_luma + 2;
+  int chroma_freq_split_scan_start = cinfo->master->num_scans_luma +
+                                     cinfo->master->num_scans_chroma_dc +
+                                     (6 * cinfo->master->Al_max_chroma + 4);
+  int min_Al = MIN(master->best_Al_luma, master->best_Al_chroma);
+  int Al, n = 0;
+
+  scans[n++] = 0;
+
+  if (cinfo->num_scans > cinfo->master->num_scans_luma &&
+      cinfo->master->dc_scan_opt_mode != 0) {
+    base_scan_idx = cinfo->master->num_scans_luma;
+
+    if (master->interleave_chroma_dc && cinfo->master->dc_scan_opt_mode != 1)
+      scans[n++] = base_scan_idx;
+    else {
+      scans[n++] = base_scan_idx+1;
+      scans[n++] = base_scan_idx+2;
+    }
+  }
+
+  if (master->best_freq_split_idx_luma == 0)
+    scans[n++] = luma_freq_split_scan_start;
+  else {
+    scans[n++] = luma_freq_split_scan_start+2*(master->best_freq_split_idx_luma-1)+1;
+    scans[n++] = luma_freq_split_scan_start+2*(master->best_freq_split_idx_luma-1)+2;
+  }
+
+  /* the LSB refinements as well */
+  for (Al = master->best_Al_luma-1; Al >= min_Al; Al--)
+    scans[n++] = 3 + 3*Al;
+
+  if (cinfo->num_scans > cinfo->master->num_scans_luma) {
+    if (master->best_freq_split_idx_chroma == 0) {
+      scans[n++] = chroma_freq_split_scan_start;
+      scans[n++] = chroma_freq_split_scan_start+1;
+    }
+    else {
+      scans[n++] = chroma_freq_split_scan_start+4*(master->best_freq_split_idx_chroma-1)+2;
+      scans[n++] = chroma_freq_split_scan_start+4*(master->best_freq_split_idx_chroma-1)+3;
+      scans[n++] = chroma_freq_split_scan_start+4*(master->best_freq_split_idx_chroma-1)+4;
+      scans[n++] = chroma_freq_split_scan_start+4*(master->best_freq_split_idx_chroma-1)+5;
+    }
+
+    base_scan_idx = cinfo->master->num_scans_luma +
+                    cinfo->master->num_scans_chroma_dc;
+
+    for (Al = master->best_Al_chroma-1; Al >= min_Al; Al--) {
+      scans[n++] = base_scan_idx + 6*Al + 4;
+      scans[n++] = base_scan_idx + 6*Al + 5;
+    }
+  }
+
+  for (Al = min_Al-1; Al >= 0; Al--) {
+    scans[n++] = 3 + 3*Al;
+
+    if (cinfo->num_scans > cinfo->master->num_scans_luma) {
+      scans[n++] = base_scan_idx + 6*Al + 4;
+      scans[n++] = base_scan_idx + 6*Al + 5;
+    }
+  }
+
+  return n;
+}
+
+/* Forward declarations */
+LOCAL(void) encode_selected_scans(j_compress_ptr cinfo, const int *scans,
+                                  int num_scans);
+
 LOCAL(void)
 select_scans (j_compress_ptr cinfo, int next_scan_number)
 {
@@ -792,6 +892,9 @@ select_scans (j_compress_ptr cinfo, int next_scan_number)
       cost += master->scan_size[next_scan_number-1];
       for (i = 0; i < Al; i++)
         cost += master->scan_size[3 + 3*i];
+      /* Only the refinement scans of an Al trial are ever output. */
+      free_scan_buffer(cinfo, next_scan_number-2);
+      free_scan_buffer(cinfo, next_scan_number-1);
       
       if (Al == 0 || cost < master->best_cost) {
         master->best_cost = cost;
@@ -815,8 +918,17 @@ select_scans (j_compress_ptr cinfo, int next_scan_number)
       cost += master->scan_size[next_scan_number-1];
       
       if (cost < master->best_cost) {
+        if (master->best_freq_split_idx_luma == 0)
+          free_scan_buffer(cinfo, luma_freq_split_scan_start);
+        else {
+          free_scan_buffer(cinfo, luma_freq_split_scan_start+2*(master->best_freq_split_idx_luma-1)+1);
+          free_scan_buffer(cinfo, luma_freq_split_scan_start+2*(master->best_freq_split_idx_luma-1)+2);
+        }
         master->best_cost = cost;
         master->best_freq_split_idx_luma = idx;
+      } else {
+        free_scan_buffer(cinfo, next_scan_number-2);
+        free_scan_buffer(cinfo, next_scan_number-1);
       }
       
       /* if after testing first 3, no split is the best, don't search further */
@@ -836,6 +948,14 @@ select_scans (j_compress_ptr cinfo, int next_scan_number)
       base_scan_idx = cinfo->master->num_scans_luma;
 
       master->interleave_chroma_dc = master->scan_size[base_scan_idx] <= master->scan_size[base_scan_idx+1] + master->scan_size[base_scan_idx+2];
+      if (cinfo->master->dc_scan_opt_mode == 0 ||
+          (master->interleave_chroma_dc && cinfo->master->dc_scan_opt_mode != 1)) {
+        free_scan_buffer(cinfo, base_scan_idx+1);
+        free_scan_buffer(cinfo, base_scan_idx+2);
+      }
+      if (cinfo->master->dc_scan_opt_mode == 0 ||
+          !master->interleave_chroma_dc || cinfo->master->dc_scan_opt_mode == 1)
+        free_scan_buffer(cinfo, base_scan_idx);
       
     } else if (next_scan_number > cinfo->master->num_scans_luma +
                                   cinfo->master->num_scans_chroma_dc &&
@@ -854,6 +974,8 @@ select_scans (j_compress_ptr cinfo, int next_scan_number)
           cost += master->scan_size[base_scan_idx + 4 + 6*i];
           cost += master->scan_size[base_scan_idx + 5 + 6*i];
         }
+        for (i = 1; i <= 4; i++)
+          free_scan_buffer(cinfo, next_scan_number-i);
         
         if (Al == 0 || cost < master->best_cost) {
           master->best_cost = cost;
@@ -879,8 +1001,20 @@ select_scans (j_compress_ptr cinfo, int next_scan_number)
         cost += master->scan_size[next_scan_number-1];
         
         if (cost < master->best_cost) {
+          if (master->best_freq_split_idx_chroma == 0) {
+            free_scan_buffer(cinfo, chroma_freq_split_scan_start);
+            free_scan_buffer(cinfo, chroma_freq_split_scan_start+1);
+          } else {
+            int i;
+            for (i = 2; i <= 5; i++)
+              free_scan_buffer(cinfo, chroma_freq_split_scan_start+4*(master->best_freq_split_idx_chroma-1)+i);
+          }
           master->best_cost = cost;
           master->best_freq_split_idx_chroma = idx;
+        } else {
+          int i;
+          for (i = 1; i <= 4; i++)
+            free_scan_buffer(cinfo, next_scan_number-i);
         }
         
         /* if after testing first 3, no split is the best, don't search further */
@@ -896,71 +1030,446 @@ select_scans (j_compress_ptr cinfo, int next_scan_number)
   }
   
   if (master->scan_number == cinfo->num_scans - 1) {
-    int i, Al;
-    int min_Al = MIN(master->best_Al_luma, master->best_Al_chroma);
-    
-    copy_buffer(cinfo, 0);
+    int scans[64], num_selected, i;
 
-    if (cinfo->num_scans > cinfo->master->num_scans_luma &&
-        cinfo->master->dc_scan_opt_mode != 0) {
-      base_scan_idx = cinfo->master->num_scans_luma;
-      
-      if (master->interleave_chroma_dc && cinfo->master->dc_scan_opt_mode != 1)
-        copy_buffer(cinfo, base_scan_idx);
-      else {
-        copy_buffer(cinfo, base_scan_idx+1);
-        copy_buffer(cinfo, base_scan_idx+2);
-      }
+    num_selected = get_selected_scans(cinfo, scans);
+    encode_selected_scans(cinfo, scans, num_selected);
+    for (i = 0; i < num_selected; i++)
+      copy_buffer(cinfo, scans[i]);
+
+    /* free the memory allocated for buffers */
+    for (i = 0; i < cinfo->num_scans; i++)
+      free_scan_buffer(cinfo, i);
+  }
+}
+
+
+/*
+ * Parallel scan optimization.
+ *
+ * When optimize_scans is enabled, every candidate scan in the search script
+ * is encoded into its own memory buffer, and select_scans() then picks the
+ * cheapest combination.  The trial encodes only read the full-image
+ * coefficient buffer, so with JINT_NUM_THREADS > 1 we encode them
+ * concurrently, each in a private compressor object that shares the parent's
+ * coefficient arrays, marker writer, and quantization tables.  select_scans()
+ * is then replayed over the results in the usual order, so the output is
+ * identical to that of the serial search.
+ *
+ * The frequency-split scans use the best Al value found by the preceding
+ * successive approximation trials, so the luma and chroma frequency-split
+ * scans are deferred to later batches until that value is known.  Trials that
+ * the serial search would have skipped are encoded anyway; they are simply
+ * discarded.
+ *
+ * If JBOOLEAN_ESTIMATE_SCANS is enabled, then the trials are used regardless
+ * of the number of threads, but they only gather Huffman statistics.  The
+ * size of each candidate scan is computed from the statistics and the
+ * resulting optimal Huffman tables, and only the scans that select_scans()
+ * ends up choosing are encoded (see encode_selected_scans().)  The estimates
+ * ignore byte stuffing, so the search may occasionally choose a different
+ * (but nearly equivalent) combination of scans than it would otherwise.
+ */
+
+typedef struct {
+  struct jpeg_error_mgr pub;    /* "public" fields */
+  jmp_buf setjmp_buffer;        /* for return to encode_scan_trial() */
+} trial_error_mgr;
+
+typedef trial_error_mgr *trial_error_ptr;
+
+/* Destination manager that merely counts the bytes written to it */
+typedef struct {
+  struct jpeg_destination_mgr pub; /* public fields */
+  size_t count;                 /* # of bytes written so far */
+  JOCTET buffer[64];
+} count_destination_mgr;
+
+typedef count_destination_mgr *count_dest_ptr;
+
+/* Per-worker state, allocated by the main thread */
+typedef struct {
+  struct jpeg_compress_struct cinfo;
+  trial_error_mgr err;
+  my_comp_master master;
+  jpeg_component_info comp_info[MAX_COMPONENTS];
+  JHUFF_TBL dc_huff_tbls[NUM_HUFF_TBLS];
+  JHUFF_TBL ac_huff_tbls[NUM_HUFF_TBLS];
+  count_destination_mgr count_dest; /* for estimating scan header sizes */
+  boolean failed;               /* TRUE if a trial on this worker failed */
+  struct jpeg_error_mgr failure; /* error state of the failed trial */
+} scan_trial;
+
+typedef struct {
+  j_compress_ptr cinfo;         /* parent compressor */
+  scan_trial *trials;           /* one per worker */
+  int num_workers;              /* # of entries in trials[] */
+  boolean estimate;             /* TRUE=only estimate the scan sizes */
+  int num_scans;                /* # of scans in this batch */
+  int scans[64];                /* scan_info[] indices to encode */
+} scan_trial_job;
+
+
+METHODDEF(void)
+init_count_destination(j_compress_ptr cinfo)
+{
+  count_dest_ptr dest = (count_dest_ptr)cinfo->dest;
+
+  dest->pub.next_output_byte = dest->buffer;
+  dest->pub.free_in_buffer = sizeof(dest->buffer);
+}
+
+
+METHODDEF(boolean)
+empty_count_output_buffer(j_compress_ptr cinfo)
+{
+  count_dest_ptr dest = (count_dest_ptr)cinfo->dest;
+
+  dest->count += sizeof(dest->buffer);
+  dest->pub.next_output_byte = dest->buffer;
+  dest->pub.free_in_buffer = sizeof(dest->buffer);
+  return TRUE;
+}
+
+
+METHODDEF(void)
+term_count_destination(j_compress_ptr cinfo)
+{
+  count_dest_ptr dest = (count_dest_ptr)cinfo->dest;
+
+  dest->count += sizeof(dest->buffer) - dest->pub.free_in_buffer;
+  dest->pub.free_in_buffer = sizeof(dest->buffer);
+}
+
+
+METHODDEF(void)
+trial_error_exit(j_common_ptr cinfo)
+{
+  trial_error_ptr err = (trial_error_ptr)cinfo->err;
+
+  longjmp(err->setjmp_buffer, 1);
+}
+
+
+LOCAL(void)
+compress_trial_rows(j_compress_ptr cinfo)
+{
+  JDIMENSION iMCU_row;
+  boolean ok;
+
+  for (iMCU_row = 0; iMCU_row < cinfo->total_iMCU_rows; iMCU_row++) {
+    if (cinfo->data_precision == 12)
+      ok = (*cinfo->coef->compress_data_12) (cinfo, (J12SAMPIMAGE)NULL);
+    else
+      ok = (*cinfo->coef->compress_data) (cinfo, (JSAMPIMAGE)NULL);
+    if (!ok)
+      ERREXIT(cinfo, JERR_CANT_SUSPEND);
+  }
+}
+
+
+/*
+ * Encode one trial scan, or estimate its size.  This runs concurrently with
+ * other trials, so it must not modify anything in the parent other than its
+ * own scan buffer and size.
+ */
+
+METHODDEF(void)
+encode_scan_trial(void *arg, int task, int worker)
+{
+  scan_trial_job *job = (scan_trial_job *)arg;
+  j_compress_ptr cinfo = job->cinfo;
+  my_master_ptr master = (my_master_ptr)cinfo->master;
+  scan_trial *t = &job->trials[worker];
+  j_compress_ptr trial = &t->cinfo;
+  int scan = job->scans[task];
+  int i;
+
+  if (t->failed)
+    return;
+
+  memcpy(trial, cinfo, sizeof(struct jpeg_compress_struct));
+  memcpy(&t->err.pub, cinfo->err, sizeof(struct jpeg_error_mgr));
+  t->err.pub.error_exit = trial_error_exit;
+  trial->err = &t->err.pub;
+  trial->mem = NULL;
+  trial->progress = NULL;
+  trial->dest = NULL;
+  if (setjmp(t->err.setjmp_buffer)) {
+    /* Make sure the parent sees the current scan buffer, so it can free it */
+    if (trial->dest != NULL)
+      (*trial->dest->term_destination) (trial);
+    t->failure = t->err.pub;
+    t->failed = TRUE;
+    jpeg_destroy((j_common_ptr)trial);
+    return;
+  }
+  jinit_memory_mgr((j_common_ptr)trial);
+
+  /* Make private copies of everything that per-scan setup and entropy
+   * encoding modify.
+   */
+  memcpy(&t->master, master, sizeof(my_comp_master));
+  t->master.pub.trellis_passes = FALSE;
+  /* The derived table caches belong to the parent and aren't thread-safe */
+  t->master.pub.warm_context = FALSE;
+  t->master.scan_number = scan;
+  trial->master = &t->master.pub;
+  memcpy(t->comp_info, cinfo->comp_info,
+         cinfo->num_components * sizeof(jpeg_component_info));
+  trial->comp_info = t->comp_info;
+  for (i = 0; i < NUM_HUFF_TBLS; i++) {
+    if (cinfo->dc_huff_tbl_ptrs[i] != NULL) {
+      t->dc_huff_tbls[i] = *cinfo->dc_huff_tbl_ptrs[i];
+      trial->dc_huff_tbl_ptrs[i] = &t->dc_huff_tbls[i];
     }
-    
-    if (master->best_freq_split_idx_luma == 0)
-      copy_buffer(cinfo, luma_freq_split_scan_start);
-    else {
-      copy_buffer(cinfo, luma_freq_split_scan_start+2*(master->best_freq_split_idx_luma-1)+1);
-      copy_buffer(cinfo, luma_freq_split_scan_start+2*(master->best_freq_split_idx_luma-1)+2);
+    if (cinfo->ac_huff_tbl_ptrs[i] != NULL) {
+      t->ac_huff_tbls[i] = *cinfo->ac_huff_tbl_ptrs[i];
+      trial->ac_huff_tbl_ptrs[i] = &t->ac_huff_tbls[i];
     }
-    
-    /* copy the LSB refinements as well */
-    for (Al = master->best_Al_luma-1; Al >= min_Al; Al--)
-      copy_buffer(cinfo, 3 + 3*Al);
+  }
 
-    if (cinfo->num_scans > cinfo->master->num_scans_luma) {
-      if (master->best_freq_split_idx_chroma == 0) {
-        copy_buffer(cinfo, chroma_freq_split_scan_start);
-        copy_buffer(cinfo, chroma_freq_split_scan_start+1);
-      }
-      else {
-        copy_buffer(cinfo, chroma_freq_split_scan_start+4*(master->best_freq_split_idx_chroma-1)+2);
-        copy_buffer(cinfo, chroma_freq_split_scan_start+4*(master->best_freq_split_idx_chroma-1)+3);
-        copy_buffer(cinfo, chroma_freq_split_scan_start+4*(master->best_freq_split_idx_chroma-1)+4);
-        copy_buffer(cinfo, chroma_freq_split_scan_start+4*(master->best_freq_split_idx_chroma-1)+5);
-      }
-      
-      base_scan_idx = cinfo->master->num_scans_luma +
-                      cinfo->master->num_scans_chroma_dc;
-      
-      for (Al = master->best_Al_chroma-1; Al >= min_Al; Al--) {
-        copy_buffer(cinfo, base_scan_idx + 6*Al + 4);
-        copy_buffer(cinfo, base_scan_idx + 6*Al + 5);
-      }
+  select_scan_parameters(trial);
+  per_scan_setup(trial);
+
+  if (trial->arith_code) {
+#ifdef C_ARITH_CODING_SUPPORTED
+    jinit_arith_encoder(trial);
+#else
+    ERREXIT(trial, JERR_ARITH_NOTIMPL);
+#endif
+  } else if (trial->progressive_mode)
+    jinit_phuff_encoder(trial);
+  else
+    jinit_huff_encoder(trial);
+  if (trial->data_precision == 12)
+    j12init_c_coef_clone(trial, cinfo);
+  else
+    jinit_c_coef_clone(trial, cinfo);
+
+  if (job->estimate) {
+    count_dest_ptr dest = &t->count_dest;
+
+    /* The entropy encoder expects a destination even when only gathering
+     * statistics.
+     */
+    dest->pub.init_destination = init_count_destination;
+    dest->pub.empty_output_buffer = empty_count_output_buffer;
+    dest->pub.term_destination = term_count_destination;
+    trial->dest = &dest->pub;
+    (*trial->dest->init_destination) (trial);
+
+    /* Gather statistics for the scan.  That also counts the bits that aren't
+     * Huffman-coded, so this works for DC refinement scans as well.
+     */
+    (*trial->entropy->start_pass) (trial, TRUE);
+    (*trial->coef->start_pass) (trial, JBUF_CRANK_DEST);
+    compress_trial_rows(trial);
+    (*trial->entropy->finish_pass) (trial);
+
+    /* Measure the scan header, including the new Huffman tables */
+    dest->count = 0;
+    (*trial->marker->write_scan_header) (trial);
+    (*trial->dest->term_destination) (trial);
+
+    master->scan_size[scan] = (unsigned long)
+      (dest->count + (t->master.pub.gathered_bits + 7) / 8);
+  } else {
+    /* The entropy encoder expects a destination even when only gathering
+     * statistics.
+     */
+    master->scan_size[scan] = 0;
+    jpeg_mem_dest_internal(trial, &master->scan_buffer[scan],
+                           &master->scan_size[scan], JPOOL_IMAGE);
+
+    /* Same sequence as the huff_opt_pass and output_pass cases of
+     * prepare_for_pass()
+     */
+    if (trial->optimize_coding && (trial->Ss != 0 || trial->Ah == 0)) {
+      (*trial->entropy->start_pass) (trial, TRUE);
+      (*trial->coef->start_pass) (trial, JBUF_CRANK_DEST);
+      compress_trial_rows(trial);
+      (*trial->entropy->finish_pass) (trial);
     }
-    
-    for (Al = min_Al-1; Al >= 0; Al--) {
-      copy_buffer(cinfo, 3 + 3*Al);
-      
-      if (cinfo->num_scans > cinfo->master->num_scans_luma) {
-        copy_buffer(cinfo, base_scan_idx + 6*Al + 4);
-        copy_buffer(cinfo, base_scan_idx + 6*Al + 5);
-      }
+
+    (*trial->dest->init_destination) (trial);
+    (*trial->entropy->start_pass) (trial, FALSE);
+    (*trial->coef->start_pass) (trial, JBUF_CRANK_DEST);
+    (*trial->marker->write_scan_header) (trial);
+    compress_trial_rows(trial);
+    (*trial->entropy->finish_pass) (trial);
+    (*trial->dest->term_destination) (trial);
+  }
+
+  master->actual_Al[scan] = t->master.actual_Al[scan];
+  jpeg_destroy((j_common_ptr)trial);
+}
+
+
+/*
+ * Determine the number of workers to use for a batch of trials.
+ */
+
+LOCAL(int)
+scan_trial_workers(j_compress_ptr cinfo, int num_tasks)
+{
+  /* Concurrent access to a virtual array is safe only if it never swaps. */
+  if (!jmem_virt_arrays_resident((j_common_ptr)cinfo))
+    return 1;
+  return jthread_clamp_workers(cinfo->master->num_threads, num_tasks);
+}
+
+
+/*
+ * Determine whether the remaining scan trials should be encoded (or
+ * estimated) using run_scan_trials().  This is checked after each output
+ * pass but succeeds at most once, since run_scan_trials() completes all
+ * remaining scans.
+ */
+
+LOCAL(boolean)
+use_scan_trials(j_compress_ptr cinfo)
+{
+  my_master_ptr master = (my_master_ptr)cinfo->master;
+
+  if ((cinfo->master->num_threads < 2 && !cinfo->master->estimate_scans) ||
+      !cinfo->master->optimize_scans ||
+      cinfo->master->num_scans_luma <= 0 || cinfo->master->lossless ||
+      master->transcode_only || master->scan_number >= cinfo->num_scans)
+    return FALSE;
+  /* The marker writer tracks the restart interval across scans. */
+  if (cinfo->restart_interval != 0 || cinfo->restart_in_rows != 0)
+    return FALSE;
+  /* Estimating the scan sizes requires Huffman statistics. */
+  if (cinfo->master->estimate_scans && !cinfo->arith_code)
+    return TRUE;
+  return scan_trial_workers(cinfo, cinfo->num_scans) > 1;
+}
+
+
+LOCAL(void)
+init_scan_trial_job(j_compress_ptr cinfo, scan_trial_job *job,
+                    int num_workers, boolean estimate)
+{
+  int w;
+
+  job->cinfo = cinfo;
+  job->num_workers = num_workers;
+  job->estimate = estimate;
+  job->num_scans = 0;
+  job->trials = (scan_trial *)
+    (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                num_workers * sizeof(scan_trial));
+  for (w = 0; w < num_workers; w++)
+    job->trials[w].failed = FALSE;
+}
+
+
+/*
+ * Encode a batch of trials, and rethrow the first error that occurred in any
+ * of them.
+ */
+
+LOCAL(void)
+run_scan_trial_batch(j_compress_ptr cinfo, scan_trial_job *job)
+{
+  int i, w;
+
+  jthread_run(job, encode_scan_trial, job->num_scans, job->num_workers);
+
+  for (w = 0; w < job->num_workers; w++) {
+    if (job->trials[w].failed) {
+      for (i = 0; i < cinfo->num_scans; i++)
+        free_scan_buffer(cinfo, i);
+      cinfo->err->msg_code = job->trials[w].failure.msg_code;
+      memcpy(&cinfo->err->msg_parm, &job->trials[w].failure.msg_parm,
+             sizeof(cinfo->err->msg_parm));
+      (*cinfo->err->error_exit) ((j_common_ptr)cinfo);
     }
-    
-    /* free the memory allocated for buffers */
-    for (i = 0; i < cinfo->num_scans; i++)
-      if (master->scan_buffer[i])
-        free(master->scan_buffer[i]);
   }
 }
 
+
+LOCAL(void)
+run_scan_trials(j_compress_ptr cinfo)
+{
+  my_master_ptr master = (my_master_ptr)cinfo->master;
+  int luma_freq_split_scan_start = cinfo->master->num_scans_luma_dc +
+                                   3 * cinfo->master->Al_max_luma + 2;
+  int chroma_freq_split_scan_start = cinfo->master->num_scans_luma +
+                                     cinfo->master->num_scans_chroma_dc +
+                                     (6 * cinfo->master->Al_max_chroma + 4);
+  boolean encoded[64];
+  scan_trial_job job;
+  int i;
+
+  init_scan_trial_job(cinfo, &job,
+                      scan_trial_workers(cinfo, cinfo->num_scans),
+                      cinfo->master->estimate_scans && !cinfo->arith_code);
+  for (i = 0; i < cinfo->num_scans; i++)
+    encoded[i] = FALSE;
+
+  while (master->scan_number < cinfo->num_scans) {
+    /* Gather every remaining scan whose parameters are already known.  The
+     * current scan always qualifies, so each batch makes progress.
+     */
+    job.num_scans = 0;
+    for (i = master->scan_number; i < cinfo->num_scans; i++) {
+      if (encoded[i])
+        continue;
+      if (master->scan_number < luma_freq_split_scan_start &&
+          i >= luma_freq_split_scan_start &&
+          i < cinfo->master->num_scans_luma)
+        continue;
+      if (master->scan_number < chroma_freq_split_scan_start &&
+          i >= chroma_freq_split_scan_start)
+        continue;
+      job.scans[job.num_scans++] = i;
+    }
+
+    run_scan_trial_batch(cinfo, &job);
+    for (i = 0; i < job.num_scans; i++)
+      encoded[job.scans[i]] = TRUE;
+
+    /* Replay the serial search over the scans encoded so far */
+    while (master->scan_number < cinfo->num_scans &&
+           encoded[master->scan_number]) {
+      select_scans(cinfo, master->scan_number + 1);
+      master->scan_number++;
+    }
+  }
+
+  master->pass_number = master->total_passes - 1;
+  master->pub.is_last_pass = TRUE;
+}
+
+
+/*
+ * Encode the selected scans whose sizes were only estimated, so that they can
+ * be copied to the output.
+ */
+
+LOCAL(void)
+encode_selected_scans(j_compress_ptr cinfo, const int *scans, int num_scans)
+{
+  my_master_ptr master = (my_master_ptr)cinfo->master;
+  scan_trial_job job;
+  int i, num_missing = 0;
+
+  for (i = 0; i < num_scans; i++)
+    if (master->scan_buffer[scans[i]] == NULL)
+      num_missing++;
+  if (num_missing == 0)
+    return;
+
+  init_scan_trial_job(cinfo, &job, scan_trial_workers(cinfo, num_missing),
+                      FALSE);
+  for (i = 0; i < num_scans; i++)
+    if (master->scan_buffer[scans[i]] == NULL)
+      job.scans[job.num_scans++] = scans[i];
+  run_scan_trial_batch(cinfo, &job);
+}
+
 /*
  * Finish up at end of pass.
  */
@@ -1004,6 +1513,8 @@ finish_pass_master(j_compress_ptr cinfo)
     }
 
     master->scan_number++;
+    if (use_scan_trials(cinfo))
+      run_scan_trials(cinfo);
     break;
   case trellis_pass:
     if (cinfo->optimize_coding)
@@ -1116,6 +1627,7 @@ jinit_c_master_control(j_compress_ptr cinfo, boolean transcode_only)
     /* for normal compression, first pass is always this type: */
     master->pass_type = main_pass;
   }
+  master->transcode_only = transcode_only;
   master->scan_number = 0;
   master->pass_number = 0;
   if (cinfo->optimize_coding)
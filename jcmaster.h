@@ -43,6 +43,7 @@ typedef struct {
   int best_Al_chroma; /* best value for Al found in scan search (luma) */
   boolean interleave_chroma_dc; /* indicate whether to interleave chroma DC scans */
   struct jpeg_destination_mgr * saved_dest; /* saved value of cinfo->dest */
+  boolean transcode_only; /* TRUE if coefficients come from jpeg_write_coefficients() */
 
   /*
    * This is here so we can add libjpeg-turbo version/build information to the
@@ -52,6 +52,8 @@ jpeg_abort(j_common_ptr cinfo)
      */
     ((j_decompress_ptr)cinfo)->marker_list = NULL;
     ((j_decompress_ptr)cinfo)->master->marker_list_end = NULL;
+    /* Likewise for the decode index, which is in the image pool. */
+    ((j_decompress_ptr)cinfo)->master->decode_index = NULL;
   } else {
     cinfo->global_state = CSTATE_START;
   }
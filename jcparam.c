@@ -501,6 +501,8 @@ jpeg_set_defaults(j_compress_ptr cinfo)
   } else
     cinfo->master->optimize_scans = FALSE;
 #endif
+  cinfo->master->estimate_scans = FALSE;
+  cinfo->master->transcode_requantize = FALSE;
   
   cinfo->master->trellis_quant =
     cinfo->master->compress_profile == JCP_MAX_COMPRESSION;
@@ -64,6 +64,8 @@ typedef struct {
 
   /* Mode flag: TRUE for optimization, FALSE for actual data output */
   boolean gather_statistics;
+  size_t gathered_bits;         /* # of non-Huffman bits counted in gather
+                                   mode */
 
   /* Bit-level coding status.
    * next_output_byte/free_in_buffer are local copies of cinfo->dest fields.
@@ -186,6 +188,7 @@ start_pass_phuff(j_compress_ptr cinfo, boolean gather_statistics)
 
   entropy->cinfo = cinfo;
   entropy->gather_statistics = gather_statistics;
+  entropy->gathered_bits = 0;
 
   is_DC_band = (cinfo->Ss == 0);
 
@@ -331,8 +334,10 @@ emit_bits(phuff_entropy_ptr entropy, unsigned int code, int size)
   if (size == 0)
     ERREXIT(entropy->cinfo, JERR_HUFF_MISSING_CODE);
 
-  if (entropy->gather_statistics)
-    return;                     /* do nothing if we're only getting stats */
+  if (entropy->gather_statistics) {
+    entropy->gathered_bits += size; /* just count if we're only getting stats */
+    return;
+  }
 
   put_buffer &= (((size_t)1) << size) - 1; /* mask off any extra bits in code */
 
@@ -391,8 +396,10 @@ LOCAL(void)
 emit_buffered_bits(phuff_entropy_ptr entropy, char *bufstart,
                    unsigned int nbits)
 {
-  if (entropy->gather_statistics)
-    return;                     /* no real work */
+  if (entropy->gather_statistics) {
+    entropy->gathered_bits += nbits; /* no real work */
+    return;
+  }
 
   while (nbits > 0) {
     emit_bits(entropy, (unsigned int)(*bufstart), 1);
@@ -1038,8 +1045,28 @@ finish_pass_phuff(j_compress_ptr cinfo)
 }
 
 
+/*
+ * Count the bits needed to code the given symbol frequencies with a Huffman
+ * table.
+ */
+
+LOCAL(size_t)
+count_huff_bits(JHUFF_TBL *htbl, const long freq[])
+{
+  size_t total = 0;
+  int l, i, p = 0;
+
+  for (l = 1; l <= 16; l++)
+    for (i = 0; i < (int)htbl->bits[l]; i++)
+      total += (size_t)freq[htbl->huffval[p++]] * l;
+  return total;
+}
+
+
 /*
  * Finish up a statistics-gathering pass and create the new Huffman tables.
+ * The size of the scan's entropy-coded data, if it were coded with the new
+ * tables, is left in cinfo->master->gathered_bits.
  */
 
 METHODDEF(void)
@@ -1051,9 +1078,12 @@ finish_pass_gather_phuff(j_compress_ptr cinfo)
   jpeg_component_info *compptr;
   JHUFF_TBL **htblptr;
   boolean did[NUM_HUFF_TBLS];
+  long freq[257];
+  size_t bits;
 
   /* Flush out buffered data (all we care about is counting the EOB symbol) */
   emit_eobrun(entropy);
+  bits = entropy->gathered_bits;
 
   is_DC_band = (cinfo->Ss == 0);
 
@@ -1078,10 +1108,14 @@ finish_pass_gather_phuff(j_compress_ptr cinfo)
         htblptr = &cinfo->ac_huff_tbl_ptrs[tbl];
       if (*htblptr == NULL)
         *htblptr = jpeg_alloc_huff_table((j_common_ptr)cinfo);
+      memcpy(freq, entropy->count_ptrs[tbl], sizeof(freq));
       jpeg_gen_optimal_table(cinfo, *htblptr, entropy->count_ptrs[tbl]);
+      bits += count_huff_bits(*htblptr, freq);
       did[tbl] = TRUE;
     }
   }
+
+  cinfo->master->gathered_bits = bits;
 }
 
 
@@ -499,9 +499,9 @@ _jinit_downsampler(j_compress_ptr cinfo)
     } else if (compptr->h_samp_factor * 2 == cinfo->max_h_samp_factor &&
                compptr->v_samp_factor == cinfo->max_v_samp_factor) {
       smoothok = FALSE;
-#ifdef WITH_SIMD
-      if (jsimd_can_h2v1_downsample())
-        downsample->methods[ci] = jsimd_h2v1_downsample;
+#if defined(WITH_SIMD) || defined(WITH_SIMD12)
+      if (_jsimd_can_h2v1_downsample())
+        downsample->methods[ci] = _jsimd_h2v1_downsample;
       else
 #endif
         downsample->methods[ci] = h2v1_downsample;
@@ -519,9 +519,9 @@ _jinit_downsampler(j_compress_ptr cinfo)
       } else
 #endif
       {
-#ifdef WITH_SIMD
-        if (jsimd_can_h2v2_downsample())
-          downsample->methods[ci] = jsimd_h2v2_downsample;
+#if defined(WITH_SIMD) || defined(WITH_SIMD12)
+        if (_jsimd_can_h2v2_downsample())
+          downsample->methods[ci] = _jsimd_h2v2_downsample;
         else
 #endif
           downsample->methods[ci] = h2v2_downsample;
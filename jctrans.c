@@ -19,13 +19,15 @@
 #include "jinclude.h"
 #include "jpeglib.h"
 #include "jpegapicomp.h"
+#include "jchuff.h"
 
 
 /* Forward declarations */
 LOCAL(void) transencode_master_selection(j_compress_ptr cinfo,
                                          jvirt_barray_ptr *coef_arrays);
 LOCAL(void) transencode_coef_controller(j_compress_ptr cinfo,
-                                        jvirt_barray_ptr *coef_arrays);
+                                        jvirt_barray_ptr *coef_arrays,
+                                        boolean requant_trellis);
 
 
 /*
@@ -57,6 +59,9 @@ jpeg_write_coefficients(j_compress_ptr cinfo, jvirt_barray_ptr *coef_arrays)
   /* (Re)initialize error mgr and destination modules */
   (*cinfo->err->reset_error_mgr) ((j_common_ptr)cinfo);
   (*cinfo->dest->init_destination) (cinfo);
+  /* Any coefficient source must be supplied anew for each image */
+  cinfo->master->coef_source = NULL;
+  cinfo->master->coef_source_data = NULL;
   /* Perform master selection of active modules */
   transencode_master_selection(cinfo, coef_arrays);
   /* Wait for jpeg_finish_compress() call */
@@ -65,11 +70,43 @@ jpeg_write_coefficients(j_compress_ptr cinfo, jvirt_barray_ptr *coef_arrays)
 }
 
 
+/*
+ * Supply the coefficients one iMCU row at a time rather than in the virtual
+ * arrays passed to jpeg_write_coefficients().  This must be called after
+ * jpeg_write_coefficients() and before jpeg_finish_compress().
+ *
+ * coef_source is called whenever the coefficient controller needs the blocks
+ * for one iMCU row of a component; it must store the v_samp_factor block rows
+ * of that iMCU row, each at least width_in_blocks blocks wide, in rows[].  The
+ * same row may be requested any number of times, since each scan (and each
+ * optimization pass) reads the entire image again, so the callback must
+ * always produce the same coefficients.  The virtual arrays passed to
+ * jpeg_write_coefficients() are not accessed in that case, so they needn't be
+ * filled.  Requantization (JBOOLEAN_TRANSCODE_REQUANTIZE) is not supported
+ * with a coefficient source.
+ */
+
+GLOBAL(void)
+jpeg_set_coef_source(j_compress_ptr cinfo, jpeg_coef_source_ptr coef_source,
+                     void *client_data)
+{
+  if (cinfo->global_state != CSTATE_WRCOEFS)
+    ERREXIT1(cinfo, JERR_BAD_STATE, cinfo->global_state);
+
+  cinfo->master->coef_source = coef_source;
+  cinfo->master->coef_source_data = client_data;
+}
+
+
 /*
  * Initialize the compression object with default parameters,
  * then copy from the source object all parameters needed for lossless
  * transcoding.  Parameters that can be varied without loss (such as
  * scan script and Huffman optimization) are left in their default states.
+ *
+ * The source's quantization tables are also saved, so that the application
+ * may replace the destination's tables afterwards and enable
+ * JBOOLEAN_TRANSCODE_REQUANTIZE to requantize the coefficients to them.
  */
 
 GLOBAL(void)
@@ -108,8 +145,13 @@ jpeg_copy_critical_parameters (const j_decompress_ptr srcinfo, j_compress_ptr ds
   dstinfo->data_precision = srcinfo->data_precision;
   dstinfo->CCIR601_sampling = srcinfo->CCIR601_sampling;
   /* Copy the source's quantization tables. */
+  memset(dstinfo->master->src_quantval, 0,
+         sizeof(dstinfo->master->src_quantval));
   for (tblno = 0; tblno < NUM_QUANT_TBLS; tblno++) {
     if (srcinfo->quant_tbl_ptrs[tblno] != NULL) {
+      memcpy(dstinfo->master->src_quantval[tblno],
+             srcinfo->quant_tbl_ptrs[tblno]->quantval,
+             sizeof(dstinfo->master->src_quantval[tblno]));
       qtblptr = &dstinfo->quant_tbl_ptrs[tblno];
       if (*qtblptr == NULL)
         *qtblptr = jpeg_alloc_quant_table((j_common_ptr)dstinfo);
@@ -180,12 +222,25 @@ LOCAL(void)
 transencode_master_selection(j_compress_ptr cinfo,
                              jvirt_barray_ptr *coef_arrays)
 {
+  boolean requant_trellis = FALSE;
+
   /* Although we don't actually use input_components for transcoding,
    * jcmaster.c's initial_setup will complain if input_components is 0.
    */
   cinfo->input_components = 1;
+  /* The trellis passes scheduled by jcmaster.c need sample data, so trellis
+   * quantization is possible only when requantizing, and it is then done by
+   * the coefficient controller.  quantize_trellis() exists only for 8-bit
+   * data.
+   */
+  if (cinfo->master->transcode_requantize && cinfo->master->trellis_quant &&
+      cinfo->data_precision == 8)
+    requant_trellis = TRUE;
+  cinfo->master->trellis_quant = FALSE;
   /* Initialize master control (includes parameter checking/processing) */
   jinit_c_master_control(cinfo, TRUE /* transcode only */);
+  if (requant_trellis)
+    jinit_trellis_quantizer(cinfo);
 
   /* Entropy encoding: either Huffman or arithmetic coding. */
   if (cinfo->arith_code) {
@@ -206,7 +261,7 @@ transencode_master_selection(j_compress_ptr cinfo,
   }
 
   /* We need a special coefficient buffer controller. */
-  transencode_coef_controller(cinfo, coef_arrays);
+  transencode_coef_controller(cinfo, coef_arrays, requant_trellis);
 
   jinit_marker_writer(cinfo);
 
@@ -226,7 +281,8 @@ transencode_master_selection(j_compress_ptr cinfo,
  * buffer controller.  This is similar to jccoefct.c, but it handles only
  * output from presupplied virtual arrays.  Furthermore, we generate any
  * dummy padding blocks on-the-fly rather than expecting them to be present
- * in the arrays.
+ * in the arrays.  If requested, it also requantizes the coefficients to the
+ * destination's quantization tables before the first pass.
  */
 
 /* Private buffer controller object */
@@ -244,8 +300,22 @@ typedef struct {
 
   /* Workspace for constructing dummy blocks at right/bottom edges. */
   JBLOCKROW dummy_buffer[C_MAX_BLOCKS_IN_MCU];
+
+  /* Requantization state */
+  boolean requantize;           /* TRUE until coefficients are requantized */
+  boolean requant_trellis;      /* TRUE to use trellis quantization */
+  JBLOCKARRAY requant_src;      /* dequantized coefficients for one iMCU
+                                   row of one component (trellis only) */
+
+  /* Buffers for the iMCU row most recently obtained from the coefficient
+   * source, if any, for each component
+   */
+  JBLOCKARRAY source_buffer[MAX_COMPONENTS];
+  JDIMENSION source_iMCU_row[MAX_COMPONENTS];   /* or INVALID_ROW */
 } my_coef_controller;
 
+#define INVALID_ROW  ((JDIMENSION)~0)
+
 typedef my_coef_controller *my_coef_ptr;
 
 
@@ -273,6 +343,165 @@ start_iMCU_row(j_compress_ptr cinfo)
 }
 
 
+/*
+ * Requantize a row of DCT blocks from the source quantization table to the
+ * destination table, rounding to nearest.
+ */
+
+LOCAL(void)
+requantize_block_row(JBLOCKROW row, JDIMENSION num_blocks,
+                     const UINT16 *src_qval, const UINT16 *dst_qval,
+                     JLONG max_coef)
+{
+  JDIMENSION bi;
+  JLONG x, q, val;
+  int k;
+
+  for (bi = 0; bi < num_blocks; bi++) {
+    for (k = 0; k < DCTSIZE2; k++) {
+      x = (JLONG)row[bi][k] * src_qval[k];
+      q = dst_qval[k];
+      if (x < 0) {
+        val = -((q / 2 - x) / q);
+        if (val < -max_coef)
+          val = -max_coef;
+      } else {
+        val = (x + q / 2) / q;
+        if (val > max_coef)
+          val = max_coef;
+      }
+      row[bi][k] = (JCOEF)val;
+    }
+  }
+}
+
+
+/*
+ * Dequantize a row of DCT blocks into the form that quantize_trellis()
+ * expects, that is, scaled up by 8 as the output of the forward DCT is.
+ */
+
+LOCAL(void)
+dequantize_block_row(JBLOCKROW row, JBLOCKROW output_row,
+                     JDIMENSION num_blocks, const UINT16 *src_qval)
+{
+  JDIMENSION bi;
+  JLONG x;
+  int k;
+
+  for (bi = 0; bi < num_blocks; bi++) {
+    for (k = 0; k < DCTSIZE2; k++) {
+      x = (JLONG)row[bi][k] * src_qval[k] * 8;
+      output_row[bi][k] = (JCOEF)MAX(MIN(x, 32767), -32767);
+    }
+  }
+}
+
+
+/*
+ * Requantize the coefficient arrays in place.  This is done at the start of
+ * the first pass rather than in jpeg_write_coefficients(), since the
+ * application may fill in or modify the arrays between the two (jpegtran's
+ * transformations do.)  As in jccoefct.c, the trellis is run over one iMCU
+ * row at a time, with the DC predictor reset at the start of each row.
+ */
+
+LOCAL(void)
+requantize_coefficients(j_compress_ptr cinfo)
+{
+  my_coef_ptr coef = (my_coef_ptr)cinfo->coef;
+  JLONG max_coef = (1L << (cinfo->data_precision + 2)) - 1;
+  JDIMENSION start_row;
+  int ci, tblno, block_row, block_rows, save_Ss, save_Se;
+  JBLOCKARRAY buffer;
+  JQUANT_TBL *qtbl;
+  const UINT16 *src_qval;
+  jpeg_component_info *compptr;
+  c_derived_tbl dctbl, actbl;
+  c_derived_tbl *dctbl_ptr = &dctbl, *actbl_ptr = &actbl;
+#ifdef C_ARITH_CODING_SUPPORTED
+  arith_rates arith_r;
+#endif
+  JCOEF lastDC;
+
+  /* The trellis considers all coefficients, whatever the first scan is. */
+  save_Ss = cinfo->Ss;
+  save_Se = cinfo->Se;
+  cinfo->Ss = 0;
+  cinfo->Se = DCTSIZE2 - 1;
+
+  for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
+       ci++, compptr++) {
+    tblno = compptr->quant_tbl_no;
+    qtbl = cinfo->quant_tbl_ptrs[tblno];
+    if (qtbl == NULL)
+      ERREXIT1(cinfo, JERR_NO_QUANT_TABLE, tblno);
+    src_qval = cinfo->master->src_quantval[tblno];
+    if (src_qval[0] == 0)
+      ERREXIT1(cinfo, JERR_NO_SOURCE_QUANT_TABLE, tblno);
+    if (!coef->requant_trellis &&
+        !memcmp(src_qval, qtbl->quantval, sizeof(qtbl->quantval)))
+      continue;                 /* nothing to do */
+
+    if (coef->requant_trellis) {
+#ifdef C_ARITH_CODING_SUPPORTED
+      if (cinfo->arith_code)
+        jget_arith_rates(cinfo, compptr->dc_tbl_no, compptr->ac_tbl_no,
+                         &arith_r);
+      else
+#endif
+      {
+        jpeg_make_c_derived_tbl(cinfo, TRUE, compptr->dc_tbl_no, &dctbl_ptr);
+        jpeg_make_c_derived_tbl(cinfo, FALSE, compptr->ac_tbl_no, &actbl_ptr);
+      }
+    }
+
+    for (start_row = 0; start_row < compptr->height_in_blocks;
+         start_row += compptr->v_samp_factor) {
+      block_rows = (int)MIN((JDIMENSION)compptr->v_samp_factor,
+                            compptr->height_in_blocks - start_row);
+      buffer = (*cinfo->mem->access_virt_barray)
+        ((j_common_ptr)cinfo, coef->whole_image[ci], start_row,
+         (JDIMENSION)block_rows, TRUE);
+      lastDC = 0;
+      for (block_row = 0; block_row < block_rows; block_row++) {
+        if (coef->requant_trellis)
+          dequantize_block_row(buffer[block_row], coef->requant_src[block_row],
+                               compptr->width_in_blocks, src_qval);
+        /* This also supplies the DC coefficients if the trellis doesn't. */
+        requantize_block_row(buffer[block_row], compptr->width_in_blocks,
+                             src_qval, qtbl->quantval, max_coef);
+        if (!coef->requant_trellis)
+          continue;
+#ifdef C_ARITH_CODING_SUPPORTED
+        if (cinfo->arith_code)
+          quantize_trellis_arith(cinfo, &arith_r, buffer[block_row],
+                                 coef->requant_src[block_row],
+                                 compptr->width_in_blocks, qtbl,
+                                 cinfo->master->norm_src[tblno],
+                                 cinfo->master->norm_coef[tblno], &lastDC,
+                                 block_row > 0 ? buffer[block_row - 1] : NULL,
+                                 block_row > 0 ?
+                                 coef->requant_src[block_row - 1] : NULL, 0);
+        else
+#endif
+          quantize_trellis(cinfo, dctbl_ptr, actbl_ptr, buffer[block_row],
+                           coef->requant_src[block_row],
+                           compptr->width_in_blocks, qtbl,
+                           cinfo->master->norm_src[tblno],
+                           cinfo->master->norm_coef[tblno], &lastDC,
+                           block_row > 0 ? buffer[block_row - 1] : NULL,
+                           block_row > 0 ?
+                           coef->requant_src[block_row - 1] : NULL, 0);
+      }
+    }
+  }
+
+  cinfo->Ss = save_Ss;
+  cinfo->Se = save_Se;
+}
+
+
 /*
  * Initialize for a processing pass.
  */
@@ -285,11 +514,62 @@ start_pass_coef(j_compress_ptr cinfo, J_BUF_MODE pass_mode)
   if (pass_mode != JBUF_CRANK_DEST)
     ERREXIT(cinfo, JERR_BAD_BUFFER_MODE);
 
+  if (coef->requantize) {
+    if (cinfo->master->coef_source != NULL)
+      ERREXIT(cinfo, JERR_NOTIMPL);
+    requantize_coefficients(cinfo);
+    coef->requantize = FALSE;
+  }
+
+  if (cinfo->master->coef_source != NULL &&
+      coef->source_buffer[0] == NULL) {
+    jpeg_component_info *compptr;
+    int ci;
+
+    for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
+         ci++, compptr++) {
+      coef->source_buffer[ci] = (*cinfo->mem->alloc_barray)
+        ((j_common_ptr)cinfo, JPOOL_IMAGE,
+         (JDIMENSION)jround_up((long)compptr->width_in_blocks,
+                               (long)compptr->h_samp_factor),
+         (JDIMENSION)compptr->v_samp_factor);
+      coef->source_iMCU_row[ci] = INVALID_ROW;
+    }
+  }
+
   coef->iMCU_row_num = 0;
   start_iMCU_row(cinfo);
 }
 
 
+/*
+ * Obtain the blocks for one iMCU row of a component, either from its virtual
+ * array or from the coefficient source.
+ */
+
+LOCAL(JBLOCKARRAY)
+access_coef_rows(j_compress_ptr cinfo, jpeg_component_info *compptr,
+                 JDIMENSION iMCU_row)
+{
+  my_coef_ptr coef = (my_coef_ptr)cinfo->coef;
+  int ci = compptr->component_index;
+
+  if (cinfo->master->coef_source == NULL)
+    return (*cinfo->mem->access_virt_barray)
+      ((j_common_ptr)cinfo, coef->whole_image[ci],
+       iMCU_row * compptr->v_samp_factor,
+       (JDIMENSION)compptr->v_samp_factor, FALSE);
+
+  /* A suspended iMCU row is resumed from the buffer. */
+  if (coef->source_iMCU_row[ci] != iMCU_row) {
+    (*cinfo->master->coef_source) (cinfo, cinfo->master->coef_source_data,
+                                   ci, iMCU_row, coef->source_buffer[ci]);
+    coef->source_iMCU_row[ci] = iMCU_row;
+  }
+  return coef->source_buffer[ci];
+}
+
+
 /*
  * Process some data.
  * We process the equivalent of one fully interleaved MCU row ("iMCU" row)
@@ -317,10 +597,7 @@ compress_output(j_compress_ptr cinfo, JSAMPIMAGE input_buf)
   /* Align the virtual buffers for the components used in this scan. */
   for (ci = 0; ci < cinfo->comps_in_scan; ci++) {
     compptr = cinfo->cur_comp_info[ci];
-    buffer[ci] = (*cinfo->mem->access_virt_barray)
-      ((j_common_ptr)cinfo, coef->whole_image[compptr->component_index],
-       coef->iMCU_row_num * compptr->v_samp_factor,
-       (JDIMENSION)compptr->v_samp_factor, FALSE);
+    buffer[ci] = access_coef_rows(cinfo, compptr, coef->iMCU_row_num);
   }
 
   /* Loop to process one whole iMCU row */
@@ -394,10 +671,12 @@ compress_output_12(j_compress_ptr cinfo, J12SAMPIMAGE input_buf)
 
 LOCAL(void)
 transencode_coef_controller(j_compress_ptr cinfo,
-                            jvirt_barray_ptr *coef_arrays)
+                            jvirt_barray_ptr *coef_arrays,
+                            boolean requant_trellis)
 {
   my_coef_ptr coef;
   JBLOCKROW buffer;
+  JDIMENSION max_width = 0;
   int i;
 
   coef = (my_coef_ptr)
@@ -419,4 +698,17 @@ transencode_coef_controller(j_compress_ptr cinfo,
   for (i = 0; i < C_MAX_BLOCKS_IN_MCU; i++) {
     coef->dummy_buffer[i] = buffer + i;
   }
+
+  for (i = 0; i < MAX_COMPONENTS; i++)
+    coef->source_buffer[i] = NULL;
+
+  coef->requantize = cinfo->master->transcode_requantize;
+  coef->requant_trellis = requant_trellis;
+  coef->requant_src = NULL;
+  if (requant_trellis) {
+    for (i = 0; i < cinfo->num_components; i++)
+      max_width = MAX(max_width, cinfo->comp_info[i].width_in_blocks);
+    coef->requant_src = (*cinfo->mem->alloc_barray)
+      ((j_common_ptr)cinfo, JPOOL_IMAGE, max_width, (JDIMENSION)MAX_SAMP_FACTOR);
+  }
 }
@@ -606,8 +606,25 @@ _jpeg_skip_scanlines(j_decompress_ptr cinfo, JDIMENSION num_lines)
     return num_lines;
   }
 
-  /* Skip the iMCU rows that we can safely skip. */
-  for (i = 0; i < lines_to_skip; i += lines_per_iMCU_row) {
+  /* Skip the iMCU rows that we can safely skip.  If the entropy decoder
+   * supports random access, then seek to the first MCU after the skipped rows.
+   * Otherwise, or if there is no random access point among the skipped rows,
+   * decode and discard the MCUs in those rows.
+   */
+  i = 0;
+  if (lines_to_skip > 0 && cinfo->entropy->seek_mcu) {
+    JDIMENSION iMCU_rows = lines_to_skip / lines_per_iMCU_row;
+
+    if (cinfo->input_iMCU_row + iMCU_rows < cinfo->total_iMCU_rows &&
+        (*cinfo->entropy->seek_mcu) (cinfo, iMCU_row_first_MCU(cinfo,
+                                       cinfo->input_iMCU_row + iMCU_rows))) {
+      cinfo->input_iMCU_row += iMCU_rows;
+      cinfo->output_iMCU_row += iMCU_rows;
+      start_iMCU_row(cinfo);
+      i = lines_to_skip;
+    }
+  }
+  for (; i < lines_to_skip; i += lines_per_iMCU_row) {
     for (y = 0; y < coef->MCU_rows_per_iMCU_row; y++) {
       for (x = 0; x < cinfo->MCUs_per_row; x++) {
         /* Calling decode_mcu() with a NULL pointer causes it to discard the
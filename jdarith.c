@@ -22,6 +22,7 @@
 #define JPEG_INTERNALS
 #include "jinclude.h"
 #include "jpeglib.h"
+#include "jpeg_nbits.h"
 
 
 #define NEG_1  ((unsigned int)-1)
@@ -117,10 +118,21 @@ arith_decode(j_decompress_ptr cinfo, unsigned char *st)
   register arith_entropy_ptr e = (arith_entropy_ptr)cinfo->entropy;
   register unsigned char nl, nm;
   register JLONG qe, temp;
-  register int sv, data;
+  register int sv, data, n;
 
   /* Renormalization & data input per section D.2.6 */
   while (e->a < 0x8000L) {
+    if (e->ct > 0) {
+      /* Shift by as many bits as are needed to normalize A, up to the number
+       * of bits left in the bit buffer, without fetching any data.
+       */
+      n = 16 - JPEG_NBITS_NONZERO((unsigned int)e->a);
+      if (n > e->ct)
+        n = e->ct;
+      e->ct -= n;
+      e->a <<= n;
+      continue;
+    }
     if (--e->ct < 0) {
       /* Need to fetch next data byte */
       if (cinfo->unread_marker)
@@ -757,6 +769,8 @@ jinit_arith_decoder(j_decompress_ptr cinfo)
                                 sizeof(arith_entropy_decoder));
   cinfo->entropy = (struct jpeg_entropy_decoder *)entropy;
   entropy->pub.start_pass = start_pass;
+  entropy->pub.seek_mcu = NULL;
+  entropy->pub.save_index = NULL;
 
   /* Mark tables unallocated */
   for (i = 0; i < NUM_ARITH_TBLS; i++) {
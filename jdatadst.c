@@ -54,6 +54,26 @@ typedef struct {
 typedef my_mem_destination_mgr *my_mem_dest_ptr;
 
 
+/* Expanded data destination object for chained memory output */
+
+typedef struct {
+  struct jpeg_destination_mgr pub; /* public fields */
+
+  size_t chunk_size;            /* # of bytes to write to each chunk */
+  size_t alloc_size;            /* size of each chunk in pool[] */
+  JOCTET **pool;                /* chunks allocated so far, reused for each
+                                   image */
+  int pool_count;               /* # of chunks allocated */
+  jpeg_output_chunk *chunks;    /* chunks holding the current image */
+  int num_chunks;               /* # of chunks in use */
+  int max_chunks;               /* # of entries in pool[] and chunks[] */
+} my_chain_destination_mgr;
+
+typedef my_chain_destination_mgr *my_chain_dest_ptr;
+
+#define DEFAULT_CHUNK_SIZE  65536
+
+
 /*
  * Initialize destination --- called by jpeg_start_compress
  * before any data is actually written.
@@ -80,6 +100,62 @@ init_mem_destination(j_compress_ptr cinfo)
 }
 
 
+/*
+ * Start a new chunk of chained memory output, taking it from the pool if
+ * possible.
+ */
+
+LOCAL(void)
+next_chunk(j_compress_ptr cinfo)
+{
+  my_chain_dest_ptr dest = (my_chain_dest_ptr)cinfo->dest;
+  jpeg_output_chunk *chunk;
+
+  if (dest->num_chunks >= dest->max_chunks) {
+    /* Enlarge the chunk lists.  The old lists remain in the permanent pool,
+     * but they hold only pointers, and they are needed only while the number
+     * of chunks grows.
+     */
+    int max_chunks = dest->max_chunks * 2;
+    JOCTET **pool;
+    jpeg_output_chunk *chunks;
+
+    pool = (JOCTET **)
+      (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
+                                  max_chunks * sizeof(JOCTET *));
+    chunks = (jpeg_output_chunk *)
+      (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
+                                  max_chunks * sizeof(jpeg_output_chunk));
+    memcpy(pool, dest->pool, dest->pool_count * sizeof(JOCTET *));
+    memcpy(chunks, dest->chunks,
+           dest->num_chunks * sizeof(jpeg_output_chunk));
+    dest->pool = pool;
+    dest->chunks = chunks;
+    dest->max_chunks = max_chunks;
+  }
+  if (dest->num_chunks >= dest->pool_count)
+    dest->pool[dest->pool_count++] = (JOCTET *)
+      (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
+                                  dest->alloc_size * sizeof(JOCTET));
+
+  chunk = &dest->chunks[dest->num_chunks++];
+  chunk->data = dest->pool[dest->num_chunks - 1];
+  chunk->size = 0;
+  dest->pub.next_output_byte = chunk->data;
+  dest->pub.free_in_buffer = dest->chunk_size;
+}
+
+METHODDEF(void)
+init_chain_destination(j_compress_ptr cinfo)
+{
+  my_chain_dest_ptr dest = (my_chain_dest_ptr)cinfo->dest;
+
+  /* Reuse the chunks of the previous image, if any */
+  dest->num_chunks = 0;
+  next_chunk(cinfo);
+}
+
+
 /*
  * Empty the output buffer --- called whenever buffer fills up.
  *
@@ -147,6 +223,18 @@ empty_mem_output_buffer(j_compress_ptr cinfo)
   return TRUE;
 }
 
+METHODDEF(boolean)
+empty_chain_output_buffer(j_compress_ptr cinfo)
+{
+  my_chain_dest_ptr dest = (my_chain_dest_ptr)cinfo->dest;
+
+  /* The current chunk is full, so just link in another one. */
+  dest->chunks[dest->num_chunks - 1].size = dest->chunk_size;
+  next_chunk(cinfo);
+
+  return TRUE;
+}
+
 
 /*
  * Terminate destination --- called by jpeg_finish_compress
@@ -183,6 +271,20 @@ term_mem_destination(j_compress_ptr cinfo)
   *dest->outsize = (unsigned long)(dest->bufsize - dest->pub.free_in_buffer);
 }
 
+METHODDEF(void)
+term_chain_destination(j_compress_ptr cinfo)
+{
+  my_chain_dest_ptr dest = (my_chain_dest_ptr)cinfo->dest;
+
+  dest->chunks[dest->num_chunks - 1].size =
+    dest->chunk_size - dest->pub.free_in_buffer;
+  /* The encoder empties the buffer as soon as it is full, so if the data
+   * ended on a chunk boundary, then the last chunk is empty.
+   */
+  if (dest->num_chunks > 1 && dest->chunks[dest->num_chunks - 1].size == 0)
+    dest->num_chunks--;
+}
+
 
 /*
  * Prepare for output to a stdio stream.
@@ -287,3 +389,85 @@ jpeg_mem_dest (j_compress_ptr cinfo,
   jpeg_mem_dest_internal(cinfo, outbuffer, outsize, JPOOL_PERMANENT);
 }
 
+
+/*
+ * Prepare for output to a chain of fixed-size memory chunks.
+ * Unlike jpeg_mem_dest(), this never has to copy the data written so far
+ * when the output grows.  After jpeg_finish_compress(), the chunks can be
+ * obtained with jpeg_get_output_chunks(), e.g. to pass them to writev().
+ * The chunks are allocated from the permanent pool of the JPEG object and
+ * are reused for each image written with this destination, so they remain
+ * valid until the next image is started or the object is destroyed.
+ * A chunk_size of 0 selects the default size.
+ */
+
+GLOBAL(void)
+jpeg_chain_dest(j_compress_ptr cinfo, size_t chunk_size)
+{
+  my_chain_dest_ptr dest;
+
+  if (chunk_size == 0)
+    chunk_size = DEFAULT_CHUNK_SIZE;
+
+  /* The destination object is made permanent so that the chunks can be
+   * reused for multiple JPEG images without re-executing jpeg_chain_dest.
+   */
+  if (cinfo->dest == NULL) {    /* first time for this JPEG object? */
+    cinfo->dest = (struct jpeg_destination_mgr *)
+      (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
+                                  sizeof(my_chain_destination_mgr));
+    dest = (my_chain_dest_ptr)cinfo->dest;
+    dest->alloc_size = 0;
+    dest->pool_count = 0;
+    dest->max_chunks = 16;
+    dest->pool = (JOCTET **)
+      (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
+                                  dest->max_chunks * sizeof(JOCTET *));
+    dest->chunks = (jpeg_output_chunk *)
+      (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
+                                  dest->max_chunks *
+                                  sizeof(jpeg_output_chunk));
+  } else if (cinfo->dest->init_destination != init_chain_destination) {
+    /* It is unsafe to reuse the existing destination manager unless it was
+     * created by this function.
+     */
+    ERREXIT(cinfo, JERR_BUFFER_SIZE);
+  }
+
+  dest = (my_chain_dest_ptr)cinfo->dest;
+  dest->pub.init_destination = init_chain_destination;
+  dest->pub.empty_output_buffer = empty_chain_output_buffer;
+  dest->pub.term_destination = term_chain_destination;
+  dest->chunk_size = chunk_size;
+  if (chunk_size > dest->alloc_size) {
+    /* The pooled chunks are too small to be reused.  Memory in the permanent
+     * pool can't be freed piecemeal, so they remain allocated until the JPEG
+     * object is destroyed.
+     */
+    dest->alloc_size = chunk_size;
+    dest->pool_count = 0;
+  }
+  dest->num_chunks = 0;
+}
+
+
+/*
+ * Return the number of chunks written to a chained memory destination by the
+ * most recent image, and set *chunks to point to their descriptors.
+ */
+
+GLOBAL(int)
+jpeg_get_output_chunks(j_compress_ptr cinfo, const jpeg_output_chunk **chunks)
+{
+  my_chain_dest_ptr dest = (my_chain_dest_ptr)cinfo->dest;
+
+  if (cinfo->global_state != CSTATE_START)
+    ERREXIT1(cinfo, JERR_BAD_STATE, cinfo->global_state);
+  if (dest == NULL || dest->pub.init_destination != init_chain_destination)
+    ERREXIT(cinfo, JERR_NO_CHAIN_DEST);
+  if (chunks == NULL)
+    ERREXIT(cinfo, JERR_BAD_PARAM);
+
+  *chunks = dest->chunks;
+  return dest->num_chunks;
+}
@@ -87,6 +87,7 @@ decompress_onepass(j_decompress_ptr cinfo, _JSAMPIMAGE output_buf)
 {
   my_coef_ptr coef = (my_coef_ptr)cinfo->coef;
   JDIMENSION MCU_col_num;       /* index of current MCU within row */
+  JDIMENSION MCU_row_start;     /* index of first MCU in row within scan */
   JDIMENSION last_MCU_col = cinfo->MCUs_per_row - 1;
   JDIMENSION last_iMCU_row = cinfo->total_iMCU_rows - 1;
   int blkn, ci, xindex, yindex, yoffset, useful_width;
@@ -98,8 +99,25 @@ decompress_onepass(j_decompress_ptr cinfo, _JSAMPIMAGE output_buf)
   /* Loop to process as much as one whole iMCU row */
   for (yoffset = coef->MCU_vert_offset; yoffset < coef->MCU_rows_per_iMCU_row;
        yoffset++) {
+    MCU_row_start = iMCU_row_first_MCU(cinfo, cinfo->input_iMCU_row) +
+                    yoffset * cinfo->MCUs_per_row;
     for (MCU_col_num = coef->MCU_ctr; MCU_col_num <= last_MCU_col;
          MCU_col_num++) {
+      /* If the entropy decoder supports random access, then seek past the
+       * MCUs to the left and right of the cropping region rather than
+       * decoding them.
+       */
+      if (cinfo->entropy->seek_mcu) {
+        if (MCU_col_num == coef->MCU_ctr &&
+            MCU_col_num < cinfo->master->first_iMCU_col &&
+            (*cinfo->entropy->seek_mcu) (cinfo, MCU_row_start +
+                                         cinfo->master->first_iMCU_col))
+          MCU_col_num = cinfo->master->first_iMCU_col;
+        else if (MCU_col_num == cinfo->master->last_iMCU_col + 1 &&
+                 (*cinfo->entropy->seek_mcu) (cinfo, MCU_row_start +
+                                              cinfo->MCUs_per_row))
+          break;
+      }
       /* Try to fetch an MCU.  Entropy decoder expects buffer to be zeroed. */
       jzero_far((void *)coef->MCU_buffer[0],
                 (size_t)(cinfo->blocks_in_MCU * sizeof(JBLOCK)));
@@ -370,6 +388,10 @@ smoothing_ok(j_decompress_ptr cinfo)
   if (!cinfo->progressive_mode || cinfo->coef_bits == NULL)
     return FALSE;
 
+  /* Smoothing only estimates AC coefficients, which a 1x1 IDCT ignores. */
+  if (cinfo->master->dc_only)
+    return FALSE;
+
   /* Allocate latch area if not already done */
   if (coef->coef_bits_latch == NULL)
     coef->coef_bits_latch = (int *)
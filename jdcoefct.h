@@ -85,4 +85,19 @@ start_iMCU_row(j_decompress_ptr cinfo)
   coef->MCU_vert_offset = 0;
 }
 
+
+LOCAL(JDIMENSION)
+iMCU_row_first_MCU(j_decompress_ptr cinfo, JDIMENSION iMCU_row)
+/* Return the index (in raster order) of the first MCU in the given iMCU row,
+ * for use with the entropy decoder's seek_mcu() method
+ */
+{
+  JDIMENSION MCU_row = iMCU_row;
+
+  if (cinfo->comps_in_scan == 1)
+    MCU_row *= cinfo->cur_comp_info[0]->v_samp_factor;
+
+  return MCU_row * cinfo->MCUs_per_row;
+}
+
 #endif /* BITS_IN_JSAMPLE != 16 || defined(D_LOSSLESS_SUPPORTED) */
@@ -838,9 +838,9 @@ _jinit_color_deconverter(j_decompress_ptr cinfo)
 #endif
     cinfo->out_color_components = rgb_pixelsize[cinfo->out_color_space];
     if (cinfo->jpeg_color_space == JCS_YCbCr) {
-#ifdef WITH_SIMD
-      if (jsimd_can_ycc_rgb())
-        cconvert->pub._color_convert = jsimd_ycc_rgb_convert;
+#if defined(WITH_SIMD) || defined(WITH_SIMD12)
+      if (_jsimd_can_ycc_rgb())
+        cconvert->pub._color_convert = _jsimd_ycc_rgb_convert;
       else
 #endif
       {
@@ -164,9 +164,9 @@ start_pass(j_decompress_ptr cinfo)
       switch (cinfo->dct_method) {
 #ifdef DCT_ISLOW_SUPPORTED
       case JDCT_ISLOW:
-#ifdef WITH_SIMD
-        if (jsimd_can_idct_islow())
-          method_ptr = jsimd_idct_islow;
+#if defined(WITH_SIMD) || defined(WITH_SIMD12)
+        if (_jsimd_can_idct_islow())
+          method_ptr = _jsimd_idct_islow;
         else
 #endif
           method_ptr = _jpeg_idct_islow;
@@ -0,0 +1,187 @@
+/*
+ * jdext.c
+ *
+ * Copyright (C) 2026, Mozilla Corporation.
+ * For conditions of distribution and use, see the accompanying README file.
+ *
+ * This file contains accessor functions for decompressor extension
+ * parameters.  See jcext.c for the compressor equivalents.
+ *
+ * It also contains the functions that save and load a decode index, which
+ * records the random access points within a single-scan image.  The index
+ * itself is built by the entropy decoder (see jdhuff.c.)
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+
+
+GLOBAL(boolean)
+jpeg_d_bool_param_supported (const j_decompress_ptr cinfo,
+                             J_BOOLEAN_PARAM param)
+{
+  switch (param) {
+  case JBOOLEAN_WARM_CONTEXT:
+  case JBOOLEAN_RECORD_DECODE_INDEX:
+    return TRUE;
+  default:
+    break;
+  }
+
+  return FALSE;
+}
+
+
+GLOBAL(void)
+jpeg_d_set_bool_param (j_decompress_ptr cinfo, J_BOOLEAN_PARAM param,
+                       boolean value)
+{
+  switch (param) {
+  case JBOOLEAN_WARM_CONTEXT:
+    cinfo->master->warm_context = value;
+    jmem_retain_image_pool((j_common_ptr)cinfo, value);
+    break;
+  case JBOOLEAN_RECORD_DECODE_INDEX:
+    cinfo->master->record_decode_index = value;
+    break;
+  default:
+    ERREXIT(cinfo, JERR_BAD_PARAM);
+  }
+}
+
+
+GLOBAL(boolean)
+jpeg_d_get_bool_param (const j_decompress_ptr cinfo, J_BOOLEAN_PARAM param)
+{
+  switch (param) {
+  case JBOOLEAN_WARM_CONTEXT:
+    return cinfo->master->warm_context;
+  case JBOOLEAN_RECORD_DECODE_INDEX:
+    return cinfo->master->record_decode_index;
+  default:
+    ERREXIT(cinfo, JERR_BAD_PARAM);
+  }
+
+  return FALSE;
+}
+
+
+GLOBAL(boolean)
+jpeg_d_int_param_supported (const j_decompress_ptr cinfo, J_INT_PARAM param)
+{
+  switch (param) {
+  case JINT_NUM_THREADS:
+  case JINT_SCAN_BUDGET:
+  case JINT_CHECKPOINT_INTERVAL:
+    return TRUE;
+  default:
+    break;
+  }
+
+  return FALSE;
+}
+
+
+GLOBAL(void)
+jpeg_d_set_int_param (j_decompress_ptr cinfo, J_INT_PARAM param, int value)
+{
+  switch (param) {
+  case JINT_NUM_THREADS:
+    if (value < 1)
+      ERREXIT(cinfo, JERR_BAD_PARAM_VALUE);
+    cinfo->master->num_threads = value;
+    break;
+  case JINT_SCAN_BUDGET:
+    if (value < 0)
+      ERREXIT(cinfo, JERR_BAD_PARAM_VALUE);
+    cinfo->master->scan_budget = value;
+    break;
+  case JINT_CHECKPOINT_INTERVAL:
+    if (value < 0)
+      ERREXIT(cinfo, JERR_BAD_PARAM_VALUE);
+    cinfo->master->checkpoint_interval = value;
+    break;
+  default:
+    ERREXIT(cinfo, JERR_BAD_PARAM);
+  }
+}
+
+
+GLOBAL(int)
+jpeg_d_get_int_param (const j_decompress_ptr cinfo, J_INT_PARAM param)
+{
+  switch (param) {
+  case JINT_NUM_THREADS:
+    return cinfo->master->num_threads;
+  case JINT_SCAN_BUDGET:
+    return cinfo->master->scan_budget;
+  case JINT_CHECKPOINT_INTERVAL:
+    return cinfo->master->checkpoint_interval;
+  default:
+    ERREXIT(cinfo, JERR_BAD_PARAM);
+  }
+
+  return -1;
+}
+
+
+/*
+ * Save the decode index of the current scan.  This can be called at any time
+ * after jpeg_start_decompress() and before jpeg_finish_decompress(), but the
+ * index covers only the part of the scan that has been decoded so far, so it
+ * is normally called after all of the scanlines have been read.
+ *
+ * TRUE is returned if an index was available, FALSE if not.  If TRUE is
+ * returned, *index_data_ptr is set to point to the returned data, and
+ * *index_data_len is set to its length.  As with jpeg_read_icc_profile(), the
+ * data is allocated with malloc() and must be freed by the caller with free().
+ */
+
+GLOBAL(boolean)
+jpeg_save_decode_index(j_decompress_ptr cinfo, JOCTET **index_data_ptr,
+                       unsigned int *index_data_len)
+{
+  if (index_data_ptr == NULL || index_data_len == NULL)
+    ERREXIT(cinfo, JERR_BUFFER_SIZE);
+  if (cinfo->global_state != DSTATE_SCANNING &&
+      cinfo->global_state != DSTATE_RAW_OK &&
+      cinfo->global_state != DSTATE_STOPPING)
+    ERREXIT1(cinfo, JERR_BAD_STATE, cinfo->global_state);
+
+  *index_data_ptr = NULL;       /* avoid confusion if FALSE return */
+  *index_data_len = 0;
+
+  if (cinfo->entropy == NULL || cinfo->entropy->save_index == NULL)
+    return FALSE;
+  return (*cinfo->entropy->save_index) (cinfo, index_data_ptr,
+                                        index_data_len);
+}
+
+
+/*
+ * Supply a decode index that was saved while decompressing the same image.
+ * This must be called after jpeg_read_header() and before
+ * jpeg_start_decompress().  The data is copied, so the caller may free it
+ * immediately.  An index that doesn't match the image is ignored with a
+ * warning when the scan begins.
+ */
+
+GLOBAL(void)
+jpeg_load_decode_index(j_decompress_ptr cinfo, const JOCTET *index_data,
+                       unsigned int index_data_len)
+{
+  if (cinfo->global_state != DSTATE_READY)
+    ERREXIT1(cinfo, JERR_BAD_STATE, cinfo->global_state);
+
+  cinfo->master->decode_index = NULL;
+  cinfo->master->decode_index_len = 0;
+  if (index_data == NULL || index_data_len == 0)
+    return;
+
+  cinfo->master->decode_index = (JOCTET *)
+    (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                index_data_len);
+  memcpy(cinfo->master->decode_index, index_data, index_data_len);
+  cinfo->master->decode_index_len = index_data_len;
+}
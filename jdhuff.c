@@ -19,6 +19,22 @@
  * into local working storage, and update them back to the permanent
  * storage only upon successful completion of an MCU.
  *
+ * If JINT_CHECKPOINT_INTERVAL is set, then the decoder also supports random
+ * access within a single-scan image by way of seek_mcu().  If the scan uses
+ * restart markers and its entire entropy-coded segment is in the source
+ * buffer, then the positions of the markers are indexed when the scan
+ * begins, and seek_mcu() can resume decoding at any restart interval without
+ * decoding the MCUs that precede it.
+ *
+ * A scan without restart markers can only be entered at a position recorded
+ * while decoding it, along with the bit position within that byte and the DC
+ * predictions.  If JBOOLEAN_RECORD_DECODE_INDEX is set, then such a "decode
+ * index" is recorded every JINT_CHECKPOINT_INTERVAL MCUs whenever the segment
+ * is in the source buffer, and it can be saved with jpeg_save_decode_index()
+ * and supplied to later decompressions of the same image with
+ * jpeg_load_decode_index().  (This is the same technique that zran uses for
+ * gzip streams.)
+ *
  * NOTE: All referenced figures are from
  * Recommendation ITU-T T.81 (1992) | ISO/IEC 10918-1:1994.
  */
@@ -28,6 +44,7 @@
 #include "jpeglib.h"
 #include "jdhuff.h"             /* Declarations shared with jd*huff.c */
 #include "jpegapicomp.h"
+#include "jmemsys.h"            /* for MAX_ALLOC_CHUNK */
 #include "jstdhuff.c"
 
 
@@ -42,6 +59,39 @@ typedef struct {
   int last_dc_val[MAX_COMPS_IN_SCAN]; /* last DC coef for each component */
 } savable_state;
 
+/* A position within the entropy-coded segment at which decoding can resume
+ * without decoding any of the MCUs that precede it
+ */
+
+typedef struct {
+  JDIMENSION MCU_num;           /* index of the MCU that begins here */
+  size_t offset;                /* offset of its first byte in the segment */
+  int bit;                      /* # of bits of that byte used by prior MCU */
+  int last_dc_val[MAX_COMPS_IN_SCAN]; /* DC predictions at this point */
+} huff_checkpoint;
+
+/* Serialized decode index (all values are big-endian):
+ *
+ *   0: 'J' 'D' 'X' version
+ *   4: image width
+ *   8: image height
+ *  12: MCUs per row
+ *  16: MCU rows in scan
+ *  20: length of entropy-coded segment (64 bits)
+ *  28: components in scan
+ *  32: # of MCUs between checkpoints
+ *  36: # of checkpoints
+ *  40: checkpoints
+ *
+ * Each checkpoint consists of the offset relative to the previous checkpoint
+ * (32 bits), the bit position (8 bits), and the DC prediction for each
+ * component in the scan (32 bits each.)
+ */
+
+#define INDEX_VERSION  1
+#define INDEX_HEADER_SIZE  40
+#define INDEX_ENTRY_SIZE(comps)  (5 + 4 * (comps))
+
 typedef struct {
   struct jpeg_entropy_decoder pub; /* public fields */
 
@@ -53,6 +103,17 @@ typedef struct {
 
   /* These fields are NOT loaded into local working state. */
   unsigned int restarts_to_go;  /* MCUs left in this restart interval */
+  JDIMENSION next_MCU;          /* index of next MCU within the scan */
+
+  /* Random access index for the current scan (see seek_mcu()) */
+  const JOCTET *scan_data;      /* start of entropy-coded segment */
+  size_t scan_length;           /* # of source bytes from there to the end */
+  size_t segment_length;        /* # of bytes before the terminating marker */
+  huff_checkpoint *checkpoints; /* in increasing MCU order */
+  JDIMENSION num_checkpoints;
+  size_t checkpoints_alloc;     /* allocated size of checkpoints[] */
+  JDIMENSION index_interval;    /* # of MCUs between decode index entries */
+  JDIMENSION record_MCU;        /* next MCU to record in index (0 = none) */
 
   /* Pointers to derived tables (these workspaces have image lifespan) */
   d_derived_tbl *dc_derived_tbls[NUM_HUFF_TBLS];
@@ -71,6 +132,310 @@ typedef struct {
 typedef huff_entropy_decoder *huff_entropy_ptr;
 
 
+/* Forward declarations */
+METHODDEF(boolean) seek_mcu(j_decompress_ptr cinfo, JDIMENSION MCU_num);
+
+
+/*
+ * Locate the next marker in the source buffer, starting at p.  Returns a
+ * pointer to the marker code, or NULL if there is no marker before limit.
+ * As in jpeg_fill_bit_buffer(), any number of 0xFF fill bytes may precede the
+ * 0x00 of a stuffed byte or the code byte of a marker.
+ */
+
+LOCAL(const JOCTET *)
+find_marker(const JOCTET *p, const JOCTET *limit)
+{
+  const JOCTET *q;
+
+  for (; ; p = q + 1) {
+    p = (const JOCTET *)memchr(p, 0xFF, limit - p);
+    if (p == NULL)
+      return NULL;
+    for (q = p + 1; q < limit && *q == 0xFF; q++);
+    if (q >= limit)
+      return NULL;
+    if (*q != 0)
+      return q;
+  }
+}
+
+
+/*
+ * Make sure that checkpoints[] can hold the given number of checkpoints.
+ */
+
+LOCAL(void)
+alloc_checkpoints(j_decompress_ptr cinfo, size_t num_checkpoints)
+{
+  huff_entropy_ptr entropy = (huff_entropy_ptr)cinfo->entropy;
+
+  if (entropy->checkpoints_alloc < num_checkpoints) {
+    entropy->checkpoints = (huff_checkpoint *)
+      (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                  num_checkpoints * sizeof(huff_checkpoint));
+    entropy->checkpoints_alloc = num_checkpoints;
+  }
+}
+
+
+/*
+ * Build the random access index for the current scan by locating its restart
+ * markers.  A checkpoint is kept for every restart interval that begins at
+ * least JINT_CHECKPOINT_INTERVAL MCUs after the previous checkpoint.
+ *
+ * The markers are located in the source buffer, so this works only if the
+ * entire entropy-coded segment is there (as is the case with jpeg_mem_src()),
+ * which also guarantees that the source buffer won't be refilled while the
+ * segment is decoded.  If the segment isn't in the buffer, or if the restart
+ * markers are missing or out of sequence, then no index is built, and the
+ * scan is decoded serially.
+ */
+
+LOCAL(void)
+index_restart_markers(j_decompress_ptr cinfo)
+{
+  huff_entropy_ptr entropy = (huff_entropy_ptr)cinfo->entropy;
+  const JOCTET *start = cinfo->src->next_input_byte;
+  const JOCTET *limit = start + cinfo->src->bytes_in_buffer;
+  const JOCTET *p, *q;
+  JDIMENSION total_MCUs, num_intervals, spacing, interval;
+  size_t max_checkpoints;
+
+  if (start == NULL)
+    return;
+  total_MCUs = cinfo->MCUs_per_row * cinfo->MCU_rows_in_scan;
+  num_intervals = total_MCUs / cinfo->restart_interval +
+                  (total_MCUs % cinfo->restart_interval != 0);
+  if (num_intervals < 2)
+    return;
+
+  /* # of restart intervals between checkpoints */
+  spacing = (JDIMENSION)cinfo->master->checkpoint_interval /
+            cinfo->restart_interval;
+  if (spacing < 1)
+    spacing = 1;
+  while ((max_checkpoints = (num_intervals - 1) / spacing) >
+         (size_t)MAX_ALLOC_CHUNK / sizeof(huff_checkpoint))
+    spacing *= 2;
+  if (max_checkpoints == 0)
+    return;
+  alloc_checkpoints(cinfo, max_checkpoints);
+
+  interval = 1;
+  for (p = start; (q = find_marker(p, limit)) != NULL; p = q + 1) {
+    if (*q < JPEG_RST0 || *q > JPEG_RST0 + 7)
+      break;                    /* terminating marker */
+    if (interval >= num_intervals ||
+        *q != JPEG_RST0 + ((interval - 1) & 7))
+      goto abandon;
+    if (interval % spacing == 0) {
+      huff_checkpoint *cp = &entropy->checkpoints[entropy->num_checkpoints++];
+
+      cp->MCU_num = interval * cinfo->restart_interval;
+      cp->offset = q + 1 - start;
+      cp->bit = 0;
+      memset(cp->last_dc_val, 0, sizeof(cp->last_dc_val));
+    }
+    interval++;
+  }
+  if (q == NULL || interval != num_intervals)
+    goto abandon;
+
+  entropy->scan_data = start;
+  entropy->scan_length = limit - start;
+  entropy->pub.seek_mcu = seek_mcu;
+  return;
+
+abandon:
+  entropy->num_checkpoints = 0;
+}
+
+
+LOCAL(unsigned int)
+get_uint32(const JOCTET *p)
+{
+  return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) |
+         ((unsigned int)p[2] << 8) | (unsigned int)p[3];
+}
+
+
+LOCAL(void)
+put_uint32(JOCTET *p, unsigned int val)
+{
+  p[0] = (JOCTET)(val >> 24);
+  p[1] = (JOCTET)(val >> 16);
+  p[2] = (JOCTET)(val >> 8);
+  p[3] = (JOCTET)val;
+}
+
+
+/*
+ * Load the decode index supplied by the application.  Returns FALSE if it
+ * doesn't describe the current scan.
+ */
+
+LOCAL(boolean)
+load_decode_index(j_decompress_ptr cinfo)
+{
+  huff_entropy_ptr entropy = (huff_entropy_ptr)cinfo->entropy;
+  const JOCTET *data = cinfo->master->decode_index;
+  size_t len = cinfo->master->decode_index_len;
+  size_t entry_size = INDEX_ENTRY_SIZE(cinfo->comps_in_scan);
+  JDIMENSION total_MCUs = cinfo->MCUs_per_row * cinfo->MCU_rows_in_scan;
+  JDIMENSION interval, num_checkpoints, i;
+  size_t offset = 0;
+  int ci;
+
+  if (len < INDEX_HEADER_SIZE || data[0] != 'J' || data[1] != 'D' ||
+      data[2] != 'X' || data[3] != INDEX_VERSION)
+    return FALSE;
+  if (get_uint32(data + 4) != cinfo->image_width ||
+      get_uint32(data + 8) != cinfo->image_height ||
+      get_uint32(data + 12) != cinfo->MCUs_per_row ||
+      get_uint32(data + 16) != cinfo->MCU_rows_in_scan ||
+      get_uint32(data + 20) !=
+        (unsigned int)(entropy->segment_length >> 16 >> 16) ||
+      get_uint32(data + 24) != (unsigned int)entropy->segment_length ||
+      get_uint32(data + 28) != (unsigned int)cinfo->comps_in_scan)
+    return FALSE;
+  interval = get_uint32(data + 32);
+  num_checkpoints = get_uint32(data + 36);
+  if (interval < 1 || num_checkpoints > total_MCUs / interval ||
+      (len - INDEX_HEADER_SIZE) / entry_size != num_checkpoints ||
+      (len - INDEX_HEADER_SIZE) % entry_size != 0 ||
+      num_checkpoints > (size_t)MAX_ALLOC_CHUNK / sizeof(huff_checkpoint))
+    return FALSE;
+  if (num_checkpoints == 0)
+    return TRUE;
+  alloc_checkpoints(cinfo, num_checkpoints);
+
+  data += INDEX_HEADER_SIZE;
+  for (i = 0; i < num_checkpoints; i++, data += entry_size) {
+    huff_checkpoint *cp = &entropy->checkpoints[i];
+
+    offset += get_uint32(data);
+    cp->MCU_num = (i + 1) * interval;
+    cp->offset = offset;
+    cp->bit = data[4];
+    for (ci = 0; ci < cinfo->comps_in_scan; ci++)
+      cp->last_dc_val[ci] = (int)get_uint32(data + 5 + 4 * ci);
+    /* seek_mcu() reads up to two bytes (FF/00) at the offset. */
+    if (offset + 2 > entropy->segment_length || cp->bit > 7)
+      return FALSE;
+  }
+
+  entropy->num_checkpoints = num_checkpoints;
+  entropy->index_interval = interval;
+  return TRUE;
+}
+
+
+/*
+ * Prepare for random access within a scan that has no restart markers.  If
+ * the application supplied a decode index, then it is loaded.  Otherwise, a
+ * decode index is recorded as the scan is decoded.
+ */
+
+LOCAL(void)
+index_segment(j_decompress_ptr cinfo)
+{
+  huff_entropy_ptr entropy = (huff_entropy_ptr)cinfo->entropy;
+  const JOCTET *start = cinfo->src->next_input_byte;
+  const JOCTET *limit = start + cinfo->src->bytes_in_buffer;
+  const JOCTET *q;
+  JDIMENSION total_MCUs, interval;
+  size_t max_checkpoints;
+  int blkn;
+
+  /* As in index_restart_markers(), the whole segment must be in the source
+   * buffer.
+   */
+  if (start == NULL || (q = find_marker(start, limit)) == NULL)
+    return;
+  entropy->scan_data = start;
+  entropy->scan_length = limit - start;
+  while (q - 1 > start && q[-1] == 0xFF)
+    q--;
+  entropy->segment_length = q - start;
+
+  if (cinfo->master->decode_index != NULL) {
+    if (load_decode_index(cinfo)) {
+      if (entropy->num_checkpoints > 0)
+        entropy->pub.seek_mcu = seek_mcu;
+    } else {
+      entropy->num_checkpoints = 0;
+      WARNMS(cinfo, JWRN_BAD_DECODE_INDEX);
+    }
+    return;
+  }
+
+  total_MCUs = cinfo->MCUs_per_row * cinfo->MCU_rows_in_scan;
+  interval = (JDIMENSION)cinfo->master->checkpoint_interval;
+  while ((max_checkpoints = total_MCUs / interval) >
+         (size_t)MAX_ALLOC_CHUNK / sizeof(huff_checkpoint))
+    interval *= 2;
+  if (max_checkpoints == 0)
+    return;
+  alloc_checkpoints(cinfo, max_checkpoints);
+  entropy->index_interval = interval;
+  entropy->record_MCU = interval;
+
+  /* The index must include the DC predictions of every component, even if
+   * this decompression doesn't need them.
+   */
+  for (blkn = 0; blkn < cinfo->blocks_in_MCU; blkn++)
+    entropy->dc_needed[blkn] = TRUE;
+}
+
+
+/*
+ * Record a decode index entry for the MCU that is about to be decoded.  This
+ * is called by decode_mcu() when it reaches entropy->record_MCU.
+ */
+
+LOCAL(void)
+record_checkpoint(j_decompress_ptr cinfo)
+{
+  huff_entropy_ptr entropy = (huff_entropy_ptr)cinfo->entropy;
+  const JOCTET *p = cinfo->src->next_input_byte;
+  int bits_left = entropy->bitstate.bits_left;
+  huff_checkpoint *cp;
+  int n;
+
+  /* Once the terminating marker has been read, the bit buffer may contain
+   * fake zero bits, so there is nothing more to record.
+   */
+  entropy->record_MCU = 0;
+  if (cinfo->unread_marker != 0 || entropy->pub.insufficient_data)
+    return;
+
+  /* The bit buffer holds the last bits_left bits of the bytes preceding p.
+   * Back up to the byte containing the first of them.  An FF/00 pair
+   * represents a single byte.
+   */
+  for (n = (bits_left + 7) / 8; n > 0; n--) {
+    if (p - 2 >= entropy->scan_data && p[-1] == 0 && p[-2] == 0xFF)
+      p -= 2;
+    else
+      p--;
+  }
+  if (p < entropy->scan_data ||
+      p + 2 > entropy->scan_data + entropy->segment_length)
+    return;
+
+  cp = &entropy->checkpoints[entropy->num_checkpoints++];
+  cp->MCU_num = entropy->next_MCU;
+  cp->offset = p - entropy->scan_data;
+  cp->bit = (8 - bits_left % 8) % 8;
+  memcpy(cp->last_dc_val, entropy->saved.last_dc_val,
+         sizeof(cp->last_dc_val));
+
+  if (entropy->num_checkpoints < entropy->checkpoints_alloc)
+    entropy->record_MCU = entropy->next_MCU + entropy->index_interval;
+}
+
+
 /*
  * Initialize for a Huffman-compressed scan.
  */
@@ -129,6 +494,22 @@ start_pass_huff_decoder(j_decompress_ptr cinfo)
 
   /* Initialize restart counter */
   entropy->restarts_to_go = cinfo->restart_interval;
+  entropy->next_MCU = 0;
+
+  /* Prepare for random access if it has been requested */
+  entropy->num_checkpoints = 0;
+  entropy->index_interval = 0;
+  entropy->record_MCU = 0;
+  entropy->pub.seek_mcu = NULL;
+  if (!cinfo->inputctl->has_multiple_scans && !cinfo->buffered_image) {
+    if (cinfo->restart_interval) {
+      if (cinfo->master->checkpoint_interval > 0)
+        index_restart_markers(cinfo);
+    } else if (cinfo->master->decode_index != NULL ||
+               (cinfo->master->record_decode_index &&
+                cinfo->master->checkpoint_interval > 0))
+      index_segment(cinfo);
+  }
 }
 
 
@@ -245,6 +626,41 @@ jpeg_make_d_derived_tbl(j_decompress_ptr cinfo, boolean isDC, int tblno,
     }
   }
 
+  /* Compute code + value lookahead table.  Again, we set all the table
+   * entries to 0, indicating "too long", and then we fill in the entries for
+   * all codes whose length, plus the number of magnitude bits that follow
+   * them, is short enough.  Lossless DC symbol 16 has no magnitude bits but
+   * represents a difference of 32768, so it is left to the slow path.
+   */
+
+  memset(dtbl->val_lookup, 0, sizeof(dtbl->val_lookup));
+
+  p = 0;
+  for (l = 1; l <= HUFF_VAL_LOOKAHEAD; l++) {
+    for (i = 1; i <= (int)htbl->bits[l]; i++, p++) {
+      int sym = htbl->huffval[p];
+      int run = sym >> 4, size = sym & 15, extra = HUFF_VAL_LOOKAHEAD - l;
+      int bits, val;
+
+      if (isDC && sym > 15)
+        continue;
+      if (size > extra)
+        continue;
+      extra -= size;
+      for (bits = 0; bits < (1 << size); bits++) {
+        /* Figure F.12: extend sign bit */
+        val = bits;
+        if (size && bits < (1 << (size - 1)))
+          val -= (1 << size) - 1;
+        lookbits = ((huffcode[p] << size) | bits) << extra;
+        for (ctr = 1 << extra; ctr > 0; ctr--) {
+          dtbl->val_lookup[lookbits] = (val * 256) | (run << 4) | (l + size);
+          lookbits++;
+        }
+      }
+    }
+  }
+
   /* Validate symbols as being reasonable.
    * For AC tables, we make no check, but accept all byte values 0..255.
    * For DC tables, we require the symbols to be in range 0..15 in lossy mode
@@ -570,12 +986,7 @@ decode_mcu_slow(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
     /* Decode a single block's worth of coefficients */
 
     /* Section F.2.2.1: decode the DC coefficient difference */
-    HUFF_DECODE(s, br_state, dctbl, return FALSE, label1);
-    if (s) {
-      CHECK_BIT_BUFFER(br_state, s, return FALSE);
-      r = GET_BITS(s);
-      s = HUFF_EXTEND(r, s);
-    }
+    HUFF_DECODE_VALUE(s, r, br_state, dctbl, return FALSE, label1);
 
     if (entropy->dc_needed[blkn]) {
       /* Convert DC difference to actual value, update last_dc_val */
@@ -601,16 +1012,10 @@ decode_mcu_slow(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
       /* Section F.2.2.2: decode the AC coefficients */
       /* Since zeroes are skipped, output area must be cleared beforehand */
       for (k = 1; k < DCTSIZE2; k++) {
-        HUFF_DECODE(s, br_state, actbl, return FALSE, label2);
-
-        r = s >> 4;
-        s &= 15;
+        HUFF_DECODE_VALUE(s, r, br_state, actbl, return FALSE, label2);
 
         if (s) {
           k += r;
-          CHECK_BIT_BUFFER(br_state, s, return FALSE);
-          r = GET_BITS(s);
-          s = HUFF_EXTEND(r, s);
           /* Output coefficient in natural (dezigzagged) order.
            * Note: the extra entries in jpeg_natural_order[] will save us
            * if k >= DCTSIZE2, which could happen if the data is corrupted.
@@ -680,12 +1085,7 @@ decode_mcu_fast(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
     d_derived_tbl *actbl = entropy->ac_cur_tbls[blkn];
     register int s, k, r, l;
 
-    HUFF_DECODE_FAST(s, l, dctbl);
-    if (s) {
-      FILL_BIT_BUFFER_FAST
-      r = GET_BITS(s);
-      s = HUFF_EXTEND(r, s);
-    }
+    HUFF_DECODE_VALUE_FAST(s, r, l, dctbl);
 
     if (entropy->dc_needed[blkn]) {
       int ci = cinfo->MCU_membership[blkn];
@@ -701,15 +1101,10 @@ decode_mcu_fast(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
     if (entropy->ac_needed[blkn] && block) {
 
       for (k = 1; k < DCTSIZE2; k++) {
-        HUFF_DECODE_FAST(s, l, actbl);
-        r = s >> 4;
-        s &= 15;
+        HUFF_DECODE_VALUE_FAST(s, r, l, actbl);
 
         if (s) {
           k += r;
-          FILL_BIT_BUFFER_FAST
-          r = GET_BITS(s);
-          s = HUFF_EXTEND(r, s);
           (*block)[jpeg_natural_order[k]] = (JCOEF)s;
         } else {
           if (r != 15) break;
@@ -802,6 +1197,150 @@ use_slow:
   if (cinfo->restart_interval)
     entropy->restarts_to_go--;
 
+  entropy->next_MCU++;
+  if (entropy->next_MCU == entropy->record_MCU)
+    record_checkpoint(cinfo);
+  return TRUE;
+}
+
+
+/*
+ * Position the decoder so that the next call to decode_mcu() decodes the MCU
+ * with the given index (in raster order) within the current scan.  This is
+ * done by resuming at the last checkpoint at or before that MCU and then
+ * discarding the MCUs between the checkpoint and the requested MCU.  Returns
+ * FALSE, without changing the decoder state, if there is no such checkpoint
+ * beyond the current position, in which case the caller should simply decode
+ * the intervening MCUs.
+ */
+
+METHODDEF(boolean)
+seek_mcu(j_decompress_ptr cinfo, JDIMENSION MCU_num)
+{
+  huff_entropy_ptr entropy = (huff_entropy_ptr)cinfo->entropy;
+  huff_checkpoint *cp;
+  JDIMENSION lo = 0, hi = entropy->num_checkpoints, mid;
+  int ci;
+
+  /* Find the last checkpoint at or before the requested MCU. */
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (entropy->checkpoints[mid].MCU_num <= MCU_num)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo == 0)
+    return FALSE;
+  cp = &entropy->checkpoints[lo - 1];
+  if (cp->MCU_num <= entropy->next_MCU)
+    return FALSE;
+
+  cinfo->src->next_input_byte = entropy->scan_data + cp->offset;
+  cinfo->src->bytes_in_buffer = entropy->scan_length - cp->offset;
+  entropy->bitstate.bits_left = 0;
+  entropy->bitstate.get_buffer = 0;
+  if (cp->bit) {
+    /* Reload the bits of the first byte that the previous MCU didn't use. */
+    int c = *cinfo->src->next_input_byte++;
+
+    cinfo->src->bytes_in_buffer--;
+    if (c == 0xFF) {
+      /* Skip the stuffed zero byte */
+      cinfo->src->next_input_byte++;
+      cinfo->src->bytes_in_buffer--;
+    }
+    entropy->bitstate.get_buffer = c;
+    entropy->bitstate.bits_left = 8 - cp->bit;
+  }
+  for (ci = 0; ci < cinfo->comps_in_scan; ci++)
+    entropy->saved.last_dc_val[ci] = cp->last_dc_val[ci];
+  if (cinfo->restart_interval) {
+    /* The checkpoint immediately follows a restart marker, so the decoder
+     * state is the same as after process_restart().
+     */
+    entropy->restarts_to_go = cinfo->restart_interval;
+    cinfo->marker->next_restart_num =
+      (int)((cp->MCU_num / cinfo->restart_interval) & 7);
+  }
+  cinfo->unread_marker = 0;
+  entropy->pub.insufficient_data = FALSE;
+  entropy->next_MCU = cp->MCU_num;
+
+  /* This cannot suspend, since the whole segment is in the source buffer. */
+  while (entropy->next_MCU < MCU_num)
+    if (!decode_mcu(cinfo, NULL))
+      break;
+
+  return TRUE;
+}
+
+
+/*
+ * Serialize the decode index of the current scan (see
+ * jpeg_save_decode_index().)
+ */
+
+METHODDEF(boolean)
+save_index(j_decompress_ptr cinfo, JOCTET **index_data_ptr,
+           unsigned int *index_data_len)
+{
+  huff_entropy_ptr entropy = (huff_entropy_ptr)cinfo->entropy;
+  size_t entry_size = INDEX_ENTRY_SIZE(cinfo->comps_in_scan);
+  JDIMENSION num_checkpoints = 0, i;
+  size_t prev_offset = 0;
+  JOCTET *data, *ptr;
+  int ci;
+
+  /* Restart marker indices are rebuilt for every decompression, so only
+   * recorded or loaded indices are saved.
+   */
+  if (entropy->index_interval == 0)
+    return FALSE;
+
+  /* Offsets are stored as 32-bit deltas, and the length of the index must fit
+   * in an unsigned int, so truncate the index if necessary.
+   */
+  for (i = 0; i < entropy->num_checkpoints; i++) {
+    if (entropy->checkpoints[i].offset - prev_offset > 0xFFFFFFFFUL ||
+        (size_t)(i + 1) * entry_size > 0xFFFFFFFFUL - INDEX_HEADER_SIZE)
+      break;
+    prev_offset = entropy->checkpoints[i].offset;
+    num_checkpoints++;
+  }
+  if (num_checkpoints == 0)
+    return FALSE;
+
+  *index_data_len =
+    (unsigned int)(INDEX_HEADER_SIZE + num_checkpoints * entry_size);
+  data = (JOCTET *)malloc(*index_data_len);
+  if (data == NULL)
+    ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 12);  /* oops, out of memory */
+
+  data[0] = 'J';  data[1] = 'D';  data[2] = 'X';  data[3] = INDEX_VERSION;
+  put_uint32(data + 4, cinfo->image_width);
+  put_uint32(data + 8, cinfo->image_height);
+  put_uint32(data + 12, cinfo->MCUs_per_row);
+  put_uint32(data + 16, cinfo->MCU_rows_in_scan);
+  put_uint32(data + 20, (unsigned int)(entropy->segment_length >> 16 >> 16));
+  put_uint32(data + 24, (unsigned int)entropy->segment_length);
+  put_uint32(data + 28, (unsigned int)cinfo->comps_in_scan);
+  put_uint32(data + 32, entropy->index_interval);
+  put_uint32(data + 36, num_checkpoints);
+
+  prev_offset = 0;
+  ptr = data + INDEX_HEADER_SIZE;
+  for (i = 0; i < num_checkpoints; i++, ptr += entry_size) {
+    huff_checkpoint *cp = &entropy->checkpoints[i];
+
+    put_uint32(ptr, (unsigned int)(cp->offset - prev_offset));
+    ptr[4] = (JOCTET)cp->bit;
+    for (ci = 0; ci < cinfo->comps_in_scan; ci++)
+      put_uint32(ptr + 5 + 4 * ci, (unsigned int)cp->last_dc_val[ci]);
+    prev_offset = cp->offset;
+  }
+
+  *index_data_ptr = data;
   return TRUE;
 }
 
@@ -828,6 +1367,10 @@ jinit_huff_decoder(j_decompress_ptr cinfo)
   cinfo->entropy = (struct jpeg_entropy_decoder *)entropy;
   entropy->pub.start_pass = start_pass_huff_decoder;
   entropy->pub.decode_mcu = decode_mcu;
+  entropy->pub.seek_mcu = NULL;
+  entropy->pub.save_index = save_index;
+  entropy->checkpoints = NULL;
+  entropy->checkpoints_alloc = 0;
 
   /* Mark tables unallocated */
   for (i = 0; i < NUM_HUFF_TBLS; i++) {
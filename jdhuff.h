@@ -23,6 +23,7 @@
 /* Derived data constructed for each Huffman table */
 
 #define HUFF_LOOKAHEAD  8       /* # of bits of lookahead */
+#define HUFF_VAL_LOOKAHEAD  11  /* # of bits of code + value lookahead */
 
 typedef struct {
   /* Basic tables: (element [0] of each array is unused) */
@@ -48,6 +49,21 @@ typedef struct {
    * symbol.
    */
   int lookup[1 << HUFF_LOOKAHEAD];
+
+  /* Code + value lookahead table: indexed by the next HUFF_VAL_LOOKAHEAD
+   * bits of the input data stream.  If the next Huffman code and the
+   * magnitude bits that follow it are together no more than
+   * HUFF_VAL_LOOKAHEAD bits long, we can obtain the decoded coefficient value
+   * directly from this table, without a separate GET_BITS()/HUFF_EXTEND()
+   * step.
+   *
+   * The lower 4 bits of each table entry contain the total number of bits
+   * (code + magnitude), or 0 if too long.  The next 4 bits contain the run
+   * length (the upper 4 bits of the symbol, which is always 0 for DC
+   * symbols), and the remaining bits contain the signed coefficient value
+   * (0 for EOB and ZRL codes.)
+   */
+  int val_lookup[1 << HUFF_VAL_LOOKAHEAD];
 } d_derived_tbl;
 
 /* Expand a Huffman table definition into the derived format */
@@ -243,6 +259,60 @@ slowlabel: \
       s = htbl->pub->huffval[(int)(s + htbl->valoffset[nb]) & 0xFF]; \
   }
 
+/*
+ * These macros decode the next Huffman code along with the magnitude bits
+ * that follow it, using the code + value lookahead table if possible.  On
+ * return, r is the run length (the upper 4 bits of the symbol), and s is the
+ * sign-extended coefficient value, or 0 if the symbol has no magnitude bits.
+ * HUFF_EXTEND must be defined by the including module.
+ *
+ * HUFF_DECODE_VALUE refills the bit buffer under the same conditions as
+ * HUFF_DECODE followed by CHECK_BIT_BUFFER, so the bit buffer state (and thus
+ * the handling of corrupt or truncated data) is unchanged.
+ */
+
+#define HUFF_DECODE_VALUE(s, r, state, htbl, failaction, slowlabel) { \
+  register int vl; \
+  if (bits_left < HUFF_LOOKAHEAD) { \
+    if (!jpeg_fill_bit_buffer(&state, get_buffer, bits_left, 0)) \
+      { failaction; } \
+    get_buffer = state.get_buffer;  bits_left = state.bits_left; \
+  } \
+  if (bits_left >= HUFF_VAL_LOOKAHEAD && \
+      (vl = htbl->val_lookup[PEEK_BITS(HUFF_VAL_LOOKAHEAD)]) != 0) { \
+    DROP_BITS(vl & 15); \
+    r = (vl >> 4) & 15; \
+    s = vl >> 8; \
+  } else { \
+    HUFF_DECODE(s, state, htbl, failaction, slowlabel); \
+    r = s >> 4; \
+    s &= 15; \
+    if (s) { \
+      CHECK_BIT_BUFFER(state, s, failaction); \
+      vl = GET_BITS(s); \
+      s = HUFF_EXTEND(vl, s); \
+    } \
+  } \
+}
+
+#define HUFF_DECODE_VALUE_FAST(s, r, nb, htbl) \
+  FILL_BIT_BUFFER_FAST; \
+  s = htbl->val_lookup[PEEK_BITS(HUFF_VAL_LOOKAHEAD)]; \
+  if (s) { \
+    DROP_BITS(s & 15); \
+    r = (s >> 4) & 15; \
+    s >>= 8; \
+  } else { \
+    HUFF_DECODE_FAST(s, nb, htbl); \
+    r = s >> 4; \
+    s &= 15; \
+    if (s) { \
+      FILL_BIT_BUFFER_FAST \
+      nb = GET_BITS(s); \
+      s = HUFF_EXTEND(nb, s); \
+    } \
+  }
+
 /* Out-of-line case for Huffman code fetching */
 EXTERN(int) jpeg_huff_decode(bitread_working_state *state,
                              register bit_buf_type get_buffer,
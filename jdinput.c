@@ -37,6 +37,7 @@ typedef my_input_controller *my_inputctl_ptr;
 
 /* Forward declarations */
 METHODDEF(int) consume_markers(j_decompress_ptr cinfo);
+METHODDEF(int) skip_scan(j_decompress_ptr cinfo);
 
 
 /*
@@ -293,6 +294,11 @@ start_input_pass(j_decompress_ptr cinfo)
   per_scan_setup(cinfo);
   if (!cinfo->master->lossless)
     latch_quant_tables(cinfo);
+  if (cinfo->master->dc_only && cinfo->progressive_mode && cinfo->Ss > 0) {
+    /* The AC coefficients won't be used, so don't bother decoding them. */
+    cinfo->inputctl->consume_input = skip_scan;
+    return;
+  }
   (*cinfo->entropy->start_pass) (cinfo);
   (*cinfo->coef->start_input_pass) (cinfo);
   cinfo->inputctl->consume_input = cinfo->coef->consume_data;
@@ -312,6 +318,23 @@ finish_input_pass(j_decompress_ptr cinfo)
 }
 
 
+/*
+ * Skip the compressed data of an AC scan in a progressive image.
+ * This is used in place of the coefficient controller's consume_data routine
+ * when every component is reconstructed from its DC coefficient alone.
+ * Return value is JPEG_SUSPENDED or JPEG_SCAN_COMPLETED.
+ */
+
+METHODDEF(int)
+skip_scan(j_decompress_ptr cinfo)
+{
+  if (!(*cinfo->marker->skip_scan_data) (cinfo))
+    return JPEG_SUSPENDED;
+  finish_input_pass(cinfo);
+  return JPEG_SCAN_COMPLETED;
+}
+
+
 /*
  * Read JPEG markers before, between, or after compressed-data scans.
  * Change state as necessary when a new scan is reached.
@@ -333,6 +356,18 @@ consume_markers(j_decompress_ptr cinfo)
 
   val = (*cinfo->marker->read_markers) (cinfo);
 
+  /* If the caller has limited the number of progressive scans to decode, then
+   * treat the SOS marker of the first scan beyond the limit as EOI.  The
+   * remainder of the datastream is not read, and block smoothing estimates the
+   * coefficients that the skipped scans would have refined.
+   */
+  if (val == JPEG_REACHED_SOS && !inputctl->inheaders &&
+      cinfo->progressive_mode && cinfo->master->scan_budget > 0 &&
+      cinfo->input_scan_number > cinfo->master->scan_budget) {
+    cinfo->input_scan_number--;
+    val = JPEG_REACHED_EOI;
+  }
+
   switch (val) {
   case JPEG_REACHED_SOS:        /* Found SOS */
     if (inputctl->inheaders) {  /* 1st SOS */
@@ -292,6 +292,8 @@ jinit_lhuff_decoder(j_decompress_ptr cinfo)
   entropy->pub.start_pass = start_pass_lhuff_decoder;
   entropy->pub.decode_mcus = decode_mcus;
   entropy->pub.process_restart = process_restart;
+  entropy->pub.seek_mcu = NULL;
+  entropy->pub.save_index = NULL;
 
   /* Mark tables unallocated */
   for (i = 0; i < NUM_HUFF_TBLS; i++) {
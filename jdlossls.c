@@ -18,6 +18,7 @@
 #include "jinclude.h"
 #include "jpeglib.h"
 #include "jlossls.h"
+#include "jsimd.h"
 
 #ifdef D_LOSSLESS_SUPPORTED
 
@@ -184,6 +185,13 @@ jpeg_undifference_first_row(j_decompress_ptr cinfo, int comp_index,
    * undifferencer that corresponds to the predictor specified in the
    * scan header.
    */
+#if defined(WITH_SIMD) || defined(WITH_SIMD12) || defined(WITH_SIMD16)
+  /* The SIMD undifferencers support only predictors 1-5 (see jsimd.h.) */
+  if (cinfo->Ss <= 5 && jsimd_can_undifference()) {
+    losslessd->predict_undifference[comp_index] = jsimd_undifference;
+    return;
+  }
+#endif
   switch (cinfo->Ss) {
   case 1:
     losslessd->predict_undifference[comp_index] = jpeg_undifference1;
@@ -262,6 +270,11 @@ start_pass_lossless(j_decompress_ptr cinfo)
     losslessd->predict_undifference[ci] = jpeg_undifference_first_row;
 
   /* Set scaler function based on Pt */
+#if defined(WITH_SIMD) || defined(WITH_SIMD12) || defined(WITH_SIMD16)
+  if (_jsimd_can_upscale())
+    losslessd->scaler_scale = _jsimd_upscale;
+  else
+#endif
   if (cinfo->Al)
     losslessd->scaler_scale = simple_upscale;
   else
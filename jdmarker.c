@@ -1258,6 +1258,53 @@ jpeg_resync_to_restart(j_decompress_ptr cinfo, int desired)
 }
 
 
+/*
+ * Skip the compressed data of the current scan without decoding it, stopping
+ * at the first marker other than RSTn and saving it in cinfo->unread_marker.
+ * Unlike next_marker(), this does not consider the skipped bytes to be
+ * extraneous.  Returns FALSE if had to suspend.
+ */
+
+METHODDEF(boolean)
+skip_scan_data(j_decompress_ptr cinfo)
+{
+  const JOCTET *ptr;
+  int c;
+  INPUT_VARS(cinfo);
+
+  for (;;) {
+    /* Skip quickly to the next FF byte. */
+    MAKE_BYTE_AVAIL(cinfo, return FALSE);
+    ptr = (const JOCTET *)memchr(next_input_byte, 0xFF, bytes_in_buffer);
+    if (ptr == NULL) {
+      next_input_byte += bytes_in_buffer;
+      bytes_in_buffer = 0;
+      INPUT_SYNC(cinfo);
+      continue;
+    }
+    bytes_in_buffer -= ptr - next_input_byte;
+    next_input_byte = ptr;
+    INPUT_SYNC(cinfo);
+    /* As in next_marker(), swallow any duplicate FF bytes.  If the FF is
+     * followed by a zero byte (stuffed FF data byte) or a restart marker,
+     * then it is part of the scan, so we discard it and keep going.
+     */
+    INPUT_BYTE(cinfo, c, return FALSE);
+    do {
+      INPUT_BYTE(cinfo, c, return FALSE);
+    } while (c == 0xFF);
+    if (c != 0 && (c < (int)M_RST0 || c > (int)M_RST7))
+      break;
+    INPUT_SYNC(cinfo);
+  }
+
+  cinfo->unread_marker = c;
+
+  INPUT_SYNC(cinfo);
+  return TRUE;
+}
+
+
 /*
  * Reset marker processing state to begin a fresh datastream.
  */
@@ -1297,6 +1344,7 @@ jinit_marker_reader(j_decompress_ptr cinfo)
   marker->pub.reset_marker_reader = reset_marker_reader;
   marker->pub.read_markers = read_markers;
   marker->pub.read_restart_marker = read_restart_marker;
+  marker->pub.skip_scan_data = skip_scan_data;
   /* Initialize COM/APPn processing.
    * By default, we examine and then discard APP0 and APP14,
    * but simply discard COM and all other APPn.
@@ -283,11 +283,16 @@ jpeg_calc_output_dimensions(j_decompress_ptr cinfo)
      * scale up the chroma components via IDCT scaling rather than upsampling.
      * This saves time if the upsampler gets to use 1:1 scaling.
      * Note this code adapts subsampling ratios which are powers of 2.
+     * If the application has requested a scaling ratio smaller than
+     * 1/block_size, then we instead reconstruct all components from their DC
+     * coefficients alone, which allows the AC scans of a progressive image to
+     * be skipped (see master_selection().)
      */
     for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
          ci++, compptr++) {
       int ssize = cinfo->_min_DCT_scaled_size;
       while (ssize < DCTSIZE &&
+             cinfo->scale_num * DCTSIZE >= cinfo->scale_denom &&
              ((cinfo->max_h_samp_factor * cinfo->_min_DCT_scaled_size) %
               (compptr->h_samp_factor * ssize * 2) == 0) &&
              ((cinfo->max_v_samp_factor * cinfo->_min_DCT_scaled_size) %
@@ -512,6 +517,8 @@ master_selection(j_decompress_ptr cinfo)
 {
   my_master_ptr master = (my_master_ptr)cinfo->master;
   boolean use_c_buffer;
+  int ci;
+  jpeg_component_info *compptr;
   long samplesperrow;
   JDIMENSION jd_samplesperrow;
 
@@ -539,6 +546,16 @@ master_selection(j_decompress_ptr cinfo)
   if ((long)jd_samplesperrow != samplesperrow)
     ERREXIT(cinfo, JERR_WIDTH_OVERFLOW);
 
+  /* If every component uses a 1x1 IDCT, then only the DC coefficients are
+   * needed, and jdinput.c can skip the AC scans of a progressive image.
+   */
+  master->pub.dc_only = !master->pub.lossless;
+  for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
+       ci++, compptr++) {
+    if (compptr->_DCT_h_scaled_size != 1 || compptr->_DCT_v_scaled_size != 1)
+      master->pub.dc_only = FALSE;
+  }
+
   /* Initialize my private state */
   master->pass_number = 0;
   master->using_merged_upsample = use_merged_upsample(cinfo);
@@ -696,8 +713,11 @@ master_selection(j_decompress_ptr cinfo)
 #else
         ERREXIT(cinfo, JERR_NOT_COMPILED);
 #endif
-      } else
+      } else {
         jinit_huff_decoder(cinfo);
+        if (cinfo->master->num_threads > 1)
+          jinit_shuff_decoder(cinfo);
+      }
     }
 
     /* Initialize principal buffer controllers. */
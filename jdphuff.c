@@ -26,6 +26,7 @@
 #include "jinclude.h"
 #include "jpeglib.h"
 #include "jdhuff.h"             /* Declarations shared with jd*huff.c */
+#include "jsimd.h"
 #include <limits.h>
 
 
@@ -59,6 +60,12 @@ typedef struct {
   d_derived_tbl *derived_tbls[NUM_HUFF_TBLS];
 
   d_derived_tbl *ac_derived_tbl; /* active table during an AC scan */
+
+#if SIZEOF_SIZE_T == 8
+  /* Pointer to routine to prepare data for decode_mcu_AC_refine_fast() */
+  size_t (*AC_refine_prepare) (const JCOEF *block,
+                               const int *jpeg_natural_order_start, int Sl);
+#endif
 } phuff_entropy_decoder;
 
 typedef phuff_entropy_decoder *phuff_entropy_ptr;
@@ -70,8 +77,15 @@ METHODDEF(boolean) decode_mcu_AC_first(j_decompress_ptr cinfo,
                                        JBLOCKROW *MCU_data);
 METHODDEF(boolean) decode_mcu_DC_refine(j_decompress_ptr cinfo,
                                         JBLOCKROW *MCU_data);
+#if SIZEOF_SIZE_T != 8
 METHODDEF(boolean) decode_mcu_AC_refine(j_decompress_ptr cinfo,
                                         JBLOCKROW *MCU_data);
+#else
+METHODDEF(boolean) decode_mcu_AC_refine_fast(j_decompress_ptr cinfo,
+                                             JBLOCKROW *MCU_data);
+METHODDEF(size_t) decode_mcu_AC_refine_prepare
+  (const JCOEF *block, const int *jpeg_natural_order_start, int Sl);
+#endif
 
 
 /*
@@ -152,8 +166,19 @@ start_pass_phuff_decoder(j_decompress_ptr cinfo)
   } else {
     if (is_DC_band)
       entropy->pub.decode_mcu = decode_mcu_DC_refine;
-    else
+    else {
+#if SIZEOF_SIZE_T == 8
+      entropy->pub.decode_mcu = decode_mcu_AC_refine_fast;
+#ifdef WITH_SIMD
+      if (jsimd_can_decode_mcu_AC_refine_prepare())
+        entropy->AC_refine_prepare = jsimd_decode_mcu_AC_refine_prepare;
+      else
+#endif
+        entropy->AC_refine_prepare = decode_mcu_AC_refine_prepare;
+#else
       entropy->pub.decode_mcu = decode_mcu_AC_refine;
+#endif
+    }
   }
 
   for (ci = 0; ci < cinfo->comps_in_scan; ci++) {
@@ -326,12 +351,8 @@ decode_mcu_DC_first(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
       /* Decode a single block's worth of coefficients */
 
       /* Section F.2.2.1: decode the DC coefficient difference */
-      HUFF_DECODE(s, br_state, tbl, return FALSE, label1);
-      if (s) {
-        CHECK_BIT_BUFFER(br_state, s, return FALSE);
-        r = GET_BITS(s);
-        s = HUFF_EXTEND(r, s);
-      }
+      HUFF_DECODE_VALUE(s, r, br_state, tbl, return FALSE, label1);
+      (void)(r);
 
       /* Convert DC difference to actual value, update last_dc_val */
       if ((state.last_dc_val[ci] >= 0 &&
@@ -401,14 +422,9 @@ decode_mcu_AC_first(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
       tbl = entropy->ac_derived_tbl;
 
       for (k = cinfo->Ss; k <= Se; k++) {
-        HUFF_DECODE(s, br_state, tbl, return FALSE, label2);
-        r = s >> 4;
-        s &= 15;
+        HUFF_DECODE_VALUE(s, r, br_state, tbl, return FALSE, label2);
         if (s) {
           k += r;
-          CHECK_BIT_BUFFER(br_state, s, return FALSE);
-          r = GET_BITS(s);
-          s = HUFF_EXTEND(r, s);
           /* Scale and output coefficient in natural (dezigzagged) order */
           (*block)[jpeg_natural_order[k]] = (JCOEF)LEFT_SHIFT(s, Al);
         } else {
@@ -494,6 +510,8 @@ decode_mcu_DC_refine(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
 }
 
 
+#if SIZEOF_SIZE_T != 8
+
 /*
  * MCU decoding for AC successive approximation refinement scan.
  */
@@ -644,6 +662,252 @@ undoit:
   return FALSE;
 }
 
+#else /* SIZEOF_SIZE_T == 8 */
+
+/* Count the bits that are set */
+INLINE
+LOCAL(int)
+count_ones(size_t x)
+{
+#if defined(HAVE_BUILTIN_POPCOUNTL)
+  return __builtin_popcountl(x);
+#else
+  x = x - ((x >> 1) & (size_t)0x5555555555555555);
+  x = (x & (size_t)0x3333333333333333) + ((x >> 2) & (size_t)0x3333333333333333);
+  x = (x + (x >> 4)) & (size_t)0x0F0F0F0F0F0F0F0F;
+  return (int)((x * (size_t)0x0101010101010101) >> 56);
+#endif
+}
+
+/* Return the index of the lowest set bit (x must be nonzero) */
+INLINE
+LOCAL(int)
+lowest_one(size_t x)
+{
+#if defined(HAVE_BUILTIN_CTZL)
+  return __builtin_ctzl(x);
+#elif defined(HAVE_BITSCANFORWARD64)
+  unsigned long result;
+  _BitScanForward64(&result, x);
+  return (int)result;
+#else
+  int result = 0;
+  while ((x & 1) == 0) {
+    ++result;
+    x >>= 1;
+  }
+  return result;
+#endif
+}
+
+
+/*
+ * Build a bitmap of the coefficients in the band that are already nonzero.
+ * Bit k of the return value is set if block[jpeg_natural_order_start[k]] is
+ * nonzero.
+ */
+
+METHODDEF(size_t)
+decode_mcu_AC_refine_prepare(const JCOEF *block,
+                             const int *jpeg_natural_order_start, int Sl)
+{
+  size_t nzbits = 0;
+  int k;
+
+  for (k = 0; k < Sl; k++)
+    nzbits |= (size_t)(block[jpeg_natural_order_start[k]] != 0) << k;
+
+  return nzbits;
+}
+
+
+/*
+ * Append correction bits to the already-nonzero coefficients whose positions,
+ * relative to k, are set in corrbits.  A correction bit is 1 if the absolute
+ * value of the coefficient must be increased.  The correction bits are read
+ * up to 16 at a time, rather than one at a time as the coefficients are
+ * visited.  We never read more bits than are already in the bit buffer,
+ * though, so that the buffer is refilled at the same points as in the classic
+ * algorithm.  (This keeps the behavior with corrupt data unchanged.)
+ */
+
+#define APPEND_CORRECTION_BITS(corrbits) { \
+  while (corrbits) { \
+    nbits = count_ones(corrbits); \
+    if (nbits > 16) \
+      nbits = 16; \
+    if (nbits > bits_left) \
+      nbits = bits_left > 0 ? bits_left : 1; \
+    CHECK_BIT_BUFFER(br_state, nbits, goto undoit); \
+    bits = GET_BITS(nbits); \
+    while (nbits-- > 0) { \
+      thiscoef = *block + jpeg_natural_order[k + lowest_one(corrbits)]; \
+      corrbits &= corrbits - 1; \
+      if ((bits >> nbits) & 1) { \
+        if ((*thiscoef & p1) == 0) { /* do nothing if already set it */ \
+          if (*thiscoef >= 0) \
+            *thiscoef += (JCOEF)p1; \
+          else \
+            *thiscoef += (JCOEF)m1; \
+        } \
+      } \
+    } \
+  } \
+}
+
+
+/*
+ * MCU decoding for AC successive approximation refinement scan.
+ *
+ * This is equivalent to the classic decode_mcu_AC_refine() algorithm (fig.
+ * G.7), but rather than testing each coefficient in the band as it is
+ * visited, we start with a bitmap of the already-nonzero coefficients.  The
+ * target of each zero run can then be found without visiting the intervening
+ * coefficients, and only the already-nonzero coefficients are touched when
+ * appending correction bits.
+ */
+
+METHODDEF(boolean)
+decode_mcu_AC_refine_fast(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
+{
+  phuff_entropy_ptr entropy = (phuff_entropy_ptr)cinfo->entropy;
+  int Ss = cinfo->Ss;
+  int Se = cinfo->Se;
+  int p1 = 1 << cinfo->Al;        /* 1 in the bit position being coded */
+  int m1 = (NEG_1) << cinfo->Al;  /* -1 in the bit position being coded */
+  register int s, k, r;
+  int idx, nbits, bits;
+  unsigned int EOBRUN;
+  size_t nzbits, zerobits, corrbits;
+  JBLOCKROW block;
+  JCOEFPTR thiscoef;
+  BITREAD_STATE_VARS;
+  d_derived_tbl *tbl;
+  int num_newnz;
+  int newnz_pos[DCTSIZE2];
+
+  /* Process restart marker if needed; may have to suspend */
+  if (cinfo->restart_interval) {
+    if (entropy->restarts_to_go == 0)
+      if (!process_restart(cinfo))
+        return FALSE;
+  }
+
+  /* If we've run out of data, don't modify the MCU.
+   */
+  if (!entropy->pub.insufficient_data) {
+
+    /* Load up working state */
+    BITREAD_LOAD_STATE(cinfo, entropy->bitstate);
+    EOBRUN = entropy->saved.EOBRUN; /* only part of saved state we need */
+
+    /* There is always only one block per MCU */
+    block = MCU_data[0];
+    tbl = entropy->ac_derived_tbl;
+
+    /* Bit (k - Ss) of nzbits is set if coefficient k is nonzero.  Since
+     * Ss >= 1 in an AC scan, the band is never more than 63 coefficients
+     * long.
+     */
+    nzbits = entropy->AC_refine_prepare(*block, jpeg_natural_order + Ss,
+                                        Se - Ss + 1);
+
+    /* If we are forced to suspend, we must undo the assignments to any newly
+     * nonzero coefficients in the block, because otherwise we'd get confused
+     * next time about which coefficients were already nonzero.
+     * But we need not undo addition of bits to already-nonzero coefficients;
+     * instead, we can test the current bit to see if we already did it.
+     */
+    num_newnz = 0;
+
+    /* initialize coefficient loop counter to start of band */
+    k = Ss;
+
+    if (EOBRUN == 0) {
+      for (; k <= Se; k++) {
+        HUFF_DECODE(s, br_state, tbl, goto undoit, label3);
+        r = s >> 4;
+        s &= 15;
+        if (s) {
+          if (s != 1)           /* size of new coef should always be 1 */
+            WARNMS(cinfo, JWRN_HUFF_BAD_CODE);
+          CHECK_BIT_BUFFER(br_state, 1, goto undoit);
+          if (GET_BITS(1))
+            s = p1;             /* newly nonzero coef is positive */
+          else
+            s = m1;             /* newly nonzero coef is negative */
+        } else {
+          if (r != 15) {
+            EOBRUN = 1 << r;    /* EOBr, run length is 2^r + appended bits */
+            if (r) {
+              CHECK_BIT_BUFFER(br_state, r, goto undoit);
+              r = GET_BITS(r);
+              EOBRUN += r;
+            }
+            break;              /* rest of block is handled by EOB logic */
+          }
+          /* note s = 0 for processing ZRL */
+        }
+        /* Advance over already-nonzero coefs and r still-zero coefs,
+         * appending correction bits to the nonzeroes.  The target is the
+         * (r+1)th still-zero coef, or the end of the band if there are not
+         * that many.
+         */
+        corrbits = (nzbits >> (k - Ss)) &
+                   (((size_t)1 << (Se - k + 1)) - 1);
+        zerobits = corrbits ^ (((size_t)1 << (Se - k + 1)) - 1);
+        while (r-- > 0 && zerobits)
+          zerobits &= zerobits - 1;
+        idx = zerobits ? lowest_one(zerobits) : Se - k + 1;
+        corrbits &= ((size_t)1 << idx) - 1;
+        APPEND_CORRECTION_BITS(corrbits);
+        k += idx;
+        if (s) {
+          int pos = jpeg_natural_order[k];
+          /* Output newly nonzero coefficient */
+          (*block)[pos] = (JCOEF)s;
+          /* Remember its position in case we have to suspend */
+          newnz_pos[num_newnz++] = pos;
+          nzbits |= (size_t)1 << (k - Ss);
+        }
+      }
+    }
+
+    if (EOBRUN > 0) {
+      /* Scan any remaining coefficient positions after the end-of-band
+       * (the last newly nonzero coefficient, if any).  Append a correction
+       * bit to each already-nonzero coefficient.
+       */
+      if (k <= Se) {
+        corrbits = (nzbits >> (k - Ss)) &
+                   (((size_t)1 << (Se - k + 1)) - 1);
+        APPEND_CORRECTION_BITS(corrbits);
+      }
+      /* Count one block completed in EOB run */
+      EOBRUN--;
+    }
+
+    /* Completed MCU, so update state */
+    BITREAD_SAVE_STATE(cinfo, entropy->bitstate);
+    entropy->saved.EOBRUN = EOBRUN; /* only part of saved state we need */
+  }
+
+  /* Account for restart interval (no-op if not using restarts) */
+  if (cinfo->restart_interval)
+    entropy->restarts_to_go--;
+
+  return TRUE;
+
+undoit:
+  /* Re-zero any output coefficients that we made newly nonzero */
+  while (num_newnz > 0)
+    (*block)[newnz_pos[--num_newnz]] = 0;
+
+  return FALSE;
+}
+
+#endif /* SIZEOF_SIZE_T != 8 */
+
 
 /*
  * Module initialization routine for progressive Huffman entropy decoding.
@@ -661,6 +925,8 @@ jinit_phuff_decoder(j_decompress_ptr cinfo)
                                 sizeof(phuff_entropy_decoder));
   cinfo->entropy = (struct jpeg_entropy_decoder *)entropy;
   entropy->pub.start_pass = start_pass_phuff_decoder;
+  entropy->pub.seek_mcu = NULL;
+  entropy->pub.save_index = NULL;
 
   /* Mark derived tables unallocated */
   for (i = 0; i < NUM_HUFF_TBLS; i++) {
@@ -0,0 +1,733 @@
+/*
+ * jdshuff.c
+ *
+ * Copyright (C) 2026, Mozilla Corporation.
+ * For conditions of distribution and use, see the accompanying README.ijg
+ * file.
+ *
+ * This file contains a multithreaded Huffman entropy decoder for sequential
+ * scans without restart markers.  It is used in place of the ordinary
+ * Huffman decoder (jdhuff.c) when JINT_NUM_THREADS is greater than 1.
+ *
+ * Without restart markers, there is no way to know where an MCU begins
+ * without decoding everything before it.  However, Huffman codes tend to
+ * resynchronize quickly when decoding starts at an arbitrary bit position,
+ * so we split the entropy-coded segment into byte ranges ("chunks") and
+ * decode the whole scan in three steps:
+ *
+ * 1. Each worker decodes one chunk speculatively, starting at the first bit
+ *    of the chunk as though an MCU began there, and records the bit positions
+ *    at which its first MAX_SYNC_MCUS MCUs begin.  This pass discards the
+ *    coefficients.
+ * 2. The calling thread walks the chunks in order.  The true position of the
+ *    first MCU in chunk 0 is known, and the true position of the first MCU in
+ *    each subsequent chunk is where the previous chunk left off.  From there,
+ *    the calling thread decodes MCUs until it reaches a position that the
+ *    speculative decoder also recorded, at which point the two decoders have
+ *    synchronized and the rest of the speculative result (the MCU count and
+ *    exit position of the chunk) is known to be correct.  Normally this takes
+ *    only a few MCUs.  If the decoders never synchronize, then the chunk is
+ *    simply decoded serially.
+ * 3. Now that the first MCU and the MCU count of each chunk are known, the
+ *    workers decode the chunks again, this time storing the coefficients in a
+ *    buffer that holds the whole scan.  DC predictions start from 0 in each
+ *    chunk, and the correct predictions are added in decode_mcu() as the
+ *    coefficients are handed to the coefficient controller.
+ *
+ * This requires the entire entropy-coded segment to be present in the data
+ * source's buffer (as is the case with jpeg_mem_src()), and it requires
+ * memory for the coefficients of the whole scan.  Corrupt data is decoded by
+ * the ordinary Huffman decoder so that the same warnings are issued, which is
+ * also what happens whenever the scan is too small to be worth splitting.
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+#include "jdhuff.h"             /* Declarations shared with jd*huff.c */
+#include "jpegapicomp.h"
+#include "jmemsys.h"            /* for MAX_ALLOC_CHUNK */
+#include "jthread.h"
+
+
+/* Minimum # of bytes of entropy-coded data per chunk */
+#define MIN_CHUNK_SIZE  1024
+
+/* # of speculative MCU positions recorded for each chunk */
+#define MAX_SYNC_MCUS  256
+
+/* Zero bytes appended to the destuffed data, so that peek_bits() can read
+ * past the end.
+ */
+#define DATA_PADDING  8
+
+
+typedef struct {
+  /* Bit positions of the chunk boundaries in the destuffed data */
+  size_t start, end;
+
+  /* Results of the speculative pass */
+  size_t *sync_pos;             /* positions of the first few MCUs */
+  int num_sync;                 /* # of valid entries in sync_pos[] */
+  JDIMENSION spec_MCUs;         /* # of MCUs beginning in [start, end) */
+  size_t spec_exit;             /* position of first MCU beginning >= end */
+
+  /* True location of the chunk, determined by synchronize_chunks() */
+  size_t entry;                 /* position of first MCU beginning >= start */
+  JDIMENSION first_MCU;         /* index of that MCU within the scan */
+  JDIMENSION num_MCUs;          /* # of MCUs to decode */
+
+  /* Results of the decoding pass */
+  size_t exit;                  /* position after the last decoded MCU */
+  boolean bad_code;             /* TRUE if an invalid Huffman code was seen */
+  unsigned int dc_sum[MAX_COMPS_IN_SCAN]; /* sum of DC differences */
+
+  /* DC predictions at the start of the chunk */
+  unsigned int dc_offset[MAX_COMPS_IN_SCAN];
+} shuff_chunk;
+
+typedef struct {
+  struct jpeg_entropy_decoder pub; /* public fields */
+
+  /* Ordinary Huffman decoder, used whenever the scan isn't decoded in
+   * parallel.  Its methods expect cinfo->entropy to point to it, so we
+   * temporarily swap it in when calling them.
+   */
+  struct jpeg_entropy_decoder *serial;
+  boolean parallel;             /* TRUE if current scan was decoded here */
+
+  /* Destuffed entropy-coded segment of the current scan */
+  JOCTET *data;
+  size_t data_size;             /* # of bytes, not counting padding */
+  size_t data_alloc;            /* allocated size of data[] */
+
+  /* Coefficients for every MCU of the current scan */
+  JBLOCKROW coefs;
+  size_t coefs_alloc;           /* allocated size of coefs[], in blocks */
+  JDIMENSION total_MCUs;        /* # of MCUs in the current scan */
+  JDIMENSION next_MCU;          /* index of next MCU for decode_mcu() */
+
+  /* Chunks of the current scan */
+  shuff_chunk chunks[JTHREAD_MAX_WORKERS];
+  int num_chunks;
+  int cur_chunk;                /* chunk containing next_MCU */
+  size_t *sync_pos;             /* MAX_SYNC_MCUS entries for each chunk */
+
+  /* Pointers to derived tables (these workspaces have image lifespan) */
+  d_derived_tbl *dc_derived_tbls[NUM_HUFF_TBLS];
+  d_derived_tbl *ac_derived_tbls[NUM_HUFF_TBLS];
+
+  /* Pointers to derived tables to be used for each block within an MCU */
+  d_derived_tbl *dc_cur_tbls[D_MAX_BLOCKS_IN_MCU];
+  d_derived_tbl *ac_cur_tbls[D_MAX_BLOCKS_IN_MCU];
+  /* Whether we care about the DC and AC coefficient values for each block */
+  boolean dc_needed[D_MAX_BLOCKS_IN_MCU];
+  boolean ac_needed[D_MAX_BLOCKS_IN_MCU];
+  int MCU_membership[D_MAX_BLOCKS_IN_MCU];
+  int blocks_in_MCU;
+} shuff_entropy_decoder;
+
+typedef shuff_entropy_decoder *shuff_entropy_ptr;
+
+
+/*
+ * Figure F.12: extend sign bit (same as in jdhuff.c)
+ */
+
+#define NEG_1  ((unsigned int)-1)
+#define HUFF_EXTEND(x, s) \
+  ((x) + ((((x) - (1 << ((s) - 1))) >> 31) & (((NEG_1) << (s)) + 1)))
+
+
+/*
+ * Return the 32 bits of destuffed data that begin at bit position pos,
+ * left-justified.  Bits beyond the end of the data read as zeroes, which is
+ * what jpeg_fill_bit_buffer() supplies once it reaches a marker.
+ */
+
+static INLINE unsigned long
+peek_bits(const JOCTET *data, size_t size, size_t pos)
+{
+  size_t byte = pos >> 3;
+  int shift = (int)(pos & 7);
+  const JOCTET *p;
+  unsigned long window;
+
+  if (byte >= size)
+    return 0;
+  p = data + byte;              /* at least 4 bytes of padding follow */
+  window = ((unsigned long)p[0] << 24) | ((unsigned long)p[1] << 16) |
+           ((unsigned long)p[2] << 8) | (unsigned long)p[3];
+  window = (window << shift) | ((unsigned long)p[4] >> (8 - shift));
+  return window & 0xFFFFFFFFUL;
+}
+
+
+/*
+ * Decode one Huffman symbol at bit position *pos and advance *pos.
+ * This is the equivalent of HUFF_DECODE() in jdhuff.h.
+ */
+
+static INLINE int
+huff_decode_at(const d_derived_tbl *htbl, const JOCTET *data, size_t size,
+               size_t *pos, boolean *bad_code)
+{
+  unsigned long window = peek_bits(data, size, *pos);
+  int look = htbl->lookup[window >> (32 - HUFF_LOOKAHEAD)];
+  int nb = look >> HUFF_LOOKAHEAD;
+  JLONG code;
+
+  if (nb <= HUFF_LOOKAHEAD) {
+    *pos += nb;
+    return look & ((1 << HUFF_LOOKAHEAD) - 1);
+  }
+
+  /* Figure F.16: collect the rest of the code one bit at a time */
+  code = (JLONG)(window >> (32 - nb));
+  while (code > htbl->maxcode[nb]) {
+    nb++;
+    code = (JLONG)(window >> (32 - nb));
+  }
+  *pos += nb;
+
+  /* With garbage input we may reach the sentinel value nb = 17. */
+  if (nb > 16) {
+    *bad_code = TRUE;
+    return 0;
+  }
+  return htbl->pub->huffval[(int)(code + htbl->valoffset[nb]) & 0xFF];
+}
+
+
+/*
+ * Decode one Huffman symbol and the magnitude bits that follow it at bit
+ * position *pos, and advance *pos.  This is the equivalent of
+ * HUFF_DECODE_VALUE() in jdhuff.h.  The run length is stored in *run, and
+ * the sign-extended value (or 0 if the symbol has no magnitude bits) is
+ * returned.
+ */
+
+static INLINE int
+huff_decode_value_at(const d_derived_tbl *htbl, const JOCTET *data,
+                     size_t size, size_t *pos, int *run, boolean *bad_code)
+{
+  int look = htbl->val_lookup[peek_bits(data, size, *pos) >>
+                              (32 - HUFF_VAL_LOOKAHEAD)];
+  int s, r;
+
+  if (look) {
+    *pos += look & 15;
+    *run = (look >> 4) & 15;
+    return look >> 8;
+  }
+
+  s = huff_decode_at(htbl, data, size, pos, bad_code);
+  *run = s >> 4;
+  s &= 15;
+  if (s) {
+    r = (int)(peek_bits(data, size, *pos) >> (32 - s));
+    *pos += s;
+    s = HUFF_EXTEND(r, s);
+  }
+  return s;
+}
+
+
+/*
+ * Decode one MCU beginning at bit position *pos and advance *pos.  If
+ * MCU_data is NULL, then the coefficients are discarded.  Otherwise, they
+ * are stored in MCU_data[] (which must be zeroed beforehand), and DC
+ * differences are accumulated in last_dc_val[] modulo 2^32, which yields the
+ * same JCOEF values as jdhuff.c.  Returns FALSE if an invalid Huffman code
+ * was encountered.
+ */
+
+LOCAL(boolean)
+decode_mcu_at(shuff_entropy_ptr entropy, size_t *pos, JBLOCKROW MCU_data,
+              unsigned int *last_dc_val)
+{
+  const JOCTET *data = entropy->data;
+  size_t size = entropy->data_size;
+  boolean bad_code = FALSE;
+  int blkn, s, k, r;
+
+  for (blkn = 0; blkn < entropy->blocks_in_MCU; blkn++) {
+    d_derived_tbl *dctbl = entropy->dc_cur_tbls[blkn];
+    d_derived_tbl *actbl = entropy->ac_cur_tbls[blkn];
+    JBLOCKROW block = MCU_data ? MCU_data + blkn : NULL;
+
+    /* Section F.2.2.1: decode the DC coefficient difference */
+    s = huff_decode_value_at(dctbl, data, size, pos, &r, &bad_code);
+    if (block) {
+      int ci = entropy->MCU_membership[blkn];
+
+      last_dc_val[ci] += (unsigned int)s;
+      (*block)[0] = (JCOEF)last_dc_val[ci];
+    }
+
+    /* Section F.2.2.2: decode the AC coefficients */
+    for (k = 1; k < DCTSIZE2; k++) {
+      s = huff_decode_value_at(actbl, data, size, pos, &r, &bad_code);
+
+      if (s) {
+        k += r;
+        if (block) {
+          /* The extra entries in jpeg_natural_order[] will save us if
+           * k >= DCTSIZE2, which could happen if the data is corrupted.
+           */
+          (*block)[jpeg_natural_order[k]] = (JCOEF)s;
+        }
+      } else {
+        if (r != 15)
+          break;
+        k += 15;
+      }
+    }
+  }
+
+  return !bad_code;
+}
+
+
+/*
+ * Speculatively decode one chunk, starting at its first bit (worker thread)
+ */
+
+METHODDEF(void)
+sync_chunk_task(void *arg, int task, int worker)
+{
+  shuff_entropy_ptr entropy = (shuff_entropy_ptr)arg;
+  shuff_chunk *chunk = &entropy->chunks[task];
+  size_t pos = chunk->start;
+  JDIMENSION n = 0;
+
+  /* An MCU occupies at least one bit, so this terminates even if the data
+   * are garbage.  The MCU count limit merely avoids wasted effort.
+   */
+  while (pos < chunk->end && n < entropy->total_MCUs) {
+    if (n < MAX_SYNC_MCUS)
+      chunk->sync_pos[n] = pos;
+    n++;
+    decode_mcu_at(entropy, &pos, NULL, NULL);
+  }
+  chunk->num_sync = (int)MIN(n, MAX_SYNC_MCUS);
+  chunk->spec_MCUs = n;
+  chunk->spec_exit = pos;
+}
+
+
+/*
+ * Determine the true location of each chunk by resynchronizing with the
+ * speculative results.  Returns FALSE if the data ran out before the last
+ * MCU of the scan.
+ */
+
+LOCAL(boolean)
+synchronize_chunks(shuff_entropy_ptr entropy)
+{
+  size_t pos = 0;
+  JDIMENSION first_MCU = 0;
+  int i;
+
+  for (i = 0; i < entropy->num_chunks; i++) {
+    shuff_chunk *chunk = &entropy->chunks[i];
+    JDIMENSION n = 0;
+    int j = 0;
+
+    chunk->entry = pos;
+    chunk->first_MCU = first_MCU;
+    while (pos < chunk->end && first_MCU + n < entropy->total_MCUs) {
+      while (j < chunk->num_sync && chunk->sync_pos[j] < pos)
+        j++;
+      if (j < chunk->num_sync && chunk->sync_pos[j] == pos) {
+        /* Synchronized.  The rest of the speculative pass was correct. */
+        n += chunk->spec_MCUs - (JDIMENSION)j;
+        pos = chunk->spec_exit;
+        break;
+      }
+      decode_mcu_at(entropy, &pos, NULL, NULL);
+      n++;
+    }
+    n = MIN(n, entropy->total_MCUs - first_MCU);
+    chunk->num_MCUs = n;
+    first_MCU += n;
+  }
+
+  return first_MCU == entropy->total_MCUs;
+}
+
+
+/*
+ * Decode the MCUs of one chunk into the coefficient buffer (worker thread)
+ */
+
+METHODDEF(void)
+decode_chunk_task(void *arg, int task, int worker)
+{
+  shuff_entropy_ptr entropy = (shuff_entropy_ptr)arg;
+  shuff_chunk *chunk = &entropy->chunks[task];
+  JBLOCKROW MCU_data = entropy->coefs +
+                       (size_t)chunk->first_MCU * entropy->blocks_in_MCU;
+  size_t pos = chunk->entry;
+  JDIMENSION n;
+  int ci;
+
+  for (ci = 0; ci < MAX_COMPS_IN_SCAN; ci++)
+    chunk->dc_sum[ci] = 0;
+  chunk->bad_code = FALSE;
+
+  jzero_far((void *)MCU_data, (size_t)chunk->num_MCUs *
+            entropy->blocks_in_MCU * sizeof(JBLOCK));
+  for (n = 0; n < chunk->num_MCUs; n++) {
+    if (!decode_mcu_at(entropy, &pos, MCU_data, chunk->dc_sum))
+      chunk->bad_code = TRUE;
+    MCU_data += entropy->blocks_in_MCU;
+  }
+  chunk->exit = pos;
+}
+
+
+/*
+ * Copy the destuffed entropy-coded segment of the current scan out of the
+ * source buffer.  Returns the number of source bytes that precede the marker
+ * terminating the segment, or 0 if the marker isn't in the source buffer.
+ */
+
+LOCAL(size_t)
+load_scan_data(j_decompress_ptr cinfo)
+{
+  shuff_entropy_ptr entropy = (shuff_entropy_ptr)cinfo->entropy;
+  const JOCTET *start = cinfo->src->next_input_byte;
+  const JOCTET *limit = start + cinfo->src->bytes_in_buffer;
+  const JOCTET *p, *q;
+  size_t length, size;
+
+  if (start == NULL)
+    return 0;
+
+  /* Find the terminating marker.  As in jpeg_fill_bit_buffer(), any number of
+   * 0xFF fill bytes may precede the 0x00 of a stuffed byte or the code byte
+   * of a marker.
+   */
+  for (p = start; ; p = q + 1) {
+    p = (const JOCTET *)memchr(p, 0xFF, limit - p);
+    if (p == NULL)
+      return 0;
+    for (q = p + 1; q < limit && *q == 0xFF; q++);
+    if (q >= limit)
+      return 0;
+    if (*q != 0)
+      break;
+  }
+  length = p - start;
+  if (length == 0 || length > ((size_t)-1 - DATA_PADDING) / 8)
+    return 0;
+
+  if (entropy->data_alloc < length + DATA_PADDING) {
+    if (length + DATA_PADDING > (size_t)MAX_ALLOC_CHUNK)
+      return 0;
+    entropy->data = (JOCTET *)
+      (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                  length + DATA_PADDING);
+    entropy->data_alloc = length + DATA_PADDING;
+  }
+
+  /* Destuff.  Each 0xFF in the data is followed by fill bytes and a 0x00. */
+  size = 0;
+  for (p = start; p < start + length; p = q + 1) {
+    q = (const JOCTET *)memchr(p, 0xFF, start + length - p);
+    if (q == NULL)
+      q = start + length;
+    memcpy(entropy->data + size, p, q - p);
+    size += q - p;
+    if (q == start + length)
+      break;
+    entropy->data[size++] = 0xFF;
+    while (*q == 0xFF)
+      q++;
+  }
+  memset(entropy->data + size, 0, DATA_PADDING);
+  entropy->data_size = size;
+
+  return length;
+}
+
+
+/*
+ * Decode the current scan in parallel.  Returns FALSE if that isn't possible,
+ * in which case no input has been consumed.
+ */
+
+LOCAL(boolean)
+decode_scan_parallel(j_decompress_ptr cinfo)
+{
+  shuff_entropy_ptr entropy = (shuff_entropy_ptr)cinfo->entropy;
+  shuff_chunk *last;
+  size_t src_length, chunk_size, num_blocks;
+  int num_chunks, i, ci;
+
+  if (cinfo->restart_interval)
+    return FALSE;
+  entropy->total_MCUs = cinfo->MCUs_per_row * cinfo->MCU_rows_in_scan;
+  if (entropy->total_MCUs == 0 ||
+      (size_t)entropy->total_MCUs >
+        (size_t)MAX_ALLOC_CHUNK / cinfo->blocks_in_MCU / sizeof(JBLOCK))
+    return FALSE;
+  num_blocks = (size_t)entropy->total_MCUs * cinfo->blocks_in_MCU;
+  if (cinfo->mem->max_memory_to_use &&
+      num_blocks * sizeof(JBLOCK) > (size_t)cinfo->mem->max_memory_to_use)
+    return FALSE;
+  /* Quick check before copying the data */
+  num_chunks = jthread_clamp_workers(cinfo->master->num_threads,
+    (int)MIN(cinfo->src->bytes_in_buffer / MIN_CHUNK_SIZE, JTHREAD_MAX_WORKERS));
+  if (num_chunks < 2)
+    return FALSE;
+
+  if ((src_length = load_scan_data(cinfo)) == 0)
+    return FALSE;
+  num_chunks = jthread_clamp_workers(cinfo->master->num_threads,
+    (int)MIN(entropy->data_size / MIN_CHUNK_SIZE, JTHREAD_MAX_WORKERS));
+  if (num_chunks < 2)
+    return FALSE;
+
+  /* Step 1: speculative decoding */
+  if (entropy->sync_pos == NULL)
+    entropy->sync_pos = (size_t *)
+      (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                  (size_t)JTHREAD_MAX_WORKERS *
+                                  MAX_SYNC_MCUS * sizeof(size_t));
+  entropy->num_chunks = num_chunks;
+  chunk_size = entropy->data_size / num_chunks;
+  for (i = 0; i < num_chunks; i++) {
+    shuff_chunk *chunk = &entropy->chunks[i];
+
+    chunk->start = (size_t)i * chunk_size * 8;
+    chunk->end = (i == num_chunks - 1) ? entropy->data_size * 8 :
+                                         (size_t)(i + 1) * chunk_size * 8;
+    chunk->sync_pos = entropy->sync_pos + (size_t)i * MAX_SYNC_MCUS;
+  }
+  jthread_run(entropy, sync_chunk_task, num_chunks, num_chunks);
+
+  /* Step 2: resynchronization */
+  if (!synchronize_chunks(entropy))
+    return FALSE;
+
+  /* Step 3: decoding */
+  if (entropy->coefs_alloc < num_blocks) {
+    entropy->coefs = (JBLOCKROW)
+      (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                  num_blocks * sizeof(JBLOCK));
+    entropy->coefs_alloc = num_blocks;
+  }
+  jthread_run(entropy, decode_chunk_task, num_chunks, num_chunks);
+
+  /* If the data are corrupt, or if anything other than padding bits follows
+   * the last MCU, then let the ordinary Huffman decoder issue the appropriate
+   * warnings.
+   */
+  last = entropy->chunks;
+  for (i = 0; i < num_chunks; i++) {
+    if (entropy->chunks[i].bad_code)
+      return FALSE;
+    if (entropy->chunks[i].num_MCUs > 0)
+      last = &entropy->chunks[i];
+  }
+  if (last->exit > entropy->data_size * 8 ||
+      last->exit + 8 <= entropy->data_size * 8)
+    return FALSE;
+
+  /* Compute the DC predictions at the start of each chunk. */
+  for (ci = 0; ci < MAX_COMPS_IN_SCAN; ci++)
+    entropy->chunks[0].dc_offset[ci] = 0;
+  for (i = 1; i < num_chunks; i++) {
+    for (ci = 0; ci < MAX_COMPS_IN_SCAN; ci++)
+      entropy->chunks[i].dc_offset[ci] = entropy->chunks[i - 1].dc_offset[ci] +
+                                         entropy->chunks[i - 1].dc_sum[ci];
+  }
+
+  /* Consume the entropy-coded segment, leaving the marker for jdmarker.c. */
+  cinfo->src->next_input_byte += src_length;
+  cinfo->src->bytes_in_buffer -= src_length;
+
+  entropy->cur_chunk = 0;
+  entropy->next_MCU = 0;
+  return TRUE;
+}
+
+
+/* Forward declarations */
+METHODDEF(boolean) seek_mcu(j_decompress_ptr cinfo, JDIMENSION MCU_num);
+
+
+/*
+ * Initialize for a Huffman-compressed scan.
+ */
+
+METHODDEF(void)
+start_pass_shuff_decoder(j_decompress_ptr cinfo)
+{
+  shuff_entropy_ptr entropy = (shuff_entropy_ptr)cinfo->entropy;
+  int ci, blkn;
+  d_derived_tbl **pdtbl;
+  jpeg_component_info *compptr;
+
+  /* The ordinary decoder checks the scan parameters and tables. */
+  cinfo->entropy = entropy->serial;
+  (*entropy->serial->start_pass) (cinfo);
+  cinfo->entropy = &entropy->pub;
+  entropy->pub.insufficient_data = FALSE;
+
+  for (ci = 0; ci < cinfo->comps_in_scan; ci++) {
+    compptr = cinfo->cur_comp_info[ci];
+    pdtbl = (d_derived_tbl **)(entropy->dc_derived_tbls) + compptr->dc_tbl_no;
+    jpeg_make_d_derived_tbl(cinfo, TRUE, compptr->dc_tbl_no, pdtbl);
+    pdtbl = (d_derived_tbl **)(entropy->ac_derived_tbls) + compptr->ac_tbl_no;
+    jpeg_make_d_derived_tbl(cinfo, FALSE, compptr->ac_tbl_no, pdtbl);
+  }
+
+  /* Precalculate decoding info for each block in an MCU of this scan */
+  entropy->blocks_in_MCU = cinfo->blocks_in_MCU;
+  for (blkn = 0; blkn < cinfo->blocks_in_MCU; blkn++) {
+    ci = cinfo->MCU_membership[blkn];
+    compptr = cinfo->cur_comp_info[ci];
+    entropy->MCU_membership[blkn] = ci;
+    entropy->dc_cur_tbls[blkn] = entropy->dc_derived_tbls[compptr->dc_tbl_no];
+    entropy->ac_cur_tbls[blkn] = entropy->ac_derived_tbls[compptr->ac_tbl_no];
+    if (compptr->component_needed) {
+      entropy->dc_needed[blkn] = TRUE;
+      /* we don't need the ACs if producing a 1/8th-size image */
+      entropy->ac_needed[blkn] = (compptr->_DCT_scaled_size > 1);
+    } else {
+      entropy->dc_needed[blkn] = entropy->ac_needed[blkn] = FALSE;
+    }
+  }
+
+  entropy->parallel = decode_scan_parallel(cinfo);
+  entropy->pub.seek_mcu = entropy->parallel || entropy->serial->seek_mcu ?
+                          seek_mcu : NULL;
+}
+
+
+/*
+ * Hand over the next MCU of a scan that was decoded in parallel.
+ */
+
+METHODDEF(boolean)
+decode_mcu(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
+{
+  shuff_entropy_ptr entropy = (shuff_entropy_ptr)cinfo->entropy;
+  shuff_chunk *chunk;
+  JBLOCKROW src;
+  int blkn;
+  boolean retval;
+
+  if (!entropy->parallel) {
+    cinfo->entropy = entropy->serial;
+    retval = (*entropy->serial->decode_mcu) (cinfo, MCU_data);
+    cinfo->entropy = &entropy->pub;
+    entropy->pub.insufficient_data = entropy->serial->insufficient_data;
+    return retval;
+  }
+
+  if (entropy->next_MCU >= entropy->total_MCUs)
+    return TRUE;                /* shouldn't happen; leave the MCU zeroed */
+  chunk = &entropy->chunks[entropy->cur_chunk];
+  while (entropy->next_MCU >= chunk->first_MCU + chunk->num_MCUs)
+    chunk++;
+  entropy->cur_chunk = (int)(chunk - entropy->chunks);
+
+  if (MCU_data) {
+    src = entropy->coefs + (size_t)entropy->next_MCU * entropy->blocks_in_MCU;
+    for (blkn = 0; blkn < entropy->blocks_in_MCU; blkn++) {
+      JBLOCKROW block = MCU_data[blkn];
+
+      if (entropy->dc_needed[blkn]) {
+        int ci = entropy->MCU_membership[blkn];
+
+        (*block)[0] = (JCOEF)(chunk->dc_offset[ci] + (unsigned int)src[blkn][0]);
+      }
+      if (entropy->ac_needed[blkn])
+        memcpy(&(*block)[1], &src[blkn][1], (DCTSIZE2 - 1) * sizeof(JCOEF));
+    }
+  }
+
+  entropy->next_MCU++;
+  return TRUE;
+}
+
+
+/*
+ * Position the decoder at the given MCU of the current scan.  A scan that was
+ * decoded in parallel can be entered anywhere.
+ */
+
+METHODDEF(boolean)
+seek_mcu(j_decompress_ptr cinfo, JDIMENSION MCU_num)
+{
+  shuff_entropy_ptr entropy = (shuff_entropy_ptr)cinfo->entropy;
+  boolean retval;
+
+  if (!entropy->parallel) {
+    cinfo->entropy = entropy->serial;
+    retval = (*entropy->serial->seek_mcu) (cinfo, MCU_num);
+    cinfo->entropy = &entropy->pub;
+    entropy->pub.insufficient_data = entropy->serial->insufficient_data;
+    return retval;
+  }
+
+  if (MCU_num <= entropy->next_MCU || MCU_num > entropy->total_MCUs)
+    return FALSE;
+  entropy->next_MCU = MCU_num;
+  return TRUE;
+}
+
+
+/*
+ * Save the decode index, which is recorded only if the scan was decoded
+ * serially.
+ */
+
+METHODDEF(boolean)
+save_index(j_decompress_ptr cinfo, JOCTET **index_data_ptr,
+           unsigned int *index_data_len)
+{
+  shuff_entropy_ptr entropy = (shuff_entropy_ptr)cinfo->entropy;
+  boolean retval;
+
+  if (entropy->parallel)
+    return FALSE;
+  cinfo->entropy = entropy->serial;
+  retval = (*entropy->serial->save_index) (cinfo, index_data_ptr,
+                                           index_data_len);
+  cinfo->entropy = &entropy->pub;
+  return retval;
+}
+
+
+/*
+ * Module initialization routine for multithreaded Huffman entropy decoding.
+ * This wraps the ordinary Huffman decoder, which must already have been
+ * initialized.
+ */
+
+GLOBAL(void)
+jinit_shuff_decoder(j_decompress_ptr cinfo)
+{
+  shuff_entropy_ptr entropy;
+  int i;
+
+  entropy = (shuff_entropy_ptr)
+    (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                sizeof(shuff_entropy_decoder));
+  memset(entropy, 0, sizeof(shuff_entropy_decoder));
+  entropy->serial = cinfo->entropy;
+  cinfo->entropy = (struct jpeg_entropy_decoder *)entropy;
+  entropy->pub.start_pass = start_pass_shuff_decoder;
+  entropy->pub.decode_mcu = decode_mcu;
+  entropy->pub.save_index = save_index;
+
+  /* Mark tables unallocated */
+  for (i = 0; i < NUM_HUFF_TBLS; i++) {
+    entropy->dc_derived_tbls[i] = entropy->ac_derived_tbls[i] = NULL;
+  }
+}
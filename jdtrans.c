@@ -105,6 +105,8 @@ transdecode_master_selection(j_decompress_ptr cinfo)
 {
   /* This is effectively a buffered-image operation. */
   cinfo->buffered_image = TRUE;
+  /* All of the coefficients are needed. */
+  cinfo->master->dc_only = FALSE;
 
 #if JPEG_LIB_VERSION >= 80
   /* Compute output image dimensions and related values. */
@@ -125,8 +127,11 @@ transdecode_master_selection(j_decompress_ptr cinfo)
 #else
       ERREXIT(cinfo, JERR_NOT_COMPILED);
 #endif
-    } else
+    } else {
       jinit_huff_decoder(cinfo);
+      if (cinfo->master->num_threads > 1)
+        jinit_shuff_decoder(cinfo);
+    }
   }
 
   /* Always get a full-image coefficient buffer. */
@@ -220,6 +220,12 @@ JMESSAGE(JERR_BAD_DROP_SAMPLING,
 #endif
 JMESSAGE(JERR_BAD_RESTART,
          "Invalid restart interval %d; must be an integer multiple of the number of MCUs in an MCU row (%d)")
+JMESSAGE(JWRN_BAD_DECODE_INDEX,
+         "Decode index does not match this image; ignoring it")
+JMESSAGE(JERR_NO_SOURCE_QUANT_TABLE,
+         "Source quantization table 0x%02x is unknown; cannot requantize")
+JMESSAGE(JERR_NO_CHAIN_DEST,
+         "Destination manager was not set up by jpeg_chain_dest()")
 
 #ifdef JMAKE_ENUM_LIST
 
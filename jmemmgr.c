@@ -142,6 +142,15 @@ typedef struct {
    * array routines.
    */
   JDIMENSION last_rowsperchunk; /* from most recent alloc_sarray/barray */
+
+  /* If retain_image_pool is TRUE, then free_pool(JPOOL_IMAGE) keeps the
+   * pools that were used for the most recent image on these lists, so that
+   * the next image can reuse them rather than obtaining new memory from the
+   * system.  See jmem_retain_image_pool().
+   */
+  boolean retain_image_pool;
+  small_pool_ptr spare_small_list;
+  large_pool_ptr spare_large_list;
 } my_memory_mgr;
 
 typedef my_memory_mgr *my_mem_ptr;
@@ -301,6 +310,30 @@ alloc_small(j_common_ptr cinfo, int pool_id, size_t sizeofobject)
     hdr_ptr = hdr_ptr->next;
   }
 
+  /* Reuse a pool retained from the previous image, if one is big enough */
+  if (hdr_ptr == NULL && pool_id == JPOOL_IMAGE) {
+    small_pool_ptr prev_spare_ptr = NULL;
+
+    hdr_ptr = mem->spare_small_list;
+    while (hdr_ptr != NULL && hdr_ptr->bytes_left < sizeofobject) {
+      prev_spare_ptr = hdr_ptr;
+      hdr_ptr = hdr_ptr->next;
+    }
+    if (hdr_ptr != NULL) {
+      if (prev_spare_ptr == NULL)
+        mem->spare_small_list = hdr_ptr->next;
+      else
+        prev_spare_ptr->next = hdr_ptr->next;
+      mem->total_space_allocated += hdr_ptr->bytes_left +
+                                    sizeof(small_pool_hdr) + ALIGN_SIZE - 1;
+      hdr_ptr->next = NULL;
+      if (prev_hdr_ptr == NULL)
+        mem->small_list[pool_id] = hdr_ptr;
+      else
+        prev_hdr_ptr->next = hdr_ptr;
+    }
+  }
+
   /* Time to make a new pool? */
   if (hdr_ptr == NULL) {
     /* min_request is what we need now, slop is what will be leftover */
@@ -384,25 +417,51 @@ alloc_large(j_common_ptr cinfo, int pool_id, size_t sizeofobject)
       MAX_ALLOC_CHUNK)
     out_of_memory(cinfo, 3);    /* request exceeds malloc's ability */
 
-  /* Always make a new pool */
+  /* Always make a new pool, unless a pool retained from the previous image
+   * is big enough
+   */
   if (pool_id < 0 || pool_id >= JPOOL_NUMPOOLS)
     ERREXIT1(cinfo, JERR_BAD_POOL_ID, pool_id); /* safety check */
 
-  hdr_ptr = (large_pool_ptr)jpeg_get_large(cinfo, sizeofobject +
-                                           sizeof(large_pool_hdr) +
-                                           ALIGN_SIZE - 1);
-  if (hdr_ptr == NULL)
-    out_of_memory(cinfo, 4);    /* jpeg_get_large failed */
-  mem->total_space_allocated += sizeofobject + sizeof(large_pool_hdr) +
-                                ALIGN_SIZE - 1;
+  hdr_ptr = NULL;
+  if (pool_id == JPOOL_IMAGE && mem->spare_large_list != NULL) {
+    large_pool_ptr *best_link = NULL, *link;
+
+    /* Pick the smallest spare pool that fits */
+    for (link = &mem->spare_large_list; *link != NULL; link = &(*link)->next) {
+      if ((*link)->bytes_left >= sizeofobject &&
+          (best_link == NULL || (*link)->bytes_left < (*best_link)->bytes_left))
+        best_link = link;
+    }
+    if (best_link != NULL) {
+      hdr_ptr = *best_link;
+      *best_link = hdr_ptr->next;
+      mem->total_space_allocated += hdr_ptr->bytes_left +
+                                    sizeof(large_pool_hdr) + ALIGN_SIZE - 1;
+      /* The unused part of the pool is counted in bytes_left, so that
+       * free_pool() still computes the full size of the pool.
+       */
+      hdr_ptr->bytes_left -= sizeofobject;
+    }
+  }
 
-  /* Success, initialize the new pool header and add to list */
+  if (hdr_ptr == NULL) {
+    hdr_ptr = (large_pool_ptr)jpeg_get_large(cinfo, sizeofobject +
+                                             sizeof(large_pool_hdr) +
+                                             ALIGN_SIZE - 1);
+    if (hdr_ptr == NULL)
+      out_of_memory(cinfo, 4);  /* jpeg_get_large failed */
+    mem->total_space_allocated += sizeofobject + sizeof(large_pool_hdr) +
+                                  ALIGN_SIZE - 1;
+    hdr_ptr->bytes_left = 0;
+  }
+
+  /* Success, initialize the pool header and add to list */
   hdr_ptr->next = mem->large_list[pool_id];
   /* We maintain space counts in each pool header for statistical purposes,
    * even though they are not needed for allocation.
    */
   hdr_ptr->bytes_used = sizeofobject;
-  hdr_ptr->bytes_left = 0;
   mem->large_list[pool_id] = hdr_ptr;
 
   data_ptr = (char *)hdr_ptr; /* point to first data byte in pool... */
@@ -1089,6 +1148,38 @@ access_virt_barray(j_common_ptr cinfo, jvirt_barray_ptr ptr,
 }
 
 
+/*
+ * Release the pools that were retained from the previous image (see
+ * jmem_retain_image_pool()) and not reused.
+ */
+
+LOCAL(void)
+release_spare_pools(j_common_ptr cinfo)
+{
+  my_mem_ptr mem = (my_mem_ptr)cinfo->mem;
+  small_pool_ptr shdr_ptr;
+  large_pool_ptr lhdr_ptr;
+
+  lhdr_ptr = mem->spare_large_list;
+  mem->spare_large_list = NULL;
+  while (lhdr_ptr != NULL) {
+    large_pool_ptr next_lhdr_ptr = lhdr_ptr->next;
+    jpeg_free_large(cinfo, (void *)lhdr_ptr, lhdr_ptr->bytes_left +
+                    sizeof(large_pool_hdr) + ALIGN_SIZE - 1);
+    lhdr_ptr = next_lhdr_ptr;
+  }
+
+  shdr_ptr = mem->spare_small_list;
+  mem->spare_small_list = NULL;
+  while (shdr_ptr != NULL) {
+    small_pool_ptr next_shdr_ptr = shdr_ptr->next;
+    jpeg_free_small(cinfo, (void *)shdr_ptr, shdr_ptr->bytes_left +
+                    sizeof(small_pool_hdr) + ALIGN_SIZE - 1);
+    shdr_ptr = next_shdr_ptr;
+  }
+}
+
+
 /*
  * Release all objects belonging to a specified pool.
  */
@@ -1130,6 +1221,41 @@ free_pool(j_common_ptr cinfo, int pool_id)
     mem->virt_barray_list = NULL;
   }
 
+  /* If retaining the IMAGE pool, release the pools retained from the
+   * previous image that weren't reused, and then retain this image's pools
+   * instead.  Retained pools are not counted in total_space_allocated.
+   */
+  if (pool_id == JPOOL_IMAGE && mem->retain_image_pool) {
+    release_spare_pools(cinfo);
+
+    lhdr_ptr = mem->large_list[pool_id];
+    mem->large_list[pool_id] = NULL;
+    while (lhdr_ptr != NULL) {
+      large_pool_ptr next_lhdr_ptr = lhdr_ptr->next;
+      lhdr_ptr->bytes_left += lhdr_ptr->bytes_used;
+      lhdr_ptr->bytes_used = 0;
+      mem->total_space_allocated -= lhdr_ptr->bytes_left +
+                                    sizeof(large_pool_hdr) + ALIGN_SIZE - 1;
+      lhdr_ptr->next = mem->spare_large_list;
+      mem->spare_large_list = lhdr_ptr;
+      lhdr_ptr = next_lhdr_ptr;
+    }
+
+    /* Keep the small pools in their original order, so that the next image's
+     * allocations are laid out the same way.
+     */
+    mem->spare_small_list = mem->small_list[pool_id];
+    mem->small_list[pool_id] = NULL;
+    for (shdr_ptr = mem->spare_small_list; shdr_ptr != NULL;
+         shdr_ptr = shdr_ptr->next) {
+      shdr_ptr->bytes_left += shdr_ptr->bytes_used;
+      shdr_ptr->bytes_used = 0;
+      mem->total_space_allocated -= shdr_ptr->bytes_left +
+                                    sizeof(small_pool_hdr) + ALIGN_SIZE - 1;
+    }
+    return;
+  }
+
   /* Release large objects */
   lhdr_ptr = mem->large_list[pool_id];
   mem->large_list[pool_id] = NULL;
@@ -1167,8 +1293,12 @@ free_pool(j_common_ptr cinfo, int pool_id)
 METHODDEF(void)
 self_destruct(j_common_ptr cinfo)
 {
+  my_mem_ptr mem = (my_mem_ptr)cinfo->mem;
   int pool;
 
+  mem->retain_image_pool = FALSE;
+  release_spare_pools(cinfo);
+
   /* Close all backing store, release all memory.
    * Releasing pools in reverse order might help avoid fragmentation
    * with some (brain-damaged) malloc libraries.
@@ -1185,6 +1315,51 @@ self_destruct(j_common_ptr cinfo)
 }
 
 
+/*
+ * Determine whether every realized virtual array is held entirely in memory.
+ * Read-only access to such an array never touches backing store or modifies
+ * the array control block, so it can safely be performed by several threads
+ * at once.
+ */
+
+GLOBAL(boolean)
+jmem_virt_arrays_resident(j_common_ptr cinfo)
+{
+  my_mem_ptr mem = (my_mem_ptr)cinfo->mem;
+  jvirt_sarray_ptr sptr;
+  jvirt_barray_ptr bptr;
+
+  for (sptr = mem->virt_sarray_list; sptr != NULL; sptr = sptr->next) {
+    if (sptr->mem_buffer == NULL || sptr->rows_in_mem < sptr->rows_in_array)
+      return FALSE;
+  }
+  for (bptr = mem->virt_barray_list; bptr != NULL; bptr = bptr->next) {
+    if (bptr->mem_buffer == NULL || bptr->rows_in_mem < bptr->rows_in_array)
+      return FALSE;
+  }
+  return TRUE;
+}
+
+
+/*
+ * Enable or disable retention of the IMAGE pool.  When enabled, the memory
+ * used for one image is kept when the image is finished or aborted, and it is
+ * reused for the next image, so that compressing or decompressing a series of
+ * similar images does not repeatedly obtain the same memory from the system.
+ * At most one image's worth of pools is retained.
+ */
+
+GLOBAL(void)
+jmem_retain_image_pool(j_common_ptr cinfo, boolean retain)
+{
+  my_mem_ptr mem = (my_mem_ptr)cinfo->mem;
+
+  mem->retain_image_pool = retain;
+  if (!retain)
+    release_spare_pools(cinfo);
+}
+
+
 /*
  * Memory manager initialization.
  * When this is called, only the error manager pointer is valid in cinfo!
@@ -1254,6 +1429,9 @@ jinit_memory_mgr(j_common_ptr cinfo)
   }
   mem->virt_sarray_list = NULL;
   mem->virt_barray_list = NULL;
+  mem->retain_image_pool = FALSE;
+  mem->spare_small_list = NULL;
+  mem->spare_large_list = NULL;
 
   mem->total_space_allocated = sizeof(my_memory_mgr);
 
@@ -109,6 +109,15 @@ struct jpeg_comp_master {
   boolean trellis_passes; /* TRUE=currently doing trellis-related passes [not exposed] */
   boolean trellis_q_opt; /* TRUE=optimize quant table in trellis loop */
   boolean overshoot_deringing; /* TRUE=preprocess input to reduce ringing of edges on white background */
+  boolean estimate_scans; /* TRUE=estimate sizes of candidate scans rather than encoding them */
+  size_t gathered_bits; /* size of the data counted by the last statistics-gathering pass [not exposed] */
+  boolean warm_context; /* TRUE=retain memory and derived tables across images */
+  void *huff_tbl_cache; /* Huffman derived tables retained by warm_context (jchuff.c) [not exposed] */
+  void *divisor_cache[2]; /* quantization divisors retained by warm_context, for 8-bit and 12-bit data (jcdctmgr.c) [not exposed] */
+  boolean transcode_requantize; /* TRUE=requantize DCT coefficients to the current quant tables when transcoding */
+  UINT16 src_quantval[NUM_QUANT_TBLS][DCTSIZE2]; /* source quant tables saved by jpeg_copy_critical_parameters, all zero if absent [not exposed] */
+  jpeg_coef_source_ptr coef_source; /* callback that supplies the coefficients for jpeg_write_coefficients(), or NULL [not exposed] */
+  void *coef_source_data; /* client data passed to coef_source [not exposed] */
 
   double norm_src[NUM_QUANT_TBLS][DCTSIZE2];
   double norm_coef[NUM_QUANT_TBLS][DCTSIZE2];
@@ -118,6 +127,7 @@ struct jpeg_comp_master {
   int quant_tbl_master_idx; /* Quantization table master index */
   int trellis_freq_split; /* splitting point for frequency in trellis quantization */
   int trellis_num_loops; /* number of trellis loops */
+  int num_threads; /* max # of threads used for encoding */
 
   int num_scans_luma; /* # of entries in scan_info array pertaining to luma (used when optimize_scans is TRUE */
   int num_scans_luma_dc;
@@ -311,8 +321,24 @@ struct jpeg_decomp_master {
   /* Last iMCU row that was successfully decoded */
   JDIMENSION last_good_iMCU_row;
 
+  /* True if every component is reconstructed from its DC coefficient alone,
+   * in which case the AC scans of a progressive image are skipped
+   */
+  boolean dc_only;
+
   /* Tail of list of saved markers */
   jpeg_saved_marker_ptr marker_list_end;
+
+  /* Extension parameters */
+  int num_threads; /* max # of threads used for decoding */
+  int scan_budget; /* max # of progressive scans to decode (0 = all) */
+  int checkpoint_interval; /* min # of MCUs between random access points */
+  boolean record_decode_index; /* TRUE=record index for saving */
+  boolean warm_context; /* TRUE=retain memory across images */
+
+  /* Decode index supplied by jpeg_load_decode_index() (NULL if none) */
+  JOCTET *decode_index;
+  unsigned int decode_index_len;
 };
 
 /* Input control module */
@@ -408,6 +434,11 @@ struct jpeg_marker_reader {
   boolean saw_SOF;              /* found SOF? */
   int next_restart_num;         /* next restart number expected (0-7) */
   unsigned int discarded_bytes; /* # of bytes skipped looking for a marker */
+
+  /* Skip the compressed data of the current scan without decoding it.
+   * Returns FALSE if had to suspend.
+   */
+  boolean (*skip_scan_data) (j_decompress_ptr cinfo);
 };
 
 /* Entropy decoding */
@@ -421,6 +452,12 @@ struct jpeg_entropy_decoder {
                              JDIMENSION MCU_row_num, JDIMENSION MCU_col_num,
                              JDIMENSION nMCU);
   boolean (*process_restart) (j_decompress_ptr cinfo);
+  /* Random access within a single-scan image; NULL if not supported */
+  boolean (*seek_mcu) (j_decompress_ptr cinfo, JDIMENSION MCU_num);
+  /* Serialize the random access points of the current scan (see
+   * jpeg_save_decode_index()); NULL if not supported */
+  boolean (*save_index) (j_decompress_ptr cinfo, JOCTET **index_data_ptr,
+                         unsigned int *index_data_len);
 
   /* This is here to share code between baseline and progressive decoders; */
   /* other modules probably should not use it */
@@ -552,12 +589,15 @@ EXTERN(void) jinit_c_coef_controller(j_compress_ptr cinfo,
                                      boolean need_full_buffer);
 EXTERN(void) j12init_c_coef_controller(j_compress_ptr cinfo,
                                        boolean need_full_buffer);
+EXTERN(void) jinit_c_coef_clone(j_compress_ptr cinfo, j_compress_ptr src);
+EXTERN(void) j12init_c_coef_clone(j_compress_ptr cinfo, j_compress_ptr src);
 EXTERN(void) jinit_color_converter(j_compress_ptr cinfo);
 EXTERN(void) j12init_color_converter(j_compress_ptr cinfo);
 EXTERN(void) jinit_downsampler(j_compress_ptr cinfo);
 EXTERN(void) j12init_downsampler(j_compress_ptr cinfo);
 EXTERN(void) jinit_forward_dct(j_compress_ptr cinfo);
 EXTERN(void) j12init_forward_dct(j_compress_ptr cinfo);
+EXTERN(void) jinit_trellis_quantizer(j_compress_ptr cinfo);
 EXTERN(void) jinit_huff_encoder(j_compress_ptr cinfo);
 EXTERN(void) jinit_phuff_encoder(j_compress_ptr cinfo);
 EXTERN(void) jinit_arith_encoder(j_compress_ptr cinfo);
@@ -599,6 +639,7 @@ EXTERN(void) jinit_input_controller(j_decompress_ptr cinfo);
 EXTERN(void) jinit_marker_reader(j_decompress_ptr cinfo);
 EXTERN(void) jinit_huff_decoder(j_decompress_ptr cinfo);
 EXTERN(void) jinit_phuff_decoder(j_decompress_ptr cinfo);
+EXTERN(void) jinit_shuff_decoder(j_decompress_ptr cinfo);
 EXTERN(void) jinit_arith_decoder(j_decompress_ptr cinfo);
 EXTERN(void) jinit_inverse_dct(j_decompress_ptr cinfo);
 EXTERN(void) j12init_inverse_dct(j_decompress_ptr cinfo);
@@ -633,6 +674,8 @@ EXTERN(void) j16init_lossless_decompressor(j_decompress_ptr cinfo);
 
 /* Memory manager initialization */
 EXTERN(void) jinit_memory_mgr(j_common_ptr cinfo);
+EXTERN(boolean) jmem_virt_arrays_resident(j_common_ptr cinfo);
+EXTERN(void) jmem_retain_image_pool(j_common_ptr cinfo, boolean retain);
 
 #if JPEG_LIB_VERSION >= 80 || defined(MEM_SRCDST_SUPPORTED)
 EXTERN(void)
@@ -664,7 +707,7 @@ EXTERN(void) jget_arith_rates (j_compress_ptr cinfo, int dc_tbl_no, int ac_tbl_n
 EXTERN(void) quantize_trellis_arith
 (j_compress_ptr cinfo, arith_rates *r, JBLOCKROW coef_blocks, JBLOCKROW src, JDIMENSION num_blocks,
  JQUANT_TBL * qtbl, double *norm_src, double *norm_coef, JCOEF *last_dc_val,
- JBLOCKROW coef_blocks_above, JBLOCKROW src_above);
+ JBLOCKROW coef_blocks_above, JBLOCKROW src_above, int worker);
 #endif
 
 /* Constant tables in jutils.c */
@@ -326,7 +326,11 @@ typedef enum {
   JBOOLEAN_USE_LAMBDA_WEIGHT_TBL = 0x339DB65F, /* TRUE=use lambda weighting table */
   JBOOLEAN_USE_SCANS_IN_TRELLIS = 0xFD841435, /* TRUE=use scans in trellis optimization */
   JBOOLEAN_TRELLIS_Q_OPT = 0xE12AE269, /* TRUE=optimize quant table in trellis loop */
-  JBOOLEAN_OVERSHOOT_DERINGING = 0x3F4BBBF9 /* TRUE=preprocess input to reduce ringing of edges on white background */
+  JBOOLEAN_OVERSHOOT_DERINGING = 0x3F4BBBF9, /* TRUE=preprocess input to reduce ringing of edges on white background */
+  JBOOLEAN_ESTIMATE_SCANS = 0x52E07B1D, /* TRUE=estimate sizes of candidate scans rather than encoding them */
+  JBOOLEAN_WARM_CONTEXT = 0x9B61D4E2, /* TRUE=retain memory and derived tables across images */
+  JBOOLEAN_TRANSCODE_REQUANTIZE = 0x4E27C0B3, /* TRUE=requantize DCT coefficients to the current quant tables when transcoding */
+  JBOOLEAN_RECORD_DECODE_INDEX = 0x7C3E5A91 /* TRUE=record a decode index for jpeg_save_decode_index() */
 } J_BOOLEAN_PARAM;
 
 /* Floating point parameters */
@@ -344,7 +348,10 @@ typedef enum {
   JINT_TRELLIS_FREQ_SPLIT = 0x6FAFF127, /* splitting point for frequency in trellis quantization */
   JINT_TRELLIS_NUM_LOOPS = 0xB63EBF39, /* number of trellis loops */
   JINT_BASE_QUANT_TBL_IDX = 0x44492AB1, /* base quantization table index */
-  JINT_DC_SCAN_OPT_MODE = 0x0BE7AD3C /* DC scan optimization mode */
+  JINT_DC_SCAN_OPT_MODE = 0x0BE7AD3C, /* DC scan optimization mode */
+  JINT_NUM_THREADS = 0x7A5D3C81, /* max # of threads used for encoding/decoding */
+  JINT_SCAN_BUDGET = 0x2F8C51D7, /* max # of progressive scans to decode (0 = all) */
+  JINT_CHECKPOINT_INTERVAL = 0x6E3B9A14 /* min # of MCUs between random access points (0 = disabled) */
 } J_INT_PARAM;
 
 
@@ -1219,11 +1226,58 @@ EXTERN(boolean) jpeg_c_int_param_supported (const j_compress_ptr cinfo,
 EXTERN(void) jpeg_c_set_int_param (j_compress_ptr cinfo, J_INT_PARAM param,
                                    int value);
 EXTERN(int) jpeg_c_get_int_param (const j_compress_ptr cinfo, J_INT_PARAM param);
+
+#define JPEG_D_PARAM_SUPPORTED 1
+EXTERN(boolean) jpeg_d_bool_param_supported (const j_decompress_ptr cinfo,
+                                             J_BOOLEAN_PARAM param);
+EXTERN(void) jpeg_d_set_bool_param (j_decompress_ptr cinfo,
+                                    J_BOOLEAN_PARAM param, boolean value);
+EXTERN(boolean) jpeg_d_get_bool_param (const j_decompress_ptr cinfo,
+                                       J_BOOLEAN_PARAM param);
+
+EXTERN(boolean) jpeg_d_int_param_supported (const j_decompress_ptr cinfo,
+                                            J_INT_PARAM param);
+EXTERN(void) jpeg_d_set_int_param (j_decompress_ptr cinfo, J_INT_PARAM param,
+                                   int value);
+EXTERN(int) jpeg_d_get_int_param (const j_decompress_ptr cinfo, J_INT_PARAM param);
 /* Read ICC profile.  See libjpeg.txt for usage information. */
 EXTERN(boolean) jpeg_read_icc_profile(j_decompress_ptr cinfo,
                                       JOCTET **icc_data_ptr,
                                       unsigned int *icc_data_len);
 
+/* Save or load an index of random access points within a single-scan
+ * Huffman-coded image.  See README-mozilla.txt for usage information.
+ */
+EXTERN(boolean) jpeg_save_decode_index(j_decompress_ptr cinfo,
+                                       JOCTET **index_data_ptr,
+                                       unsigned int *index_data_len);
+EXTERN(void) jpeg_load_decode_index(j_decompress_ptr cinfo,
+                                    const JOCTET *index_data,
+                                    unsigned int index_data_len);
+
+/* Supply the coefficients for jpeg_write_coefficients() one iMCU row at a
+ * time through a callback, rather than in virtual arrays.  See
+ * README-mozilla.txt for usage information.
+ */
+typedef void (*jpeg_coef_source_ptr) (j_compress_ptr cinfo, void *client_data,
+                                      int ci, JDIMENSION iMCU_row,
+                                      JBLOCKARRAY rows);
+EXTERN(void) jpeg_set_coef_source(j_compress_ptr cinfo,
+                                  jpeg_coef_source_ptr coef_source,
+                                  void *client_data);
+
+/* Collect compressed data in a chain of fixed-size memory chunks rather than
+ * in one contiguous buffer.  See README-mozilla.txt for usage information.
+ */
+typedef struct {
+  JOCTET *data;                 /* start of chunk */
+  size_t size;                  /* # of bytes written to chunk */
+} jpeg_output_chunk;
+
+EXTERN(void) jpeg_chain_dest(j_compress_ptr cinfo, size_t chunk_size);
+EXTERN(int) jpeg_get_output_chunks(j_compress_ptr cinfo,
+                                   const jpeg_output_chunk **chunks);
+
 /*
  * Permit users to replace the IDCT method dynamically.
  * The selector callback is called after the default idct implementation was choosen,
@@ -23,6 +23,8 @@
 #include "transupp.h"           /* Support routines for jpegtran */
 #include "jversion.h"           /* for version message */
 #include "jconfigint.h"
+#include "jthread.h"            /* worker pool for -batch and -stream */
+#include <setjmp.h>
 
 
 /*
@@ -44,6 +46,9 @@ static boolean strict;          /* for -strict switch */
 static boolean prefer_smallest;  /* use smallest of input or result file (if no image-changing options supplied) */
 static JCOPY_OPTION copyoption; /* -copy switch */
 static jpeg_transform_info transformoption; /* image transformation options */
+static char *batchfilename;     /* for -batch switch */
+static boolean streammode;      /* for -stream switch */
+static int num_threads;         /* for -threads switch */
 boolean memsrc = FALSE;  /* for -memsrc switch */
 #define INPUT_BUF_SIZE  4096
 
@@ -88,19 +93,30 @@ usage(void)
   fprintf(stderr, "                 with -drop: Requantize drop file to match source file\n");
   fprintf(stderr, "  -wipe WxH+X+Y  Wipe (gray out) a rectangular region\n");
 #endif
+  fprintf(stderr, "  -quality N     Requantize to compression quality N (0..100; lower is smaller,\n");
+  fprintf(stderr, "                 worse); should be coarser than the quality of the input file\n");
+  fprintf(stderr, "  -notrellis     With -quality: Disable trellis quantization\n");
   fprintf(stderr, "Switches for advanced users:\n");
 #ifdef C_ARITH_CODING_SUPPORTED
   fprintf(stderr, "  -arithmetic    Use arithmetic coding\n");
 #endif
   fprintf(stderr, "  -icc FILE      Embed ICC profile contained in FILE\n");
   fprintf(stderr, "  -restart N     Set restart interval in rows, or in blocks with B\n");
+  fprintf(stderr, "  -lowmemory     Transform on demand instead of into a copy of the image\n");
+  fprintf(stderr, "                 (uses less memory; ignored with -quality)\n");
   fprintf(stderr, "  -maxmemory N   Maximum memory to use (in kbytes)\n");
   fprintf(stderr, "  -maxscans N    Maximum number of scans to allow in input file\n");
   fprintf(stderr, "  -outfile name  Specify name for output file\n");
   fprintf(stderr, "  -report        Report transformation progress\n");
   fprintf(stderr, "  -strict        Treat all warnings as fatal\n");
+  fprintf(stderr, "  -threads N     Use up to N threads (default is 1)\n");
   fprintf(stderr, "  -verbose  or  -debug   Emit debug output\n");
   fprintf(stderr, "  -version       Print version information and exit\n");
+  fprintf(stderr, "Switches for batch processing:\n");
+  fprintf(stderr, "  -batch FILE    Transcode each pair of input/output file names listed in\n");
+  fprintf(stderr, "                 FILE (- for standard input)\n");
+  fprintf(stderr, "  -stream        Transcode length-prefixed JPEG images from standard input to\n");
+  fprintf(stderr, "                 standard output\n");
   fprintf(stderr, "Switches for wizards:\n");
 #ifdef C_MULTISCAN_FILES_SUPPORTED
   fprintf(stderr, "  -scans FILE    Create multi-scan JPEG per script FILE\n");
@@ -148,6 +164,8 @@ parse_switches(j_compress_ptr cinfo, int argc, char **argv,
   char *arg;
   boolean simple_progressive;
   char *scansarg = NULL;        /* saves -scans parm if any */
+  int quality = -1;             /* -quality parameter (-1 = don't requantize) */
+  boolean trellis = TRUE;       /* FALSE if -notrellis */
 
   /* Set up default JPEG parameters. */
 #ifdef C_PROGRESSIVE_SUPPORTED
@@ -167,8 +185,12 @@ parse_switches(j_compress_ptr cinfo, int argc, char **argv,
   transformoption.force_grayscale = FALSE;
   transformoption.crop = FALSE;
   transformoption.slow_hflip = FALSE;
+  transformoption.streaming = FALSE;
   cinfo->err->trace_level = 0;
   prefer_smallest = TRUE;
+  batchfilename = NULL;
+  streammode = FALSE;
+  num_threads = 1;
 
   /* Scan command line options, adjust parameters */
 
@@ -198,6 +220,12 @@ parse_switches(j_compress_ptr cinfo, int argc, char **argv,
       exit(EXIT_FAILURE);
 #endif
 
+    } else if (keymatch(arg, "batch", 1)) {
+      /* Transcode the files listed in a manifest. */
+      if (++argn >= argc)       /* advance to next argument */
+        usage();
+      batchfilename = argv[argn];
+
     } else if (keymatch(arg, "copy", 1)) {
       /* Select which extra markers to copy. */
       if (++argn >= argc)       /* advance to next argument */
@@ -301,6 +329,10 @@ parse_switches(j_compress_ptr cinfo, int argc, char **argv,
         usage();
       icc_filename = argv[argn];
 
+    } else if (keymatch(arg, "lowmemory", 3)) {
+      /* Feed the transformed coefficients to the encoder on demand. */
+      transformoption.streaming = TRUE;
+
     } else if (keymatch(arg, "maxmemory", 3)) {
       /* Maximum memory in Kb (or Mb with 'm'). */
       long lval;
@@ -320,6 +352,10 @@ parse_switches(j_compress_ptr cinfo, int argc, char **argv,
       if (sscanf(argv[argn], "%u", &max_scans) != 1)
         usage();
 
+    } else if (keymatch(arg, "notrellis", 3)) {
+      /* Disable trellis quantization when requantizing. */
+      trellis = FALSE;
+
     } else if (keymatch(arg, "optimize", 1) || keymatch(arg, "optimise", 1)) {
       /* Enable entropy parm optimization. */
 #ifdef ENTROPY_OPT_SUPPORTED
@@ -353,6 +389,15 @@ parse_switches(j_compress_ptr cinfo, int argc, char **argv,
       exit(EXIT_FAILURE);
 #endif
 
+    } else if (keymatch(arg, "quality", 1)) {
+      /* Requantize to the quantization tables for the given quality. */
+      if (++argn >= argc)       /* advance to next argument */
+        usage();
+      if (sscanf(argv[argn], "%d", &quality) != 1 || quality < 0 ||
+          quality > 100)
+        usage();
+      prefer_smallest = FALSE;
+
     } else if (keymatch(arg, "report", 3)) {
       report = TRUE;
 
@@ -412,6 +457,19 @@ parse_switches(j_compress_ptr cinfo, int argc, char **argv,
     } else if (keymatch(arg, "strict", 2)) {
       strict = TRUE;
 
+    } else if (keymatch(arg, "stream", 4)) {
+      /* Transcode length-prefixed images from stdin to stdout. */
+      streammode = TRUE;
+
+    } else if (keymatch(arg, "threads", 2)) {
+      /* Maximum number of threads used by the encoder, or number of images
+       * transcoded concurrently in batch mode.
+       */
+      if (++argn >= argc)       /* advance to next argument */
+        usage();
+      if (sscanf(argv[argn], "%d", &num_threads) != 1 || num_threads < 1)
+        usage();
+
     } else if (keymatch(arg, "transpose", 1)) {
       /* Transpose (across UL-to-LR axis). */
       select_transform(JXFORM_TRANSPOSE);
@@ -449,8 +507,45 @@ parse_switches(j_compress_ptr cinfo, int argc, char **argv,
 
   /* Post-switch-scanning cleanup */
 
+  /* Requantization modifies the coefficients in place, so it needs a copy
+   * of the transformed image.
+   */
+  if (quality >= 0)
+    transformoption.streaming = FALSE;
+
   if (for_real) {
 
+    if (quality >= 0) {         /* process -quality and -notrellis */
+      /* This must follow jpeg_copy_critical_parameters(), which installs the
+       * source's tables and disables trellis quantization.
+       */
+      boolean replaced[NUM_QUANT_TBLS];
+      int ci, tblno;
+
+      jpeg_set_quality(cinfo, quality, TRUE);
+      /* jpeg_set_quality() replaces only tables 0 and 1.  Any other table
+       * that a component uses (for instance, a separate Cr table) receives
+       * the luminance values if it belongs to the first component and the
+       * chrominance values otherwise, as cjpeg would use.
+       */
+      memset(replaced, 0, sizeof(replaced));
+      for (ci = 0; ci < cinfo->num_components; ci++) {
+        tblno = cinfo->comp_info[ci].quant_tbl_no;
+        if (tblno > 1 && !replaced[tblno] &&
+            cinfo->quant_tbl_ptrs[tblno] != NULL) {
+          memcpy(cinfo->quant_tbl_ptrs[tblno]->quantval,
+                 cinfo->quant_tbl_ptrs[ci == 0 ? 0 : 1]->quantval,
+                 sizeof(cinfo->quant_tbl_ptrs[tblno]->quantval));
+          replaced[tblno] = TRUE;
+        }
+      }
+      jpeg_c_set_bool_param(cinfo, JBOOLEAN_TRANSCODE_REQUANTIZE, TRUE);
+      if (jpeg_c_get_int_param(cinfo, JINT_COMPRESS_PROFILE) !=
+          JCP_MAX_COMPRESSION)
+        trellis = FALSE;        /* -revert */
+      jpeg_c_set_bool_param(cinfo, JBOOLEAN_TRELLIS_QUANT, trellis);
+    }
+
 #ifdef C_PROGRESSIVE_SUPPORTED
     if (simple_progressive)     /* process -progressive; -scans can override */
       jpeg_simple_progression(cinfo);
@@ -480,6 +575,597 @@ my_emit_message(j_common_ptr cinfo, int msg_level)
 }
 
 
+/*
+ * Batch processing (-batch and -stream switches.)
+ *
+ * Each image in a batch is assigned to a slot, and each slot owns a
+ * decompression object and a compression object that are reused for every
+ * image assigned to it.  JBOOLEAN_WARM_CONTEXT is enabled for both objects, so
+ * the memory pools of one image are recycled for the next one.  Images are
+ * processed in groups of num_threads, one per slot, and each group is
+ * transcoded in three phases:
+ *
+ * 1. Read the input and decode the DCT coefficients (in parallel)
+ * 2. Set the destination parameters (serially, since parse_switches()
+ *    modifies global variables)
+ * 3. Encode and write the output (in parallel)
+ *
+ * Errors are caught with setjmp()/longjmp() and reported for the image in
+ * question, and processing continues with the next image.
+ */
+
+typedef struct batch_slot batch_slot;
+
+typedef struct {
+  struct jpeg_error_mgr pub;    /* "public" fields */
+  batch_slot *slot;             /* for returning to caller */
+} batch_error_mgr;
+
+struct batch_slot {
+  struct jpeg_decompress_struct srcinfo;
+  struct jpeg_compress_struct dstinfo;
+  batch_error_mgr jsrcerr, jdsterr;
+  struct jpeg_progress_mgr src_progress; /* for -maxscans */
+  jmp_buf setjmp_buffer;        /* return point for errors */
+  jpeg_transform_info xform;    /* per-image copy of transformoption */
+  jvirt_barray_ptr *src_coef_arrays;
+  jvirt_barray_ptr *dst_coef_arrays;
+
+  char *inname;                 /* input file name or record label */
+  char *outname;                /* output file name (NULL if -stream) */
+  unsigned char *inbuffer;      /* input buffer, reused across images */
+  unsigned long insize, inbufsize;
+  const jpeg_output_chunk *chunks; /* output, owned by dstinfo */
+  int num_chunks;
+  unsigned long outsize;
+  boolean keep_input;           /* TRUE if the input is smaller */
+  unsigned long result_size;    /* size of the input or the output */
+
+  boolean busy;                 /* TRUE if an image is assigned to the slot */
+  boolean failed;               /* TRUE if the image couldn't be transcoded */
+  char errmsg[JMSG_LENGTH_MAX];
+};
+
+typedef struct {
+  batch_slot *slots;
+  JCOPY_OPTION copyoption;      /* snapshots of the global options, which */
+  jpeg_transform_info xform;    /* parse_switches() resets while parsing */
+  JOCTET *icc_profile;
+  unsigned int icc_len;
+} batch_job;
+
+
+METHODDEF(void)
+batch_error_exit(j_common_ptr cinfo)
+{
+  batch_slot *slot = ((batch_error_mgr *)cinfo->err)->slot;
+
+  (*cinfo->err->format_message) (cinfo, slot->errmsg);
+  longjmp(slot->setjmp_buffer, 1);
+}
+
+
+METHODDEF(void)
+batch_output_message(j_common_ptr cinfo)
+{
+  batch_slot *slot = ((batch_error_mgr *)cinfo->err)->slot;
+  char buffer[JMSG_LENGTH_MAX];
+
+  (*cinfo->err->format_message) (cinfo, buffer);
+  fprintf(stderr, "%s: %s: %s\n", progname, slot->inname, buffer);
+}
+
+
+METHODDEF(void)
+batch_progress_monitor(j_common_ptr cinfo)
+{
+  j_decompress_ptr srcinfo = (j_decompress_ptr)cinfo;
+  batch_slot *slot = ((batch_error_mgr *)cinfo->err)->slot;
+
+  if (srcinfo->input_scan_number > (int)max_scans) {
+    SNPRINTF(slot->errmsg, JMSG_LENGTH_MAX,
+             "Scan number %d exceeds maximum scans (%u)",
+             srcinfo->input_scan_number, max_scans);
+    longjmp(slot->setjmp_buffer, 1);
+  }
+}
+
+
+LOCAL(void)
+batch_init_slot(batch_slot *slot, int argc, char **argv)
+{
+  memset(slot, 0, sizeof(batch_slot));
+
+  slot->srcinfo.err = jpeg_std_error(&slot->jsrcerr.pub);
+  slot->jsrcerr.pub.error_exit = batch_error_exit;
+  slot->jsrcerr.pub.output_message = batch_output_message;
+  slot->jsrcerr.slot = slot;
+  jpeg_create_decompress(&slot->srcinfo);
+  slot->dstinfo.err = jpeg_std_error(&slot->jdsterr.pub);
+  slot->jdsterr.pub.error_exit = batch_error_exit;
+  slot->jdsterr.pub.output_message = batch_output_message;
+  slot->jdsterr.slot = slot;
+  jpeg_create_compress(&slot->dstinfo);
+
+  /* As in main(), parse the switches into the destination object and copy
+   * over what needs to affect the source object too.
+   */
+  parse_switches(&slot->dstinfo, argc, argv, 0, FALSE);
+  slot->jsrcerr.pub.trace_level = slot->jdsterr.pub.trace_level;
+  slot->srcinfo.mem->max_memory_to_use = slot->dstinfo.mem->max_memory_to_use;
+  if (strict)
+    slot->jsrcerr.pub.emit_message = my_emit_message;
+  if (max_scans != 0) {
+    slot->src_progress.progress_monitor = batch_progress_monitor;
+    slot->srcinfo.progress = &slot->src_progress;
+  }
+
+  if (jpeg_d_bool_param_supported(&slot->srcinfo, JBOOLEAN_WARM_CONTEXT))
+    jpeg_d_set_bool_param(&slot->srcinfo, JBOOLEAN_WARM_CONTEXT, TRUE);
+  if (jpeg_c_bool_param_supported(&slot->dstinfo, JBOOLEAN_WARM_CONTEXT))
+    jpeg_c_set_bool_param(&slot->dstinfo, JBOOLEAN_WARM_CONTEXT, TRUE);
+}
+
+
+LOCAL(void)
+batch_release_image(batch_slot *slot)
+{
+  free(slot->inname);
+  free(slot->outname);
+  slot->inname = slot->outname = NULL;
+  slot->busy = FALSE;
+}
+
+
+LOCAL(void)
+batch_destroy_slot(batch_slot *slot)
+{
+  batch_release_image(slot);
+  jpeg_destroy_compress(&slot->dstinfo);
+  jpeg_destroy_decompress(&slot->srcinfo);
+  free(slot->inbuffer);
+}
+
+
+/* Make sure that the slot's input buffer can hold at least size bytes. */
+
+LOCAL(boolean)
+batch_reserve_input(batch_slot *slot, unsigned long size)
+{
+  unsigned char *newbuffer;
+
+  if (size <= slot->inbufsize)
+    return TRUE;
+  if (size < slot->inbufsize * 2)
+    size = slot->inbufsize * 2;
+  newbuffer = (unsigned char *)realloc(slot->inbuffer, size);
+  if (newbuffer == NULL) {
+    SNPRINTF(slot->errmsg, JMSG_LENGTH_MAX, "memory allocation failure");
+    return FALSE;
+  }
+  slot->inbuffer = newbuffer;
+  slot->inbufsize = size;
+  return TRUE;
+}
+
+
+LOCAL(boolean)
+batch_read_file(batch_slot *slot)
+{
+  FILE *fp;
+  size_t nbytes;
+
+  if ((fp = fopen(slot->inname, READ_BINARY)) == NULL) {
+    SNPRINTF(slot->errmsg, JMSG_LENGTH_MAX, "can't open for reading");
+    return FALSE;
+  }
+  slot->insize = 0;
+  do {
+    if (!batch_reserve_input(slot, slot->insize + INPUT_BUF_SIZE)) {
+      fclose(fp);
+      return FALSE;
+    }
+    nbytes = fread(&slot->inbuffer[slot->insize], 1,
+                   slot->inbufsize - slot->insize, fp);
+    slot->insize += (unsigned long)nbytes;
+  } while (nbytes > 0 && slot->insize == slot->inbufsize);
+  if (ferror(fp)) {
+    SNPRINTF(slot->errmsg, JMSG_LENGTH_MAX, "can't read");
+    fclose(fp);
+    return FALSE;
+  }
+  fclose(fp);
+  return TRUE;
+}
+
+
+/* Write either the input or the output, whichever was chosen. */
+
+LOCAL(boolean)
+batch_write_result(batch_slot *slot, FILE *fp)
+{
+  int i;
+
+  if (slot->keep_input)
+    return fwrite(slot->inbuffer, 1, slot->insize, fp) == slot->insize;
+  for (i = 0; i < slot->num_chunks; i++) {
+    if (fwrite(slot->chunks[i].data, 1, slot->chunks[i].size, fp) <
+        slot->chunks[i].size)
+      return FALSE;
+  }
+  return TRUE;
+}
+
+
+LOCAL(boolean)
+batch_write_file(batch_slot *slot)
+{
+  FILE *fp;
+  boolean written;
+
+  if ((fp = fopen(slot->outname, WRITE_BINARY)) == NULL) {
+    SNPRINTF(slot->errmsg, JMSG_LENGTH_MAX, "can't open %s for writing",
+             slot->outname);
+    return FALSE;
+  }
+  written = batch_write_result(slot, fp);
+  if (fclose(fp) != 0 || !written) {
+    SNPRINTF(slot->errmsg, JMSG_LENGTH_MAX, "can't write to %s",
+             slot->outname);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+
+/* Phase 1: read the input and decode the DCT coefficients. */
+
+METHODDEF(void)
+batch_read_task(void *job_, int task, int worker)
+{
+  batch_job *job = (batch_job *)job_;
+  batch_slot *slot = &job->slots[task];
+
+  if (!slot->busy || slot->failed)
+    return;
+  if (setjmp(slot->setjmp_buffer)) {
+    slot->failed = TRUE;
+    jpeg_abort_decompress(&slot->srcinfo);
+    return;
+  }
+
+  if (slot->outname != NULL && !batch_read_file(slot)) {
+    slot->failed = TRUE;
+    return;
+  }
+
+  slot->jsrcerr.pub.num_warnings = 0;
+  jpeg_mem_src(&slot->srcinfo, slot->inbuffer, slot->insize);
+  jcopy_markers_setup(&slot->srcinfo, job->copyoption);
+  (void)jpeg_read_header(&slot->srcinfo, TRUE);
+
+  slot->xform = job->xform;
+#if TRANSFORMS_SUPPORTED
+  if (!jtransform_request_workspace(&slot->srcinfo, &slot->xform)) {
+    SNPRINTF(slot->errmsg, JMSG_LENGTH_MAX, "transformation is not perfect");
+    slot->failed = TRUE;
+    jpeg_abort_decompress(&slot->srcinfo);
+    return;
+  }
+#endif
+
+  slot->src_coef_arrays = jpeg_read_coefficients(&slot->srcinfo);
+}
+
+
+/* Phase 2: set the destination parameters. */
+
+LOCAL(void)
+batch_setup(batch_slot *slot, int argc, char **argv)
+{
+  if (!slot->busy || slot->failed)
+    return;
+  if (setjmp(slot->setjmp_buffer)) {
+    slot->failed = TRUE;
+    jpeg_abort_compress(&slot->dstinfo);
+    jpeg_abort_decompress(&slot->srcinfo);
+    return;
+  }
+
+  slot->jdsterr.pub.num_warnings = 0;
+  jpeg_copy_critical_parameters(&slot->srcinfo, &slot->dstinfo);
+#if TRANSFORMS_SUPPORTED
+  slot->dst_coef_arrays =
+    jtransform_adjust_parameters(&slot->srcinfo, &slot->dstinfo,
+                                 slot->src_coef_arrays, &slot->xform);
+#else
+  slot->dst_coef_arrays = slot->src_coef_arrays;
+#endif
+  parse_switches(&slot->dstinfo, argc, argv, 0, TRUE);
+}
+
+
+/* Phase 3: encode and write the output. */
+
+METHODDEF(void)
+batch_write_task(void *job_, int task, int worker)
+{
+  batch_job *job = (batch_job *)job_;
+  batch_slot *slot = &job->slots[task];
+  int i;
+
+  if (!slot->busy || slot->failed)
+    return;
+  if (setjmp(slot->setjmp_buffer)) {
+    slot->failed = TRUE;
+    jpeg_abort_compress(&slot->dstinfo);
+    jpeg_abort_decompress(&slot->srcinfo);
+    return;
+  }
+
+  /* The chunks belong to the compression object, so they are reused for the
+   * next image and released along with the object, even if this image
+   * aborts.
+   */
+  jpeg_chain_dest(&slot->dstinfo, 0);
+
+  jpeg_write_coefficients(&slot->dstinfo, slot->dst_coef_arrays);
+  jcopy_markers_execute(&slot->srcinfo, &slot->dstinfo, job->copyoption);
+  if (job->icc_profile != NULL)
+    jpeg_write_icc_profile(&slot->dstinfo, job->icc_profile, job->icc_len);
+#if TRANSFORMS_SUPPORTED
+  jtransform_execute_transformation(&slot->srcinfo, &slot->dstinfo,
+                                    slot->src_coef_arrays, &slot->xform);
+#endif
+  jpeg_finish_compress(&slot->dstinfo);
+
+  slot->num_chunks = jpeg_get_output_chunks(&slot->dstinfo, &slot->chunks);
+  slot->outsize = 0;
+  for (i = 0; i < slot->num_chunks; i++)
+    slot->outsize += (unsigned long)slot->chunks[i].size;
+  slot->keep_input = FALSE;
+  slot->result_size = slot->outsize;
+
+  (void)jpeg_finish_decompress(&slot->srcinfo);
+
+  if (prefer_smallest && slot->insize < slot->outsize &&
+      jpeg_c_get_int_param(&slot->dstinfo, JINT_COMPRESS_PROFILE) ==
+        JCP_MAX_COMPRESSION) {
+    slot->keep_input = TRUE;
+    slot->result_size = slot->insize;
+  }
+
+  if (slot->outname != NULL && !batch_write_file(slot))
+    slot->failed = TRUE;
+}
+
+
+/* Read the next pair of file names from the manifest.  Returns FALSE at the
+ * end of the manifest.
+ */
+
+LOCAL(boolean)
+batch_next_file(FILE *manifest, batch_slot *slot)
+{
+  char line[8192], *inname, *outname, *end;
+
+  while (fgets(line, sizeof(line), manifest) != NULL) {
+    end = line + strlen(line);
+    while (end > line && (end[-1] == '\n' || end[-1] == '\r'))
+      *--end = '\0';
+    if (line[0] == '\0' || line[0] == '#')
+      continue;
+
+    /* The names are separated by a tab, if there is one, or by the first
+     * space otherwise.
+     */
+    inname = line;
+    if ((outname = strchr(line, '\t')) == NULL)
+      outname = strchr(line, ' ');
+    if (outname == NULL || outname == line) {
+      fprintf(stderr, "%s: bogus line in %s: %s\n", progname, batchfilename,
+              line);
+      continue;
+    }
+    *outname++ = '\0';
+    while (*outname == ' ' || *outname == '\t')
+      outname++;
+    if (*outname == '\0') {
+      fprintf(stderr, "%s: bogus line in %s: %s\n", progname, batchfilename,
+              inname);
+      continue;
+    }
+
+    slot->inname = (char *)malloc(strlen(inname) + 1);
+    slot->outname = (char *)malloc(strlen(outname) + 1);
+    if (slot->inname == NULL || slot->outname == NULL) {
+      fprintf(stderr, "%s: memory allocation failure\n", progname);
+      exit(EXIT_FAILURE);
+    }
+    strcpy(slot->inname, inname);
+    strcpy(slot->outname, outname);
+    return TRUE;
+  }
+  return FALSE;
+}
+
+
+/* Read the next length-prefixed image from standard input.  Each image is
+ * preceded by its length, as a 4-byte big-endian integer.  Returns FALSE at
+ * the end of the stream.
+ */
+
+LOCAL(boolean)
+batch_next_record(FILE *infile, batch_slot *slot, unsigned long record_num)
+{
+  unsigned char prefix[4];
+  unsigned long length;
+  size_t nbytes;
+
+  nbytes = fread(prefix, 1, 4, infile);
+  if (nbytes == 0 && feof(infile))
+    return FALSE;
+  if (nbytes < 4) {
+    fprintf(stderr, "%s: premature end of input stream\n", progname);
+    return FALSE;
+  }
+  length = ((unsigned long)prefix[0] << 24) |
+           ((unsigned long)prefix[1] << 16) |
+           ((unsigned long)prefix[2] << 8) | (unsigned long)prefix[3];
+
+  if ((slot->inname = (char *)malloc(32)) == NULL) {
+    fprintf(stderr, "%s: memory allocation failure\n", progname);
+    exit(EXIT_FAILURE);
+  }
+  SNPRINTF(slot->inname, 32, "record %lu", record_num);
+
+  /* Consume the record even if it can't be stored, so that the stream stays
+   * in sync.
+   */
+  if (!batch_reserve_input(slot, length > 0 ? length : 1)) {
+    slot->failed = TRUE;
+    while (length > 0 && fgetc(infile) != EOF)
+      length--;
+    return TRUE;
+  }
+  slot->insize = (unsigned long)fread(slot->inbuffer, 1, length, infile);
+  if (slot->insize < length) {
+    fprintf(stderr, "%s: premature end of input stream\n", progname);
+    free(slot->inname);
+    slot->inname = NULL;
+    return FALSE;
+  }
+  return TRUE;
+}
+
+
+LOCAL(void)
+batch_put_uint32(FILE *outfile, unsigned long value)
+{
+  putc((int)((value >> 24) & 0xFF), outfile);
+  putc((int)((value >> 16) & 0xFF), outfile);
+  putc((int)((value >> 8) & 0xFF), outfile);
+  putc((int)(value & 0xFF), outfile);
+}
+
+
+/*
+ * Transcode all images listed in the manifest (-batch) or contained in the
+ * standard input stream (-stream).  For each image, a summary of the number
+ * of bytes saved is printed to stderr.  In stream mode, each output image is
+ * written to standard output using the same length-prefixed format as the
+ * input, and a length of 0 indicates that the image could not be transcoded.
+ */
+
+LOCAL(int)
+batch_transcode(int argc, char **argv, JOCTET *icc_profile, long icc_len)
+{
+  batch_job job;
+  FILE *infile = NULL, *outfile = NULL;
+  int i, num_slots = num_threads, num_busy;
+  unsigned long record_num = 0, num_files = 0, num_failed = 0;
+  unsigned long long total_in = 0, total_out = 0;
+  boolean warnings = FALSE, done = FALSE;
+
+  if (streammode) {
+    infile = read_stdin();
+    outfile = write_stdout();
+  } else if (strcmp(batchfilename, "-") == 0) {
+    infile = read_stdin();
+  } else if ((infile = fopen(batchfilename, "r")) == NULL) {
+    fprintf(stderr, "%s: can't open %s\n", progname, batchfilename);
+    exit(EXIT_FAILURE);
+  }
+
+  job.copyoption = copyoption;
+  job.xform = transformoption;
+  job.icc_profile = icc_profile;
+  job.icc_len = (unsigned int)icc_len;
+  job.slots = (batch_slot *)malloc(sizeof(batch_slot) * num_slots);
+  if (job.slots == NULL) {
+    fprintf(stderr, "%s: memory allocation failure\n", progname);
+    exit(EXIT_FAILURE);
+  }
+  for (i = 0; i < num_slots; i++)
+    batch_init_slot(&job.slots[i], argc, argv);
+
+  while (!done) {
+    /* Assign the next group of images to the slots. */
+    for (num_busy = 0; num_busy < num_slots; num_busy++) {
+      batch_slot *slot = &job.slots[num_busy];
+
+      slot->failed = FALSE;
+      slot->insize = slot->outsize = 0;
+      if (streammode ? !batch_next_record(infile, slot, record_num) :
+                       !batch_next_file(infile, slot)) {
+        done = TRUE;
+        break;
+      }
+      slot->busy = TRUE;
+      record_num++;
+    }
+    if (num_busy == 0)
+      break;
+
+    jthread_run(&job, batch_read_task, num_busy,
+                jthread_clamp_workers(num_threads, num_busy));
+    for (i = 0; i < num_busy; i++)
+      batch_setup(&job.slots[i], argc, argv);
+    jthread_run(&job, batch_write_task, num_busy,
+                jthread_clamp_workers(num_threads, num_busy));
+
+    /* Report the results in order. */
+    for (i = 0; i < num_busy; i++) {
+      batch_slot *slot = &job.slots[i];
+
+      num_files++;
+      if (slot->jsrcerr.pub.num_warnings + slot->jdsterr.pub.num_warnings)
+        warnings = TRUE;
+      if (slot->failed) {
+        num_failed++;
+        fprintf(stderr, "%s: %s: %s\n", progname, slot->inname,
+                slot->errmsg);
+        if (streammode)
+          batch_put_uint32(outfile, 0);
+      } else {
+        total_in += slot->insize;
+        total_out += slot->result_size;
+        fprintf(stderr, "%s: %lu -> %lu bytes (saved %ld)\n", slot->inname,
+                slot->insize, slot->result_size,
+                (long)slot->insize - (long)slot->result_size);
+        if (streammode) {
+          batch_put_uint32(outfile, slot->result_size);
+          (void)batch_write_result(slot, outfile);
+        }
+      }
+      batch_release_image(slot);
+    }
+    if (streammode) {
+      fflush(outfile);
+      if (ferror(outfile)) {
+        fprintf(stderr, "%s: can't write to stdout\n", progname);
+        exit(EXIT_FAILURE);
+      }
+    }
+  }
+
+  fprintf(stderr,
+          "%s: %lu files, %lu failed, %llu -> %llu bytes (saved %lld)\n",
+          progname, num_files, num_failed, total_in, total_out,
+          (long long)(total_in - total_out));
+
+  for (i = 0; i < num_slots; i++)
+    batch_destroy_slot(&job.slots[i]);
+  free(job.slots);
+  if (infile != stdin)
+    fclose(infile);
+
+  if (num_failed)
+    return EXIT_FAILURE;
+  return warnings ? EXIT_WARNING : EXIT_SUCCESS;
+}
+
+
 /*
  * The main program.
  */
@@ -505,8 +1191,6 @@ main(int argc, char **argv)
   FILE *fp;
   unsigned char *inbuffer = NULL;
   unsigned long insize = 0;
-  unsigned char *outbuffer = NULL;
-  unsigned long outsize = 0;
   FILE *icc_file;
   JOCTET *icc_profile = NULL;
   long icc_len = 0;
@@ -537,40 +1221,43 @@ main(int argc, char **argv)
   if (strict)
     jsrcerr.emit_message = my_emit_message;
 
-#ifdef TWO_FILE_COMMANDLINE
-  /* Must have either -outfile switch or explicit output file name */
-  if (outfilename == NULL) {
-    if (file_index != argc - 2) {
-      fprintf(stderr, "%s: must name one input and one output file\n",
-              progname);
+  if (batchfilename != NULL || streammode) {
+    /* All input and output file names come from the manifest or stream */
+    if (file_index < argc || outfilename != NULL || dropfilename != NULL ||
+        report || (batchfilename != NULL && streammode)) {
+      fprintf(stderr, "%s: -batch and -stream cannot be used with file names, -drop, -outfile,\n"
+              "-report, or each other\n", progname);
       usage();
     }
-    outfilename = argv[file_index + 1];
   } else {
-    if (file_index != argc - 1) {
-      fprintf(stderr, "%s: must name one input and one output file\n",
-              progname);
-      usage();
+    /* Outside of batch mode, the threads are used by the lossless transform
+     * and by the encoder.
+     */
+    jpeg_c_set_int_param(&dstinfo, JINT_NUM_THREADS, num_threads);
+
+#ifdef TWO_FILE_COMMANDLINE
+    /* Must have either -outfile switch or explicit output file name */
+    if (outfilename == NULL) {
+      if (file_index != argc - 2) {
+        fprintf(stderr, "%s: must name one input and one output file\n",
+                progname);
+        usage();
+      }
+      outfilename = argv[file_index + 1];
+    } else {
+      if (file_index != argc - 1) {
+        fprintf(stderr, "%s: must name one input and one output file\n",
+                progname);
+        usage();
+      }
     }
-  }
 #else
-  /* Unix style: expect zero or one file name */
-  if (file_index < argc - 1) {
-    fprintf(stderr, "%s: only one input file\n", progname);
-    usage();
-  }
-#endif /* TWO_FILE_COMMANDLINE */
-
-  /* Open the input file. */
-  if (file_index < argc) {
-    if ((fp = fopen(argv[file_index], READ_BINARY)) == NULL) {
-      fprintf(stderr, "%s: can't open %s for reading\n", progname,
-              argv[file_index]);
-      exit(EXIT_FAILURE);
+    /* Unix style: expect zero or one file name */
+    if (file_index < argc - 1) {
+      fprintf(stderr, "%s: only one input file\n", progname);
+      usage();
     }
-  } else {
-    /* default input file is stdin */
-    fp = read_stdin();
+#endif /* TWO_FILE_COMMANDLINE */
   }
 
   if (icc_filename != NULL) {
@@ -604,6 +1291,27 @@ main(int argc, char **argv)
       copyoption = JCOPYOPT_NONE;
   }
 
+  if (batchfilename != NULL || streammode) {
+    int status = batch_transcode(argc, argv, icc_profile, icc_len);
+
+    jpeg_destroy_compress(&dstinfo);
+    jpeg_destroy_decompress(&srcinfo);
+    free(icc_profile);
+    exit(status);
+  }
+
+  /* Open the input file. */
+  if (file_index < argc) {
+    if ((fp = fopen(argv[file_index], READ_BINARY)) == NULL) {
+      fprintf(stderr, "%s: can't open %s for reading\n", progname,
+              argv[file_index]);
+      exit(EXIT_FAILURE);
+    }
+  } else {
+    /* default input file is stdin */
+    fp = read_stdin();
+  }
+
   if (report) {
     start_progress_monitor((j_common_ptr)&dstinfo, &dst_progress);
     dst_progress.report = report;
@@ -740,7 +1448,7 @@ main(int argc, char **argv)
   if (jpeg_c_int_param_supported(&dstinfo, JINT_COMPRESS_PROFILE) &&
       jpeg_c_get_int_param(&dstinfo, JINT_COMPRESS_PROFILE)
         == JCP_MAX_COMPRESSION)
-    jpeg_mem_dest(&dstinfo, &outbuffer, &outsize);
+    jpeg_chain_dest(&dstinfo, 0);
   else
 #endif
   jpeg_stdio_dest(&dstinfo, fp);
@@ -767,16 +1475,23 @@ main(int argc, char **argv)
   if (jpeg_c_int_param_supported(&dstinfo, JINT_COMPRESS_PROFILE) &&
       jpeg_c_get_int_param(&dstinfo, JINT_COMPRESS_PROFILE)
         == JCP_MAX_COMPRESSION) {
-    size_t nbytes;
-    
-    unsigned char *buffer = outbuffer;
-    unsigned long size = outsize;
+    const jpeg_output_chunk *chunks;
+    int num_chunks, i;
+    size_t size = 0, nbytes = 0;
+
+    /* Write the compressed data straight from the destination's chunks, so
+     * it is never gathered into one contiguous buffer.
+     */
+    num_chunks = jpeg_get_output_chunks(&dstinfo, &chunks);
+    for (i = 0; i < num_chunks; i++)
+      size += chunks[i].size;
     if (prefer_smallest && insize < size) {
       size = insize;
-      buffer = inbuffer;
+      nbytes = fwrite(inbuffer, 1, size, fp);
+    } else {
+      for (i = 0; i < num_chunks; i++)
+        nbytes += fwrite(chunks[i].data, 1, chunks[i].size, fp);
     }
-
-    nbytes = fwrite(buffer, 1, size, fp);
     if (nbytes < size && ferror(fp)) {
       if (file_index < argc)
         fprintf(stderr, "%s: can't write to %s\n", progname,
@@ -812,7 +1527,6 @@ main(int argc, char **argv)
     end_progress_monitor((j_common_ptr)&srcinfo);
 
   free(inbuffer);
-  free(outbuffer);
 
   free(icc_profile);
 
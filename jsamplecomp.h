@@ -83,6 +83,19 @@
 #define _jcopy_sample_rows  j16copy_sample_rows
 #endif
 
+/* SIMD routines (jsimd.h) */
+#ifdef C_LOSSLESS_SUPPORTED
+#define _jsimd_can_difference  j16simd_can_difference
+#define _jsimd_difference  j16simd_difference
+#define _jsimd_can_downscale  j16simd_can_downscale
+#define _jsimd_downscale  j16simd_downscale
+#endif
+
+#ifdef D_LOSSLESS_SUPPORTED
+#define _jsimd_can_upscale  j16simd_can_upscale
+#define _jsimd_upscale  j16simd_upscale
+#endif
+
 /* Internal fields (cdjpeg.h) */
 
 #if defined(C_LOSSLESS_SUPPORTED) || defined(D_LOSSLESS_SUPPORTED)
@@ -155,6 +168,7 @@
 #define _jinit_c_main_controller  j12init_c_main_controller
 #define _jinit_c_prep_controller  j12init_c_prep_controller
 #define _jinit_c_coef_controller  j12init_c_coef_controller
+#define _jinit_c_coef_clone  j12init_c_coef_clone
 #define _jinit_color_converter  j12init_color_converter
 #define _jinit_downsampler  j12init_downsampler
 #define _jinit_forward_dct  j12init_forward_dct
@@ -202,6 +216,28 @@
 #define _jpeg_idct_15x15  jpeg12_idct_15x15
 #define _jpeg_idct_16x16  jpeg12_idct_16x16
 
+/* SIMD routines (jsimd.h, jsimddct.h) */
+#define _jsimd_can_rgb_ycc  j12simd_can_rgb_ycc
+#define _jsimd_rgb_ycc_convert  j12simd_rgb_ycc_convert
+#define _jsimd_can_ycc_rgb  j12simd_can_ycc_rgb
+#define _jsimd_ycc_rgb_convert  j12simd_ycc_rgb_convert
+#define _jsimd_can_h2v2_downsample  j12simd_can_h2v2_downsample
+#define _jsimd_can_h2v1_downsample  j12simd_can_h2v1_downsample
+#define _jsimd_h2v2_downsample  j12simd_h2v2_downsample
+#define _jsimd_h2v1_downsample  j12simd_h2v1_downsample
+#define _jsimd_can_h2v2_fancy_upsample  j12simd_can_h2v2_fancy_upsample
+#define _jsimd_can_h2v1_fancy_upsample  j12simd_can_h2v1_fancy_upsample
+#define _jsimd_h2v2_fancy_upsample  j12simd_h2v2_fancy_upsample
+#define _jsimd_h2v1_fancy_upsample  j12simd_h2v1_fancy_upsample
+#define _jsimd_can_idct_islow  j12simd_can_idct_islow
+#define _jsimd_idct_islow  j12simd_idct_islow
+#define _jsimd_can_difference  j12simd_can_difference
+#define _jsimd_difference  j12simd_difference
+#define _jsimd_can_downscale  j12simd_can_downscale
+#define _jsimd_downscale  j12simd_downscale
+#define _jsimd_can_upscale  j12simd_can_upscale
+#define _jsimd_upscale  j12simd_upscale
+
 /* Internal fields (cdjpeg.h) */
 
 /* Use the 12-bit buffer in the cjpeg_source_struct and djpeg_dest_struct
@@ -270,6 +306,7 @@
 #define _jinit_c_main_controller  jinit_c_main_controller
 #define _jinit_c_prep_controller  jinit_c_prep_controller
 #define _jinit_c_coef_controller  jinit_c_coef_controller
+#define _jinit_c_coef_clone  jinit_c_coef_clone
 #define _jinit_color_converter  jinit_color_converter
 #define _jinit_downsampler  jinit_downsampler
 #define _jinit_forward_dct  jinit_forward_dct
@@ -317,6 +354,28 @@
 #define _jpeg_idct_15x15  jpeg_idct_15x15
 #define _jpeg_idct_16x16  jpeg_idct_16x16
 
+/* SIMD routines (jsimd.h, jsimddct.h) */
+#define _jsimd_can_rgb_ycc  jsimd_can_rgb_ycc
+#define _jsimd_rgb_ycc_convert  jsimd_rgb_ycc_convert
+#define _jsimd_can_ycc_rgb  jsimd_can_ycc_rgb
+#define _jsimd_ycc_rgb_convert  jsimd_ycc_rgb_convert
+#define _jsimd_can_h2v2_downsample  jsimd_can_h2v2_downsample
+#define _jsimd_can_h2v1_downsample  jsimd_can_h2v1_downsample
+#define _jsimd_h2v2_downsample  jsimd_h2v2_downsample
+#define _jsimd_h2v1_downsample  jsimd_h2v1_downsample
+#define _jsimd_can_h2v2_fancy_upsample  jsimd_can_h2v2_fancy_upsample
+#define _jsimd_can_h2v1_fancy_upsample  jsimd_can_h2v1_fancy_upsample
+#define _jsimd_h2v2_fancy_upsample  jsimd_h2v2_fancy_upsample
+#define _jsimd_h2v1_fancy_upsample  jsimd_h2v1_fancy_upsample
+#define _jsimd_can_idct_islow  jsimd_can_idct_islow
+#define _jsimd_idct_islow  jsimd_idct_islow
+#define _jsimd_can_difference  jsimd_can_difference
+#define _jsimd_difference  jsimd_difference
+#define _jsimd_can_downscale  jsimd_can_downscale
+#define _jsimd_downscale  jsimd_downscale
+#define _jsimd_can_upscale  jsimd_can_upscale
+#define _jsimd_upscale  jsimd_upscale
+
 /* Internal fields (cdjpeg.h) */
 
 /* Use the 8-bit buffer in the cjpeg_source_struct and djpeg_dest_struct
@@ -124,4 +124,115 @@ EXTERN(int) jsimd_encode_mcu_AC_refine_prepare
   (const JCOEF *block, const int *jpeg_natural_order_start, int Sl, int Al,
    UJCOEF *absvalues, size_t *bits);
 
+EXTERN(int) jsimd_can_decode_mcu_AC_refine_prepare(void);
+
+EXTERN(size_t) jsimd_decode_mcu_AC_refine_prepare
+  (const JCOEF *block, const int *jpeg_natural_order_start, int Sl);
+
+EXTERN(int) jsimd_can_trellis_search(void);
+
+EXTERN(int) jsimd_trellis_search(const char *ehufsi, const int *runs,
+                                 const float *run_cost, int num_runs,
+                                 const float *candidate_dist,
+                                 int num_candidates);
+
 #endif /* WITH_SIMD */
+
+#if defined(WITH_SIMD) || defined(WITH_SIMD12)
+
+/* 12-bit versions of some of the above routines.  The precision-generic
+ * modules refer to these using the _jsimd_* names defined in jsamplecomp.h.
+ */
+
+EXTERN(int) j12simd_can_rgb_ycc(void);
+EXTERN(int) j12simd_can_ycc_rgb(void);
+
+EXTERN(void) j12simd_rgb_ycc_convert(j_compress_ptr cinfo,
+                                     J12SAMPARRAY input_buf,
+                                     J12SAMPIMAGE output_buf,
+                                     JDIMENSION output_row, int num_rows);
+EXTERN(void) j12simd_ycc_rgb_convert(j_decompress_ptr cinfo,
+                                     J12SAMPIMAGE input_buf,
+                                     JDIMENSION input_row,
+                                     J12SAMPARRAY output_buf, int num_rows);
+
+EXTERN(int) j12simd_can_h2v2_downsample(void);
+EXTERN(int) j12simd_can_h2v1_downsample(void);
+
+EXTERN(void) j12simd_h2v2_downsample(j_compress_ptr cinfo,
+                                     jpeg_component_info *compptr,
+                                     J12SAMPARRAY input_data,
+                                     J12SAMPARRAY output_data);
+EXTERN(void) j12simd_h2v1_downsample(j_compress_ptr cinfo,
+                                     jpeg_component_info *compptr,
+                                     J12SAMPARRAY input_data,
+                                     J12SAMPARRAY output_data);
+
+EXTERN(int) j12simd_can_h2v2_fancy_upsample(void);
+EXTERN(int) j12simd_can_h2v1_fancy_upsample(void);
+
+EXTERN(void) j12simd_h2v2_fancy_upsample(j_decompress_ptr cinfo,
+                                         jpeg_component_info *compptr,
+                                         J12SAMPARRAY input_data,
+                                         J12SAMPARRAY *output_data_ptr);
+EXTERN(void) j12simd_h2v1_fancy_upsample(j_decompress_ptr cinfo,
+                                         jpeg_component_info *compptr,
+                                         J12SAMPARRAY input_data,
+                                         J12SAMPARRAY *output_data_ptr);
+
+#endif /* defined(WITH_SIMD) || defined(WITH_SIMD12) */
+
+#if defined(WITH_SIMD) || defined(WITH_SIMD12) || defined(WITH_SIMD16)
+
+/* Lossless mode routines.  These have 8-bit, 12-bit, and 16-bit
+ * implementations, apart from the undifferencer, which operates only on
+ * JDIFF values and is therefore precision-independent.
+ */
+
+EXTERN(int) jsimd_can_difference(void);
+EXTERN(int) j12simd_can_difference(void);
+EXTERN(int) j16simd_can_difference(void);
+
+EXTERN(void) jsimd_difference(j_compress_ptr cinfo, JSAMPROW input_buf,
+                              JSAMPROW prev_row, JDIFFROW diff_buf,
+                              JDIMENSION width);
+EXTERN(void) j12simd_difference(j_compress_ptr cinfo, J12SAMPROW input_buf,
+                                J12SAMPROW prev_row, JDIFFROW diff_buf,
+                                JDIMENSION width);
+EXTERN(void) j16simd_difference(j_compress_ptr cinfo, J16SAMPROW input_buf,
+                                J16SAMPROW prev_row, JDIFFROW diff_buf,
+                                JDIMENSION width);
+
+EXTERN(int) jsimd_can_downscale(void);
+EXTERN(int) j12simd_can_downscale(void);
+EXTERN(int) j16simd_can_downscale(void);
+
+EXTERN(void) jsimd_downscale(j_compress_ptr cinfo, JSAMPROW input_buf,
+                             JSAMPROW output_buf, JDIMENSION width);
+EXTERN(void) j12simd_downscale(j_compress_ptr cinfo, J12SAMPROW input_buf,
+                               J12SAMPROW output_buf, JDIMENSION width);
+EXTERN(void) j16simd_downscale(j_compress_ptr cinfo, J16SAMPROW input_buf,
+                               J16SAMPROW output_buf, JDIMENSION width);
+
+/* The SIMD undifferencers support only predictors 1-5.  Predictors 6 and 7
+ * depend non-linearly on the reconstructed sample to the left, so they cannot
+ * be computed in parallel.
+ */
+EXTERN(int) jsimd_can_undifference(void);
+
+EXTERN(void) jsimd_undifference(j_decompress_ptr cinfo, int comp_index,
+                                JDIFFROW diff_buf, JDIFFROW prev_row,
+                                JDIFFROW undiff_buf, JDIMENSION width);
+
+EXTERN(int) jsimd_can_upscale(void);
+EXTERN(int) j12simd_can_upscale(void);
+EXTERN(int) j16simd_can_upscale(void);
+
+EXTERN(void) jsimd_upscale(j_decompress_ptr cinfo, JDIFFROW diff_buf,
+                           JSAMPROW output_buf, JDIMENSION width);
+EXTERN(void) j12simd_upscale(j_decompress_ptr cinfo, JDIFFROW diff_buf,
+                             J12SAMPROW output_buf, JDIMENSION width);
+EXTERN(void) j16simd_upscale(j_decompress_ptr cinfo, JDIFFROW diff_buf,
+                             J16SAMPROW output_buf, JDIMENSION width);
+
+#endif /* defined(WITH_SIMD) || defined(WITH_SIMD12) || defined(WITH_SIMD16) */
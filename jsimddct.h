@@ -33,6 +33,13 @@ EXTERN(void) jsimd_quantize(JCOEFPTR coef_block, DCTELEM *divisors,
 EXTERN(void) jsimd_quantize_float(JCOEFPTR coef_block, FAST_FLOAT *divisors,
                                   FAST_FLOAT *workspace);
 
+EXTERN(int) jsimd_can_preprocess_deringing(void);
+EXTERN(int) jsimd_can_preprocess_deringing_float(void);
+
+EXTERN(int) jsimd_preprocess_deringing(const DCTELEM *data, int *sum);
+EXTERN(int) jsimd_preprocess_deringing_float(const FAST_FLOAT *data,
+                                             FAST_FLOAT *sum);
+
 EXTERN(int) jsimd_can_idct_2x2(void);
 EXTERN(int) jsimd_can_idct_4x4(void);
 EXTERN(int) jsimd_can_idct_6x6(void);
@@ -68,3 +75,11 @@ EXTERN(void) jsimd_idct_float(j_decompress_ptr cinfo,
                               jpeg_component_info *compptr,
                               JCOEFPTR coef_block, JSAMPARRAY output_buf,
                               JDIMENSION output_col);
+
+/* 12-bit version of jsimd_idct_islow() (see jsimd.h) */
+EXTERN(int) j12simd_can_idct_islow(void);
+
+EXTERN(void) j12simd_idct_islow(j_decompress_ptr cinfo,
+                                jpeg_component_info *compptr,
+                                JCOEFPTR coef_block, J12SAMPARRAY output_buf,
+                                JDIMENSION output_col);
@@ -0,0 +1,209 @@
+/*
+ * jthread.c
+ *
+ * Copyright (C) 2026, Mozilla Corporation.
+ * For conditions of distribution and use, see the accompanying README.ijg
+ * file.
+ *
+ * This file contains the minimal fork/join threading facility used by the
+ * multi-threaded encoding and decoding paths.  See jthread.h for the
+ * interface contract.
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+#include "jthread.h"
+
+#ifdef WITH_THREADS
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#endif
+
+
+typedef struct {
+  void *job;                    /* opaque job descriptor */
+  jthread_task_ptr task_func;   /* function to run for each task */
+  int num_tasks;                /* total # of tasks in the job */
+  int next_task;                /* index of next task to hand out */
+  boolean use_lock;             /* TRUE if more than one thread is running */
+#ifdef WITH_THREADS
+#ifdef _WIN32
+  CRITICAL_SECTION lock;
+#else
+  pthread_mutex_t lock;
+#endif
+#endif
+} jthread_job;
+
+typedef struct {
+  jthread_job *job;
+  int worker;                   /* index passed to the task function */
+#ifdef WITH_THREADS
+#ifdef _WIN32
+  HANDLE handle;
+#else
+  pthread_t handle;
+#endif
+#endif
+} jthread_worker;
+
+
+/*
+ * Fetch the next unclaimed task index, or -1 if there are no more tasks.
+ */
+
+LOCAL(int)
+next_task(jthread_job *job)
+{
+  int task;
+
+#ifdef WITH_THREADS
+  if (job->use_lock)
+#ifdef _WIN32
+    EnterCriticalSection(&job->lock);
+#else
+    pthread_mutex_lock(&job->lock);
+#endif
+#endif
+  task = job->next_task;
+  if (task < job->num_tasks)
+    job->next_task++;
+  else
+    task = -1;
+#ifdef WITH_THREADS
+  if (job->use_lock)
+#ifdef _WIN32
+    LeaveCriticalSection(&job->lock);
+#else
+    pthread_mutex_unlock(&job->lock);
+#endif
+#endif
+  return task;
+}
+
+
+LOCAL(void)
+worker_loop(jthread_worker *worker)
+{
+  jthread_job *job = worker->job;
+  int task;
+
+  while ((task = next_task(job)) >= 0)
+    (*job->task_func) (job->job, task, worker->worker);
+}
+
+
+#ifdef WITH_THREADS
+#ifdef _WIN32
+static DWORD WINAPI
+worker_thread(LPVOID arg)
+{
+  worker_loop((jthread_worker *)arg);
+  return 0;
+}
+#else
+static void *
+worker_thread(void *arg)
+{
+  worker_loop((jthread_worker *)arg);
+  return NULL;
+}
+#endif
+#endif
+
+
+GLOBAL(int)
+jthread_clamp_workers(int num_workers, int num_tasks)
+{
+#ifndef WITH_THREADS
+  num_workers = 1;
+#endif
+  if (num_workers > num_tasks)
+    num_workers = num_tasks;
+  if (num_workers > JTHREAD_MAX_WORKERS)
+    num_workers = JTHREAD_MAX_WORKERS;
+  if (num_workers < 1)
+    num_workers = 1;
+  return num_workers;
+}
+
+
+GLOBAL(int)
+jthread_run(void *job, jthread_task_ptr task_func, int num_tasks,
+            int num_workers)
+{
+  jthread_job shared;
+  jthread_worker workers[JTHREAD_MAX_WORKERS];
+  int i, started = 1;
+
+  if (num_tasks <= 0)
+    return 0;
+  num_workers = jthread_clamp_workers(num_workers, num_tasks);
+
+  shared.job = job;
+  shared.task_func = task_func;
+  shared.num_tasks = num_tasks;
+  shared.next_task = 0;
+  shared.use_lock = FALSE;
+  for (i = 0; i < num_workers; i++) {
+    workers[i].job = &shared;
+    workers[i].worker = i;
+  }
+
+#ifdef WITH_THREADS
+  if (num_workers > 1) {
+#ifdef _WIN32
+    InitializeCriticalSection(&shared.lock);
+    shared.use_lock = TRUE;
+#else
+    if (pthread_mutex_init(&shared.lock, NULL) == 0)
+      shared.use_lock = TRUE;
+    else
+      num_workers = 1;
+#endif
+  }
+
+  /* If a thread can't be created, then the remaining workers' share of the
+   * job is simply absorbed by the threads that did start.
+   */
+  for (; started < num_workers; started++) {
+#ifdef _WIN32
+    workers[started].handle = CreateThread(NULL, 0, worker_thread,
+                                           &workers[started], 0, NULL);
+    if (workers[started].handle == NULL)
+      break;
+#else
+    if (pthread_create(&workers[started].handle, NULL, worker_thread,
+                       &workers[started]) != 0)
+      break;
+#endif
+  }
+#endif
+
+  worker_loop(&workers[0]);
+
+#ifdef WITH_THREADS
+  for (i = 1; i < started; i++) {
+#ifdef _WIN32
+    WaitForSingleObject(workers[i].handle, INFINITE);
+    CloseHandle(workers[i].handle);
+#else
+    pthread_join(workers[i].handle, NULL);
+#endif
+  }
+
+  if (shared.use_lock) {
+#ifdef _WIN32
+    DeleteCriticalSection(&shared.lock);
+#else
+    pthread_mutex_destroy(&shared.lock);
+#endif
+  }
+#endif
+
+  return started;
+}
@@ -0,0 +1,37 @@
+/*
+ * jthread.h
+ *
+ * Copyright (C) 2026, Mozilla Corporation.
+ * For conditions of distribution and use, see the accompanying README.ijg
+ * file.
+ *
+ * This file contains declarations for the minimal fork/join threading
+ * facility used by the multi-threaded encoding and decoding paths.  A job is
+ * split into a fixed number of independent tasks, which are then handed out
+ * dynamically to a set of worker threads.  The calling thread always acts as
+ * worker 0, and jthread_run() does not return until every task is complete.
+ *
+ * Task functions run concurrently and must therefore never call ERREXIT() or
+ * any other routine that might longjmp() out of the library using the shared
+ * error manager.  All memory needed by a task should be allocated by the
+ * calling thread beforehand, typically as one scratch area per worker.
+ *
+ * If the library was built without thread support, or if the system refuses
+ * to create additional threads, then all tasks are executed serially by the
+ * calling thread.  The results are identical either way.
+ */
+
+/* Upper limit on the number of workers used by any parallel job */
+#define JTHREAD_MAX_WORKERS  64
+
+typedef void (*jthread_task_ptr) (void *job, int task, int worker);
+
+/* Run tasks 0..num_tasks-1 of job on up to num_workers threads.  Returns the
+ * number of workers actually used (which is also the number of distinct
+ * worker indices passed to the task function.)
+ */
+EXTERN(int) jthread_run(void *job, jthread_task_ptr task_func, int num_tasks,
+                        int num_workers);
+
+/* Clamp a requested thread count to the range supported by jthread_run(). */
+EXTERN(int) jthread_clamp_workers(int num_workers, int num_tasks);
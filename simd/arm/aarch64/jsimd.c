@@ -32,6 +32,8 @@
 
 static THREAD_LOCAL unsigned int simd_support = ~0;
 static THREAD_LOCAL unsigned int simd_huffman = 1;
+static THREAD_LOCAL unsigned int simd_trellis = 1;
+static THREAD_LOCAL unsigned int simd_dering = 1;
 static THREAD_LOCAL unsigned int simd_features = JSIMD_FASTLD3 |
                                                  JSIMD_FASTST3 | JSIMD_FASTTBL;
 
@@ -152,6 +154,10 @@ init_simd(void)
     simd_support = 0;
   if (!GETENV_S(env, 2, "JSIMD_NOHUFFENC") && !strcmp(env, "1"))
     simd_huffman = 0;
+  if (!GETENV_S(env, 2, "JSIMD_NOTRELLIS") && !strcmp(env, "1"))
+    simd_trellis = 0;
+  if (!GETENV_S(env, 2, "JSIMD_NODERINGING") && !strcmp(env, "1"))
+    simd_dering = 0;
   if (!GETENV_S(env, 2, "JSIMD_FASTLD3") && !strcmp(env, "1"))
     simd_features |= JSIMD_FASTLD3;
   if (!GETENV_S(env, 2, "JSIMD_FASTLD3") && !strcmp(env, "0"))
@@ -827,6 +833,56 @@ jsimd_quantize_float(JCOEFPTR coef_block, FAST_FLOAT *divisors,
 {
 }
 
+GLOBAL(int)
+jsimd_can_preprocess_deringing(void)
+{
+  init_simd();
+
+  /* The code is optimised for these values only */
+  if (DCTSIZE != 8)
+    return 0;
+  if (sizeof(DCTELEM) != 2)
+    return 0;
+  if (!simd_dering)
+    return 0;
+
+  if (simd_support & JSIMD_NEON)
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(int)
+jsimd_can_preprocess_deringing_float(void)
+{
+  init_simd();
+
+  /* The code is optimised for these values only */
+  if (DCTSIZE != 8)
+    return 0;
+  if (sizeof(FAST_FLOAT) != 4)
+    return 0;
+  if (!simd_dering)
+    return 0;
+
+  if (simd_support & JSIMD_NEON)
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(int)
+jsimd_preprocess_deringing(const DCTELEM *data, int *sum)
+{
+  return jsimd_preprocess_deringing_neon(data, sum);
+}
+
+GLOBAL(int)
+jsimd_preprocess_deringing_float(const FAST_FLOAT *data, FAST_FLOAT *sum)
+{
+  return jsimd_preprocess_deringing_float_neon(data, sum);
+}
+
 GLOBAL(int)
 jsimd_can_idct_2x2(void)
 {
@@ -1055,3 +1111,259 @@ jsimd_encode_mcu_AC_refine_prepare(const JCOEF *block,
                                                  jpeg_natural_order_start,
                                                  Sl, Al, absvalues, bits);
 }
+
+GLOBAL(int)
+jsimd_can_decode_mcu_AC_refine_prepare(void)
+{
+  return 0;
+}
+
+GLOBAL(size_t)
+jsimd_decode_mcu_AC_refine_prepare(const JCOEF *block,
+                                   const int *jpeg_natural_order_start, int Sl)
+{
+  return 0;
+}
+
+GLOBAL(int)
+jsimd_can_trellis_search(void)
+{
+  init_simd();
+
+  if (BITS_IN_JSAMPLE != 8)
+    return 0;
+  if (sizeof(float) != 4)
+    return 0;
+
+  if ((simd_support & JSIMD_NEON) && simd_trellis)
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(int)
+jsimd_trellis_search(const char *ehufsi, const int *runs,
+                     const float *run_cost, int num_runs,
+                     const float *candidate_dist, int num_candidates)
+{
+  return jsimd_trellis_search_neon(ehufsi, runs, run_cost, num_runs,
+                                   candidate_dist, num_candidates);
+}
+
+/*
+ * 12-bit routines (see jsamplecomp.h).  There are no 12-bit implementations
+ * for this architecture.
+ */
+
+GLOBAL(int)
+j12simd_can_rgb_ycc(void)
+{
+  return 0;
+}
+
+GLOBAL(int)
+j12simd_can_ycc_rgb(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+j12simd_rgb_ycc_convert(j_compress_ptr cinfo, J12SAMPARRAY input_buf,
+                        J12SAMPIMAGE output_buf, JDIMENSION output_row,
+                        int num_rows)
+{
+}
+
+GLOBAL(void)
+j12simd_ycc_rgb_convert(j_decompress_ptr cinfo, J12SAMPIMAGE input_buf,
+                        JDIMENSION input_row, J12SAMPARRAY output_buf,
+                        int num_rows)
+{
+}
+
+GLOBAL(int)
+j12simd_can_h2v2_downsample(void)
+{
+  return 0;
+}
+
+GLOBAL(int)
+j12simd_can_h2v1_downsample(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+j12simd_h2v2_downsample(j_compress_ptr cinfo, jpeg_component_info *compptr,
+                        J12SAMPARRAY input_data, J12SAMPARRAY output_data)
+{
+}
+
+GLOBAL(void)
+j12simd_h2v1_downsample(j_compress_ptr cinfo, jpeg_component_info *compptr,
+                        J12SAMPARRAY input_data, J12SAMPARRAY output_data)
+{
+}
+
+GLOBAL(int)
+j12simd_can_h2v2_fancy_upsample(void)
+{
+  return 0;
+}
+
+GLOBAL(int)
+j12simd_can_h2v1_fancy_upsample(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+j12simd_h2v2_fancy_upsample(j_decompress_ptr cinfo,
+                            jpeg_component_info *compptr,
+                            J12SAMPARRAY input_data,
+                            J12SAMPARRAY *output_data_ptr)
+{
+}
+
+GLOBAL(void)
+j12simd_h2v1_fancy_upsample(j_decompress_ptr cinfo,
+                            jpeg_component_info *compptr,
+                            J12SAMPARRAY input_data,
+                            J12SAMPARRAY *output_data_ptr)
+{
+}
+
+GLOBAL(int)
+j12simd_can_idct_islow(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+j12simd_idct_islow(j_decompress_ptr cinfo, jpeg_component_info *compptr,
+                   JCOEFPTR coef_block, J12SAMPARRAY output_buf,
+                   JDIMENSION output_col)
+{
+}
+
+/* Lossless mode routines */
+
+GLOBAL(int)
+jsimd_can_difference(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+jsimd_difference(j_compress_ptr cinfo, JSAMPROW input_buf,
+                 JSAMPROW prev_row, JDIFFROW diff_buf, JDIMENSION width)
+{
+}
+
+GLOBAL(int)
+j12simd_can_difference(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+j12simd_difference(j_compress_ptr cinfo, J12SAMPROW input_buf,
+                   J12SAMPROW prev_row, JDIFFROW diff_buf, JDIMENSION width)
+{
+}
+
+GLOBAL(int)
+j16simd_can_difference(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+j16simd_difference(j_compress_ptr cinfo, J16SAMPROW input_buf,
+                   J16SAMPROW prev_row, JDIFFROW diff_buf, JDIMENSION width)
+{
+}
+
+GLOBAL(int)
+jsimd_can_downscale(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+jsimd_downscale(j_compress_ptr cinfo, JSAMPROW input_buf,
+                JSAMPROW output_buf, JDIMENSION width)
+{
+}
+
+GLOBAL(int)
+j12simd_can_downscale(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+j12simd_downscale(j_compress_ptr cinfo, J12SAMPROW input_buf,
+                  J12SAMPROW output_buf, JDIMENSION width)
+{
+}
+
+GLOBAL(int)
+j16simd_can_downscale(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+j16simd_downscale(j_compress_ptr cinfo, J16SAMPROW input_buf,
+                  J16SAMPROW output_buf, JDIMENSION width)
+{
+}
+
+GLOBAL(int)
+jsimd_can_undifference(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+jsimd_undifference(j_decompress_ptr cinfo, int comp_index, JDIFFROW diff_buf,
+                   JDIFFROW prev_row, JDIFFROW undiff_buf, JDIMENSION width)
+{
+}
+
+GLOBAL(int)
+jsimd_can_upscale(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+jsimd_upscale(j_decompress_ptr cinfo, JDIFFROW diff_buf,
+              JSAMPROW output_buf, JDIMENSION width)
+{
+}
+
+GLOBAL(int)
+j12simd_can_upscale(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+j12simd_upscale(j_decompress_ptr cinfo, JDIFFROW diff_buf,
+                J12SAMPROW output_buf, JDIMENSION width)
+{
+}
+
+GLOBAL(int)
+j16simd_can_upscale(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+j16simd_upscale(j_decompress_ptr cinfo, JDIFFROW diff_buf,
+                J16SAMPROW output_buf, JDIMENSION width)
+{
+}
@@ -0,0 +1,105 @@
+/*
+ * jcdering-neon.c - overshoot deringing block analysis (Arm Neon)
+ *
+ * Copyright (C) 2026, Mozilla Corporation.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#define JPEG_INTERNALS
+#include "../../jinclude.h"
+#include "../../jpeglib.h"
+#include "../../jsimd.h"
+#include "../../jdct.h"
+#include "../../jsimddct.h"
+#include "../jsimd.h"
+
+#include <arm_neon.h>
+
+
+/* Count the samples in a block that are >= 127 (the maximum value after the
+ * unsigned->signed conversion) and sum all of the samples.  This is the part
+ * of overshoot deringing that runs for every block.
+ *
+ * Each 16-bit lane sums at most 8 samples, so the partial sums cannot
+ * overflow.
+ *
+ * The equivalent scalar C function preprocess_deringing() can be found in
+ * jcdctmgr.c.
+ */
+
+int jsimd_preprocess_deringing_neon(const DCTELEM *data, int *sum)
+{
+  const int16x8_t maxsample = vdupq_n_s16(127);
+  int16x8_t sum_acc = vdupq_n_s16(0);
+  uint16x8_t count_acc = vdupq_n_u16(0);
+  int32x4_t sum32;
+  uint32x4_t count32;
+  int64x2_t sum64;
+  uint64x2_t count64;
+  int i;
+
+  for (i = 0; i < DCTSIZE; i++) {
+    int16x8_t row = vld1q_s16(data + i * DCTSIZE);
+
+    sum_acc = vaddq_s16(sum_acc, row);
+    /* The comparison yields 0xFFFF for each maximum-valued sample. */
+    count_acc = vsubq_u16(count_acc, vcgeq_s16(row, maxsample));
+  }
+
+  sum32 = vpaddlq_s16(sum_acc);
+  count32 = vpaddlq_u16(count_acc);
+  sum64 = vpaddlq_s32(sum32);
+  count64 = vpaddlq_u32(count32);
+
+  *sum = (int)(vgetq_lane_s64(sum64, 0) + vgetq_lane_s64(sum64, 1));
+  return (int)(vgetq_lane_u64(count64, 0) + vgetq_lane_u64(count64, 1));
+}
+
+
+/* Float version of the above.  The samples are whole numbers, so their sum is
+ * exact regardless of the order of the additions.
+ *
+ * The equivalent scalar C function float_preprocess_deringing() can be found
+ * in jcdctmgr.c.
+ */
+
+int jsimd_preprocess_deringing_float_neon(const FAST_FLOAT *data,
+                                          FAST_FLOAT *sum)
+{
+  const float32x4_t maxsample = vdupq_n_f32(127.0f);
+  float32x4_t sum_acc = vdupq_n_f32(0.0f);
+  uint32x4_t count_acc = vdupq_n_u32(0);
+  float32x2_t sum2;
+  uint64x2_t count64;
+  int i;
+
+  for (i = 0; i < DCTSIZE2; i += 4) {
+    float32x4_t samples = vld1q_f32(data + i);
+
+    sum_acc = vaddq_f32(sum_acc, samples);
+    /* The comparison yields 0xFFFFFFFF for each maximum-valued sample. */
+    count_acc = vsubq_u32(count_acc, vcgeq_f32(samples, maxsample));
+  }
+
+  sum2 = vadd_f32(vget_low_f32(sum_acc), vget_high_f32(sum_acc));
+  sum2 = vpadd_f32(sum2, sum2);
+  count64 = vpaddlq_u32(count_acc);
+
+  *sum = vget_lane_f32(sum2, 0);
+  return (int)(vgetq_lane_u64(count64, 0) + vgetq_lane_u64(count64, 1));
+}
@@ -0,0 +1,127 @@
+/*
+ * jctrellis-neon.c - trellis quantization rate/distortion search (Arm Neon)
+ *
+ * Copyright (C) 2026, Mozilla Corporation.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#define JPEG_INTERNALS
+#include "../../jinclude.h"
+#include "../../jpeglib.h"
+#include "../../jsimd.h"
+#include "../jsimd.h"
+#include "align.h"
+#include "neon-compat.h"
+
+#include <arm_neon.h>
+
+
+/* Find the cheapest (run start, candidate value) combination for one AC
+ * coefficient during Huffman trellis quantization.
+ *
+ * Candidate k is evaluated in lane k % 4 of vector k / 4, and each lane keeps
+ * the cheapest run start for its candidate.  The costs are computed with the
+ * same single-precision operations as in the C implementation, and each lane
+ * only moves to a later run start if that is strictly cheaper, so a scalar
+ * reduction over the lanes that prefers the lowest run start and then the
+ * lowest candidate yields exactly the result of the C implementation.  (This
+ * relies on IEEE-754 arithmetic, so it is only used with AArch64.)
+ *
+ * At most 12 candidates are supported, which is more than the 10 that can
+ * occur with 8-bit data precision.  candidate_dist must be readable for 12
+ * entries.
+ *
+ * The equivalent scalar C function trellis_search() can be found in
+ * jcdctmgr.c.
+ */
+
+ALIGN(16) static const int32_t jsimd_trellis_candidate_bits[12] = {
+  1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12
+};
+
+int jsimd_trellis_search_neon(const char *ehufsi, const int *runs,
+                              const float *run_cost, int num_runs,
+                              const float *candidate_dist, int num_candidates)
+{
+  const int num_vectors = (num_candidates > 8) ? 3 : 2;
+  float32x4_t best_cost[3], dist[3];
+  int32x4_t best_run[3], candidate_bits[3];
+  float lane_cost[12];
+  int32_t lane_run[12];
+  float best = 1e38f;
+  int best_r = -1, result = -1;
+  int r, k, v;
+
+  for (v = 0; v < 3; v++) {
+    best_cost[v] = vdupq_n_f32(1e38f);
+    best_run[v] = vdupq_n_s32(-1);
+    dist[v] = vld1q_f32(candidate_dist + 4 * v);
+    candidate_bits[v] = vld1q_s32(jsimd_trellis_candidate_bits + 4 * v);
+  }
+
+  for (r = 0; r < num_runs; r++) {
+    const uint8_t *ptr = (const uint8_t *)ehufsi + runs[2 * r] + 1;
+    const int32x4_t zrl_bits = vdupq_n_s32(runs[2 * r + 1]);
+    const float32x4_t cost_before = vdupq_n_f32(run_cost[r]);
+    const int32x4_t run = vdupq_n_s32(r);
+    uint16x8_t bits_u16 = vmovl_u8(vld1_u8(ptr));
+    int32x4_t coef_bits[3];
+    uint32_t bits_8_11;
+
+    coef_bits[0] = vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(bits_u16)));
+    coef_bits[1] = vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(bits_u16)));
+    if (num_vectors > 2) {
+      /* Load only 4 bytes, so as not to read past the end of ehufsi[] */
+      memcpy(&bits_8_11, ptr + 8, sizeof(bits_8_11));
+      bits_u16 = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(bits_8_11)));
+      coef_bits[2] = vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(bits_u16)));
+    }
+
+    for (v = 0; v < num_vectors; v++) {
+      int32x4_t rate = vaddq_s32(vaddq_s32(coef_bits[v], candidate_bits[v]),
+                                 zrl_bits);
+      float32x4_t cost = vaddq_f32(vcvtq_f32_s32(rate), dist[v]);
+      uint32x4_t update;
+
+      cost = vaddq_f32(cost, cost_before);
+      /* Only update lanes whose code exists and that are strictly cheaper */
+      update = vandq_u32(vcltq_f32(cost, best_cost[v]),
+                         vtstq_s32(coef_bits[v], coef_bits[v]));
+      best_cost[v] = vbslq_f32(update, cost, best_cost[v]);
+      best_run[v] = vbslq_s32(update, run, best_run[v]);
+    }
+  }
+
+  for (v = 0; v < num_vectors; v++) {
+    vst1q_f32(lane_cost + 4 * v, best_cost[v]);
+    vst1q_s32(lane_run + 4 * v, best_run[v]);
+  }
+
+  for (k = 0; k < num_candidates; k++) {
+    if (lane_run[k] < 0)
+      continue;
+    if (lane_cost[k] < best ||
+        (lane_cost[k] == best && lane_run[k] < best_r)) {
+      best = lane_cost[k];
+      best_r = lane_run[k];
+      result = (best_r << 4) + k;
+    }
+  }
+
+  return result;
+}
@@ -100,6 +100,29 @@ EXTERN(void) jsimd_extxrgb_ycc_convert_avx2
   (JDIMENSION img_width, JSAMPARRAY input_buf, JSAMPIMAGE output_buf,
    JDIMENSION output_row, int num_rows);
 
+extern const int j12const_rgb_ycc_convert_avx2[];
+EXTERN(void) j12simd_rgb_ycc_convert_avx2
+  (JDIMENSION img_width, J12SAMPARRAY input_buf, J12SAMPIMAGE output_buf,
+   JDIMENSION output_row, int num_rows);
+EXTERN(void) j12simd_extrgb_ycc_convert_avx2
+  (JDIMENSION img_width, J12SAMPARRAY input_buf, J12SAMPIMAGE output_buf,
+   JDIMENSION output_row, int num_rows);
+EXTERN(void) j12simd_extrgbx_ycc_convert_avx2
+  (JDIMENSION img_width, J12SAMPARRAY input_buf, J12SAMPIMAGE output_buf,
+   JDIMENSION output_row, int num_rows);
+EXTERN(void) j12simd_extbgr_ycc_convert_avx2
+  (JDIMENSION img_width, J12SAMPARRAY input_buf, J12SAMPIMAGE output_buf,
+   JDIMENSION output_row, int num_rows);
+EXTERN(void) j12simd_extbgrx_ycc_convert_avx2
+  (JDIMENSION img_width, J12SAMPARRAY input_buf, J12SAMPIMAGE output_buf,
+   JDIMENSION output_row, int num_rows);
+EXTERN(void) j12simd_extxbgr_ycc_convert_avx2
+  (JDIMENSION img_width, J12SAMPARRAY input_buf, J12SAMPIMAGE output_buf,
+   JDIMENSION output_row, int num_rows);
+EXTERN(void) j12simd_extxrgb_ycc_convert_avx2
+  (JDIMENSION img_width, J12SAMPARRAY input_buf, J12SAMPIMAGE output_buf,
+   JDIMENSION output_row, int num_rows);
+
 EXTERN(void) jsimd_rgb_ycc_convert_neon
   (JDIMENSION img_width, JSAMPARRAY input_buf, JSAMPIMAGE output_buf,
    JDIMENSION output_row, int num_rows);
@@ -425,6 +448,29 @@ EXTERN(void) jsimd_ycc_extxrgb_convert_avx2
   (JDIMENSION out_width, JSAMPIMAGE input_buf, JDIMENSION input_row,
    JSAMPARRAY output_buf, int num_rows);
 
+extern const int j12const_ycc_rgb_convert_avx2[];
+EXTERN(void) j12simd_ycc_rgb_convert_avx2
+  (JDIMENSION out_width, J12SAMPIMAGE input_buf, JDIMENSION input_row,
+   J12SAMPARRAY output_buf, int num_rows);
+EXTERN(void) j12simd_ycc_extrgb_convert_avx2
+  (JDIMENSION out_width, J12SAMPIMAGE input_buf, JDIMENSION input_row,
+   J12SAMPARRAY output_buf, int num_rows);
+EXTERN(void) j12simd_ycc_extrgbx_convert_avx2
+  (JDIMENSION out_width, J12SAMPIMAGE input_buf, JDIMENSION input_row,
+   J12SAMPARRAY output_buf, int num_rows);
+EXTERN(void) j12simd_ycc_extbgr_convert_avx2
+  (JDIMENSION out_width, J12SAMPIMAGE input_buf, JDIMENSION input_row,
+   J12SAMPARRAY output_buf, int num_rows);
+EXTERN(void) j12simd_ycc_extbgrx_convert_avx2
+  (JDIMENSION out_width, J12SAMPIMAGE input_buf, JDIMENSION input_row,
+   J12SAMPARRAY output_buf, int num_rows);
+EXTERN(void) j12simd_ycc_extxbgr_convert_avx2
+  (JDIMENSION out_width, J12SAMPIMAGE input_buf, JDIMENSION input_row,
+   J12SAMPARRAY output_buf, int num_rows);
+EXTERN(void) j12simd_ycc_extxrgb_convert_avx2
+  (JDIMENSION out_width, J12SAMPIMAGE input_buf, JDIMENSION input_row,
+   J12SAMPARRAY output_buf, int num_rows);
+
 EXTERN(void) jsimd_ycc_rgb_convert_neon
   (JDIMENSION out_width, JSAMPIMAGE input_buf, JDIMENSION input_row,
    JSAMPARRAY output_buf, int num_rows);
@@ -544,6 +590,9 @@ EXTERN(void) jsimd_h2v1_downsample_sse2
 EXTERN(void) jsimd_h2v1_downsample_avx2
   (JDIMENSION image_width, int max_v_samp_factor, JDIMENSION v_samp_factor,
    JDIMENSION width_in_blocks, JSAMPARRAY input_data, JSAMPARRAY output_data);
+EXTERN(void) j12simd_h2v1_downsample_avx2
+  (JDIMENSION image_width, int max_v_samp_factor, JDIMENSION v_samp_factor,
+   JDIMENSION output_cols, J12SAMPARRAY input_data, J12SAMPARRAY output_data);
 
 EXTERN(void) jsimd_h2v1_downsample_neon
   (JDIMENSION image_width, int max_v_samp_factor, JDIMENSION v_samp_factor,
@@ -569,6 +618,9 @@ EXTERN(void) jsimd_h2v2_downsample_sse2
 EXTERN(void) jsimd_h2v2_downsample_avx2
   (JDIMENSION image_width, int max_v_samp_factor, JDIMENSION v_samp_factor,
    JDIMENSION width_in_blocks, JSAMPARRAY input_data, JSAMPARRAY output_data);
+EXTERN(void) j12simd_h2v2_downsample_avx2
+  (JDIMENSION image_width, int max_v_samp_factor, JDIMENSION v_samp_factor,
+   JDIMENSION output_cols, J12SAMPARRAY input_data, J12SAMPARRAY output_data);
 
 EXTERN(void) jsimd_h2v2_downsample_neon
   (JDIMENSION image_width, int max_v_samp_factor, JDIMENSION v_samp_factor,
@@ -665,6 +717,14 @@ EXTERN(void) jsimd_h2v2_fancy_upsample_avx2
   (int max_v_samp_factor, JDIMENSION downsampled_width, JSAMPARRAY input_data,
    JSAMPARRAY *output_data_ptr);
 
+extern const int j12const_fancy_upsample_avx2[];
+EXTERN(void) j12simd_h2v1_fancy_upsample_avx2
+  (int max_v_samp_factor, JDIMENSION downsampled_width,
+   J12SAMPARRAY input_data, J12SAMPARRAY *output_data_ptr);
+EXTERN(void) j12simd_h2v2_fancy_upsample_avx2
+  (int max_v_samp_factor, JDIMENSION downsampled_width,
+   J12SAMPARRAY input_data, J12SAMPARRAY *output_data_ptr);
+
 EXTERN(void) jsimd_h2v1_fancy_upsample_neon
   (int max_v_samp_factor, JDIMENSION downsampled_width, JSAMPARRAY input_data,
    JSAMPARRAY *output_data_ptr);
@@ -1111,6 +1171,19 @@ EXTERN(void) jsimd_quantize_float_sse2
 EXTERN(void) jsimd_quantize_float_dspr2
   (JCOEFPTR coef_block, FAST_FLOAT *divisors, FAST_FLOAT *workspace);
 
+/* Overshoot Deringing */
+EXTERN(int) jsimd_preprocess_deringing_sse2(const DCTELEM *data, int *sum);
+
+EXTERN(int) jsimd_preprocess_deringing_avx2(const DCTELEM *data, int *sum);
+
+EXTERN(int) jsimd_preprocess_deringing_neon(const DCTELEM *data, int *sum);
+
+EXTERN(int) jsimd_preprocess_deringing_float_sse2
+  (const FAST_FLOAT *data, FAST_FLOAT *sum);
+
+EXTERN(int) jsimd_preprocess_deringing_float_neon
+  (const FAST_FLOAT *data, FAST_FLOAT *sum);
+
 /* Scaled Inverse DCT */
 EXTERN(void) jsimd_idct_2x2_mmx
   (void *dct_table, JCOEFPTR coef_block, JSAMPARRAY output_buf,
@@ -1163,6 +1236,11 @@ EXTERN(void) jsimd_idct_islow_avx2
   (void *dct_table, JCOEFPTR coef_block, JSAMPARRAY output_buf,
    JDIMENSION output_col);
 
+extern const int j12const_idct_islow_avx2[];
+EXTERN(void) j12simd_idct_islow_avx2
+  (void *dct_table, JCOEFPTR coef_block, J12SAMPARRAY output_buf,
+   JDIMENSION output_col);
+
 EXTERN(void) jsimd_idct_islow_neon
   (void *dct_table, JCOEFPTR coef_block, JSAMPARRAY output_buf,
    JDIMENSION output_col);
@@ -1256,3 +1334,107 @@ EXTERN(int) jsimd_encode_mcu_AC_refine_prepare_sse2
 EXTERN(int) jsimd_encode_mcu_AC_refine_prepare_neon
   (const JCOEF *block, const int *jpeg_natural_order_start, int Sl, int Al,
    UJCOEF *absvalues, size_t *bits);
+
+/* Progressive Huffman decoding */
+EXTERN(size_t) jsimd_decode_mcu_AC_refine_prepare_sse2
+  (const JCOEF *block, const int *jpeg_natural_order_start, int Sl);
+
+/* Trellis quantization */
+EXTERN(int) jsimd_trellis_search_avx2
+  (const char *ehufsi, const int *runs, const float *run_cost, int num_runs,
+   const float *candidate_dist, int num_candidates);
+
+EXTERN(int) jsimd_trellis_search_neon
+  (const char *ehufsi, const int *runs, const float *run_cost, int num_runs,
+   const float *candidate_dist, int num_candidates);
+
+/* Lossless Sample Differencing */
+extern const int jconst_difference_avx2[];
+EXTERN(void) jsimd_difference1_avx2
+  (JDIMENSION width, JSAMPROW input_buf, JSAMPROW prev_row, JDIFFROW diff_buf);
+EXTERN(void) jsimd_difference2_avx2
+  (JDIMENSION width, JSAMPROW input_buf, JSAMPROW prev_row, JDIFFROW diff_buf);
+EXTERN(void) jsimd_difference3_avx2
+  (JDIMENSION width, JSAMPROW input_buf, JSAMPROW prev_row, JDIFFROW diff_buf);
+EXTERN(void) jsimd_difference4_avx2
+  (JDIMENSION width, JSAMPROW input_buf, JSAMPROW prev_row, JDIFFROW diff_buf);
+EXTERN(void) jsimd_difference5_avx2
+  (JDIMENSION width, JSAMPROW input_buf, JSAMPROW prev_row, JDIFFROW diff_buf);
+EXTERN(void) jsimd_difference6_avx2
+  (JDIMENSION width, JSAMPROW input_buf, JSAMPROW prev_row, JDIFFROW diff_buf);
+EXTERN(void) jsimd_difference7_avx2
+  (JDIMENSION width, JSAMPROW input_buf, JSAMPROW prev_row, JDIFFROW diff_buf);
+EXTERN(void) j12simd_difference1_avx2
+  (JDIMENSION width, J12SAMPROW input_buf, J12SAMPROW prev_row,
+   JDIFFROW diff_buf);
+EXTERN(void) j12simd_difference2_avx2
+  (JDIMENSION width, J12SAMPROW input_buf, J12SAMPROW prev_row,
+   JDIFFROW diff_buf);
+EXTERN(void) j12simd_difference3_avx2
+  (JDIMENSION width, J12SAMPROW input_buf, J12SAMPROW prev_row,
+   JDIFFROW diff_buf);
+EXTERN(void) j12simd_difference4_avx2
+  (JDIMENSION width, J12SAMPROW input_buf, J12SAMPROW prev_row,
+   JDIFFROW diff_buf);
+EXTERN(void) j12simd_difference5_avx2
+  (JDIMENSION width, J12SAMPROW input_buf, J12SAMPROW prev_row,
+   JDIFFROW diff_buf);
+EXTERN(void) j12simd_difference6_avx2
+  (JDIMENSION width, J12SAMPROW input_buf, J12SAMPROW prev_row,
+   JDIFFROW diff_buf);
+EXTERN(void) j12simd_difference7_avx2
+  (JDIMENSION width, J12SAMPROW input_buf, J12SAMPROW prev_row,
+   JDIFFROW diff_buf);
+EXTERN(void) j16simd_difference1_avx2
+  (JDIMENSION width, J16SAMPROW input_buf, J16SAMPROW prev_row,
+   JDIFFROW diff_buf);
+EXTERN(void) j16simd_difference2_avx2
+  (JDIMENSION width, J16SAMPROW input_buf, J16SAMPROW prev_row,
+   JDIFFROW diff_buf);
+EXTERN(void) j16simd_difference3_avx2
+  (JDIMENSION width, J16SAMPROW input_buf, J16SAMPROW prev_row,
+   JDIFFROW diff_buf);
+EXTERN(void) j16simd_difference4_avx2
+  (JDIMENSION width, J16SAMPROW input_buf, J16SAMPROW prev_row,
+   JDIFFROW diff_buf);
+EXTERN(void) j16simd_difference5_avx2
+  (JDIMENSION width, J16SAMPROW input_buf, J16SAMPROW prev_row,
+   JDIFFROW diff_buf);
+EXTERN(void) j16simd_difference6_avx2
+  (JDIMENSION width, J16SAMPROW input_buf, J16SAMPROW prev_row,
+   JDIFFROW diff_buf);
+EXTERN(void) j16simd_difference7_avx2
+  (JDIMENSION width, J16SAMPROW input_buf, J16SAMPROW prev_row,
+   JDIFFROW diff_buf);
+
+/* Lossless Sample Downscaling */
+EXTERN(void) jsimd_downscale_avx2
+  (JDIMENSION width, int Al, JSAMPROW input_buf, JSAMPROW output_buf);
+EXTERN(void) j12simd_downscale_avx2
+  (JDIMENSION width, int Al, J12SAMPROW input_buf, J12SAMPROW output_buf);
+EXTERN(void) j16simd_downscale_avx2
+  (JDIMENSION width, int Al, J16SAMPROW input_buf, J16SAMPROW output_buf);
+
+/* Lossless Sample Undifferencing */
+extern const int jconst_undifference_avx2[];
+EXTERN(void) jsimd_undifference1_avx2
+  (JDIMENSION width, JDIFFROW diff_buf, JDIFFROW prev_row,
+   JDIFFROW undiff_buf);
+EXTERN(void) jsimd_undifference2_avx2
+  (JDIMENSION width, JDIFFROW diff_buf, JDIFFROW prev_row,
+   JDIFFROW undiff_buf);
+EXTERN(void) jsimd_undifference3_avx2
+  (JDIMENSION width, JDIFFROW diff_buf, JDIFFROW prev_row,
+   JDIFFROW undiff_buf);
+EXTERN(void) jsimd_undifference4_avx2
+  (JDIMENSION width, JDIFFROW diff_buf, JDIFFROW prev_row,
+   JDIFFROW undiff_buf);
+EXTERN(void) jsimd_undifference5_avx2
+  (JDIMENSION width, JDIFFROW diff_buf, JDIFFROW prev_row,
+   JDIFFROW undiff_buf);
+
+/* Lossless Sample Upscaling */
+EXTERN(void) jsimd_upscale_avx2
+  (JDIMENSION width, int Al, JDIFFROW diff_buf, JSAMPROW output_buf);
+EXTERN(void) j16simd_upscale_avx2
+  (JDIMENSION width, int Al, JDIFFROW diff_buf, J16SAMPROW output_buf);
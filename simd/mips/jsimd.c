@@ -852,6 +852,30 @@ jsimd_quantize_float(JCOEFPTR coef_block, FAST_FLOAT *divisors,
 #endif
 }
 
+GLOBAL(int)
+jsimd_can_preprocess_deringing(void)
+{
+  return 0;
+}
+
+GLOBAL(int)
+jsimd_can_preprocess_deringing_float(void)
+{
+  return 0;
+}
+
+GLOBAL(int)
+jsimd_preprocess_deringing(const DCTELEM *data, int *sum)
+{
+  return -1;
+}
+
+GLOBAL(int)
+jsimd_preprocess_deringing_float(const FAST_FLOAT *data, FAST_FLOAT *sum)
+{
+  return -1;
+}
+
 GLOBAL(int)
 jsimd_can_idct_2x2(void)
 {
@@ -1145,3 +1169,248 @@ jsimd_encode_mcu_AC_refine_prepare(const JCOEF *block,
 {
   return 0;
 }
+
+GLOBAL(int)
+jsimd_can_decode_mcu_AC_refine_prepare(void)
+{
+  return 0;
+}
+
+GLOBAL(size_t)
+jsimd_decode_mcu_AC_refine_prepare(const JCOEF *block,
+                                   const int *jpeg_natural_order_start, int Sl)
+{
+  return 0;
+}
+
+GLOBAL(int)
+jsimd_can_trellis_search(void)
+{
+  return 0;
+}
+
+GLOBAL(int)
+jsimd_trellis_search(const char *ehufsi, const int *runs,
+                     const float *run_cost, int num_runs,
+                     const float *candidate_dist, int num_candidates)
+{
+  return -1;
+}
+
+/*
+ * 12-bit routines (see jsamplecomp.h).  There are no 12-bit implementations
+ * for this architecture.
+ */
+
+GLOBAL(int)
+j12simd_can_rgb_ycc(void)
+{
+  return 0;
+}
+
+GLOBAL(int)
+j12simd_can_ycc_rgb(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+j12simd_rgb_ycc_convert(j_compress_ptr cinfo, J12SAMPARRAY input_buf,
+                        J12SAMPIMAGE output_buf, JDIMENSION output_row,
+                        int num_rows)
+{
+}
+
+GLOBAL(void)
+j12simd_ycc_rgb_convert(j_decompress_ptr cinfo, J12SAMPIMAGE input_buf,
+                        JDIMENSION input_row, J12SAMPARRAY output_buf,
+                        int num_rows)
+{
+}
+
+GLOBAL(int)
+j12simd_can_h2v2_downsample(void)
+{
+  return 0;
+}
+
+GLOBAL(int)
+j12simd_can_h2v1_downsample(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+j12simd_h2v2_downsample(j_compress_ptr cinfo, jpeg_component_info *compptr,
+                        J12SAMPARRAY input_data, J12SAMPARRAY output_data)
+{
+}
+
+GLOBAL(void)
+j12simd_h2v1_downsample(j_compress_ptr cinfo, jpeg_component_info *compptr,
+                        J12SAMPARRAY input_data, J12SAMPARRAY output_data)
+{
+}
+
+GLOBAL(int)
+j12simd_can_h2v2_fancy_upsample(void)
+{
+  return 0;
+}
+
+GLOBAL(int)
+j12simd_can_h2v1_fancy_upsample(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+j12simd_h2v2_fancy_upsample(j_decompress_ptr cinfo,
+                            jpeg_component_info *compptr,
+                            J12SAMPARRAY input_data,
+                            J12SAMPARRAY *output_data_ptr)
+{
+}
+
+GLOBAL(void)
+j12simd_h2v1_fancy_upsample(j_decompress_ptr cinfo,
+                            jpeg_component_info *compptr,
+                            J12SAMPARRAY input_data,
+                            J12SAMPARRAY *output_data_ptr)
+{
+}
+
+GLOBAL(int)
+j12simd_can_idct_islow(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+j12simd_idct_islow(j_decompress_ptr cinfo, jpeg_component_info *compptr,
+                   JCOEFPTR coef_block, J12SAMPARRAY output_buf,
+                   JDIMENSION output_col)
+{
+}
+
+/* Lossless mode routines */
+
+GLOBAL(int)
+jsimd_can_difference(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+jsimd_difference(j_compress_ptr cinfo, JSAMPROW input_buf,
+                 JSAMPROW prev_row, JDIFFROW diff_buf, JDIMENSION width)
+{
+}
+
+GLOBAL(int)
+j12simd_can_difference(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+j12simd_difference(j_compress_ptr cinfo, J12SAMPROW input_buf,
+                   J12SAMPROW prev_row, JDIFFROW diff_buf, JDIMENSION width)
+{
+}
+
+GLOBAL(int)
+j16simd_can_difference(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+j16simd_difference(j_compress_ptr cinfo, J16SAMPROW input_buf,
+                   J16SAMPROW prev_row, JDIFFROW diff_buf, JDIMENSION width)
+{
+}
+
+GLOBAL(int)
+jsimd_can_downscale(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+jsimd_downscale(j_compress_ptr cinfo, JSAMPROW input_buf,
+                JSAMPROW output_buf, JDIMENSION width)
+{
+}
+
+GLOBAL(int)
+j12simd_can_downscale(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+j12simd_downscale(j_compress_ptr cinfo, J12SAMPROW input_buf,
+                  J12SAMPROW output_buf, JDIMENSION width)
+{
+}
+
+GLOBAL(int)
+j16simd_can_downscale(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+j16simd_downscale(j_compress_ptr cinfo, J16SAMPROW input_buf,
+                  J16SAMPROW output_buf, JDIMENSION width)
+{
+}
+
+GLOBAL(int)
+jsimd_can_undifference(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+jsimd_undifference(j_decompress_ptr cinfo, int comp_index, JDIFFROW diff_buf,
+                   JDIFFROW prev_row, JDIFFROW undiff_buf, JDIMENSION width)
+{
+}
+
+GLOBAL(int)
+jsimd_can_upscale(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+jsimd_upscale(j_decompress_ptr cinfo, JDIFFROW diff_buf,
+              JSAMPROW output_buf, JDIMENSION width)
+{
+}
+
+GLOBAL(int)
+j12simd_can_upscale(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+j12simd_upscale(j_decompress_ptr cinfo, JDIFFROW diff_buf,
+                J12SAMPROW output_buf, JDIMENSION width)
+{
+}
+
+GLOBAL(int)
+j16simd_can_upscale(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+j16simd_upscale(j_decompress_ptr cinfo, JDIFFROW diff_buf,
+                J16SAMPROW output_buf, JDIMENSION width)
+{
+}
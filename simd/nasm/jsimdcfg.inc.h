@@ -74,6 +74,14 @@
 
 %define _cpp_protection_CENTERJSAMPLE  CENTERJSAMPLE
 
+; Representation of a single 12-bit sample.
+;
+%define J12SAMPLE          word            ; short
+%define SIZEOF_J12SAMPLE   SIZEOF_WORD     ; sizeof(J12SAMPLE)
+
+%define _cpp_protection_MAXJ12SAMPLE     MAXJ12SAMPLE
+%define _cpp_protection_CENTERJ12SAMPLE  CENTERJ12SAMPLE
+
 ; Representation of a DCT frequency coefficient.
 ; On this SIMD implementation, this must be 'short'.
 ;
@@ -90,7 +98,11 @@
 %define JSAMPARRAY         POINTER         ; JSAMPROW *    (jpeglib.h)
 %define JSAMPIMAGE         POINTER         ; JSAMPARRAY *  (jpeglib.h)
 %define JCOEFPTR           POINTER         ; JCOEF *       (jpeglib.h)
+%define J12SAMPROW         POINTER         ; J12SAMPLE *   (jpeglib.h)
+%define J12SAMPARRAY       POINTER         ; J12SAMPROW *  (jpeglib.h)
+%define J12SAMPIMAGE       POINTER         ; J12SAMPARRAY * (jpeglib.h)
 %define SIZEOF_JSAMPROW    SIZEOF_POINTER  ; sizeof(JSAMPROW)
+%define SIZEOF_J12SAMPROW  SIZEOF_POINTER  ; sizeof(J12SAMPROW)
 %define SIZEOF_JSAMPARRAY  SIZEOF_POINTER  ; sizeof(JSAMPARRAY)
 %define SIZEOF_JSAMPIMAGE  SIZEOF_POINTER  ; sizeof(JSAMPIMAGE)
 %define SIZEOF_JCOEFPTR    SIZEOF_POINTER  ; sizeof(JCOEFPTR)
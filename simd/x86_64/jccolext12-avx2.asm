@@ -0,0 +1,304 @@
+;
+; jccolext12.asm - colorspace conversion for 12-bit samples (64-bit AVX2)
+;
+; Copyright (C) 2026, Mozilla Corporation.
+;
+; Based on the x86 SIMD extension for IJG JPEG library
+; Copyright (C) 1999-2006, MIYASAKA Masaru.
+; For conditions of distribution and use, see copyright notice in jsimdext.inc
+;
+; This file should be assembled with NASM (Netwide Assembler) or Yasm.
+
+; --------------------------------------------------------------------------
+; After the input pixels are deinterleaved, ymm0-ymm3 contain the samples with
+; offsets 0-3 within the pixel.
+
+%if RGB_RED == 0
+%define ymmR  ymm0
+%elif RGB_RED == 1
+%define ymmR  ymm1
+%elif RGB_RED == 2
+%define ymmR  ymm2
+%else
+%define ymmR  ymm3
+%endif
+
+%if RGB_GREEN == 0
+%define ymmG  ymm0
+%elif RGB_GREEN == 1
+%define ymmG  ymm1
+%elif RGB_GREEN == 2
+%define ymmG  ymm2
+%else
+%define ymmG  ymm3
+%endif
+
+%if RGB_BLUE == 0
+%define ymmB  ymm0
+%elif RGB_BLUE == 1
+%define ymmB  ymm1
+%elif RGB_BLUE == 2
+%define ymmB  ymm2
+%else
+%define ymmB  ymm3
+%endif
+
+; --------------------------------------------------------------------------
+;
+; Convert some rows of samples to the output colorspace.
+;
+; GLOBAL(void)
+; j12simd_rgb_ycc_convert_avx2(JDIMENSION img_width, J12SAMPARRAY input_buf,
+;                              J12SAMPIMAGE output_buf, JDIMENSION output_row,
+;                              int num_rows);
+;
+; The output rows are padded (see alloc_sarray() in jmemmgr.c), so each
+; iteration stores 16 samples to them.  The input rows are not, so the last
+; pixels of a row are copied to the stack before they are loaded.
+
+; r10d = JDIMENSION img_width
+; r11 = J12SAMPARRAY input_buf
+; r12 = J12SAMPIMAGE output_buf
+; r13d = JDIMENSION output_row
+; r14d = int num_rows
+
+%define wk(i)   r15 - (WK_NUM - (i)) * SIZEOF_YMMWORD  ; ymmword wk[WK_NUM]
+%define WK_NUM  4
+
+    align       32
+    GLOBAL_FUNCTION(j12simd_rgb_ycc_convert_avx2)
+
+EXTN(j12simd_rgb_ycc_convert_avx2):
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    push        r15
+    and         rsp, byte (-SIZEOF_YMMWORD)  ; align to 256 bits
+    ; Allocate stack space for wk array.  r15 is used to access it.
+    mov         r15, rsp
+    sub         rsp, (SIZEOF_YMMWORD * WK_NUM)
+    PUSH_XMM    4
+    COLLECT_ARGS 5
+    push        rbx
+
+    mov         ecx, r10d
+    test        rcx, rcx
+    jz          near .return
+
+    push        rcx
+
+    mov         rsi, r12
+    mov         ecx, r13d
+    mov         rdip, J12SAMPARRAY [rsi+0*SIZEOF_JSAMPARRAY]
+    mov         rbxp, J12SAMPARRAY [rsi+1*SIZEOF_JSAMPARRAY]
+    mov         rdxp, J12SAMPARRAY [rsi+2*SIZEOF_JSAMPARRAY]
+    lea         rdi, [rdi+rcx*SIZEOF_J12SAMPROW]
+    lea         rbx, [rbx+rcx*SIZEOF_J12SAMPROW]
+    lea         rdx, [rdx+rcx*SIZEOF_J12SAMPROW]
+
+    pop         rcx
+
+    mov         rsi, r11
+    mov         eax, r14d
+    test        rax, rax
+    jle         near .return
+.rowloop:
+    push        rdx
+    push        rbx
+    push        rdi
+    push        rsi
+    push        rcx                     ; col
+
+    mov         rsip, J12SAMPROW [rsi]  ; inptr
+    mov         rdip, J12SAMPROW [rdi]  ; outptr0
+    mov         rbxp, J12SAMPROW [rbx]  ; outptr1
+    mov         rdxp, J12SAMPROW [rdx]  ; outptr2
+
+.columnloop:
+    cmp         rcx, byte SIZEOF_YMMWORD/SIZEOF_J12SAMPLE
+    jae         short .column_ld
+
+    ; Copy the remaining pixels to the stack.
+    push        rsi
+    push        rdi
+    push        rcx
+    lea         rdi, [wk(0)]
+%if RGB_PIXELSIZE == 3
+    lea         rcx, [rcx+rcx*2]
+    shl         rcx, 1                  ; rcx *= RGB_PIXELSIZE * SIZEOF_J12SAMPLE
+%else
+    shl         rcx, 3                  ; rcx *= RGB_PIXELSIZE * SIZEOF_J12SAMPLE
+%endif
+    rep movsb
+    pop         rcx
+    pop         rdi
+    pop         rsi
+    lea         rsi, [wk(0)]
+
+.column_ld:
+
+%if RGB_PIXELSIZE == 3  ; ---------------
+
+    vmovdqu     xmm4, XMMWORD [rsi+0*SIZEOF_XMMWORD]
+    vmovdqu     xmm5, XMMWORD [rsi+1*SIZEOF_XMMWORD]
+    vmovdqu     xmm6, XMMWORD [rsi+2*SIZEOF_XMMWORD]
+    vinserti128 ymm4, ymm4, XMMWORD [rsi+3*SIZEOF_XMMWORD], 1
+    vinserti128 ymm5, ymm5, XMMWORD [rsi+4*SIZEOF_XMMWORD], 1
+    vinserti128 ymm6, ymm6, XMMWORD [rsi+5*SIZEOF_XMMWORD], 1
+    ; ymm4=(00 01 02 10 11 12 20 21  80 81 82 90 91 92 A0 A1)
+    ; ymm5=(22 30 31 32 40 41 42 50  A2 B0 B1 B2 C0 C1 C2 D0)
+    ; ymm6=(51 52 60 61 62 70 71 72  D1 D2 E0 E1 E2 F0 F1 F2)
+
+    vpshufb     ymm0, ymm4, [rel PB_GATHER3_0_0]
+    vpshufb     ymm7, ymm5, [rel PB_GATHER3_1_0]
+    vpshufb     ymm8, ymm6, [rel PB_GATHER3_2_0]
+    vpor        ymm0, ymm0, ymm7
+    vpor        ymm0, ymm0, ymm8        ; ymm0=(00 10 20 30 40 50 60 70  80 90 ..)
+
+    vpshufb     ymm1, ymm4, [rel PB_GATHER3_0_1]
+    vpshufb     ymm7, ymm5, [rel PB_GATHER3_1_1]
+    vpshufb     ymm8, ymm6, [rel PB_GATHER3_2_1]
+    vpor        ymm1, ymm1, ymm7
+    vpor        ymm1, ymm1, ymm8        ; ymm1=(01 11 21 31 41 51 61 71  81 91 ..)
+
+    vpshufb     ymm2, ymm4, [rel PB_GATHER3_0_2]
+    vpshufb     ymm7, ymm5, [rel PB_GATHER3_1_2]
+    vpshufb     ymm8, ymm6, [rel PB_GATHER3_2_2]
+    vpor        ymm2, ymm2, ymm7
+    vpor        ymm2, ymm2, ymm8        ; ymm2=(02 12 22 32 42 52 62 72  82 92 ..)
+
+%else  ; RGB_PIXELSIZE == 4 ; -----------
+
+    vmovdqu     xmm4, XMMWORD [rsi+0*SIZEOF_XMMWORD]
+    vmovdqu     xmm5, XMMWORD [rsi+1*SIZEOF_XMMWORD]
+    vmovdqu     xmm6, XMMWORD [rsi+2*SIZEOF_XMMWORD]
+    vmovdqu     xmm7, XMMWORD [rsi+3*SIZEOF_XMMWORD]
+    vinserti128 ymm4, ymm4, XMMWORD [rsi+4*SIZEOF_XMMWORD], 1
+    vinserti128 ymm5, ymm5, XMMWORD [rsi+5*SIZEOF_XMMWORD], 1
+    vinserti128 ymm6, ymm6, XMMWORD [rsi+6*SIZEOF_XMMWORD], 1
+    vinserti128 ymm7, ymm7, XMMWORD [rsi+7*SIZEOF_XMMWORD], 1
+    ; ymm4=(00 01 02 03 10 11 12 13  80 81 82 83 90 91 92 93)
+    ; ymm5=(20 21 22 23 30 31 32 33  A0 A1 A2 A3 B0 B1 B2 B3)
+    ; ymm6=(40 41 42 43 50 51 52 53  C0 C1 C2 C3 D0 D1 D2 D3)
+    ; ymm7=(60 61 62 63 70 71 72 73  E0 E1 E2 E3 F0 F1 F2 F3)
+
+    vmovdqa     ymm8, [rel PB_GATHER4]
+    vpshufb     ymm4, ymm4, ymm8        ; ymm4=(00 10 01 11 02 12 03 13  80 90 ..)
+    vpshufb     ymm5, ymm5, ymm8        ; ymm5=(20 30 21 31 22 32 23 33  A0 B0 ..)
+    vpshufb     ymm6, ymm6, ymm8        ; ymm6=(40 50 41 51 42 52 43 53  C0 D0 ..)
+    vpshufb     ymm7, ymm7, ymm8        ; ymm7=(60 70 61 71 62 72 63 73  E0 F0 ..)
+
+    vpunpckldq  ymm8, ymm4, ymm5        ; ymm8=(00 10 20 30 01 11 21 31  80 ..)
+    vpunpckhdq  ymm4, ymm4, ymm5        ; ymm4=(02 12 22 32 03 13 23 33  82 ..)
+    vpunpckldq  ymm9, ymm6, ymm7        ; ymm9=(40 50 60 70 41 51 61 71  C0 ..)
+    vpunpckhdq  ymm6, ymm6, ymm7        ; ymm6=(42 52 62 72 43 53 63 73  C2 ..)
+
+    vpunpcklqdq ymm0, ymm8, ymm9        ; ymm0=(00 10 20 30 40 50 60 70  80 ..)
+    vpunpckhqdq ymm1, ymm8, ymm9        ; ymm1=(01 11 21 31 41 51 61 71  81 ..)
+    vpunpcklqdq ymm2, ymm4, ymm6        ; ymm2=(02 12 22 32 42 52 62 72  82 ..)
+    vpunpckhqdq ymm3, ymm4, ymm6        ; ymm3=(03 13 23 33 43 53 63 73  83 ..)
+
+%endif  ; RGB_PIXELSIZE ; ---------------
+
+    ; The C implementation ignores the upper 4 bits of the input samples.
+
+    vmovdqa     ymm7, [rel PW_MAXJ12SAMP]
+    vpand       ymmR, ymmR, ymm7
+    vpand       ymmG, ymmG, ymm7
+    vpand       ymmB, ymmB, ymm7
+
+    ; (Original)
+    ; Y  =  0.29900 * R + 0.58700 * G + 0.11400 * B
+    ; Cb = -0.16874 * R - 0.33126 * G + 0.50000 * B + CENTERJ12SAMPLE
+    ; Cr =  0.50000 * R - 0.41869 * G - 0.08131 * B + CENTERJ12SAMPLE
+    ;
+    ; (This implementation)
+    ; Y  =  0.29900 * R + 0.33700 * G + 0.11400 * B + 0.25000 * G
+    ; Cb = -0.16874 * R - 0.33126 * G + 0.50000 * B + CENTERJ12SAMPLE
+    ; Cr =  0.50000 * R - 0.41869 * G - 0.08131 * B + CENTERJ12SAMPLE
+
+    vpunpcklwd  ymm4, ymmR, ymmG        ; ymm4=RGL
+    vpunpckhwd  ymm5, ymmR, ymmG        ; ymm5=RGH
+    vpunpcklwd  ymm8, ymmB, ymmG        ; ymm8=BGL
+    vpunpckhwd  ymm9, ymmB, ymmG        ; ymm9=BGH
+
+    vpmaddwd    ymm6, ymm4, [rel PW_F0299_F0337]
+    vpmaddwd    ymm7, ymm5, [rel PW_F0299_F0337]
+    vpmaddwd    ymm10, ymm8, [rel PW_F0114_F0250]
+    vpmaddwd    ymm11, ymm9, [rel PW_F0114_F0250]
+    vpaddd      ymm6, ymm6, ymm10
+    vpaddd      ymm7, ymm7, ymm11
+    vmovdqa     ymm10, [rel PD_ONEHALF]
+    vpaddd      ymm6, ymm6, ymm10
+    vpaddd      ymm7, ymm7, ymm10
+    vpsrld      ymm6, ymm6, SCALEBITS   ; ymm6=YL
+    vpsrld      ymm7, ymm7, SCALEBITS   ; ymm7=YH
+    vpackssdw   ymm6, ymm6, ymm7        ; ymm6=Y
+    vmovdqu     YMMWORD [rdi], ymm6
+
+    vpxor       ymm11, ymm11, ymm11
+    vmovdqa     ymm10, [rel PD_ONEHALFM1_CJ]
+
+    vpmaddwd    ymm4, ymm4, [rel PW_MF016_MF033]
+    vpmaddwd    ymm5, ymm5, [rel PW_MF016_MF033]
+    vpunpcklwd  ymm6, ymm11, ymmB
+    vpunpckhwd  ymm7, ymm11, ymmB
+    vpsrld      ymm6, ymm6, 1           ; ymm6=BL*FIX(0.500)
+    vpsrld      ymm7, ymm7, 1           ; ymm7=BH*FIX(0.500)
+    vpaddd      ymm4, ymm4, ymm6
+    vpaddd      ymm5, ymm5, ymm7
+    vpaddd      ymm4, ymm4, ymm10
+    vpaddd      ymm5, ymm5, ymm10
+    vpsrld      ymm4, ymm4, SCALEBITS   ; ymm4=CbL
+    vpsrld      ymm5, ymm5, SCALEBITS   ; ymm5=CbH
+    vpackssdw   ymm4, ymm4, ymm5        ; ymm4=Cb
+    vmovdqu     YMMWORD [rbx], ymm4
+
+    vpmaddwd    ymm8, ymm8, [rel PW_MF008_MF041]
+    vpmaddwd    ymm9, ymm9, [rel PW_MF008_MF041]
+    vpunpcklwd  ymm6, ymm11, ymmR
+    vpunpckhwd  ymm7, ymm11, ymmR
+    vpsrld      ymm6, ymm6, 1           ; ymm6=RL*FIX(0.500)
+    vpsrld      ymm7, ymm7, 1           ; ymm7=RH*FIX(0.500)
+    vpaddd      ymm8, ymm8, ymm6
+    vpaddd      ymm9, ymm9, ymm7
+    vpaddd      ymm8, ymm8, ymm10
+    vpaddd      ymm9, ymm9, ymm10
+    vpsrld      ymm8, ymm8, SCALEBITS   ; ymm8=CrL
+    vpsrld      ymm9, ymm9, SCALEBITS   ; ymm9=CrH
+    vpackssdw   ymm8, ymm8, ymm9        ; ymm8=Cr
+    vmovdqu     YMMWORD [rdx], ymm8
+
+    add         rsi, RGB_PIXELSIZE*SIZEOF_YMMWORD  ; inptr
+    add         rdi, byte SIZEOF_YMMWORD           ; outptr0
+    add         rbx, byte SIZEOF_YMMWORD           ; outptr1
+    add         rdx, byte SIZEOF_YMMWORD           ; outptr2
+    sub         rcx, byte SIZEOF_YMMWORD/SIZEOF_J12SAMPLE
+    jg          near .columnloop
+
+    pop         rcx                     ; col
+    pop         rsi
+    pop         rdi
+    pop         rbx
+    pop         rdx
+
+    add         rsi, byte SIZEOF_J12SAMPROW  ; input_buf
+    add         rdi, byte SIZEOF_J12SAMPROW
+    add         rbx, byte SIZEOF_J12SAMPROW
+    add         rdx, byte SIZEOF_J12SAMPROW
+    dec         rax                          ; num_rows
+    jg          near .rowloop
+
+.return:
+    pop         rbx
+    vzeroupper
+    UNCOLLECT_ARGS 5
+    POP_XMM     4
+    lea         rsp, [rbp-8]
+    pop         r15
+    pop         rbp
+    ret
+
+; For some reason, the OS X linker does not honor the request to align the
+; segment unless we do this.
+    align       32
@@ -0,0 +1,91 @@
+;
+; jcdering.asm - overshoot deringing block analysis (64-bit AVX2)
+;
+; Copyright (C) 2026, Mozilla Corporation.
+;
+; For conditions of distribution and use, see copyright notice in jsimdext.inc
+;
+; This file should be assembled with NASM (Netwide Assembler) or Yasm.
+;
+; This file contains an AVX2 implementation of the part of overshoot
+; deringing that runs for every 8x8 block: counting the samples that have the
+; maximum value and summing the block.  See preprocess_deringing() in
+; jcdctmgr.c for more details.
+
+%include "jsimdext.inc"
+%include "jdct.inc"
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_TEXT
+    BITS        64
+;
+; Count the samples in a block that are >= 127 (the maximum value after the
+; unsigned->signed conversion) and sum all of the samples.
+;
+; GLOBAL(int)
+; jsimd_preprocess_deringing_avx2(const DCTELEM *data, int *sum);
+;
+; Each word lane sums at most 4 samples, so the partial sums cannot overflow.
+; The lanes count the samples that are below the maximum, as negative numbers,
+; because the comparison yields -1 for those.
+
+; r10 = const DCTELEM *data
+; r11 = int *sum
+
+    align       32
+    GLOBAL_FUNCTION(jsimd_preprocess_deringing_avx2)
+
+EXTN(jsimd_preprocess_deringing_avx2):
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    COLLECT_ARGS 2
+
+    vmovdqu     ymm0, YMMWORD [YMMBLOCK(0,0,r10,SIZEOF_DCTELEM)]
+    vmovdqu     ymm1, YMMWORD [YMMBLOCK(2,0,r10,SIZEOF_DCTELEM)]
+    vmovdqu     ymm2, YMMWORD [YMMBLOCK(4,0,r10,SIZEOF_DCTELEM)]
+    vmovdqu     ymm3, YMMWORD [YMMBLOCK(6,0,r10,SIZEOF_DCTELEM)]
+
+    vpcmpeqw    ymm7, ymm7, ymm7
+    vpsrlw      ymm6, ymm7, 15          ; ymm6={1 1 1 1 ..}
+    vpsrlw      ymm7, ymm7, 9           ; ymm7={127 127 127 127 ..}
+
+    vpaddw      ymm4, ymm0, ymm1
+    vpaddw      ymm5, ymm2, ymm3
+    vpaddw      ymm4, ymm4, ymm5        ; ymm4=sum
+
+    vpcmpgtw    ymm0, ymm7, ymm0        ; ymm0=(127 > data) ? -1 : 0
+    vpcmpgtw    ymm1, ymm7, ymm1
+    vpcmpgtw    ymm2, ymm7, ymm2
+    vpcmpgtw    ymm3, ymm7, ymm3
+    vpaddw      ymm0, ymm0, ymm1
+    vpaddw      ymm2, ymm2, ymm3
+    vpaddw      ymm5, ymm0, ymm2        ; ymm5=-(# of samples < 127)
+
+    vpmaddwd    ymm4, ymm4, ymm6        ; ymm4=(dword sums)
+    vpmaddwd    ymm5, ymm5, ymm6
+    vextracti128 xmm0, ymm4, 1
+    vextracti128 xmm1, ymm5, 1
+    vpaddd      xmm4, xmm4, xmm0
+    vpaddd      xmm5, xmm5, xmm1
+    vpshufd     xmm0, xmm4, 0x4E
+    vpshufd     xmm1, xmm5, 0x4E
+    vpaddd      xmm4, xmm4, xmm0
+    vpaddd      xmm5, xmm5, xmm1
+    vpshufd     xmm0, xmm4, 0xB1
+    vpshufd     xmm1, xmm5, 0xB1
+    vpaddd      xmm4, xmm4, xmm0
+    vpaddd      xmm5, xmm5, xmm1
+
+    vmovd       XMM_DWORD [r11], xmm4
+    vmovd       eax, xmm5
+    add         eax, DCTSIZE2           ; eax=# of samples >= 127
+
+    vzeroupper
+    UNCOLLECT_ARGS 2
+    pop         rbp
+    ret
+
+; For some reason, the OS X linker does not honor the request to align the
+; segment unless we do this.
+    align       32
@@ -0,0 +1,162 @@
+;
+; jcdering.asm - overshoot deringing block analysis (64-bit SSE2)
+;
+; Copyright (C) 2026, Mozilla Corporation.
+;
+; For conditions of distribution and use, see copyright notice in jsimdext.inc
+;
+; This file should be assembled with NASM (Netwide Assembler) or Yasm.
+;
+; This file contains SSE2 implementations of the part of overshoot deringing
+; that runs for every 8x8 block: counting the samples that have the maximum
+; value and summing the block.  See preprocess_deringing() and
+; float_preprocess_deringing() in jcdctmgr.c for more details.
+
+%include "jsimdext.inc"
+%include "jdct.inc"
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_TEXT
+    BITS        64
+;
+; Count the samples in a block that are >= 127 (the maximum value after the
+; unsigned->signed conversion) and sum all of the samples.
+;
+; GLOBAL(int)
+; jsimd_preprocess_deringing_sse2(const DCTELEM *data, int *sum);
+;
+; Each word lane sums at most 8 samples, so the partial sums cannot overflow.
+; The lanes count the samples that are below the maximum, as negative numbers,
+; because the comparison yields -1 for those.
+
+; r10 = const DCTELEM *data
+; r11 = int *sum
+
+    align       32
+    GLOBAL_FUNCTION(jsimd_preprocess_deringing_sse2)
+
+EXTN(jsimd_preprocess_deringing_sse2):
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    COLLECT_ARGS 2
+
+    pcmpeqw     xmm7, xmm7
+    psrlw       xmm7, 9                 ; xmm7={127 127 127 127 ..}
+    pxor        xmm5, xmm5              ; xmm5=sum
+    pxor        xmm6, xmm6              ; xmm6=-(# of samples < 127)
+
+    mov         rsi, r10
+    mov         rcx, DCTSIZE/2
+.scanloop:
+    movdqa      xmm0, XMMWORD [XMMBLOCK(0,0,rsi,SIZEOF_DCTELEM)]
+    movdqa      xmm1, XMMWORD [XMMBLOCK(1,0,rsi,SIZEOF_DCTELEM)]
+    movdqa      xmm2, xmm7
+    movdqa      xmm3, xmm7
+    paddw       xmm5, xmm0
+    paddw       xmm5, xmm1
+    pcmpgtw     xmm2, xmm0              ; xmm2=(127 > data) ? -1 : 0
+    pcmpgtw     xmm3, xmm1
+    paddw       xmm6, xmm2
+    paddw       xmm6, xmm3
+
+    add         rsi, byte 2*DCTSIZE*SIZEOF_DCTELEM
+    dec         rcx
+    jnz         short .scanloop
+
+    pcmpeqw     xmm4, xmm4
+    psrlw       xmm4, 15                ; xmm4={1 1 1 1 ..}
+    pmaddwd     xmm5, xmm4              ; xmm5=(dword sums)
+    pmaddwd     xmm6, xmm4
+    pshufd      xmm0, xmm5, 0x4E
+    pshufd      xmm1, xmm6, 0x4E
+    paddd       xmm5, xmm0
+    paddd       xmm6, xmm1
+    pshufd      xmm0, xmm5, 0xB1
+    pshufd      xmm1, xmm6, 0xB1
+    paddd       xmm5, xmm0
+    paddd       xmm6, xmm1
+
+    movd        XMM_DWORD [r11], xmm5
+    movd        eax, xmm6
+    add         eax, DCTSIZE2           ; eax=# of samples >= 127
+
+    UNCOLLECT_ARGS 2
+    pop         rbp
+    ret
+
+; --------------------------------------------------------------------------
+;
+; Float version of the above.  The samples are whole numbers, so their sum is
+; exact regardless of the order of the additions.
+;
+; GLOBAL(int)
+; jsimd_preprocess_deringing_float_sse2(const FAST_FLOAT *data,
+;                                       FAST_FLOAT *sum);
+;
+
+; r10 = const FAST_FLOAT *data
+; r11 = FAST_FLOAT *sum
+
+    align       32
+    GLOBAL_FUNCTION(jsimd_preprocess_deringing_float_sse2)
+
+EXTN(jsimd_preprocess_deringing_float_sse2):
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    COLLECT_ARGS 2
+
+    mov         eax, 0x42FE0000         ; 127.0f
+    movd        xmm7, eax
+    pshufd      xmm7, xmm7, 0x00        ; xmm7={127.0 127.0 127.0 127.0}
+    xorps       xmm5, xmm5              ; xmm5=sum
+    pxor        xmm6, xmm6              ; xmm6=-(# of samples >= 127)
+
+    mov         rsi, r10
+    mov         rcx, DCTSIZE/2
+.scanloop:
+    movaps      xmm0, XMMWORD [XMMBLOCK(0,0,rsi,SIZEOF_FAST_FLOAT)]
+    movaps      xmm1, XMMWORD [XMMBLOCK(0,1,rsi,SIZEOF_FAST_FLOAT)]
+    movaps      xmm2, XMMWORD [XMMBLOCK(1,0,rsi,SIZEOF_FAST_FLOAT)]
+    movaps      xmm3, XMMWORD [XMMBLOCK(1,1,rsi,SIZEOF_FAST_FLOAT)]
+    addps       xmm5, xmm0
+    addps       xmm5, xmm1
+    addps       xmm5, xmm2
+    addps       xmm5, xmm3
+    movaps      xmm4, xmm7
+    cmpleps     xmm4, xmm0              ; xmm4=(127.0 <= data) ? -1 : 0
+    psubd       xmm6, xmm4
+    movaps      xmm4, xmm7
+    cmpleps     xmm4, xmm1
+    psubd       xmm6, xmm4
+    movaps      xmm4, xmm7
+    cmpleps     xmm4, xmm2
+    psubd       xmm6, xmm4
+    movaps      xmm4, xmm7
+    cmpleps     xmm4, xmm3
+    psubd       xmm6, xmm4
+
+    add         rsi, byte 2*DCTSIZE*SIZEOF_FAST_FLOAT
+    dec         rcx
+    jnz         short .scanloop
+
+    movhlps     xmm0, xmm5
+    pshufd      xmm1, xmm6, 0x4E
+    addps       xmm5, xmm0
+    paddd       xmm6, xmm1
+    pshufd      xmm0, xmm5, 0xB1
+    pshufd      xmm1, xmm6, 0xB1
+    addss       xmm5, xmm0
+    paddd       xmm6, xmm1
+
+    movss       XMM_DWORD [r11], xmm5
+    movd        eax, xmm6               ; eax=# of samples >= 127
+
+    UNCOLLECT_ARGS 2
+    pop         rbp
+    ret
+
+; For some reason, the OS X linker does not honor the request to align the
+; segment unless we do this.
+    align       32
@@ -0,0 +1,356 @@
+;
+; jclossls.asm - lossless prediction and point transform (64-bit AVX2)
+;
+; Copyright (C) 2026, Mozilla Corporation.
+;
+; Based on the x86 SIMD extension for IJG JPEG library
+; Copyright (C) 1999-2006, MIYASAKA Masaru.
+; For conditions of distribution and use, see copyright notice in jsimdext.inc
+;
+; This file should be assembled with NASM (Netwide Assembler) or Yasm.
+;
+; This file contains the sample differencing and point transform routines for
+; the lossless JPEG compressor.  The following code is based directly on
+; jclossls.c; see the jclossls.c for more details.
+;
+; Unlike the undifferencers, the differencers have no serial dependency, since
+; Ra, Rb, and Rc are all input samples.  Thus, all seven predictors can be
+; computed eight samples at a time.  There is a separate set of routines for
+; each data precision, since the sample sizes (and, for 12-bit samples, the
+; signedness) differ.
+
+%include "jsimdext.inc"
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_CONST
+
+    ALIGNZ      32
+    GLOBAL_DATA(jconst_difference_avx2)
+
+EXTN(jconst_difference_avx2):
+
+PD_LANE_INDEX  dd 0, 1, 2, 3, 4, 5, 6, 7
+
+    ALIGNZ      32
+
+; --------------------------------------------------------------------------
+;
+; Compute the predictor for 8 samples.
+; ymm1 = Ra, ymm2 = Rb, ymm3 = Rc (doublewords); the result is stored in ymm1.
+;
+; %1 = predictor selection value (1-7)
+
+%macro PREDICT 1
+%if %1 == 2
+    vmovdqa     ymm1, ymm2                      ; PREDICTOR2 = Rb
+%elif %1 == 3
+    vmovdqa     ymm1, ymm3                      ; PREDICTOR3 = Rc
+%elif %1 == 4
+    vpaddd      ymm1, ymm1, ymm2
+    vpsubd      ymm1, ymm1, ymm3                ; PREDICTOR4 = Ra + Rb - Rc
+%elif %1 == 5
+    vpsubd      ymm4, ymm2, ymm3
+    vpsrad      ymm4, ymm4, 1
+    vpaddd      ymm1, ymm1, ymm4                ; PREDICTOR5 = Ra + ((Rb - Rc) >> 1)
+%elif %1 == 6
+    vpsubd      ymm4, ymm1, ymm3
+    vpsrad      ymm4, ymm4, 1
+    vpaddd      ymm1, ymm2, ymm4                ; PREDICTOR6 = Rb + ((Ra - Rc) >> 1)
+%elif %1 == 7
+    vpaddd      ymm1, ymm1, ymm2
+    vpsrad      ymm1, ymm1, 1                   ; PREDICTOR7 = (Ra + Rb) >> 1
+%endif
+%endmacro
+
+; --------------------------------------------------------------------------
+;
+; Load and difference 8 samples.  rsi and rdx point to the current sample in
+; the input row and the previous row, respectively.
+;
+; %1 = predictor selection value (1-7)
+; %2 = instruction for loading 8 samples as doublewords
+; %3 = size of the 8 samples (QWORD or XMMWORD)
+; %4 = sample size in bytes
+
+%macro DIFFERENCE8 4
+    %2          ymm0, %3 [rsi]                  ; ymm0 = current samples
+%if %1 == 1 || %1 >= 4
+    %2          ymm1, %3 [rsi-%4]               ; ymm1 = Ra
+%endif
+%if %1 == 2 || %1 >= 4
+    %2          ymm2, %3 [rdx]                  ; ymm2 = Rb
+%endif
+%if %1 >= 3 && %1 <= 6
+    %2          ymm3, %3 [rdx-%4]               ; ymm3 = Rc
+%endif
+    PREDICT     %1
+    vpsubd      ymm0, ymm0, ymm1
+%endmacro
+
+; --------------------------------------------------------------------------
+;
+; Differencer for the second and subsequent rows in a scan or restart interval
+; (see jpeg_difference*() in jclossls.c).  The first sample in the row is
+; differenced using the vertical predictor (2), and the rest of the samples
+; are differenced using the specified predictor.
+;
+; GLOBAL(void)
+; jsimd_difference<psv>_avx2(JDIMENSION width, JSAMPROW input_buf,
+;                            JSAMPROW prev_row, JDIFFROW diff_buf);
+;
+; Only the first width differences are stored, since the differences at the
+; right edge of the row must remain zero (see jinit_c_diff_controller() in
+; jcdiffct.c.)  The last samples of a row are copied to the stack before they
+; are loaded, so the input rows are never read past their end either.
+;
+; %1 = function name
+; %2 = predictor selection value (1-7)
+; %3 = instruction for loading 8 samples as doublewords
+; %4 = size of the 8 samples (QWORD or XMMWORD)
+; %5 = instruction for loading one sample as a doubleword
+; %6 = size of one sample (BYTE or WORD)
+; %7 = sample size in bytes
+
+; r10d = JDIMENSION width
+; r11 = JSAMPROW input_buf
+; r12 = JSAMPROW prev_row
+; r13 = JDIFFROW diff_buf
+
+%define wk(i)   r15 - (WK_NUM - (i)) * SIZEOF_YMMWORD  ; ymmword wk[WK_NUM]
+%define WK_NUM  2
+
+%macro DIFFERENCE 7
+    align       32
+    GLOBAL_FUNCTION(%1)
+
+EXTN(%1):
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    push        r15
+    and         rsp, byte (-SIZEOF_YMMWORD)  ; align to 256 bits
+    ; Allocate stack space for wk array.  r15 is used to access it.
+    mov         r15, rsp
+    sub         rsp, (SIZEOF_YMMWORD * WK_NUM)
+    COLLECT_ARGS 4
+    push        rbx
+
+    mov         ecx, r10d               ; width
+    test        rcx, rcx
+    jz          near .return
+
+    mov         rsi, r11                ; input_buf
+    mov         rdx, r12                ; prev_row
+    mov         rdi, r13                ; diff_buf
+
+    %5          eax, %6 [rsi]
+    %5          ebx, %6 [rdx]
+    sub         eax, ebx
+    mov         DWORD [rdi], eax        ; diff_buf[0] = input_buf[0] - Rb
+
+    add         rsi, byte %7
+    add         rdx, byte %7
+    add         rdi, byte SIZEOF_DWORD
+    dec         rcx
+    jz          near .return
+
+.columnloop:
+    cmp         rcx, byte 8
+    jb          short .column_tail
+
+    DIFFERENCE8 %2, %3, %4, %7
+    vmovdqu     YMMWORD [rdi], ymm0
+
+    add         rsi, byte 8*%7
+    add         rdx, byte 8*%7
+    add         rdi, byte 8*SIZEOF_DWORD
+    sub         rcx, byte 8
+    jnz         short .columnloop
+    jmp         near .return
+
+.column_tail:
+    ; Copy the remaining samples, along with the samples to their left, to the
+    ; stack.
+    mov         rbx, rcx                ; remaining columns
+    push        rdi
+    lea         rcx, [rbx+1]
+    sub         rsi, byte %7
+    lea         rdi, [wk(0)]
+    imul        rcx, rcx, byte %7
+    rep movsb
+%if %2 != 1
+    lea         rcx, [rbx+1]
+    mov         rsi, rdx
+    sub         rsi, byte %7
+    lea         rdi, [wk(1)]
+    imul        rcx, rcx, byte %7
+    rep movsb
+%endif
+    pop         rdi
+    lea         rsi, [wk(0)+%7]
+    lea         rdx, [wk(1)+%7]
+
+    DIFFERENCE8 %2, %3, %4, %7
+
+    vmovd       xmm5, ebx
+    vpbroadcastd ymm5, xmm5
+    vpcmpgtd    ymm5, ymm5, [rel PD_LANE_INDEX]
+    vpmaskmovd  YMMWORD [rdi], ymm5, ymm0
+
+.return:
+    pop         rbx
+    vzeroupper
+    UNCOLLECT_ARGS 4
+    lea         rsp, [rbp-8]
+    pop         r15
+    pop         rbp
+    ret
+%endmacro
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_TEXT
+    BITS        64
+
+; 8-bit samples
+    DIFFERENCE  jsimd_difference1_avx2, 1, vpmovzxbd, QWORD, movzx, BYTE, 1
+    DIFFERENCE  jsimd_difference2_avx2, 2, vpmovzxbd, QWORD, movzx, BYTE, 1
+    DIFFERENCE  jsimd_difference3_avx2, 3, vpmovzxbd, QWORD, movzx, BYTE, 1
+    DIFFERENCE  jsimd_difference4_avx2, 4, vpmovzxbd, QWORD, movzx, BYTE, 1
+    DIFFERENCE  jsimd_difference5_avx2, 5, vpmovzxbd, QWORD, movzx, BYTE, 1
+    DIFFERENCE  jsimd_difference6_avx2, 6, vpmovzxbd, QWORD, movzx, BYTE, 1
+    DIFFERENCE  jsimd_difference7_avx2, 7, vpmovzxbd, QWORD, movzx, BYTE, 1
+
+; 12-bit samples (J12SAMPLE is signed)
+    DIFFERENCE  j12simd_difference1_avx2, 1, vpmovsxwd, XMMWORD, movsx, WORD, 2
+    DIFFERENCE  j12simd_difference2_avx2, 2, vpmovsxwd, XMMWORD, movsx, WORD, 2
+    DIFFERENCE  j12simd_difference3_avx2, 3, vpmovsxwd, XMMWORD, movsx, WORD, 2
+    DIFFERENCE  j12simd_difference4_avx2, 4, vpmovsxwd, XMMWORD, movsx, WORD, 2
+    DIFFERENCE  j12simd_difference5_avx2, 5, vpmovsxwd, XMMWORD, movsx, WORD, 2
+    DIFFERENCE  j12simd_difference6_avx2, 6, vpmovsxwd, XMMWORD, movsx, WORD, 2
+    DIFFERENCE  j12simd_difference7_avx2, 7, vpmovsxwd, XMMWORD, movsx, WORD, 2
+
+; 16-bit samples
+    DIFFERENCE  j16simd_difference1_avx2, 1, vpmovzxwd, XMMWORD, movzx, WORD, 2
+    DIFFERENCE  j16simd_difference2_avx2, 2, vpmovzxwd, XMMWORD, movzx, WORD, 2
+    DIFFERENCE  j16simd_difference3_avx2, 3, vpmovzxwd, XMMWORD, movzx, WORD, 2
+    DIFFERENCE  j16simd_difference4_avx2, 4, vpmovzxwd, XMMWORD, movzx, WORD, 2
+    DIFFERENCE  j16simd_difference5_avx2, 5, vpmovzxwd, XMMWORD, movzx, WORD, 2
+    DIFFERENCE  j16simd_difference6_avx2, 6, vpmovzxwd, XMMWORD, movzx, WORD, 2
+    DIFFERENCE  j16simd_difference7_avx2, 7, vpmovzxwd, XMMWORD, movzx, WORD, 2
+
+; --------------------------------------------------------------------------
+;
+; Point transform (sample downscaling by 2^Pt)
+;
+; GLOBAL(void)
+; jsimd_downscale_avx2(JDIMENSION width, int Al, JSAMPROW input_buf,
+;                      JSAMPROW output_buf);
+;
+; The input and output rows are padded (see alloc_sarray() in jmemmgr.c), so
+; each iteration processes one ymmword regardless of the number of remaining
+; samples.
+
+; r10d = JDIMENSION width
+; r11d = int Al
+; r12 = JSAMPROW input_buf
+; r13 = JSAMPROW output_buf
+
+    align       32
+    GLOBAL_FUNCTION(jsimd_downscale_avx2)
+
+EXTN(jsimd_downscale_avx2):
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    COLLECT_ARGS 4
+
+    mov         eax, r10d               ; width
+    test        rax, rax
+    jz          short .return
+
+    ; There is no byte shift instruction, so shift words and mask off the bits
+    ; that were shifted in from the adjacent sample.
+    mov         ecx, r11d
+    mov         edx, 0xFF
+    shr         edx, cl
+    vmovd       xmm7, edx
+    vpbroadcastb ymm7, xmm7             ; ymm7 = 0xFF >> Al (bytes)
+    vmovd       xmm6, ecx               ; xmm6 = Al
+
+    mov         rsi, r12                ; input_buf
+    mov         rdi, r13                ; output_buf
+.columnloop:
+    vmovdqu     ymm0, YMMWORD [rsi]
+    vpsrlw      ymm0, ymm0, xmm6
+    vpand       ymm0, ymm0, ymm7
+    vmovdqu     YMMWORD [rdi], ymm0
+
+    add         rsi, byte SIZEOF_YMMWORD
+    add         rdi, byte SIZEOF_YMMWORD
+    sub         rax, byte SIZEOF_YMMWORD
+    jg          short .columnloop
+
+.return:
+    vzeroupper
+    UNCOLLECT_ARGS 4
+    pop         rbp
+    ret
+
+; --------------------------------------------------------------------------
+;
+; GLOBAL(void)
+; j12simd_downscale_avx2(JDIMENSION width, int Al, J12SAMPROW input_buf,
+;                        J12SAMPROW output_buf);
+; GLOBAL(void)
+; j16simd_downscale_avx2(JDIMENSION width, int Al, J16SAMPROW input_buf,
+;                        J16SAMPROW output_buf);
+;
+; %1 = function name
+; %2 = shift instruction
+
+; r10d = JDIMENSION width
+; r11d = int Al
+; r12 = J12SAMPROW/J16SAMPROW input_buf
+; r13 = J12SAMPROW/J16SAMPROW output_buf
+
+%macro DOWNSCALE16 2
+    align       32
+    GLOBAL_FUNCTION(%1)
+
+EXTN(%1):
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    COLLECT_ARGS 4
+
+    mov         eax, r10d               ; width
+    test        rax, rax
+    jz          short .return
+
+    vmovd       xmm6, r11d              ; xmm6 = Al
+
+    mov         rsi, r12                ; input_buf
+    mov         rdi, r13                ; output_buf
+.columnloop:
+    vmovdqu     ymm0, YMMWORD [rsi]
+    %2          ymm0, ymm0, xmm6
+    vmovdqu     YMMWORD [rdi], ymm0
+
+    add         rsi, byte SIZEOF_YMMWORD
+    add         rdi, byte SIZEOF_YMMWORD
+    sub         rax, byte SIZEOF_YMMWORD/2
+    jg          short .columnloop
+
+.return:
+    vzeroupper
+    UNCOLLECT_ARGS 4
+    pop         rbp
+    ret
+%endmacro
+
+    DOWNSCALE16 j12simd_downscale_avx2, vpsraw
+    DOWNSCALE16 j16simd_downscale_avx2, vpsrlw
+
+; For some reason, the OS X linker does not honor the request to align the
+; segment unless we do this.
+    align       32
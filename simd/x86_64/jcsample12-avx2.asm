@@ -0,0 +1,270 @@
+;
+; jcsample12.asm - downsampling for 12-bit samples (64-bit AVX2)
+;
+; Copyright (C) 2026, Mozilla Corporation.
+;
+; Based on the x86 SIMD extension for IJG JPEG library
+; Copyright (C) 1999-2006, MIYASAKA Masaru.
+; For conditions of distribution and use, see copyright notice in jsimdext.inc
+;
+; This file should be assembled with NASM (Netwide Assembler) or Yasm.
+;
+; Unlike the 8-bit implementation, these routines take the number of output
+; columns rather than the width in blocks, so that they also work in lossless
+; mode (in which each "block" is a single sample.)  The input and output rows
+; are padded (see alloc_sarray() in jmemmgr.c), so each iteration processes 16
+; output samples regardless of the number of remaining columns.
+
+%include "jsimdext.inc"
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_TEXT
+    BITS        64
+;
+; Downsample pixel values of a single component.
+; This version handles the common case of 2:1 horizontal and 1:1 vertical,
+; without smoothing.
+;
+; GLOBAL(void)
+; j12simd_h2v1_downsample_avx2(JDIMENSION image_width, int max_v_samp_factor,
+;                              JDIMENSION v_samp_factor,
+;                              JDIMENSION output_cols,
+;                              J12SAMPARRAY input_data,
+;                              J12SAMPARRAY output_data);
+;
+
+; r10d = JDIMENSION image_width
+; r11 = int max_v_samp_factor
+; r12d = JDIMENSION v_samp_factor
+; r13d = JDIMENSION output_cols
+; r14 = J12SAMPARRAY input_data
+; r15 = J12SAMPARRAY output_data
+
+    align       32
+    GLOBAL_FUNCTION(j12simd_h2v1_downsample_avx2)
+
+EXTN(j12simd_h2v1_downsample_avx2):
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    COLLECT_ARGS 6
+
+    mov         ecx, r13d               ; output_cols
+    test        rcx, rcx
+    jz          near .return
+
+    mov         ecx, r13d
+    shl         rcx, 1                  ; output_cols * 2
+    mov         edx, r10d
+    sub         rcx, rdx
+    jle         short .expand_end
+
+    mov         rax, r11
+    test        rax, rax
+    jle         short .expand_end
+
+    cld
+    mov         rsi, r14                ; input_data
+.expandloop:
+    push        rax
+    push        rcx
+
+    mov         rdip, J12SAMPROW [rsi]
+    lea         rdi, [rdi+rdx*SIZEOF_J12SAMPLE]
+    mov         ax, J12SAMPLE [rdi-1*SIZEOF_J12SAMPLE]
+
+    rep stosw
+
+    pop         rcx
+    pop         rax
+
+    add         rsi, byte SIZEOF_J12SAMPROW
+    dec         rax
+    jg          short .expandloop
+
+.expand_end:
+
+    ; -- h2v1_downsample
+
+    mov         eax, r12d               ; rowctr
+    test        eax, eax
+    jle         near .return
+
+    mov         rdx, 0x0000000100000000  ; bias pattern
+    vmovq       xmm7, rdx
+    vpbroadcastq ymm7, xmm7             ; ymm7={0, 1, 0, 1, 0, 1, 0, 1}
+    vpcmpeqw    ymm6, ymm6, ymm6
+    vpsrlw      ymm6, ymm6, 15          ; ymm6={1 1 1 1 ..}
+
+    mov         rsi, r14                ; input_data
+    mov         rdi, r15                ; output_data
+.rowloop:
+    push        rdi
+    push        rsi
+
+    mov         ecx, r13d               ; output_cols
+    mov         rsip, J12SAMPROW [rsi]  ; inptr
+    mov         rdip, J12SAMPROW [rdi]  ; outptr
+
+.columnloop:
+    vpmaddwd    ymm0, ymm6, YMMWORD [rsi+0*SIZEOF_YMMWORD]
+    vpmaddwd    ymm1, ymm6, YMMWORD [rsi+1*SIZEOF_YMMWORD]
+
+    vpaddd      ymm0, ymm0, ymm7
+    vpaddd      ymm1, ymm1, ymm7
+    vpsrld      ymm0, ymm0, 1           ; ymm0=( 0  1  2  3  4  5  6  7)
+    vpsrld      ymm1, ymm1, 1           ; ymm1=( 8  9 10 11 12 13 14 15)
+
+    vpackssdw   ymm0, ymm0, ymm1
+    vpermq      ymm0, ymm0, 0xd8
+
+    vmovdqu     YMMWORD [rdi+0*SIZEOF_YMMWORD], ymm0
+
+    add         rsi, byte 2*SIZEOF_YMMWORD  ; inptr
+    add         rdi, byte 1*SIZEOF_YMMWORD  ; outptr
+    sub         rcx, byte SIZEOF_YMMWORD/SIZEOF_J12SAMPLE  ; outcol
+    jg          short .columnloop
+
+    pop         rsi
+    pop         rdi
+
+    add         rsi, byte SIZEOF_J12SAMPROW  ; input_data
+    add         rdi, byte SIZEOF_J12SAMPROW  ; output_data
+    dec         rax                          ; rowctr
+    jg          near .rowloop
+
+.return:
+    vzeroupper
+    UNCOLLECT_ARGS 6
+    pop         rbp
+    ret
+
+; --------------------------------------------------------------------------
+;
+; Downsample pixel values of a single component.
+; This version handles the standard case of 2:1 horizontal and 2:1 vertical,
+; without smoothing.
+;
+; GLOBAL(void)
+; j12simd_h2v2_downsample_avx2(JDIMENSION image_width, int max_v_samp_factor,
+;                              JDIMENSION v_samp_factor,
+;                              JDIMENSION output_cols,
+;                              J12SAMPARRAY input_data,
+;                              J12SAMPARRAY output_data);
+;
+
+; r10d = JDIMENSION image_width
+; r11 = int max_v_samp_factor
+; r12d = JDIMENSION v_samp_factor
+; r13d = JDIMENSION output_cols
+; r14 = J12SAMPARRAY input_data
+; r15 = J12SAMPARRAY output_data
+
+    align       32
+    GLOBAL_FUNCTION(j12simd_h2v2_downsample_avx2)
+
+EXTN(j12simd_h2v2_downsample_avx2):
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    COLLECT_ARGS 6
+
+    mov         ecx, r13d               ; output_cols
+    test        rcx, rcx
+    jz          near .return
+
+    mov         ecx, r13d
+    shl         rcx, 1                  ; output_cols * 2
+    mov         edx, r10d
+    sub         rcx, rdx
+    jle         short .expand_end
+
+    mov         rax, r11
+    test        rax, rax
+    jle         short .expand_end
+
+    cld
+    mov         rsi, r14                ; input_data
+.expandloop:
+    push        rax
+    push        rcx
+
+    mov         rdip, J12SAMPROW [rsi]
+    lea         rdi, [rdi+rdx*SIZEOF_J12SAMPLE]
+    mov         ax, J12SAMPLE [rdi-1*SIZEOF_J12SAMPLE]
+
+    rep stosw
+
+    pop         rcx
+    pop         rax
+
+    add         rsi, byte SIZEOF_J12SAMPROW
+    dec         rax
+    jg          short .expandloop
+
+.expand_end:
+
+    ; -- h2v2_downsample
+
+    mov         eax, r12d               ; rowctr
+    test        rax, rax
+    jle         near .return
+
+    mov         rdx, 0x0000000200000001  ; bias pattern
+    vmovq       xmm7, rdx
+    vpbroadcastq ymm7, xmm7             ; ymm7={1, 2, 1, 2, 1, 2, 1, 2}
+    vpcmpeqw    ymm6, ymm6, ymm6
+    vpsrlw      ymm6, ymm6, 15          ; ymm6={1 1 1 1 ..}
+
+    mov         rsi, r14                ; input_data
+    mov         rdi, r15                ; output_data
+.rowloop:
+    push        rdi
+    push        rsi
+
+    mov         ecx, r13d                                 ; output_cols
+    mov         rdxp, J12SAMPROW [rsi+0*SIZEOF_J12SAMPROW]  ; inptr0
+    mov         rsip, J12SAMPROW [rsi+1*SIZEOF_J12SAMPROW]  ; inptr1
+    mov         rdip, J12SAMPROW [rdi]                      ; outptr
+
+.columnloop:
+    vmovdqu     ymm0, YMMWORD [rdx+0*SIZEOF_YMMWORD]
+    vmovdqu     ymm1, YMMWORD [rdx+1*SIZEOF_YMMWORD]
+    vpaddw      ymm0, ymm0, YMMWORD [rsi+0*SIZEOF_YMMWORD]
+    vpaddw      ymm1, ymm1, YMMWORD [rsi+1*SIZEOF_YMMWORD]
+
+    vpmaddwd    ymm0, ymm0, ymm6
+    vpmaddwd    ymm1, ymm1, ymm6
+    vpaddd      ymm0, ymm0, ymm7
+    vpaddd      ymm1, ymm1, ymm7
+    vpsrld      ymm0, ymm0, 2           ; ymm0=( 0  1  2  3  4  5  6  7)
+    vpsrld      ymm1, ymm1, 2           ; ymm1=( 8  9 10 11 12 13 14 15)
+
+    vpackssdw   ymm0, ymm0, ymm1
+    vpermq      ymm0, ymm0, 0xd8
+
+    vmovdqu     YMMWORD [rdi+0*SIZEOF_YMMWORD], ymm0
+
+    add         rdx, byte 2*SIZEOF_YMMWORD  ; inptr0
+    add         rsi, byte 2*SIZEOF_YMMWORD  ; inptr1
+    add         rdi, byte 1*SIZEOF_YMMWORD  ; outptr
+    sub         rcx, byte SIZEOF_YMMWORD/SIZEOF_J12SAMPLE  ; outcol
+    jg          short .columnloop
+
+    pop         rsi
+    pop         rdi
+
+    add         rsi, byte 2*SIZEOF_J12SAMPROW  ; input_data
+    add         rdi, byte 1*SIZEOF_J12SAMPROW  ; output_data
+    dec         rax                            ; rowctr
+    jg          near .rowloop
+
+.return:
+    vzeroupper
+    UNCOLLECT_ARGS 6
+    pop         rbp
+    ret
+
+; For some reason, the OS X linker does not honor the request to align the
+; segment unless we do this.
+    align       32
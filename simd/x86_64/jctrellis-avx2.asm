@@ -0,0 +1,174 @@
+;
+; jctrellis.asm - trellis quantization rate/distortion search (64-bit AVX2)
+;
+; Copyright (C) 2026, Mozilla Corporation.
+;
+; For conditions of distribution and use, see copyright notice in jsimdext.inc
+;
+; This file should be assembled with NASM (Netwide Assembler) or Yasm.
+;
+; This file contains an AVX2 implementation of the search for the cheapest
+; (run start, candidate value) combination for one AC coefficient during
+; Huffman trellis quantization.  See trellis_search() in jcdctmgr.c for more
+; details.
+
+%include "jsimdext.inc"
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_CONST
+
+    ALIGNZ      32
+    GLOBAL_DATA(jconst_trellis_search_avx2)
+
+EXTN(jconst_trellis_search_avx2):
+
+PD_BITS_LO  dd  1, 2, 3, 4, 5, 6, 7, 8
+PD_BITS_HI  dd  9, 10, 11, 12
+PD_MAXCOST  dd  0x7E967699              ; 1e38f
+
+    ALIGNZ      32
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_TEXT
+    BITS        64
+;
+; Find the cheapest way to code one AC coefficient.
+;
+; GLOBAL(int)
+; jsimd_trellis_search_avx2(const char *ehufsi, const int *runs,
+;                           const float *run_cost, int num_runs,
+;                           const float *candidate_dist, int num_candidates);
+;
+; Candidate k is evaluated in lane k of ymm0/ymm2 (k < 8) or in lane k-8 of
+; xmm1/xmm3 (8 <= k < 12), and each lane keeps the cheapest run start for its
+; candidate.  The costs are computed with the same single-precision operations
+; as in the C implementation, and each lane only moves to a later run start if
+; that is strictly cheaper, so a scalar reduction over the lanes that prefers
+; the lowest run start and then the lowest candidate yields exactly the result
+; of the C implementation.
+;
+; At most 12 candidates are supported, which is more than the 10 that can
+; occur with 8-bit data precision.  candidate_dist must be readable for 12
+; entries, and all lanes are evaluated regardless of num_candidates.  The
+; lanes beyond num_candidates are then simply ignored by the reduction.
+
+; r10 = const char *ehufsi
+; r11 = const int *runs
+; r12 = const float *run_cost
+; r13d = int num_runs
+; r14 = const float *candidate_dist
+; r15d = int num_candidates
+
+%define COSTS  rsp                               ; float costs[16]
+%define RUNS   rsp + 16 * SIZEOF_FP32            ; int runs[16]
+
+    align       32
+    GLOBAL_FUNCTION(jsimd_trellis_search_avx2)
+
+EXTN(jsimd_trellis_search_avx2):
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    PUSH_XMM    4
+    COLLECT_ARGS 6
+    sub         rsp, 4 * SIZEOF_YMMWORD
+
+    vbroadcastss ymm0, FP32 [rel PD_MAXCOST]    ; ymm0=best cost (cand. 0-7)
+    vmovaps     xmm1, xmm0                      ; xmm1=best cost (cand. 8-11)
+    vpcmpeqd    ymm2, ymm2, ymm2                ; ymm2=best run start (0-7)
+    vpcmpeqd    xmm3, xmm3, xmm3                ; xmm3=best run start (8-11)
+    vmovups     ymm4, YMMWORD [r14]             ; ymm4=candidate_dist[0..7]
+    vmovups     xmm5, XMMWORD [r14 + 8 * SIZEOF_FP32]  ; candidate_dist[8..11]
+    vpxor       ymm6, ymm6, ymm6
+
+    xor         ecx, ecx                        ; rcx=r
+    test        r13d, r13d
+    jle         near .REDUCE
+
+    align       16
+.RUNLOOP:
+    mov         eax, INT [r11 + rcx * 8]        ; rax=runs[2*r]
+    vpbroadcastd ymm9, INT [r11 + rcx * 8 + SIZEOF_INT]  ; ymm9=runs[2*r+1]
+    vbroadcastss ymm8, FP32 [r12 + rcx * SIZEOF_FP32]   ; ymm8=run_cost[r]
+    vmovd       xmm7, ecx
+    vpbroadcastd ymm7, xmm7                     ; ymm7=r
+
+    ; Candidates 0-7
+    vpmovzxbd   ymm10, XMM_MMWORD [r10 + rax + 1]  ; ymm10=coef_bits
+    vpcmpeqd    ymm11, ymm10, ymm6              ; ymm11=(coef_bits == 0)
+    vpaddd      ymm10, ymm10, ymm9
+    vpaddd      ymm10, ymm10, YMMWORD [rel PD_BITS_LO]  ; ymm10=rate
+    vcvtdq2ps   ymm10, ymm10
+    vaddps      ymm10, ymm10, ymm4
+    vaddps      ymm10, ymm10, ymm8              ; ymm10=cost
+    vblendvps   ymm10, ymm10, ymm0, ymm11       ; skip codes that don't exist
+    vcmpltps    ymm11, ymm10, ymm0
+    vblendvps   ymm0, ymm0, ymm10, ymm11
+    vblendvps   ymm2, ymm2, ymm7, ymm11
+
+    cmp         r15d, 8
+    jle         short .NEXTRUN
+
+    ; Candidates 8-11
+    vpmovzxbd   xmm10, XMM_DWORD [r10 + rax + 9]   ; xmm10=coef_bits
+    vpcmpeqd    xmm11, xmm10, xmm6
+    vpaddd      xmm10, xmm10, xmm9
+    vpaddd      xmm10, xmm10, XMMWORD [rel PD_BITS_HI]
+    vcvtdq2ps   xmm10, xmm10
+    vaddps      xmm10, xmm10, xmm5
+    vaddps      xmm10, xmm10, xmm8
+    vblendvps   xmm10, xmm10, xmm1, xmm11
+    vcmpltps    xmm11, xmm10, xmm1
+    vblendvps   xmm1, xmm1, xmm10, xmm11
+    vblendvps   xmm3, xmm3, xmm7, xmm11
+
+.NEXTRUN:
+    inc         ecx
+    cmp         ecx, r13d
+    jl          near .RUNLOOP
+
+.REDUCE:
+    vmovups     YMMWORD [COSTS], ymm0
+    vmovups     XMMWORD [COSTS + 8 * SIZEOF_FP32], xmm1
+    vmovdqu     YMMWORD [RUNS], ymm2
+    vmovdqu     XMMWORD [RUNS + 8 * SIZEOF_INT], xmm3
+
+    vmovss      xmm0, FP32 [rel PD_MAXCOST]     ; xmm0=best cost
+    mov         eax, -1                         ; eax=best (r << 4) + k
+    mov         edx, -1                         ; edx=best r
+    xor         ecx, ecx                        ; rcx=k
+    test        r15d, r15d
+    jle         short .RETURN
+
+.REDUCELOOP:
+    mov         esi, INT [RUNS + rcx * SIZEOF_INT]
+    test        esi, esi
+    js          short .NEXTLANE                 ; lane was never updated
+    vmovss      xmm1, FP32 [COSTS + rcx * SIZEOF_FP32]
+    vucomiss    xmm1, xmm0
+    jb          short .TAKE                     ; cheaper
+    jne         short .NEXTLANE                 ; more expensive
+    cmp         esi, edx
+    jge         short .NEXTLANE                 ; same cost, later run start
+.TAKE:
+    vmovaps     xmm0, xmm1
+    mov         edx, esi
+    mov         eax, esi
+    shl         eax, 4
+    add         eax, ecx
+.NEXTLANE:
+    inc         ecx
+    cmp         ecx, r15d
+    jl          short .REDUCELOOP
+
+.RETURN:
+    add         rsp, 4 * SIZEOF_YMMWORD
+    vzeroupper
+    UNCOLLECT_ARGS 6
+    POP_XMM     4
+    pop         rbp
+    ret
+
+; For some reason, the OS X linker does not honor the request to align the
+; segment unless we do this.
+    align       32
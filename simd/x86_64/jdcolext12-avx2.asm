@@ -0,0 +1,305 @@
+;
+; jdcolext12.asm - colorspace conversion for 12-bit samples (64-bit AVX2)
+;
+; Copyright (C) 2026, Mozilla Corporation.
+;
+; Based on the x86 SIMD extension for IJG JPEG library
+; Copyright (C) 1999-2006, MIYASAKA Masaru.
+; For conditions of distribution and use, see copyright notice in jsimdext.inc
+;
+; This file should be assembled with NASM (Netwide Assembler) or Yasm.
+
+; --------------------------------------------------------------------------
+; Before the output pixels are interleaved, ymm1-ymm3 contain the red, green,
+; and blue samples, and ymm0 contains the unused samples (if any).  ymmPn
+; refers to the register containing the samples with offset n within the
+; pixel.
+
+%if RGB_RED == 0
+%define ymmP0  ymm1
+%elif RGB_GREEN == 0
+%define ymmP0  ymm2
+%elif RGB_BLUE == 0
+%define ymmP0  ymm3
+%else
+%define ymmP0  ymm0
+%endif
+
+%if RGB_RED == 1
+%define ymmP1  ymm1
+%elif RGB_GREEN == 1
+%define ymmP1  ymm2
+%elif RGB_BLUE == 1
+%define ymmP1  ymm3
+%else
+%define ymmP1  ymm0
+%endif
+
+%if RGB_RED == 2
+%define ymmP2  ymm1
+%elif RGB_GREEN == 2
+%define ymmP2  ymm2
+%elif RGB_BLUE == 2
+%define ymmP2  ymm3
+%else
+%define ymmP2  ymm0
+%endif
+
+%if RGB_RED == 3
+%define ymmP3  ymm1
+%elif RGB_GREEN == 3
+%define ymmP3  ymm2
+%elif RGB_BLUE == 3
+%define ymmP3  ymm3
+%else
+%define ymmP3  ymm0
+%endif
+
+; --------------------------------------------------------------------------
+;
+; Convert some rows of samples to the output colorspace.
+;
+; GLOBAL(void)
+; j12simd_ycc_rgb_convert_avx2(JDIMENSION out_width, J12SAMPIMAGE input_buf,
+;                              JDIMENSION input_row, J12SAMPARRAY output_buf,
+;                              int num_rows)
+;
+; The input rows are padded (see alloc_sarray() in jmemmgr.c), so each
+; iteration loads 16 samples from them.  The output rows are not, so the last
+; pixels of a row are stored to the stack and then copied to the output.
+
+; r10d = JDIMENSION out_width
+; r11 = J12SAMPIMAGE input_buf
+; r12d = JDIMENSION input_row
+; r13 = J12SAMPARRAY output_buf
+; r14d = int num_rows
+
+%define wk(i)   r15 - (WK_NUM - (i)) * SIZEOF_YMMWORD  ; ymmword wk[WK_NUM]
+%define WK_NUM  4
+
+    align       32
+    GLOBAL_FUNCTION(j12simd_ycc_rgb_convert_avx2)
+
+EXTN(j12simd_ycc_rgb_convert_avx2):
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    push        r15
+    and         rsp, byte (-SIZEOF_YMMWORD)  ; align to 256 bits
+    ; Allocate stack space for wk array.  r15 is used to access it.
+    mov         r15, rsp
+    sub         rsp, (SIZEOF_YMMWORD * WK_NUM)
+    PUSH_XMM    4
+    COLLECT_ARGS 5
+    push        rbx
+
+    mov         ecx, r10d               ; num_cols
+    test        rcx, rcx
+    jz          near .return
+
+    push        rcx
+
+    mov         rdi, r11
+    mov         ecx, r12d
+    mov         rsip, J12SAMPARRAY [rdi+0*SIZEOF_JSAMPARRAY]
+    mov         rbxp, J12SAMPARRAY [rdi+1*SIZEOF_JSAMPARRAY]
+    mov         rdxp, J12SAMPARRAY [rdi+2*SIZEOF_JSAMPARRAY]
+    lea         rsi, [rsi+rcx*SIZEOF_J12SAMPROW]
+    lea         rbx, [rbx+rcx*SIZEOF_J12SAMPROW]
+    lea         rdx, [rdx+rcx*SIZEOF_J12SAMPROW]
+
+    pop         rcx
+
+    mov         rdi, r13
+    mov         eax, r14d
+    test        rax, rax
+    jle         near .return
+.rowloop:
+    push        rax
+    push        rdi
+    push        rdx
+    push        rbx
+    push        rsi
+    push        rcx                     ; col
+
+    mov         rsip, J12SAMPROW [rsi]  ; inptr0
+    mov         rbxp, J12SAMPROW [rbx]  ; inptr1
+    mov         rdxp, J12SAMPROW [rdx]  ; inptr2
+    mov         rdip, J12SAMPROW [rdi]  ; outptr
+.columnloop:
+
+    vmovdqa     ymm6, [rel PW_CENTERJ12SAMP]
+    vmovdqu     ymm0, YMMWORD [rsi]     ; ymm0=Y
+    vmovdqu     ymm4, YMMWORD [rbx]     ; ymm4=Cb
+    vmovdqu     ymm5, YMMWORD [rdx]     ; ymm5=Cr
+    vpsubw      ymm4, ymm4, ymm6        ; ymm4=Cb-CENTERJ12SAMPLE
+    vpsubw      ymm5, ymm5, ymm6        ; ymm5=Cr-CENTERJ12SAMPLE
+
+    ; (Original)
+    ; R = Y                + 1.40200 * Cr
+    ; G = Y - 0.34414 * Cb - 0.71414 * Cr
+    ; B = Y + 1.77200 * Cb
+    ;
+    ; (This implementation)
+    ; R = Y                + 0.40200 * Cr + Cr
+    ; G = Y - 0.34414 * Cb + 0.28586 * Cr - Cr
+    ; B = Y - 0.22800 * Cb + Cb + Cb
+    ;
+    ; The products are rounded the same way as in the C implementation.
+
+    vmovdqa     ymm7, [rel PW_TWO]
+
+    vpunpcklwd  ymm8, ymm5, ymm7
+    vpunpckhwd  ymm9, ymm5, ymm7
+    vpmaddwd    ymm8, ymm8, [rel PW_F0402_F025]
+    vpmaddwd    ymm9, ymm9, [rel PW_F0402_F025]
+    vpsrad      ymm8, ymm8, SCALEBITS
+    vpsrad      ymm9, ymm9, SCALEBITS
+    vpackssdw   ymm8, ymm8, ymm9        ; ymm8=(Cr * FIX(0.402))
+    vpaddw      ymm1, ymm0, ymm5
+    vpaddw      ymm1, ymm1, ymm8        ; ymm1=R
+
+    vpunpcklwd  ymm8, ymm4, ymm7
+    vpunpckhwd  ymm9, ymm4, ymm7
+    vpmaddwd    ymm8, ymm8, [rel PW_MF0228_F025]
+    vpmaddwd    ymm9, ymm9, [rel PW_MF0228_F025]
+    vpsrad      ymm8, ymm8, SCALEBITS
+    vpsrad      ymm9, ymm9, SCALEBITS
+    vpackssdw   ymm8, ymm8, ymm9        ; ymm8=(Cb * -FIX(0.228))
+    vpaddw      ymm3, ymm0, ymm4
+    vpaddw      ymm3, ymm3, ymm4
+    vpaddw      ymm3, ymm3, ymm8        ; ymm3=B
+
+    vpunpcklwd  ymm8, ymm4, ymm5
+    vpunpckhwd  ymm9, ymm4, ymm5
+    vpmaddwd    ymm8, ymm8, [rel PW_MF0344_F0285]
+    vpmaddwd    ymm9, ymm9, [rel PW_MF0344_F0285]
+    vmovdqa     ymm7, [rel PD_ONEHALF]
+    vpaddd      ymm8, ymm8, ymm7
+    vpaddd      ymm9, ymm9, ymm7
+    vpsrad      ymm8, ymm8, SCALEBITS
+    vpsrad      ymm9, ymm9, SCALEBITS
+    vpackssdw   ymm8, ymm8, ymm9        ; ymm8=(Cb * -FIX(0.344) + Cr * FIX(0.285))
+    vpsubw      ymm2, ymm0, ymm5
+    vpaddw      ymm2, ymm2, ymm8        ; ymm2=G
+
+    vpxor       ymm6, ymm6, ymm6
+    vmovdqa     ymm0, [rel PW_MAXJ12SAMP]  ; ymm0=X
+    vpmaxsw     ymm1, ymm1, ymm6
+    vpmaxsw     ymm2, ymm2, ymm6
+    vpmaxsw     ymm3, ymm3, ymm6
+    vpminsw     ymm1, ymm1, ymm0
+    vpminsw     ymm2, ymm2, ymm0
+    vpminsw     ymm3, ymm3, ymm0
+
+%if RGB_PIXELSIZE == 3  ; ---------------
+
+    vpshufb     ymm4, ymmP0, [rel PB_SCATTER3_0_0]
+    vpshufb     ymm7, ymmP1, [rel PB_SCATTER3_0_1]
+    vpshufb     ymm8, ymmP2, [rel PB_SCATTER3_0_2]
+    vpor        ymm4, ymm4, ymm7
+    vpor        ymm4, ymm4, ymm8        ; ymm4=(00 01 02 10 11 12 20 21  80 81 ..)
+
+    vpshufb     ymm5, ymmP0, [rel PB_SCATTER3_1_0]
+    vpshufb     ymm7, ymmP1, [rel PB_SCATTER3_1_1]
+    vpshufb     ymm8, ymmP2, [rel PB_SCATTER3_1_2]
+    vpor        ymm5, ymm5, ymm7
+    vpor        ymm5, ymm5, ymm8        ; ymm5=(22 30 31 32 40 41 42 50  A2 B0 ..)
+
+    vpshufb     ymm6, ymmP0, [rel PB_SCATTER3_2_0]
+    vpshufb     ymm7, ymmP1, [rel PB_SCATTER3_2_1]
+    vpshufb     ymm8, ymmP2, [rel PB_SCATTER3_2_2]
+    vpor        ymm6, ymm6, ymm7
+    vpor        ymm6, ymm6, ymm8        ; ymm6=(51 52 60 61 62 70 71 72  D1 D2 ..)
+
+    vperm2i128  ymm7, ymm4, ymm5, 0x20  ; ymm7=(00 01 02 10 .. 42 50)
+    vperm2i128  ymm8, ymm6, ymm4, 0x30  ; ymm8=(51 52 60 61 .. 92 A0 A1)
+    vperm2i128  ymm9, ymm5, ymm6, 0x31  ; ymm9=(A2 B0 B1 B2 .. F1 F2)
+
+%else  ; RGB_PIXELSIZE == 4 ; -----------
+
+    vpunpcklwd  ymm4, ymmP0, ymmP1      ; ymm4=(00 01 10 11 20 21 30 31  80 81 ..)
+    vpunpckhwd  ymm5, ymmP0, ymmP1      ; ymm5=(40 41 50 51 60 61 70 71  C0 C1 ..)
+    vpunpcklwd  ymm6, ymmP2, ymmP3      ; ymm6=(02 03 12 13 22 23 32 33  82 83 ..)
+    vpunpckhwd  ymm7, ymmP2, ymmP3      ; ymm7=(42 43 52 53 62 63 72 73  C2 C3 ..)
+
+    vpunpckldq  ymm8, ymm4, ymm6        ; ymm8=(pixels 0-1 and 8-9)
+    vpunpckhdq  ymm9, ymm4, ymm6        ; ymm9=(pixels 2-3 and 10-11)
+    vpunpckldq  ymm10, ymm5, ymm7       ; ymm10=(pixels 4-5 and 12-13)
+    vpunpckhdq  ymm11, ymm5, ymm7       ; ymm11=(pixels 6-7 and 14-15)
+
+    vperm2i128  ymm4, ymm8, ymm9, 0x20  ; ymm4=(pixels 0-3)
+    vperm2i128  ymm5, ymm10, ymm11, 0x20  ; ymm5=(pixels 4-7)
+    vperm2i128  ymm6, ymm8, ymm9, 0x31  ; ymm6=(pixels 8-11)
+    vperm2i128  ymm7, ymm10, ymm11, 0x31  ; ymm7=(pixels 12-15)
+
+%endif  ; RGB_PIXELSIZE ; ---------------
+
+    cmp         rcx, byte SIZEOF_YMMWORD/SIZEOF_J12SAMPLE
+    jb          short .column_st
+
+%if RGB_PIXELSIZE == 3
+    vmovdqu     YMMWORD [rdi+0*SIZEOF_YMMWORD], ymm7
+    vmovdqu     YMMWORD [rdi+1*SIZEOF_YMMWORD], ymm8
+    vmovdqu     YMMWORD [rdi+2*SIZEOF_YMMWORD], ymm9
+%else
+    vmovdqu     YMMWORD [rdi+0*SIZEOF_YMMWORD], ymm4
+    vmovdqu     YMMWORD [rdi+1*SIZEOF_YMMWORD], ymm5
+    vmovdqu     YMMWORD [rdi+2*SIZEOF_YMMWORD], ymm6
+    vmovdqu     YMMWORD [rdi+3*SIZEOF_YMMWORD], ymm7
+%endif
+
+    add         rsi, byte SIZEOF_YMMWORD           ; inptr0
+    add         rbx, byte SIZEOF_YMMWORD           ; inptr1
+    add         rdx, byte SIZEOF_YMMWORD           ; inptr2
+    add         rdi, RGB_PIXELSIZE*SIZEOF_YMMWORD  ; outptr
+    sub         rcx, byte SIZEOF_YMMWORD/SIZEOF_J12SAMPLE
+    jnz         near .columnloop
+    jmp         short .nextrow
+
+.column_st:
+    ; Store the remaining pixels to the stack, and copy them to the output.
+%if RGB_PIXELSIZE == 3
+    vmovdqa     YMMWORD [wk(0)], ymm7
+    vmovdqa     YMMWORD [wk(1)], ymm8
+    vmovdqa     YMMWORD [wk(2)], ymm9
+    lea         rcx, [rcx+rcx*2]
+    shl         rcx, 1                  ; rcx *= RGB_PIXELSIZE * SIZEOF_J12SAMPLE
+%else
+    vmovdqa     YMMWORD [wk(0)], ymm4
+    vmovdqa     YMMWORD [wk(1)], ymm5
+    vmovdqa     YMMWORD [wk(2)], ymm6
+    vmovdqa     YMMWORD [wk(3)], ymm7
+    shl         rcx, 3                  ; rcx *= RGB_PIXELSIZE * SIZEOF_J12SAMPLE
+%endif
+    lea         rsi, [wk(0)]
+    rep movsb
+
+.nextrow:
+    pop         rcx
+    pop         rsi
+    pop         rbx
+    pop         rdx
+    pop         rdi
+    pop         rax
+
+    add         rsi, byte SIZEOF_J12SAMPROW
+    add         rbx, byte SIZEOF_J12SAMPROW
+    add         rdx, byte SIZEOF_J12SAMPROW
+    add         rdi, byte SIZEOF_J12SAMPROW  ; output_buf
+    dec         rax                          ; num_rows
+    jg          near .rowloop
+
+.return:
+    pop         rbx
+    vzeroupper
+    UNCOLLECT_ARGS 5
+    POP_XMM     4
+    lea         rsp, [rbp-8]
+    pop         r15
+    pop         rbp
+    ret
+
+; For some reason, the OS X linker does not honor the request to align the
+; segment unless we do this.
+    align       32
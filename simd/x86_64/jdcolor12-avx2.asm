@@ -0,0 +1,128 @@
+;
+; jdcolor12.asm - colorspace conversion for 12-bit samples (64-bit AVX2)
+;
+; Copyright (C) 2026, Mozilla Corporation.
+;
+; Based on the x86 SIMD extension for IJG JPEG library
+; Copyright (C) 1999-2006, MIYASAKA Masaru.
+; For conditions of distribution and use, see copyright notice in jsimdext.inc
+;
+; This file should be assembled with NASM (Netwide Assembler) or Yasm.
+
+%include "jsimdext.inc"
+
+; --------------------------------------------------------------------------
+
+%define SCALEBITS  16
+
+F_0_344 equ  22554              ; FIX(0.34414)
+F_0_714 equ  46802              ; FIX(0.71414)
+F_1_402 equ  91881              ; FIX(1.40200)
+F_1_772 equ 116130              ; FIX(1.77200)
+F_0_402 equ (F_1_402 - 65536)   ; FIX(1.40200) - FIX(1)
+F_0_285 equ ( 65536 - F_0_714)  ; FIX(1) - FIX(0.71414)
+F_0_228 equ (131072 - F_1_772)  ; FIX(2) - FIX(1.77200)
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_CONST
+
+    ALIGNZ      32
+    GLOBAL_DATA(j12const_ycc_rgb_convert_avx2)
+
+EXTN(j12const_ycc_rgb_convert_avx2):
+
+PW_F0402_F025   times 8  dw  F_0_402, 1 << (SCALEBITS - 2)
+PW_MF0228_F025  times 8  dw -F_0_228, 1 << (SCALEBITS - 2)
+PW_MF0344_F0285 times 8  dw -F_0_344, F_0_285
+PD_ONEHALF      times 8  dd  1 << (SCALEBITS - 1)
+PW_TWO          times 16 dw  2
+PW_CENTERJ12SAMP times 16 dw CENTERJ12SAMPLE
+PW_MAXJ12SAMP   times 16 dw  MAXJ12SAMPLE
+
+; Shuffle masks that scatter the words of one component into 8 packed 3-word
+; pixels (3 xmmwords).  PB_SCATTER3_j_p places the samples with offset p within
+; the pixel into xmmword j.
+
+PB_SCATTER3_0_0 times 2  db  0x00, 0x01, 0x80, 0x80, 0x80, 0x80, 0x02, 0x03, 0x80, 0x80, 0x80, 0x80, 0x04, 0x05, 0x80, 0x80
+PB_SCATTER3_0_1 times 2  db  0x80, 0x80, 0x00, 0x01, 0x80, 0x80, 0x80, 0x80, 0x02, 0x03, 0x80, 0x80, 0x80, 0x80, 0x04, 0x05
+PB_SCATTER3_0_2 times 2  db  0x80, 0x80, 0x80, 0x80, 0x00, 0x01, 0x80, 0x80, 0x80, 0x80, 0x02, 0x03, 0x80, 0x80, 0x80, 0x80
+PB_SCATTER3_1_0 times 2  db  0x80, 0x80, 0x06, 0x07, 0x80, 0x80, 0x80, 0x80, 0x08, 0x09, 0x80, 0x80, 0x80, 0x80, 0x0A, 0x0B
+PB_SCATTER3_1_1 times 2  db  0x80, 0x80, 0x80, 0x80, 0x06, 0x07, 0x80, 0x80, 0x80, 0x80, 0x08, 0x09, 0x80, 0x80, 0x80, 0x80
+PB_SCATTER3_1_2 times 2  db  0x04, 0x05, 0x80, 0x80, 0x80, 0x80, 0x06, 0x07, 0x80, 0x80, 0x80, 0x80, 0x08, 0x09, 0x80, 0x80
+PB_SCATTER3_2_0 times 2  db  0x80, 0x80, 0x80, 0x80, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80
+PB_SCATTER3_2_1 times 2  db  0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x0E, 0x0F, 0x80, 0x80
+PB_SCATTER3_2_2 times 2  db  0x80, 0x80, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x0E, 0x0F
+
+    ALIGNZ      32
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_TEXT
+    BITS        64
+
+%include "jdcolext12-avx2.asm"
+
+%undef RGB_RED
+%undef RGB_GREEN
+%undef RGB_BLUE
+%undef RGB_PIXELSIZE
+%define RGB_RED  EXT_RGB_RED
+%define RGB_GREEN  EXT_RGB_GREEN
+%define RGB_BLUE  EXT_RGB_BLUE
+%define RGB_PIXELSIZE  EXT_RGB_PIXELSIZE
+%define j12simd_ycc_rgb_convert_avx2  j12simd_ycc_extrgb_convert_avx2
+%include "jdcolext12-avx2.asm"
+
+%undef RGB_RED
+%undef RGB_GREEN
+%undef RGB_BLUE
+%undef RGB_PIXELSIZE
+%define RGB_RED  EXT_RGBX_RED
+%define RGB_GREEN  EXT_RGBX_GREEN
+%define RGB_BLUE  EXT_RGBX_BLUE
+%define RGB_PIXELSIZE  EXT_RGBX_PIXELSIZE
+%define j12simd_ycc_rgb_convert_avx2  j12simd_ycc_extrgbx_convert_avx2
+%include "jdcolext12-avx2.asm"
+
+%undef RGB_RED
+%undef RGB_GREEN
+%undef RGB_BLUE
+%undef RGB_PIXELSIZE
+%define RGB_RED  EXT_BGR_RED
+%define RGB_GREEN  EXT_BGR_GREEN
+%define RGB_BLUE  EXT_BGR_BLUE
+%define RGB_PIXELSIZE  EXT_BGR_PIXELSIZE
+%define j12simd_ycc_rgb_convert_avx2  j12simd_ycc_extbgr_convert_avx2
+%include "jdcolext12-avx2.asm"
+
+%undef RGB_RED
+%undef RGB_GREEN
+%undef RGB_BLUE
+%undef RGB_PIXELSIZE
+%define RGB_RED  EXT_BGRX_RED
+%define RGB_GREEN  EXT_BGRX_GREEN
+%define RGB_BLUE  EXT_BGRX_BLUE
+%define RGB_PIXELSIZE  EXT_BGRX_PIXELSIZE
+%define j12simd_ycc_rgb_convert_avx2  j12simd_ycc_extbgrx_convert_avx2
+%include "jdcolext12-avx2.asm"
+
+%undef RGB_RED
+%undef RGB_GREEN
+%undef RGB_BLUE
+%undef RGB_PIXELSIZE
+%define RGB_RED  EXT_XBGR_RED
+%define RGB_GREEN  EXT_XBGR_GREEN
+%define RGB_BLUE  EXT_XBGR_BLUE
+%define RGB_PIXELSIZE  EXT_XBGR_PIXELSIZE
+%define j12simd_ycc_rgb_convert_avx2  j12simd_ycc_extxbgr_convert_avx2
+%include "jdcolext12-avx2.asm"
+
+%undef RGB_RED
+%undef RGB_GREEN
+%undef RGB_BLUE
+%undef RGB_PIXELSIZE
+%define RGB_RED  EXT_XRGB_RED
+%define RGB_GREEN  EXT_XRGB_GREEN
+%define RGB_BLUE  EXT_XRGB_BLUE
+%define RGB_PIXELSIZE  EXT_XRGB_PIXELSIZE
+%define j12simd_ycc_rgb_convert_avx2  j12simd_ycc_extxrgb_convert_avx2
+%include "jdcolext12-avx2.asm"
@@ -0,0 +1,261 @@
+;
+; jdlossls.asm - lossless reconstruction and point transform (64-bit AVX2)
+;
+; Copyright (C) 2026, Mozilla Corporation.
+;
+; Based on the x86 SIMD extension for IJG JPEG library
+; Copyright (C) 1999-2006, MIYASAKA Masaru.
+; For conditions of distribution and use, see copyright notice in jsimdext.inc
+;
+; This file should be assembled with NASM (Netwide Assembler) or Yasm.
+;
+; This file contains the sample undifferencing and point transform routines
+; for the lossless JPEG decompressor.  The following code is based directly on
+; jdlossls.c; see the jdlossls.c for more details.
+;
+; Predictors 2 and 3 do not depend on the reconstructed sample to the left
+; (Ra), so they can be computed eight samples at a time.  Predictors 1, 4, and
+; 5 are of the form Ra + f(Rb, Rc), and since the reconstructed samples are
+; calculated modulo 2^16, the row can be reconstructed by computing a prefix
+; sum of diff + f(Rb, Rc).  Predictors 6 and 7 shift Ra right, so they have no
+; such formulation and are left to the C implementation.
+
+%include "jsimdext.inc"
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_CONST
+
+    ALIGNZ      32
+    GLOBAL_DATA(jconst_undifference_avx2)
+
+EXTN(jconst_undifference_avx2):
+
+PD_LANE_INDEX  dd 0, 1, 2, 3, 4, 5, 6, 7
+
+    ALIGNZ      32
+
+; --------------------------------------------------------------------------
+;
+; Undifferencer for the second and subsequent rows in a scan or restart
+; interval (see jpeg_undifference*() in jdlossls.c).  The first sample in the
+; row is undifferenced using the vertical predictor (2), and the rest of the
+; samples are undifferenced using the specified predictor.
+;
+; GLOBAL(void)
+; jsimd_undifference<psv>_avx2(JDIMENSION width, JDIFFROW diff_buf,
+;                              JDIFFROW prev_row, JDIFFROW undiff_buf);
+;
+; prev_row and undiff_buf may point to the same row, so each group of Rb
+; values is loaded before the corresponding reconstructed samples are stored,
+; and Rc is derived from the previous group of Rb values rather than being
+; reloaded.
+;
+; %1 = function name
+; %2 = predictor selection value (1-5)
+
+; r10d = JDIMENSION width
+; r11 = JDIFFROW diff_buf
+; r12 = JDIFFROW prev_row
+; r13 = JDIFFROW undiff_buf
+
+%macro UNDIFFERENCE 2
+    align       32
+    GLOBAL_FUNCTION(%1)
+
+EXTN(%1):
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    COLLECT_ARGS 4
+
+    mov         ecx, r10d               ; width
+    test        rcx, rcx
+    jz          near .return
+
+    mov         rsi, r11                ; diff_buf
+    mov         rdx, r12                ; prev_row
+    mov         rdi, r13                ; undiff_buf
+
+    vpcmpeqd    ymm7, ymm7, ymm7
+    vpsrld      ymm7, ymm7, 16          ; ymm7 = 0xFFFF (doublewords)
+
+    vpbroadcastd ymm5, DWORD [rdx]      ; ymm5 = Rb of the previous column
+    mov         eax, DWORD [rsi]
+    add         eax, DWORD [rdx]
+    and         eax, 0xFFFF
+    mov         DWORD [rdi], eax        ; undiff_buf[0] = diff_buf[0] + Rb
+    vmovd       xmm6, eax
+    vpbroadcastd ymm6, xmm6             ; ymm6 = Ra
+
+    add         rsi, byte SIZEOF_DWORD
+    add         rdx, byte SIZEOF_DWORD
+    add         rdi, byte SIZEOF_DWORD
+    dec         rcx
+    jz          near .return
+
+.columnloop:
+    cmp         rcx, byte 8
+    jae         short .column_ld8
+
+    vmovd       xmm4, ecx
+    vpbroadcastd ymm4, xmm4
+    vpcmpgtd    ymm4, ymm4, [rel PD_LANE_INDEX]  ; ymm4 = mask of remaining columns
+    vpmaskmovd  ymm0, ymm4, YMMWORD [rsi]        ; ymm0 = diff
+%if %2 != 1
+    vpmaskmovd  ymm2, ymm4, YMMWORD [rdx]        ; ymm2 = Rb
+%endif
+    jmp         short .column_ld_done
+
+.column_ld8:
+    vmovdqu     ymm0, YMMWORD [rsi]     ; ymm0 = diff
+%if %2 != 1
+    vmovdqu     ymm2, YMMWORD [rdx]     ; ymm2 = Rb
+%endif
+
+.column_ld_done:
+%if %2 != 1 && %2 != 2
+    ; ymm3 = Rc = (Rb of the previous column, Rb[0] .. Rb[6])
+    vperm2i128  ymm3, ymm2, ymm5, 0x03
+    vpalignr    ymm3, ymm2, ymm3, 12
+    vmovdqa     ymm5, ymm2
+%endif
+
+%if %2 == 2
+    vpaddd      ymm0, ymm0, ymm2        ; diff + Rb
+    vpand       ymm0, ymm0, ymm7
+%elif %2 == 3
+    vpaddd      ymm0, ymm0, ymm3        ; diff + Rc
+    vpand       ymm0, ymm0, ymm7
+%else
+%if %2 == 4
+    vpaddd      ymm0, ymm0, ymm2
+    vpsubd      ymm0, ymm0, ymm3        ; diff + Rb - Rc
+%elif %2 == 5
+    vpsubd      ymm1, ymm2, ymm3
+    vpsrad      ymm1, ymm1, 1
+    vpaddd      ymm0, ymm0, ymm1        ; diff + ((Rb - Rc) >> 1)
+%endif
+    ; Compute the prefix sum and add Ra.
+    vpslldq     ymm1, ymm0, 4
+    vpaddd      ymm0, ymm0, ymm1
+    vpslldq     ymm1, ymm0, 8
+    vpaddd      ymm0, ymm0, ymm1
+    vpshufd     ymm1, ymm0, 0xFF
+    vperm2i128  ymm1, ymm1, ymm1, 0x08
+    vpaddd      ymm0, ymm0, ymm1
+    vpaddd      ymm0, ymm0, ymm6
+    vpand       ymm0, ymm0, ymm7
+    vpshufd     ymm6, ymm0, 0xFF
+    vperm2i128  ymm6, ymm6, ymm6, 0x11  ; ymm6 = Ra of the next column
+%endif
+
+    cmp         rcx, byte 8
+    jb          short .column_st_partial
+    vmovdqu     YMMWORD [rdi], ymm0
+
+    add         rsi, byte 8*SIZEOF_DWORD
+    add         rdx, byte 8*SIZEOF_DWORD
+    add         rdi, byte 8*SIZEOF_DWORD
+    sub         rcx, byte 8
+    jnz         near .columnloop
+    jmp         short .return
+
+.column_st_partial:
+    vpmaskmovd  YMMWORD [rdi], ymm4, ymm0
+
+.return:
+    vzeroupper
+    UNCOLLECT_ARGS 4
+    pop         rbp
+    ret
+%endmacro
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_TEXT
+    BITS        64
+
+    UNDIFFERENCE jsimd_undifference1_avx2, 1
+    UNDIFFERENCE jsimd_undifference2_avx2, 2
+    UNDIFFERENCE jsimd_undifference3_avx2, 3
+    UNDIFFERENCE jsimd_undifference4_avx2, 4
+    UNDIFFERENCE jsimd_undifference5_avx2, 5
+
+; --------------------------------------------------------------------------
+;
+; Point transform (sample upscaling by 2^Pt)
+;
+; GLOBAL(void)
+; jsimd_upscale_avx2(JDIMENSION width, int Al, JDIFFROW diff_buf,
+;                    JSAMPROW output_buf);
+; GLOBAL(void)
+; j16simd_upscale_avx2(JDIMENSION width, int Al, JDIFFROW diff_buf,
+;                      J16SAMPROW output_buf);
+;
+; As in jdlossls.c, the shifted values are truncated to the sample size.  The
+; input and output rows are padded (see alloc_sarray() in jmemmgr.c), so each
+; iteration processes 16 samples regardless of the number of remaining
+; samples.
+;
+; %1 = function name
+; %2 = sample size in bytes
+
+; r10d = JDIMENSION width
+; r11d = int Al
+; r12 = JDIFFROW diff_buf
+; r13 = JSAMPROW/J16SAMPROW output_buf
+
+%macro UPSCALE 2
+    align       32
+    GLOBAL_FUNCTION(%1)
+
+EXTN(%1):
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    COLLECT_ARGS 4
+
+    mov         eax, r10d               ; width
+    test        rax, rax
+    jz          short .return
+
+    vmovd       xmm6, r11d              ; xmm6 = Al
+    vpcmpeqd    ymm7, ymm7, ymm7
+    vpsrld      ymm7, ymm7, 32-8*%2     ; ymm7 = (1 << (8 * sample size)) - 1
+
+    mov         rsi, r12                ; diff_buf
+    mov         rdi, r13                ; output_buf
+.columnloop:
+    vmovdqu     ymm0, YMMWORD [rsi+0*SIZEOF_YMMWORD]
+    vmovdqu     ymm1, YMMWORD [rsi+1*SIZEOF_YMMWORD]
+    vpslld      ymm0, ymm0, xmm6
+    vpslld      ymm1, ymm1, xmm6
+    vpand       ymm0, ymm0, ymm7
+    vpand       ymm1, ymm1, ymm7
+    vpackusdw   ymm0, ymm0, ymm1
+    vpermq      ymm0, ymm0, 0xD8        ; ymm0 = (0 1 2 .. 15)
+%if %2 == 1
+    vextracti128 xmm1, ymm0, 1
+    vpackuswb   xmm0, xmm0, xmm1
+    vmovdqu     XMMWORD [rdi], xmm0
+%else
+    vmovdqu     YMMWORD [rdi], ymm0
+%endif
+
+    add         rsi, byte 2*SIZEOF_YMMWORD
+    add         rdi, byte 16*%2
+    sub         rax, byte 16
+    jg          short .columnloop
+
+.return:
+    vzeroupper
+    UNCOLLECT_ARGS 4
+    pop         rbp
+    ret
+%endmacro
+
+    UPSCALE     jsimd_upscale_avx2, 1
+    UPSCALE     j16simd_upscale_avx2, 2
+
+; For some reason, the OS X linker does not honor the request to align the
+; segment unless we do this.
+    align       32
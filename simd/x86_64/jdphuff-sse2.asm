@@ -0,0 +1,107 @@
+;
+; jdphuff-sse2.asm - prepare data for progressive Huffman decoding
+; (64-bit SSE2)
+;
+; Copyright (C) 2026, Mozilla Corporation.
+;
+; Based on the x86 SIMD extension for IJG JPEG library
+; Copyright (C) 1999-2006, MIYASAKA Masaru.
+; For conditions of distribution and use, see copyright notice in jsimdext.inc
+;
+; This file should be assembled with NASM (Netwide Assembler) or Yasm.
+;
+; This file contains an SSE2 implementation of data preparation for
+; progressive Huffman decoding of AC refinement scans.  See jdphuff.c for more
+; details.
+
+%include "jsimdext.inc"
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_TEXT
+    BITS        64
+;
+; Build a bitmap of the coefficients in a spectral band that are already
+; nonzero.  Bit k of the return value is set if
+; block[jpeg_natural_order_start[k]] is nonzero (0 <= k < Sl < 64.)
+;
+; The coefficients are gathered 8 at a time, so up to 7 entries of
+; jpeg_natural_order_start[] beyond Sl are read.  jpeg_natural_order[] has 16
+; extra entries, all of which point within the block (see jutils.c), and the
+; corresponding bits are discarded.
+;
+; GLOBAL(size_t)
+; jsimd_decode_mcu_AC_refine_prepare_sse2(const JCOEF *block,
+;                                         const int *jpeg_natural_order_start,
+;                                         int Sl);
+;
+
+; r10 = const JCOEF *block
+; r11 = const int *jpeg_natural_order_start
+; r12d = int Sl
+
+    align       32
+    GLOBAL_FUNCTION(jsimd_decode_mcu_AC_refine_prepare_sse2)
+
+EXTN(jsimd_decode_mcu_AC_refine_prepare_sse2):
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    COLLECT_ARGS 3
+    push        rbx
+
+    xor         eax, eax                ; rax = bitmap
+    xor         ecx, ecx                ; rcx = bit position
+    mov         edx, r12d               ; rdx = remaining coefficients
+    test        edx, edx
+    jle         short .return
+
+    pxor        xmm7, xmm7
+.gatherloop:
+    mov         ebx, INT [r11+0*SIZEOF_INT]
+    pinsrw      xmm0, word [r10+rbx*SIZEOF_JCOEF], 0
+    mov         ebx, INT [r11+1*SIZEOF_INT]
+    pinsrw      xmm0, word [r10+rbx*SIZEOF_JCOEF], 1
+    mov         ebx, INT [r11+2*SIZEOF_INT]
+    pinsrw      xmm0, word [r10+rbx*SIZEOF_JCOEF], 2
+    mov         ebx, INT [r11+3*SIZEOF_INT]
+    pinsrw      xmm0, word [r10+rbx*SIZEOF_JCOEF], 3
+    mov         ebx, INT [r11+4*SIZEOF_INT]
+    pinsrw      xmm0, word [r10+rbx*SIZEOF_JCOEF], 4
+    mov         ebx, INT [r11+5*SIZEOF_INT]
+    pinsrw      xmm0, word [r10+rbx*SIZEOF_JCOEF], 5
+    mov         ebx, INT [r11+6*SIZEOF_INT]
+    pinsrw      xmm0, word [r10+rbx*SIZEOF_JCOEF], 6
+    mov         ebx, INT [r11+7*SIZEOF_INT]
+    pinsrw      xmm0, word [r10+rbx*SIZEOF_JCOEF], 7
+
+    pcmpeqw     xmm0, xmm7              ; xmm0 = (coef == 0) ? 0xFFFF : 0
+    packsswb    xmm0, xmm7
+    pmovmskb    ebx, xmm0
+    not         ebx
+    movzx       rbx, bl                 ; rbx = nonzero flags for 8 coefs
+    shl         rbx, cl
+    or          rax, rbx
+
+    add         r11, byte 8*SIZEOF_INT
+    add         ecx, byte 8
+    sub         edx, byte 8
+    jg          short .gatherloop
+
+    ; Discard the bits for the coefficients beyond the end of the band.
+    mov         ecx, r12d
+    cmp         ecx, byte 64
+    jae         short .return
+    mov         edx, 1
+    shl         rdx, cl
+    dec         rdx
+    and         rax, rdx
+
+.return:
+    pop         rbx
+    UNCOLLECT_ARGS 3
+    pop         rbp
+    ret
+
+; For some reason, the OS X linker does not honor the request to align the
+; segment unless we do this.
+    align       32
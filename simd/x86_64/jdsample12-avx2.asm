@@ -0,0 +1,355 @@
+;
+; jdsample12.asm - upsampling for 12-bit samples (64-bit AVX2)
+;
+; Copyright (C) 2026, Mozilla Corporation.
+;
+; Based on the x86 SIMD extension for IJG JPEG library
+; Copyright (C) 1999-2006, MIYASAKA Masaru.
+; For conditions of distribution and use, see copyright notice in jsimdext.inc
+;
+; This file should be assembled with NASM (Netwide Assembler) or Yasm.
+;
+; 12-bit samples are already words, so unlike the 8-bit implementation, these
+; routines do not need to unpack the input samples.  The intermediate results
+; (at most 16 * MAXJ12SAMPLE + 8) fit in an unsigned word.
+
+%include "jsimdext.inc"
+
+; --------------------------------------------------------------------------
+; Compute the left neighbors of the samples in a ymm register, using the first
+; sample as its own left neighbor
+; %1: Output register (-1 0 1 .. 14), where sample -1 is a copy of sample 0
+; %2: Input register (0 1 2 .. 15)
+; %3: Temp register
+;
+; ymm10 must contain the mask for word 0.
+
+%macro SHIFTPREV 3
+    vperm2i128  %1, %2, %2, 0x08        ; %1=(--  --  ..  --   0  1 ..  7)
+    vpalignr    %1, %2, %1, 14          ; %1=(--  0  1 .. 14)
+    vpand       %3, %2, ymm10           ; %3=( 0 -- -- .. --)
+    vpor        %1, %1, %3
+%endmacro
+
+; --------------------------------------------------------------------------
+; Compute the right neighbors of the samples in a ymm register, using the last
+; sample as its own right neighbor
+; %1: Output register (1 2 .. 15 16), where sample 16 is a copy of sample 15
+; %2: Input register (0 1 2 .. 15)
+; %3: Temp register
+;
+; ymm9 must contain the mask for word 15.
+
+%macro SHIFTNEXT 3
+    vperm2i128  %1, %2, %2, 0x81        ; %1=( 8  9 .. 15  --  --  ..  --)
+    vpalignr    %1, %1, %2, 2           ; %1=( 1  2 .. 15 --)
+    vpand       %3, %2, ymm9            ; %3=(-- -- .. -- 15)
+    vpor        %1, %1, %3
+%endmacro
+
+; --------------------------------------------------------------------------
+; Interleave the even and odd output samples and store them
+; %1: Even output samples ( 0  2  4 .. 30)
+; %2: Odd output samples  ( 1  3  5 .. 31)
+; %3: Temp register
+; %4: Output pointer
+
+%macro STOREOUT 4
+    vpunpcklwd  %3, %1, %2              ; %3=( 0  1 ..  7 16 17 .. 23)
+    vpunpckhwd  %1, %1, %2              ; %1=( 8  9 .. 15 24 25 .. 31)
+    vperm2i128  %2, %3, %1, 0x20        ; %2=( 0  1 .. 15)
+    vperm2i128  %1, %3, %1, 0x31        ; %1=(16 17 .. 31)
+    vmovdqu     YMMWORD [%4+0*SIZEOF_YMMWORD], %2
+    vmovdqu     YMMWORD [%4+1*SIZEOF_YMMWORD], %1
+%endmacro
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_CONST
+
+    ALIGNZ      32
+    GLOBAL_DATA(j12const_fancy_upsample_avx2)
+
+EXTN(j12const_fancy_upsample_avx2):
+
+PW_ONE   times 16 dw 1
+PW_TWO   times 16 dw 2
+PW_THREE times 16 dw 3
+PW_SEVEN times 16 dw 7
+PW_EIGHT times 16 dw 8
+
+    ALIGNZ      32
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_TEXT
+    BITS        64
+;
+; Fancy processing for the common case of 2:1 horizontal and 1:1 vertical.
+;
+; The upsampling algorithm is linear interpolation between pixel centers,
+; also known as a "triangle filter".  This is a good compromise between
+; speed and visual quality.  The centers of the output pixels are 1/4 and 3/4
+; of the way between input pixel centers.
+;
+; GLOBAL(void)
+; j12simd_h2v1_fancy_upsample_avx2(int max_v_samp_factor,
+;                                  JDIMENSION downsampled_width,
+;                                  J12SAMPARRAY input_data,
+;                                  J12SAMPARRAY *output_data_ptr);
+;
+
+; r10 = int max_v_samp_factor
+; r11d = JDIMENSION downsampled_width
+; r12 = J12SAMPARRAY input_data
+; r13 = J12SAMPARRAY *output_data_ptr
+
+    align       32
+    GLOBAL_FUNCTION(j12simd_h2v1_fancy_upsample_avx2)
+
+EXTN(j12simd_h2v1_fancy_upsample_avx2):
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    PUSH_XMM    3
+    COLLECT_ARGS 4
+
+    mov         eax, r11d               ; colctr
+    test        rax, rax
+    jz          near .return
+
+    mov         rcx, r10                ; rowctr
+    test        rcx, rcx
+    jz          near .return
+
+    mov         rsi, r12                ; input_data
+    mov         rdi, r13
+    mov         rdip, J12SAMPARRAY [rdi]  ; output_data
+
+    vpcmpeqb    xmm9, xmm9, xmm9
+    vpsrldq     xmm10, xmm9, (SIZEOF_XMMWORD-2)  ; (ffff ---- ---- ... ---- ----) LSB is ffff
+    vpslldq     xmm9, xmm9, (SIZEOF_XMMWORD-2)
+    vperm2i128  ymm9, ymm9, ymm9, 1              ; (---- ---- ... ---- ---- ffff) MSB is ffff
+
+.rowloop:
+    push        rax                     ; colctr
+    push        rdi
+    push        rsi
+
+    mov         rsip, J12SAMPROW [rsi]  ; inptr
+    mov         rdip, J12SAMPROW [rdi]  ; outptr
+
+    test        rax, (SIZEOF_YMMWORD/SIZEOF_J12SAMPLE)-1
+    jz          short .skip
+    mov         dx, J12SAMPLE [rsi+(rax-1)*SIZEOF_J12SAMPLE]
+    mov         J12SAMPLE [rsi+rax*SIZEOF_J12SAMPLE], dx  ; insert a dummy sample
+.skip:
+    ; -- process the first column block
+
+    vmovdqu     ymm1, YMMWORD [rsi]     ; ymm1=( 0  1  2 .. 15)
+    SHIFTPREV   ymm2, ymm1, ymm4        ; ymm2=(-1  0  1 .. 14)
+
+    add         rax, byte (SIZEOF_YMMWORD/SIZEOF_J12SAMPLE)-1
+    and         rax, byte -(SIZEOF_YMMWORD/SIZEOF_J12SAMPLE)
+    jmp         short .getnext
+
+.columnloop:
+    vmovdqu     ymm1, YMMWORD [rsi]                     ; ymm1=( 0  1  2 .. 15)
+    vmovdqu     ymm2, YMMWORD [rsi-1*SIZEOF_J12SAMPLE]  ; ymm2=(-1  0  1 .. 14)
+
+.getnext:
+    cmp         rax, byte SIZEOF_YMMWORD/SIZEOF_J12SAMPLE
+    jbe         short .columnloop_last
+    vmovdqu     ymm3, YMMWORD [rsi+1*SIZEOF_J12SAMPLE]  ; ymm3=( 1  2  3 .. 16)
+    jmp         short .upsample
+
+.columnloop_last:
+    SHIFTNEXT   ymm3, ymm1, ymm4        ; ymm3=( 1  2  3 .. 16)
+
+.upsample:
+    vpmullw     ymm1, ymm1, [rel PW_THREE]
+    vpaddw      ymm2, ymm2, [rel PW_ONE]
+    vpaddw      ymm3, ymm3, [rel PW_TWO]
+
+    vpaddw      ymm2, ymm2, ymm1
+    vpsrlw      ymm2, ymm2, 2           ; ymm2=OutE=( 0  2  4 .. 30)
+    vpaddw      ymm3, ymm3, ymm1
+    vpsrlw      ymm3, ymm3, 2           ; ymm3=OutO=( 1  3  5 .. 31)
+
+    STOREOUT    ymm2, ymm3, ymm4, rdi
+
+    add         rsi, byte 1*SIZEOF_YMMWORD  ; inptr
+    add         rdi, byte 2*SIZEOF_YMMWORD  ; outptr
+    sub         rax, byte SIZEOF_YMMWORD/SIZEOF_J12SAMPLE
+    jnz         near .columnloop
+
+    pop         rsi
+    pop         rdi
+    pop         rax
+
+    add         rsi, byte SIZEOF_J12SAMPROW  ; input_data
+    add         rdi, byte SIZEOF_J12SAMPROW  ; output_data
+    dec         rcx                          ; rowctr
+    jg          near .rowloop
+
+.return:
+    vzeroupper
+    UNCOLLECT_ARGS 4
+    POP_XMM     3
+    pop         rbp
+    ret
+
+; --------------------------------------------------------------------------
+;
+; Fancy processing for the common case of 2:1 horizontal and 2:1 vertical.
+; Again a triangle filter; see comments for h2v1 case, above.
+;
+; GLOBAL(void)
+; j12simd_h2v2_fancy_upsample_avx2(int max_v_samp_factor,
+;                                  JDIMENSION downsampled_width,
+;                                  J12SAMPARRAY input_data,
+;                                  J12SAMPARRAY *output_data_ptr);
+;
+
+; r10 = int max_v_samp_factor
+; r11d = JDIMENSION downsampled_width
+; r12 = J12SAMPARRAY input_data
+; r13 = J12SAMPARRAY *output_data_ptr
+
+    align       32
+    GLOBAL_FUNCTION(j12simd_h2v2_fancy_upsample_avx2)
+
+EXTN(j12simd_h2v2_fancy_upsample_avx2):
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    PUSH_XMM    3
+    COLLECT_ARGS 4
+    push        rbx
+
+    mov         eax, r11d               ; colctr
+    test        rax, rax
+    jz          near .return
+
+    mov         rcx, r10                ; rowctr
+    test        rcx, rcx
+    jz          near .return
+
+    mov         rsi, r12                ; input_data
+    mov         rdi, r13
+    mov         rdip, J12SAMPARRAY [rdi]  ; output_data
+
+    vpcmpeqb    xmm9, xmm9, xmm9
+    vpsrldq     xmm10, xmm9, (SIZEOF_XMMWORD-2)  ; (ffff ---- ---- ... ---- ----) LSB is ffff
+    vpslldq     xmm9, xmm9, (SIZEOF_XMMWORD-2)
+    vperm2i128  ymm9, ymm9, ymm9, 1              ; (---- ---- ... ---- ---- ffff) MSB is ffff
+
+.rowloop:
+    push        rax                     ; colctr
+    push        rcx
+    push        rdi
+    push        rsi
+
+    mov         rcxp, J12SAMPROW [rsi-1*SIZEOF_J12SAMPROW]  ; inptr1(above)
+    mov         rbxp, J12SAMPROW [rsi+0*SIZEOF_J12SAMPROW]  ; inptr0
+    mov         rsip, J12SAMPROW [rsi+1*SIZEOF_J12SAMPROW]  ; inptr1(below)
+    mov         rdxp, J12SAMPROW [rdi+0*SIZEOF_J12SAMPROW]  ; outptr0
+    mov         rdip, J12SAMPROW [rdi+1*SIZEOF_J12SAMPROW]  ; outptr1
+
+    test        rax, (SIZEOF_YMMWORD/SIZEOF_J12SAMPLE)-1
+    jz          short .skip
+    push        rdx
+    mov         dx, J12SAMPLE [rcx+(rax-1)*SIZEOF_J12SAMPLE]
+    mov         J12SAMPLE [rcx+rax*SIZEOF_J12SAMPLE], dx
+    mov         dx, J12SAMPLE [rbx+(rax-1)*SIZEOF_J12SAMPLE]
+    mov         J12SAMPLE [rbx+rax*SIZEOF_J12SAMPLE], dx
+    mov         dx, J12SAMPLE [rsi+(rax-1)*SIZEOF_J12SAMPLE]
+    mov         J12SAMPLE [rsi+rax*SIZEOF_J12SAMPLE], dx  ; insert a dummy sample
+    pop         rdx
+.skip:
+    ; -- process the first column block
+
+    vmovdqu     ymm0, YMMWORD [rbx]     ; ymm0=row[ 0]( 0  1  2 .. 15)
+    vpmullw     ymm0, ymm0, [rel PW_THREE]
+    vpaddw      ymm1, ymm0, YMMWORD [rcx]  ; ymm1=Int0=( 0  1  2 .. 15)
+    vpaddw      ymm2, ymm0, YMMWORD [rsi]  ; ymm2=Int1=( 0  1  2 .. 15)
+
+    SHIFTPREV   ymm3, ymm1, ymm7        ; ymm3=Int0(-1  0  1 .. 14)
+    SHIFTPREV   ymm4, ymm2, ymm7        ; ymm4=Int1(-1  0  1 .. 14)
+
+    add         rax, byte (SIZEOF_YMMWORD/SIZEOF_J12SAMPLE)-1
+    and         rax, byte -(SIZEOF_YMMWORD/SIZEOF_J12SAMPLE)
+    jmp         short .getnext
+
+.columnloop:
+    vmovdqu     ymm0, YMMWORD [rbx]
+    vpmullw     ymm0, ymm0, [rel PW_THREE]
+    vpaddw      ymm1, ymm0, YMMWORD [rcx]  ; ymm1=Int0=( 0  1  2 .. 15)
+    vpaddw      ymm2, ymm0, YMMWORD [rsi]  ; ymm2=Int1=( 0  1  2 .. 15)
+
+    vmovdqu     ymm0, YMMWORD [rbx-1*SIZEOF_J12SAMPLE]
+    vpmullw     ymm0, ymm0, [rel PW_THREE]
+    vpaddw      ymm3, ymm0, YMMWORD [rcx-1*SIZEOF_J12SAMPLE]  ; ymm3=Int0(-1  0  1 .. 14)
+    vpaddw      ymm4, ymm0, YMMWORD [rsi-1*SIZEOF_J12SAMPLE]  ; ymm4=Int1(-1  0  1 .. 14)
+
+.getnext:
+    cmp         rax, byte SIZEOF_YMMWORD/SIZEOF_J12SAMPLE
+    jbe         short .columnloop_last
+
+    vmovdqu     ymm0, YMMWORD [rbx+1*SIZEOF_J12SAMPLE]
+    vpmullw     ymm0, ymm0, [rel PW_THREE]
+    vpaddw      ymm5, ymm0, YMMWORD [rcx+1*SIZEOF_J12SAMPLE]  ; ymm5=Int0( 1  2  3 .. 16)
+    vpaddw      ymm6, ymm0, YMMWORD [rsi+1*SIZEOF_J12SAMPLE]  ; ymm6=Int1( 1  2  3 .. 16)
+    jmp         short .upsample
+
+.columnloop_last:
+    SHIFTNEXT   ymm5, ymm1, ymm7        ; ymm5=Int0( 1  2  3 .. 16)
+    SHIFTNEXT   ymm6, ymm2, ymm7        ; ymm6=Int1( 1  2  3 .. 16)
+
+.upsample:
+    vpmullw     ymm1, ymm1, [rel PW_THREE]
+    vpmullw     ymm2, ymm2, [rel PW_THREE]
+    vpaddw      ymm3, ymm3, [rel PW_EIGHT]
+    vpaddw      ymm4, ymm4, [rel PW_EIGHT]
+    vpaddw      ymm5, ymm5, [rel PW_SEVEN]
+    vpaddw      ymm6, ymm6, [rel PW_SEVEN]
+
+    vpaddw      ymm3, ymm3, ymm1
+    vpsrlw      ymm3, ymm3, 4           ; ymm3=Out0E=( 0  2  4 .. 30)
+    vpaddw      ymm5, ymm5, ymm1
+    vpsrlw      ymm5, ymm5, 4           ; ymm5=Out0O=( 1  3  5 .. 31)
+    vpaddw      ymm4, ymm4, ymm2
+    vpsrlw      ymm4, ymm4, 4           ; ymm4=Out1E=( 0  2  4 .. 30)
+    vpaddw      ymm6, ymm6, ymm2
+    vpsrlw      ymm6, ymm6, 4           ; ymm6=Out1O=( 1  3  5 .. 31)
+
+    STOREOUT    ymm3, ymm5, ymm7, rdx
+    STOREOUT    ymm4, ymm6, ymm7, rdi
+
+    add         rcx, byte 1*SIZEOF_YMMWORD  ; inptr1(above)
+    add         rbx, byte 1*SIZEOF_YMMWORD  ; inptr0
+    add         rsi, byte 1*SIZEOF_YMMWORD  ; inptr1(below)
+    add         rdx, byte 2*SIZEOF_YMMWORD  ; outptr0
+    add         rdi, byte 2*SIZEOF_YMMWORD  ; outptr1
+    sub         rax, byte SIZEOF_YMMWORD/SIZEOF_J12SAMPLE
+    jnz         near .columnloop
+
+    pop         rsi
+    pop         rdi
+    pop         rcx
+    pop         rax
+
+    add         rsi, byte 1*SIZEOF_J12SAMPROW  ; input_data
+    add         rdi, byte 2*SIZEOF_J12SAMPROW  ; output_data
+    sub         rcx, byte 2                    ; rowctr
+    jg          near .rowloop
+
+.return:
+    pop         rbx
+    vzeroupper
+    UNCOLLECT_ARGS 4
+    POP_XMM     3
+    pop         rbp
+    ret
+
+; For some reason, the OS X linker does not honor the request to align the
+; segment unless we do this.
+    align       32
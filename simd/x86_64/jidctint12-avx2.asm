@@ -0,0 +1,325 @@
+;
+; jidctint12.asm - accurate integer IDCT for 12-bit samples (64-bit AVX2)
+;
+; Copyright (C) 2026, Mozilla Corporation.
+;
+; Based on the x86 SIMD extension for IJG JPEG library
+; Copyright (C) 1999-2006, MIYASAKA Masaru.
+; For conditions of distribution and use, see copyright notice in jsimdext.inc
+;
+; This file should be assembled with NASM (Netwide Assembler) or Yasm.
+;
+; This file contains a slower but more accurate integer implementation of the
+; inverse DCT (Discrete Cosine Transform) for 12-bit samples.  The following
+; code is based directly on the IJG's original jidctint.c; see the jidctint.c
+; for more details.
+;
+; With 12-bit samples, jidctint.c uses PASS1_BITS = 1, and the intermediate
+; results need 32 bits, so unlike the 8-bit implementation, each row of the
+; block is processed as 8 doublewords, and the multiplications use vpmulld.
+; The order of the operations is the same as in jidctint.c, so the results are
+; identical to those of the C implementation as long as the intermediate
+; results fit in 32 bits, which is always the case for dequantized
+; coefficients that are within the range of a 16-bit JCOEF.
+
+%include "jsimdext.inc"
+%include "jdct.inc"
+
+; --------------------------------------------------------------------------
+
+%define CONST_BITS  13
+%define PASS1_BITS  1
+
+%define DESCALE_P1  (CONST_BITS - PASS1_BITS)
+%define DESCALE_P2  (CONST_BITS + PASS1_BITS + 3)
+
+F_0_298 equ  2446  ; FIX(0.298631336)
+F_0_390 equ  3196  ; FIX(0.390180644)
+F_0_541 equ  4433  ; FIX(0.541196100)
+F_0_765 equ  6270  ; FIX(0.765366865)
+F_0_899 equ  7373  ; FIX(0.899976223)
+F_1_175 equ  9633  ; FIX(1.175875602)
+F_1_501 equ 12299  ; FIX(1.501321110)
+F_1_847 equ 15137  ; FIX(1.847759065)
+F_1_961 equ 16069  ; FIX(1.961570560)
+F_2_053 equ 16819  ; FIX(2.053119869)
+F_2_562 equ 20995  ; FIX(2.562915447)
+F_3_072 equ 25172  ; FIX(3.072711026)
+
+; The post-IDCT range limit table in jdmaster.c wraps the descaled results to
+; RANGE_MASK (14 bits) before clamping them, so the sign is taken from bit 13.
+%define RANGE_SHIFT  (32 - 14)
+
+; --------------------------------------------------------------------------
+; In-place 8x8x32-bit matrix transpose using AVX2 instructions
+; %1-%8:  Input registers (rows 0-7)
+; %9-%12: Temp registers
+;
+; Output: columns 0-3 in %9-%12, columns 4-7 in %5-%8
+
+%macro DOTRANSPOSE 12
+    vpunpckldq  %9, %1, %2              ; %9=(00 10 01 11  04 14 05 15)
+    vpunpckhdq  %10, %1, %2             ; %10=(02 12 03 13  06 16 07 17)
+    vpunpckldq  %11, %3, %4             ; %11=(20 30 21 31  24 34 25 35)
+    vpunpckhdq  %12, %3, %4             ; %12=(22 32 23 33  26 36 27 37)
+
+    vpunpcklqdq %1, %9, %11             ; %1=(00 10 20 30  04 14 24 34)
+    vpunpckhqdq %2, %9, %11             ; %2=(01 11 21 31  05 15 25 35)
+    vpunpcklqdq %3, %10, %12            ; %3=(02 12 22 32  06 16 26 36)
+    vpunpckhqdq %4, %10, %12            ; %4=(03 13 23 33  07 17 27 37)
+
+    vpunpckldq  %9, %5, %6              ; %9=(40 50 41 51  44 54 45 55)
+    vpunpckhdq  %10, %5, %6             ; %10=(42 52 43 53  46 56 47 57)
+    vpunpckldq  %11, %7, %8             ; %11=(60 70 61 71  64 74 65 75)
+    vpunpckhdq  %12, %7, %8             ; %12=(62 72 63 73  66 76 67 77)
+
+    vpunpcklqdq %5, %9, %11             ; %5=(40 50 60 70  44 54 64 74)
+    vpunpckhqdq %6, %9, %11             ; %6=(41 51 61 71  45 55 65 75)
+    vpunpcklqdq %7, %10, %12            ; %7=(42 52 62 72  46 56 66 76)
+    vpunpckhqdq %8, %10, %12            ; %8=(43 53 63 73  47 57 67 77)
+
+    vperm2i128  %9, %1, %5, 0x20        ; %9=col0
+    vperm2i128  %5, %1, %5, 0x31        ; %5=col4
+    vperm2i128  %10, %2, %6, 0x20       ; %10=col1
+    vperm2i128  %6, %2, %6, 0x31        ; %6=col5
+    vperm2i128  %11, %3, %7, 0x20       ; %11=col2
+    vperm2i128  %7, %3, %7, 0x31        ; %7=col6
+    vperm2i128  %12, %4, %8, 0x20       ; %12=col3
+    vperm2i128  %8, %4, %8, 0x31        ; %8=col7
+%endmacro
+
+; --------------------------------------------------------------------------
+; In-place 8-point accurate integer inverse DCT on 8 doubleword lanes using
+; AVX2 instructions
+; %1-%8:  Input registers (in0-in7)
+; %9-%12: Temp registers
+; %13:    Pass (1 or 2)
+;
+; Output: data0 in %7, data1 in %2, data2 in %4, data3 in %6, data4 in %8,
+;         data5 in %1, data6 in %5, data7 in %3
+
+%macro DODCT 13
+    ; -- Even part
+
+    vpaddd      %9, %3, %7
+    vpmulld     %9, %9, [rel PD_F_0_541]      ; %9=z1
+    vpmulld     %10, %7, [rel PD_MF_1_847]
+    vpaddd      %10, %10, %9                  ; %10=tmp2
+    vpmulld     %7, %3, [rel PD_F_0_765]
+    vpaddd      %7, %7, %9                    ; %7=tmp3
+
+    vpaddd      %9, %1, %5
+    vpslld      %9, %9, CONST_BITS            ; %9=tmp0
+    vpsubd      %1, %1, %5
+    vpslld      %1, %1, CONST_BITS            ; %1=tmp1
+
+    vpaddd      %3, %9, %7                    ; %3=tmp10
+    vpsubd      %9, %9, %7                    ; %9=tmp13
+    vpaddd      %5, %1, %10                   ; %5=tmp11
+    vpsubd      %1, %1, %10                   ; %1=tmp12
+
+    ; -- Odd part
+
+    vpaddd      %7, %8, %4                    ; %7=z3
+    vpaddd      %10, %6, %2                   ; %10=z4
+    vpaddd      %11, %7, %10
+    vpmulld     %11, %11, [rel PD_F_1_175]    ; %11=z5
+    vpmulld     %7, %7, [rel PD_MF_1_961]
+    vpaddd      %7, %7, %11                   ; %7=z3+z5
+    vpmulld     %10, %10, [rel PD_MF_0_390]
+    vpaddd      %10, %10, %11                 ; %10=z4+z5
+
+    vpaddd      %11, %8, %2
+    vpmulld     %11, %11, [rel PD_MF_0_899]   ; %11=z1
+    vpmulld     %8, %8, [rel PD_F_0_298]
+    vpaddd      %8, %8, %11
+    vpaddd      %8, %8, %7                    ; %8=tmp0
+    vpmulld     %2, %2, [rel PD_F_1_501]
+    vpaddd      %2, %2, %11
+    vpaddd      %2, %2, %10                   ; %2=tmp3
+
+    vpaddd      %11, %6, %4
+    vpmulld     %11, %11, [rel PD_MF_2_562]   ; %11=z2
+    vpmulld     %6, %6, [rel PD_F_2_053]
+    vpaddd      %6, %6, %11
+    vpaddd      %6, %6, %10                   ; %6=tmp1
+    vpmulld     %4, %4, [rel PD_F_3_072]
+    vpaddd      %4, %4, %11
+    vpaddd      %4, %4, %7                    ; %4=tmp2
+
+    ; -- Final output stage
+
+    vpaddd      %7, %3, %2                    ; %7=tmp10+tmp3
+    vpsubd      %3, %3, %2                    ; %3=tmp10-tmp3
+    vpaddd      %2, %5, %4                    ; %2=tmp11+tmp2
+    vpsubd      %5, %5, %4                    ; %5=tmp11-tmp2
+    vpaddd      %4, %1, %6                    ; %4=tmp12+tmp1
+    vpsubd      %1, %1, %6                    ; %1=tmp12-tmp1
+    vpaddd      %6, %9, %8                    ; %6=tmp13+tmp0
+    vpsubd      %8, %9, %8                    ; %8=tmp13-tmp0
+
+    vmovdqa     %9, [rel PD_DESCALE_P %+ %13]
+    vpaddd      %7, %7, %9
+    vpaddd      %2, %2, %9
+    vpaddd      %4, %4, %9
+    vpaddd      %6, %6, %9
+    vpaddd      %8, %8, %9
+    vpaddd      %1, %1, %9
+    vpaddd      %5, %5, %9
+    vpaddd      %3, %3, %9
+    vpsrad      %7, %7, DESCALE_P %+ %13      ; %7=data0
+    vpsrad      %2, %2, DESCALE_P %+ %13      ; %2=data1
+    vpsrad      %4, %4, DESCALE_P %+ %13      ; %4=data2
+    vpsrad      %6, %6, DESCALE_P %+ %13      ; %6=data3
+    vpsrad      %8, %8, DESCALE_P %+ %13      ; %8=data4
+    vpsrad      %1, %1, DESCALE_P %+ %13      ; %1=data5
+    vpsrad      %5, %5, DESCALE_P %+ %13      ; %5=data6
+    vpsrad      %3, %3, DESCALE_P %+ %13      ; %3=data7
+%endmacro
+
+; --------------------------------------------------------------------------
+; Range-limit two rows of output and store them
+; %1, %2: Input registers (ymm, rows %5 and %5+1, 8 doublewords each)
+; %3:     Low half of %1 (xmm)
+; %4:     Temp register (xmm)
+; %5:     Row number of %1
+;
+; ymm0 must be zero.
+
+%macro STOREROWS 5
+    vpslld      %1, %1, RANGE_SHIFT
+    vpslld      %2, %2, RANGE_SHIFT
+    vpsrad      %1, %1, RANGE_SHIFT
+    vpsrad      %2, %2, RANGE_SHIFT
+    vpackssdw   %1, %1, %2              ; %1=(rowA 0-3 rowB 0-3 rowA 4-7 rowB 4-7)
+    vpermq      %1, %1, 0xD8            ; %1=(rowA 0-7 rowB 0-7)
+    vpaddw      %1, %1, [rel PW_CENTERJSAMP12]
+    vpmaxsw     %1, %1, ymm0
+    vpminsw     %1, %1, [rel PW_MAXJSAMP12]
+
+    mov         rdxp, J12SAMPROW [r12+(%5)*SIZEOF_J12SAMPROW]
+    mov         rsip, J12SAMPROW [r12+(%5+1)*SIZEOF_J12SAMPROW]
+    vextracti128 %4, %1, 1
+    vmovdqu     XMMWORD [rdx+rax*SIZEOF_J12SAMPLE], %3
+    vmovdqu     XMMWORD [rsi+rax*SIZEOF_J12SAMPLE], %4
+%endmacro
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_CONST
+
+    ALIGNZ      32
+    GLOBAL_DATA(j12const_idct_islow_avx2)
+
+EXTN(j12const_idct_islow_avx2):
+
+PD_F_0_298        times 8  dd  F_0_298
+PD_MF_0_390       times 8  dd -F_0_390
+PD_F_0_541        times 8  dd  F_0_541
+PD_F_0_765        times 8  dd  F_0_765
+PD_MF_0_899       times 8  dd -F_0_899
+PD_F_1_175        times 8  dd  F_1_175
+PD_F_1_501        times 8  dd  F_1_501
+PD_MF_1_847       times 8  dd -F_1_847
+PD_MF_1_961       times 8  dd -F_1_961
+PD_F_2_053        times 8  dd  F_2_053
+PD_MF_2_562       times 8  dd -F_2_562
+PD_F_3_072        times 8  dd  F_3_072
+PD_DESCALE_P1     times 8  dd  1 << (DESCALE_P1 - 1)
+PD_DESCALE_P2     times 8  dd  1 << (DESCALE_P2 - 1)
+PW_CENTERJSAMP12  times 16 dw  CENTERJ12SAMPLE
+PW_MAXJSAMP12     times 16 dw  MAXJ12SAMPLE
+
+    ALIGNZ      32
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_TEXT
+    BITS        64
+;
+; Perform dequantization and inverse DCT on one block of coefficients.
+;
+; GLOBAL(void)
+; j12simd_idct_islow_avx2(void *dct_table, JCOEFPTR coef_block,
+;                         J12SAMPARRAY output_buf, JDIMENSION output_col)
+;
+; The dct_table entries (ISLOW_MULT_TYPE) are 32-bit integers, since MULTIPLIER
+; is int when building the 12-bit modules.
+
+; r10 = void *dct_table
+; r11 = JCOEFPTR coef_block
+; r12 = J12SAMPARRAY output_buf
+; r13d = JDIMENSION output_col
+
+    align       32
+    GLOBAL_FUNCTION(j12simd_idct_islow_avx2)
+
+EXTN(j12simd_idct_islow_avx2):
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    PUSH_XMM    4
+    COLLECT_ARGS 4
+
+    ; ---- Pass 1: process columns.
+
+    vpmovsxwd   ymm0, XMMWORD [XMMBLOCK(0,0,r11,SIZEOF_JCOEF)]
+    vpmovsxwd   ymm1, XMMWORD [XMMBLOCK(1,0,r11,SIZEOF_JCOEF)]
+    vpmovsxwd   ymm2, XMMWORD [XMMBLOCK(2,0,r11,SIZEOF_JCOEF)]
+    vpmovsxwd   ymm3, XMMWORD [XMMBLOCK(3,0,r11,SIZEOF_JCOEF)]
+    vpmovsxwd   ymm4, XMMWORD [XMMBLOCK(4,0,r11,SIZEOF_JCOEF)]
+    vpmovsxwd   ymm5, XMMWORD [XMMBLOCK(5,0,r11,SIZEOF_JCOEF)]
+    vpmovsxwd   ymm6, XMMWORD [XMMBLOCK(6,0,r11,SIZEOF_JCOEF)]
+    vpmovsxwd   ymm7, XMMWORD [XMMBLOCK(7,0,r11,SIZEOF_JCOEF)]
+    vpmulld     ymm0, ymm0, YMMWORD [YMMBLOCK(0,0,r10,SIZEOF_DWORD)]
+    vpmulld     ymm1, ymm1, YMMWORD [YMMBLOCK(1,0,r10,SIZEOF_DWORD)]
+    vpmulld     ymm2, ymm2, YMMWORD [YMMBLOCK(2,0,r10,SIZEOF_DWORD)]
+    vpmulld     ymm3, ymm3, YMMWORD [YMMBLOCK(3,0,r10,SIZEOF_DWORD)]
+    vpmulld     ymm4, ymm4, YMMWORD [YMMBLOCK(4,0,r10,SIZEOF_DWORD)]
+    vpmulld     ymm5, ymm5, YMMWORD [YMMBLOCK(5,0,r10,SIZEOF_DWORD)]
+    vpmulld     ymm6, ymm6, YMMWORD [YMMBLOCK(6,0,r10,SIZEOF_DWORD)]
+    vpmulld     ymm7, ymm7, YMMWORD [YMMBLOCK(7,0,r10,SIZEOF_DWORD)]
+
+    ; The columns whose AC terms are all zero do not need to be special-cased,
+    ; because the full calculation produces the same results for them.
+
+    DODCT ymm0, ymm1, ymm2, ymm3, ymm4, ymm5, ymm6, ymm7, ymm8, ymm9, ymm10, ymm11, 1
+    ; ymm6=data0, ymm1=data1, ymm3=data2, ymm5=data3,
+    ; ymm7=data4, ymm0=data5, ymm4=data6, ymm2=data7
+
+    DOTRANSPOSE ymm6, ymm1, ymm3, ymm5, ymm7, ymm0, ymm4, ymm2, ymm8, ymm9, ymm10, ymm11
+    ; ymm8=col0, ymm9=col1, ymm10=col2, ymm11=col3,
+    ; ymm7=col4, ymm0=col5, ymm4=col6, ymm2=col7
+
+    ; -- Prefetch the next coefficient block
+
+    prefetchnta [r11 + DCTSIZE2*SIZEOF_JCOEF + 0*32]
+    prefetchnta [r11 + DCTSIZE2*SIZEOF_JCOEF + 1*32]
+    prefetchnta [r11 + DCTSIZE2*SIZEOF_JCOEF + 2*32]
+    prefetchnta [r11 + DCTSIZE2*SIZEOF_JCOEF + 3*32]
+
+    ; ---- Pass 2: process rows.
+
+    DODCT ymm8, ymm9, ymm10, ymm11, ymm7, ymm0, ymm4, ymm2, ymm6, ymm1, ymm3, ymm5, 2
+    ; ymm4=data0, ymm9=data1, ymm11=data2, ymm0=data3,
+    ; ymm2=data4, ymm8=data5, ymm7=data6, ymm10=data7
+
+    DOTRANSPOSE ymm4, ymm9, ymm11, ymm0, ymm2, ymm8, ymm7, ymm10, ymm6, ymm1, ymm3, ymm5
+    ; ymm6=row0, ymm1=row1, ymm3=row2, ymm5=row3,
+    ; ymm2=row4, ymm8=row5, ymm7=row6, ymm10=row7
+
+    mov         eax, r13d
+    vpxor       ymm0, ymm0, ymm0
+
+    STOREROWS   ymm6, ymm1, xmm6, xmm4, 0
+    STOREROWS   ymm3, ymm5, xmm3, xmm4, 2
+    STOREROWS   ymm2, ymm8, xmm2, xmm4, 4
+    STOREROWS   ymm7, ymm10, xmm7, xmm4, 6
+
+    vzeroupper
+    UNCOLLECT_ARGS 4
+    POP_XMM     4
+    pop         rbp
+    ret
+
+; For some reason, the OS X linker does not honor the request to align the
+; segment unless we do this.
+    align       32
@@ -33,6 +33,8 @@
 
 static THREAD_LOCAL unsigned int simd_support = (unsigned int)(~0);
 static THREAD_LOCAL unsigned int simd_huffman = 1;
+static THREAD_LOCAL unsigned int simd_trellis = 1;
+static THREAD_LOCAL unsigned int simd_dering = 1;
 
 /*
  * Check what SIMD accelerations are supported.
@@ -59,6 +61,10 @@ init_simd(void)
     simd_support = 0;
   if (!GETENV_S(env, 2, "JSIMD_NOHUFFENC") && !strcmp(env, "1"))
     simd_huffman = 0;
+  if (!GETENV_S(env, 2, "JSIMD_NOTRELLIS") && !strcmp(env, "1"))
+    simd_trellis = 0;
+  if (!GETENV_S(env, 2, "JSIMD_NODERINGING") && !strcmp(env, "1"))
+    simd_dering = 0;
 #endif
 }
 
@@ -864,6 +870,61 @@ jsimd_quantize_float(JCOEFPTR coef_block, FAST_FLOAT *divisors,
   jsimd_quantize_float_sse2(coef_block, divisors, workspace);
 }
 
+GLOBAL(int)
+jsimd_can_preprocess_deringing(void)
+{
+  init_simd();
+
+  /* The code is optimised for these values only */
+  if (DCTSIZE != 8)
+    return 0;
+  if (sizeof(DCTELEM) != 2)
+    return 0;
+  if (!simd_dering)
+    return 0;
+
+  if (simd_support & JSIMD_AVX2)
+    return 1;
+  if (simd_support & JSIMD_SSE2)
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(int)
+jsimd_can_preprocess_deringing_float(void)
+{
+  init_simd();
+
+  /* The code is optimised for these values only */
+  if (DCTSIZE != 8)
+    return 0;
+  if (sizeof(FAST_FLOAT) != 4)
+    return 0;
+  if (!simd_dering)
+    return 0;
+
+  if (simd_support & JSIMD_SSE2)
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(int)
+jsimd_preprocess_deringing(const DCTELEM *data, int *sum)
+{
+  if (simd_support & JSIMD_AVX2)
+    return jsimd_preprocess_deringing_avx2(data, sum);
+  else
+    return jsimd_preprocess_deringing_sse2(data, sum);
+}
+
+GLOBAL(int)
+jsimd_preprocess_deringing_float(const FAST_FLOAT *data, FAST_FLOAT *sum)
+{
+  return jsimd_preprocess_deringing_float_sse2(data, sum);
+}
+
 GLOBAL(int)
 jsimd_can_idct_2x2(void)
 {
@@ -1108,3 +1169,665 @@ jsimd_encode_mcu_AC_refine_prepare(const JCOEF *block,
                                                  jpeg_natural_order_start,
                                                  Sl, Al, absvalues, bits);
 }
+
+GLOBAL(int)
+jsimd_can_decode_mcu_AC_refine_prepare(void)
+{
+  init_simd();
+
+  if (DCTSIZE != 8)
+    return 0;
+  if (sizeof(JCOEF) != 2)
+    return 0;
+  if (simd_support & JSIMD_SSE2)
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(size_t)
+jsimd_decode_mcu_AC_refine_prepare(const JCOEF *block,
+                                   const int *jpeg_natural_order_start, int Sl)
+{
+  return jsimd_decode_mcu_AC_refine_prepare_sse2(block,
+                                                 jpeg_natural_order_start, Sl);
+}
+
+GLOBAL(int)
+jsimd_can_trellis_search(void)
+{
+  init_simd();
+
+  if (BITS_IN_JSAMPLE != 8)
+    return 0;
+  if (sizeof(float) != 4)
+    return 0;
+
+  if ((simd_support & JSIMD_AVX2) && simd_trellis)
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(int)
+jsimd_trellis_search(const char *ehufsi, const int *runs,
+                     const float *run_cost, int num_runs,
+                     const float *candidate_dist, int num_candidates)
+{
+  return jsimd_trellis_search_avx2(ehufsi, runs, run_cost, num_runs,
+                                   candidate_dist, num_candidates);
+}
+
+/*
+ * 12-bit routines.  These are called from the 12-bit build of the
+ * precision-generic modules (see jsamplecomp.h), so BITS_IN_JSAMPLE is not
+ * checked here.  Only AVX2 implementations exist.
+ */
+
+GLOBAL(int)
+j12simd_can_rgb_ycc(void)
+{
+  init_simd();
+
+  /* The code is optimised for these values only */
+  if (sizeof(JDIMENSION) != 4)
+    return 0;
+  if ((RGB_PIXELSIZE != 3) && (RGB_PIXELSIZE != 4))
+    return 0;
+
+  if ((simd_support & JSIMD_AVX2) &&
+      IS_ALIGNED_AVX(j12const_rgb_ycc_convert_avx2))
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(int)
+j12simd_can_ycc_rgb(void)
+{
+  init_simd();
+
+  /* The code is optimised for these values only */
+  if (sizeof(JDIMENSION) != 4)
+    return 0;
+  if ((RGB_PIXELSIZE != 3) && (RGB_PIXELSIZE != 4))
+    return 0;
+
+  if ((simd_support & JSIMD_AVX2) &&
+      IS_ALIGNED_AVX(j12const_ycc_rgb_convert_avx2))
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(void)
+j12simd_rgb_ycc_convert(j_compress_ptr cinfo, J12SAMPARRAY input_buf,
+                        J12SAMPIMAGE output_buf, JDIMENSION output_row,
+                        int num_rows)
+{
+  void (*avx2fct) (JDIMENSION, J12SAMPARRAY, J12SAMPIMAGE, JDIMENSION, int);
+
+  switch (cinfo->in_color_space) {
+  case JCS_EXT_RGB:
+    avx2fct = j12simd_extrgb_ycc_convert_avx2;
+    break;
+  case JCS_EXT_RGBX:
+  case JCS_EXT_RGBA:
+    avx2fct = j12simd_extrgbx_ycc_convert_avx2;
+    break;
+  case JCS_EXT_BGR:
+    avx2fct = j12simd_extbgr_ycc_convert_avx2;
+    break;
+  case JCS_EXT_BGRX:
+  case JCS_EXT_BGRA:
+    avx2fct = j12simd_extbgrx_ycc_convert_avx2;
+    break;
+  case JCS_EXT_XBGR:
+  case JCS_EXT_ABGR:
+    avx2fct = j12simd_extxbgr_ycc_convert_avx2;
+    break;
+  case JCS_EXT_XRGB:
+  case JCS_EXT_ARGB:
+    avx2fct = j12simd_extxrgb_ycc_convert_avx2;
+    break;
+  default:
+    avx2fct = j12simd_rgb_ycc_convert_avx2;
+    break;
+  }
+
+  avx2fct(cinfo->image_width, input_buf, output_buf, output_row, num_rows);
+}
+
+GLOBAL(void)
+j12simd_ycc_rgb_convert(j_decompress_ptr cinfo, J12SAMPIMAGE input_buf,
+                        JDIMENSION input_row, J12SAMPARRAY output_buf,
+                        int num_rows)
+{
+  void (*avx2fct) (JDIMENSION, J12SAMPIMAGE, JDIMENSION, J12SAMPARRAY, int);
+
+  switch (cinfo->out_color_space) {
+  case JCS_EXT_RGB:
+    avx2fct = j12simd_ycc_extrgb_convert_avx2;
+    break;
+  case JCS_EXT_RGBX:
+  case JCS_EXT_RGBA:
+    avx2fct = j12simd_ycc_extrgbx_convert_avx2;
+    break;
+  case JCS_EXT_BGR:
+    avx2fct = j12simd_ycc_extbgr_convert_avx2;
+    break;
+  case JCS_EXT_BGRX:
+  case JCS_EXT_BGRA:
+    avx2fct = j12simd_ycc_extbgrx_convert_avx2;
+    break;
+  case JCS_EXT_XBGR:
+  case JCS_EXT_ABGR:
+    avx2fct = j12simd_ycc_extxbgr_convert_avx2;
+    break;
+  case JCS_EXT_XRGB:
+  case JCS_EXT_ARGB:
+    avx2fct = j12simd_ycc_extxrgb_convert_avx2;
+    break;
+  default:
+    avx2fct = j12simd_ycc_rgb_convert_avx2;
+    break;
+  }
+
+  avx2fct(cinfo->output_width, input_buf, input_row, output_buf, num_rows);
+}
+
+GLOBAL(int)
+j12simd_can_h2v2_downsample(void)
+{
+  init_simd();
+
+  /* The code is optimised for these values only */
+  if (sizeof(JDIMENSION) != 4)
+    return 0;
+
+  if (simd_support & JSIMD_AVX2)
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(int)
+j12simd_can_h2v1_downsample(void)
+{
+  init_simd();
+
+  /* The code is optimised for these values only */
+  if (sizeof(JDIMENSION) != 4)
+    return 0;
+
+  if (simd_support & JSIMD_AVX2)
+    return 1;
+
+  return 0;
+}
+
+/* The 12-bit downsampling routines take the number of output columns rather
+ * than the width in blocks, since a "block" is a single sample in lossless
+ * mode.
+ */
+
+GLOBAL(void)
+j12simd_h2v2_downsample(j_compress_ptr cinfo, jpeg_component_info *compptr,
+                        J12SAMPARRAY input_data, J12SAMPARRAY output_data)
+{
+  JDIMENSION output_cols = compptr->width_in_blocks *
+                           (cinfo->master->lossless ? 1 : DCTSIZE);
+
+  j12simd_h2v2_downsample_avx2(cinfo->image_width, cinfo->max_v_samp_factor,
+                               compptr->v_samp_factor, output_cols,
+                               input_data, output_data);
+}
+
+GLOBAL(void)
+j12simd_h2v1_downsample(j_compress_ptr cinfo, jpeg_component_info *compptr,
+                        J12SAMPARRAY input_data, J12SAMPARRAY output_data)
+{
+  JDIMENSION output_cols = compptr->width_in_blocks *
+                           (cinfo->master->lossless ? 1 : DCTSIZE);
+
+  j12simd_h2v1_downsample_avx2(cinfo->image_width, cinfo->max_v_samp_factor,
+                               compptr->v_samp_factor, output_cols,
+                               input_data, output_data);
+}
+
+GLOBAL(int)
+j12simd_can_h2v2_fancy_upsample(void)
+{
+  init_simd();
+
+  /* The code is optimised for these values only */
+  if (sizeof(JDIMENSION) != 4)
+    return 0;
+
+  if ((simd_support & JSIMD_AVX2) &&
+      IS_ALIGNED_AVX(j12const_fancy_upsample_avx2))
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(int)
+j12simd_can_h2v1_fancy_upsample(void)
+{
+  init_simd();
+
+  /* The code is optimised for these values only */
+  if (sizeof(JDIMENSION) != 4)
+    return 0;
+
+  if ((simd_support & JSIMD_AVX2) &&
+      IS_ALIGNED_AVX(j12const_fancy_upsample_avx2))
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(void)
+j12simd_h2v2_fancy_upsample(j_decompress_ptr cinfo,
+                            jpeg_component_info *compptr,
+                            J12SAMPARRAY input_data,
+                            J12SAMPARRAY *output_data_ptr)
+{
+  j12simd_h2v2_fancy_upsample_avx2(cinfo->max_v_samp_factor,
+                                   compptr->downsampled_width, input_data,
+                                   output_data_ptr);
+}
+
+GLOBAL(void)
+j12simd_h2v1_fancy_upsample(j_decompress_ptr cinfo,
+                            jpeg_component_info *compptr,
+                            J12SAMPARRAY input_data,
+                            J12SAMPARRAY *output_data_ptr)
+{
+  j12simd_h2v1_fancy_upsample_avx2(cinfo->max_v_samp_factor,
+                                   compptr->downsampled_width, input_data,
+                                   output_data_ptr);
+}
+
+GLOBAL(int)
+j12simd_can_idct_islow(void)
+{
+  init_simd();
+
+  /* The code is optimised for these values only.  ISLOW_MULT_TYPE is not
+   * checked, since this file is compiled with 8-bit samples.  In 12-bit
+   * builds, ISLOW_MULT_TYPE is always int (see jmorecfg.h), and that is what
+   * j12simd_idct_islow_avx2() expects.
+   */
+  if (DCTSIZE != 8)
+    return 0;
+  if (sizeof(JCOEF) != 2)
+    return 0;
+  if (sizeof(JDIMENSION) != 4)
+    return 0;
+  if (sizeof(int) != 4)
+    return 0;
+
+  if ((simd_support & JSIMD_AVX2) &&
+      IS_ALIGNED_AVX(j12const_idct_islow_avx2))
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(void)
+j12simd_idct_islow(j_decompress_ptr cinfo, jpeg_component_info *compptr,
+                   JCOEFPTR coef_block, J12SAMPARRAY output_buf,
+                   JDIMENSION output_col)
+{
+  j12simd_idct_islow_avx2(compptr->dct_table, coef_block, output_buf,
+                          output_col);
+}
+
+/*
+ * Lossless mode routines.  There are 8-bit, 12-bit, and 16-bit versions of the
+ * differencers and scalers.  The undifferencers operate on JDIFF values, so
+ * they are precision-independent.
+ */
+
+GLOBAL(int)
+jsimd_can_difference(void)
+{
+  init_simd();
+
+  /* The code is optimised for these values only */
+  if (sizeof(JDIMENSION) != 4)
+    return 0;
+  if (sizeof(JDIFF) != 4)
+    return 0;
+
+  if ((simd_support & JSIMD_AVX2) && IS_ALIGNED_AVX(jconst_difference_avx2))
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(void)
+jsimd_difference(j_compress_ptr cinfo, JSAMPROW input_buf,
+                 JSAMPROW prev_row, JDIFFROW diff_buf, JDIMENSION width)
+{
+  void (*avx2fct) (JDIMENSION, JSAMPROW, JSAMPROW, JDIFFROW);
+
+  switch (cinfo->Ss) {
+  case 1:
+    avx2fct = jsimd_difference1_avx2;
+    break;
+  case 2:
+    avx2fct = jsimd_difference2_avx2;
+    break;
+  case 3:
+    avx2fct = jsimd_difference3_avx2;
+    break;
+  case 4:
+    avx2fct = jsimd_difference4_avx2;
+    break;
+  case 5:
+    avx2fct = jsimd_difference5_avx2;
+    break;
+  case 6:
+    avx2fct = jsimd_difference6_avx2;
+    break;
+  default:
+    avx2fct = jsimd_difference7_avx2;
+    break;
+  }
+
+  avx2fct(width, input_buf, prev_row, diff_buf);
+}
+
+GLOBAL(int)
+j12simd_can_difference(void)
+{
+  init_simd();
+
+  /* The code is optimised for these values only */
+  if (sizeof(JDIMENSION) != 4)
+    return 0;
+  if (sizeof(JDIFF) != 4)
+    return 0;
+
+  if ((simd_support & JSIMD_AVX2) && IS_ALIGNED_AVX(jconst_difference_avx2))
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(void)
+j12simd_difference(j_compress_ptr cinfo, J12SAMPROW input_buf,
+                   J12SAMPROW prev_row, JDIFFROW diff_buf, JDIMENSION width)
+{
+  void (*avx2fct) (JDIMENSION, J12SAMPROW, J12SAMPROW, JDIFFROW);
+
+  switch (cinfo->Ss) {
+  case 1:
+    avx2fct = j12simd_difference1_avx2;
+    break;
+  case 2:
+    avx2fct = j12simd_difference2_avx2;
+    break;
+  case 3:
+    avx2fct = j12simd_difference3_avx2;
+    break;
+  case 4:
+    avx2fct = j12simd_difference4_avx2;
+    break;
+  case 5:
+    avx2fct = j12simd_difference5_avx2;
+    break;
+  case 6:
+    avx2fct = j12simd_difference6_avx2;
+    break;
+  default:
+    avx2fct = j12simd_difference7_avx2;
+    break;
+  }
+
+  avx2fct(width, input_buf, prev_row, diff_buf);
+}
+
+GLOBAL(int)
+j16simd_can_difference(void)
+{
+  init_simd();
+
+  /* The code is optimised for these values only */
+  if (sizeof(JDIMENSION) != 4)
+    return 0;
+  if (sizeof(JDIFF) != 4)
+    return 0;
+
+  if ((simd_support & JSIMD_AVX2) && IS_ALIGNED_AVX(jconst_difference_avx2))
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(void)
+j16simd_difference(j_compress_ptr cinfo, J16SAMPROW input_buf,
+                   J16SAMPROW prev_row, JDIFFROW diff_buf, JDIMENSION width)
+{
+  void (*avx2fct) (JDIMENSION, J16SAMPROW, J16SAMPROW, JDIFFROW);
+
+  switch (cinfo->Ss) {
+  case 1:
+    avx2fct = j16simd_difference1_avx2;
+    break;
+  case 2:
+    avx2fct = j16simd_difference2_avx2;
+    break;
+  case 3:
+    avx2fct = j16simd_difference3_avx2;
+    break;
+  case 4:
+    avx2fct = j16simd_difference4_avx2;
+    break;
+  case 5:
+    avx2fct = j16simd_difference5_avx2;
+    break;
+  case 6:
+    avx2fct = j16simd_difference6_avx2;
+    break;
+  default:
+    avx2fct = j16simd_difference7_avx2;
+    break;
+  }
+
+  avx2fct(width, input_buf, prev_row, diff_buf);
+}
+
+GLOBAL(int)
+jsimd_can_downscale(void)
+{
+  init_simd();
+
+  /* The code is optimised for these values only */
+  if (sizeof(JDIMENSION) != 4)
+    return 0;
+  if (sizeof(JDIFF) != 4)
+    return 0;
+
+  if ((simd_support & JSIMD_AVX2) && IS_ALIGNED_AVX(jconst_difference_avx2))
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(void)
+jsimd_downscale(j_compress_ptr cinfo, JSAMPROW input_buf,
+                JSAMPROW output_buf, JDIMENSION width)
+{
+  jsimd_downscale_avx2(width, cinfo->Al, input_buf, output_buf);
+}
+
+GLOBAL(int)
+j12simd_can_downscale(void)
+{
+  init_simd();
+
+  /* The code is optimised for these values only */
+  if (sizeof(JDIMENSION) != 4)
+    return 0;
+  if (sizeof(JDIFF) != 4)
+    return 0;
+
+  if ((simd_support & JSIMD_AVX2) && IS_ALIGNED_AVX(jconst_difference_avx2))
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(void)
+j12simd_downscale(j_compress_ptr cinfo, J12SAMPROW input_buf,
+                  J12SAMPROW output_buf, JDIMENSION width)
+{
+  j12simd_downscale_avx2(width, cinfo->Al, input_buf, output_buf);
+}
+
+GLOBAL(int)
+j16simd_can_downscale(void)
+{
+  init_simd();
+
+  /* The code is optimised for these values only */
+  if (sizeof(JDIMENSION) != 4)
+    return 0;
+  if (sizeof(JDIFF) != 4)
+    return 0;
+
+  if ((simd_support & JSIMD_AVX2) && IS_ALIGNED_AVX(jconst_difference_avx2))
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(void)
+j16simd_downscale(j_compress_ptr cinfo, J16SAMPROW input_buf,
+                  J16SAMPROW output_buf, JDIMENSION width)
+{
+  j16simd_downscale_avx2(width, cinfo->Al, input_buf, output_buf);
+}
+
+GLOBAL(int)
+jsimd_can_undifference(void)
+{
+  init_simd();
+
+  /* The code is optimised for these values only */
+  if (sizeof(JDIMENSION) != 4)
+    return 0;
+  if (sizeof(JDIFF) != 4)
+    return 0;
+
+  if ((simd_support & JSIMD_AVX2) && IS_ALIGNED_AVX(jconst_undifference_avx2))
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(void)
+jsimd_undifference(j_decompress_ptr cinfo, int comp_index, JDIFFROW diff_buf,
+                   JDIFFROW prev_row, JDIFFROW undiff_buf, JDIMENSION width)
+{
+  void (*avx2fct) (JDIMENSION, JDIFFROW, JDIFFROW, JDIFFROW);
+
+  switch (cinfo->Ss) {
+  case 1:
+    avx2fct = jsimd_undifference1_avx2;
+    break;
+  case 2:
+    avx2fct = jsimd_undifference2_avx2;
+    break;
+  case 3:
+    avx2fct = jsimd_undifference3_avx2;
+    break;
+  case 4:
+    avx2fct = jsimd_undifference4_avx2;
+    break;
+  default:
+    avx2fct = jsimd_undifference5_avx2;
+    break;
+  }
+
+  avx2fct(width, diff_buf, prev_row, undiff_buf);
+}
+
+GLOBAL(int)
+jsimd_can_upscale(void)
+{
+  init_simd();
+
+  /* The code is optimised for these values only */
+  if (sizeof(JDIMENSION) != 4)
+    return 0;
+  if (sizeof(JDIFF) != 4)
+    return 0;
+
+  if ((simd_support & JSIMD_AVX2) && IS_ALIGNED_AVX(jconst_undifference_avx2))
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(void)
+jsimd_upscale(j_decompress_ptr cinfo, JDIFFROW diff_buf,
+              JSAMPROW output_buf, JDIMENSION width)
+{
+  jsimd_upscale_avx2(width, cinfo->Al, diff_buf, output_buf);
+}
+
+GLOBAL(int)
+j12simd_can_upscale(void)
+{
+  init_simd();
+
+  /* The code is optimised for these values only */
+  if (sizeof(JDIMENSION) != 4)
+    return 0;
+  if (sizeof(JDIFF) != 4)
+    return 0;
+
+  if ((simd_support & JSIMD_AVX2) && IS_ALIGNED_AVX(jconst_undifference_avx2))
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(void)
+j12simd_upscale(j_decompress_ptr cinfo, JDIFFROW diff_buf,
+                J12SAMPROW output_buf, JDIMENSION width)
+{
+  /* The 12-bit samples are stored in shorts, and the upscaled values are
+   * truncated to 16 bits in the 12-bit C implementation as well, so the 16-bit
+   * routine produces the same result.
+   */
+  j16simd_upscale_avx2(width, cinfo->Al, diff_buf, (J16SAMPROW)output_buf);
+}
+
+GLOBAL(int)
+j16simd_can_upscale(void)
+{
+  init_simd();
+
+  /* The code is optimised for these values only */
+  if (sizeof(JDIMENSION) != 4)
+    return 0;
+  if (sizeof(JDIFF) != 4)
+    return 0;
+
+  if ((simd_support & JSIMD_AVX2) && IS_ALIGNED_AVX(jconst_undifference_avx2))
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(void)
+j16simd_upscale(j_decompress_ptr cinfo, JDIFFROW diff_buf,
+                J16SAMPROW output_buf, JDIMENSION width)
+{
+  j16simd_upscale_avx2(width, cinfo->Al, diff_buf, output_buf);
+}
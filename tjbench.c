@@ -94,7 +94,7 @@ static int tjErrorLine = -1, tjErrorCode = -1;
 static int stopOnWarning = 0, bottomUp = 0, noRealloc = 1, fastUpsample = 0,
   fastDCT = 0, optimize = 0, progressive = 0, limitScans = 0, maxMemory = 0,
   maxPixels = 0, arithmetic = 0, lossless = 0, restartIntervalBlocks = 0,
-  restartIntervalRows = 0;
+  restartIntervalRows = 0, numThreads = 1;
 static int precision = 8, sampleSize, compOnly = 0, decompOnly = 0, doYUV = 0,
   quiet = 0, doTile = 0, pf = TJPF_BGR, yuvAlign = 1, doWrite = 1;
 static char *ext = "ppm";
@@ -210,6 +210,8 @@ static int decomp(unsigned char **jpegBufs, size_t *jpegSizes, void *dstBuf,
     THROW_TJ();
   if (tj3Set(handle, TJPARAM_MAXPIXELS, maxPixels) == -1)
     THROW_TJ();
+  if (tj3Set(handle, TJPARAM_NUMTHREADS, numThreads) == -1)
+    THROW_TJ();
 
   if (IS_CROPPED(cr)) {
     if (tj3DecompressHeader(handle, jpegBufs[0], jpegSizes[0]) == -1)
@@ -469,6 +471,8 @@ static int fullTest(tjhandle handle, void *srcBuf, int w, int h, int subsamp,
       THROW_TJ();
     if (tj3Set(handle, TJPARAM_MAXMEMORY, maxMemory) == -1)
       THROW_TJ();
+    if (tj3Set(handle, TJPARAM_NUMTHREADS, numThreads) == -1)
+      THROW_TJ();
 
     if (doYUV) {
       yuvSize = tj3YUVBufSize(tilew, yuvAlign, tileh, subsamp);
@@ -934,6 +938,12 @@ static void usage(char *progName)
   printf("-restart N = When compressing, add a restart marker every N MCU rows\n");
   printf("     [default = 0 (no restart markers)].  Append 'B' to specify the restart\n");
   printf("     marker interval in MCUs (lossy only.)\n");
+  printf("-threads N = Use up to N threads to compress or decompress horizontal\n");
+  printf("     stripes of the image in parallel [default = 1] (lossy only.)  When\n");
+  printf("     compressing, each stripe begins with a restart marker.  When decompressing,\n");
+  printf("     restart markers at MCU row boundaries are used if present.  Otherwise,\n");
+  printf("     sequential Huffman-coded data is split at arbitrary byte offsets and\n");
+  printf("     decoded speculatively.\n");
   printf("-stoponwarning = Immediately discontinue the current\n");
   printf("     compression/decompression/transform operation if a warning (non-fatal\n");
   printf("     error) occurs\n");
@@ -1186,6 +1196,11 @@ int main(int argc, char *argv[])
           restartIntervalBlocks = tempi;
         else
           restartIntervalRows = tempi;
+      } else if (!strcasecmp(argv[i], "-threads") && i < argc - 1) {
+        int tempi = atoi(argv[++i]);
+
+        if (tempi < 1) usage(argv[0]);
+        numThreads = tempi;
       } else if (!strcasecmp(argv[i], "-stoponwarning"))
         stopOnWarning = 1;
       else usage(argv[0]);
@@ -825,6 +825,446 @@ bailout:
 }
 
 
+static int threadTestCompress(tjhandle handle, void *srcBuf, int w, int h,
+                              unsigned char **dstBuf, size_t *dstSize)
+{
+  /* The destination manager of a TurboJPEG instance can only reuse the buffer
+     that it allocated most recently, so start with a fresh buffer. */
+  tj3Free(*dstBuf);
+  *dstBuf = NULL;
+  *dstSize = 0;
+  if (!alloc) {
+    *dstSize = tj3JPEGBufSize(w, h, tj3Get(handle, TJPARAM_SUBSAMP));
+    if ((*dstBuf = (unsigned char *)tj3Alloc(*dstSize)) == NULL) {
+      printf("ERROR: Memory allocation failure\n");
+      return -1;
+    }
+  }
+  if (precision == 8)
+    return tj3Compress8(handle, (unsigned char *)srcBuf, w, 0, h, TJPF_BGRX,
+                        dstBuf, dstSize);
+  else
+    return tj3Compress12(handle, (short *)srcBuf, w, 0, h, TJPF_BGRX, dstBuf,
+                         dstSize);
+}
+
+static int threadTestDecompress(tjhandle handle, unsigned char *jpegBuf,
+                                size_t jpegSize, void *dstBuf)
+{
+  if (tj3DecompressHeader(handle, jpegBuf, jpegSize) == -1)
+    return -1;
+  if (precision == 8)
+    return tj3Decompress8(handle, jpegBuf, jpegSize, (unsigned char *)dstBuf,
+                          0, TJPF_BGRX);
+  else
+    return tj3Decompress12(handle, jpegBuf, jpegSize, (short *)dstBuf, 0,
+                           TJPF_BGRX);
+}
+
+/* Verify that compressing an image in parallel stripes produces the same JPEG
+   image as compressing it serially with the same restart interval, and that
+   decompressing the JPEG image in parallel stripes produces the same pixels
+   as decompressing it serially */
+
+static void threadTest(void)
+{
+  static const tjscalingfactor sf[3] = { { 1, 1 }, { 1, 2 }, { 3, 8 } };
+  int w = 131, h = 197, numThreads = 3, i, subsamp, optimize, restartRows;
+  void *srcBuf = NULL, *decBuf = NULL, *refDecBuf = NULL;
+  unsigned char *dstBuf = NULL, *refBuf = NULL, *serialBuf = NULL;
+  size_t dstSize = 0, refSize = 0, serialSize = 0;
+  tjhandle handle = NULL, handle2 = NULL;
+
+  if ((handle = tj3Init(TJINIT_COMPRESS)) == NULL)
+    THROW_TJ(NULL);
+  if ((handle2 = tj3Init(TJINIT_DECOMPRESS)) == NULL)
+    THROW_TJ(NULL);
+  TRY_TJ(handle, tj3Set(handle, TJPARAM_NOREALLOC, !alloc));
+  TRY_TJ(handle, tj3Set(handle, TJPARAM_QUALITY, 95));
+
+  if ((srcBuf = malloc(w * h * 4 * sampleSize)) == NULL ||
+      (decBuf = malloc(w * h * 4 * sampleSize)) == NULL ||
+      (refDecBuf = malloc(w * h * 4 * sampleSize)) == NULL)
+    THROW("Memory allocation failure");
+  for (i = 0; i < w * h * 4; i++) {
+    if (random() < RAND_MAX / 2) setVal(srcBuf, i, 0);
+    else setVal(srcBuf, i, maxSample);
+  }
+
+  for (subsamp = 0; subsamp < TJ_NUMSAMP; subsamp++) {
+    int mcuRows = (h + tjMCUHeight[subsamp] - 1) / tjMCUHeight[subsamp];
+
+    TRY_TJ(handle, tj3Set(handle, TJPARAM_SUBSAMP, subsamp));
+    for (optimize = 0; optimize <= 1; optimize++) {
+      TRY_TJ(handle, tj3Set(handle, TJPARAM_OPTIMIZE, optimize));
+      for (restartRows = 0; restartRows <= 2; restartRows += 2) {
+        printf("Multithreaded %s %s RESTARTROWS=%d ... ", subNameLong[subsamp],
+               optimize ? "optimized" : "baseline ", restartRows);
+
+        TRY_TJ(handle, tj3Set(handle, TJPARAM_RESTARTROWS, restartRows));
+        TRY_TJ(handle, tj3Set(handle, TJPARAM_NUMTHREADS, numThreads));
+        TRY_TJ(handle, threadTestCompress(handle, srcBuf, w, h, &dstBuf,
+                                          &dstSize));
+
+        /* Without an explicit restart interval, each stripe is one restart
+           interval.  If TurboJPEG was built without thread support, then the
+           image is compressed serially without restart markers. */
+        TRY_TJ(handle, tj3Set(handle, TJPARAM_NUMTHREADS, 1));
+        TRY_TJ(handle, threadTestCompress(handle, srcBuf, w, h, &serialBuf,
+                                          &serialSize));
+        TRY_TJ(handle, tj3Set(handle, TJPARAM_RESTARTROWS,
+                              restartRows ? restartRows :
+                              (mcuRows + numThreads - 1) / numThreads));
+        TRY_TJ(handle, threadTestCompress(handle, srcBuf, w, h, &refBuf,
+                                          &refSize));
+
+        if ((dstSize != refSize || memcmp(dstBuf, refBuf, refSize)) &&
+            (restartRows || dstSize != serialSize ||
+             memcmp(dstBuf, serialBuf, serialSize)))
+          THROW("Multithreaded and single-threaded JPEG images differ");
+
+        /* Decompress both the multithreaded JPEG image (which has restart
+           markers) and the serial JPEG image (which has none unless
+           RESTARTROWS is set.) */
+        for (i = 0; i < 12; i++) {
+          tjscalingfactor sf1 = sf[(i % 6) / 2];
+          unsigned char *jpegBuf = i < 6 ? dstBuf : serialBuf;
+          size_t jpegSize = i < 6 ? dstSize : serialSize;
+          size_t decSize = TJSCALED(w, sf1) * TJSCALED(h, sf1) * 4 *
+                           sampleSize;
+
+          TRY_TJ(handle2, tj3SetScalingFactor(handle2, sf1));
+          TRY_TJ(handle2, tj3Set(handle2, TJPARAM_FASTUPSAMPLE, i % 2));
+          TRY_TJ(handle2, tj3Set(handle2, TJPARAM_NUMTHREADS, 1));
+          TRY_TJ(handle2, threadTestDecompress(handle2, jpegBuf, jpegSize,
+                                               refDecBuf));
+          TRY_TJ(handle2, tj3Set(handle2, TJPARAM_NUMTHREADS, numThreads));
+          TRY_TJ(handle2, threadTestDecompress(handle2, jpegBuf, jpegSize,
+                                               decBuf));
+          if (memcmp(decBuf, refDecBuf, decSize))
+            THROW("Multithreaded and single-threaded decompression differ");
+        }
+        printf("Passed.\n");
+      }
+    }
+  }
+
+bailout:
+  free(srcBuf);
+  free(decBuf);
+  free(refDecBuf);
+  tj3Free(dstBuf);
+  tj3Free(refBuf);
+  tj3Free(serialBuf);
+  tj3Destroy(handle);
+  tj3Destroy(handle2);
+}
+
+
+/* Verify that decompressing a JPEG image with a scaling factor smaller than 1/8
+   produces the same pixels as decompressing it at 1/8 scale and averaging the
+   pixels that each destination pixel covers */
+
+static void reducedDecompTest(void)
+{
+  static const tjscalingfactor sf[3] = { { 1, 16 }, { 3, 64 }, { 1, 9 } };
+  static const tjscalingfactor sf8 = { 1, 8 };
+  int w = 131, h = 197, w8 = TJSCALED(w, sf8), h8 = TJSCALED(h, sf8);
+  int i, j, subsamp, progressive, x, y, c;
+  void *srcBuf = NULL, *decBuf = NULL, *refDecBuf = NULL;
+  unsigned char *jpegBuf = NULL;
+  size_t jpegSize = 0;
+  tjhandle handle = NULL, handle2 = NULL;
+
+  if ((handle = tj3Init(TJINIT_COMPRESS)) == NULL)
+    THROW_TJ(NULL);
+  if ((handle2 = tj3Init(TJINIT_DECOMPRESS)) == NULL)
+    THROW_TJ(NULL);
+  TRY_TJ(handle, tj3Set(handle, TJPARAM_NOREALLOC, !alloc));
+  TRY_TJ(handle, tj3Set(handle, TJPARAM_QUALITY, 95));
+
+  if ((srcBuf = malloc(w * h * 4 * sampleSize)) == NULL ||
+      (decBuf = malloc(w8 * h8 * 4 * sampleSize)) == NULL ||
+      (refDecBuf = malloc(w8 * h8 * 4 * sampleSize)) == NULL)
+    THROW("Memory allocation failure");
+  for (i = 0; i < w * h * 4; i++)
+    setVal(srcBuf, i, random() % (maxSample + 1));
+
+  for (subsamp = TJSAMP_444; subsamp <= TJSAMP_GRAY;
+       subsamp += TJSAMP_GRAY - TJSAMP_444) {
+    TRY_TJ(handle, tj3Set(handle, TJPARAM_SUBSAMP, subsamp));
+    for (progressive = 0; progressive <= 1; progressive++) {
+      printf("Reduced decompression %s %s ... ", subNameLong[subsamp],
+             progressive ? "progressive" : "baseline   ");
+
+      TRY_TJ(handle, tj3Set(handle, TJPARAM_PROGRESSIVE, progressive));
+      TRY_TJ(handle, threadTestCompress(handle, srcBuf, w, h, &jpegBuf,
+                                        &jpegSize));
+
+      /* With these subsampling levels, every component is decompressed using
+         only its DC coefficients at 1/8 scale as well. */
+      TRY_TJ(handle2, tj3SetScalingFactor(handle2, sf8));
+      TRY_TJ(handle2, threadTestDecompress(handle2, jpegBuf, jpegSize,
+                                           refDecBuf));
+
+      for (i = 0; i < 3; i++) {
+        int dw = TJSCALED(w, sf[i]), dh = TJSCALED(h, sf[i]);
+
+        TRY_TJ(handle2, tj3SetScalingFactor(handle2, sf[i]));
+        TRY_TJ(handle2, threadTestDecompress(handle2, jpegBuf, jpegSize,
+                                             decBuf));
+        for (y = 0; y < dh; y++) {
+          int sy0 = y * h8 / dh, sy1 = (y + 1) * h8 / dh;
+
+          for (x = 0; x < dw; x++) {
+            int sx0 = x * w8 / dw, sx1 = (x + 1) * w8 / dw;
+            int count = (sx1 - sx0) * (sy1 - sy0);
+
+            for (c = 0; c < 4; c++) {
+              int sum = 0;
+
+              for (j = sy0 * w8; j < sy1 * w8; j += w8) {
+                int sx;
+
+                for (sx = sx0; sx < sx1; sx++)
+                  sum += getVal(refDecBuf, (j + sx) * 4 + c);
+              }
+              if (getVal(decBuf, (y * dw + x) * 4 + c) !=
+                  (sum + count / 2) / count) {
+                printf("\nComp. %d at %d,%d of %d/%d\n", c, y, x, sf[i].num,
+                       sf[i].denom);
+                THROW("Reduced decompression is incorrect");
+              }
+            }
+          }
+        }
+      }
+      printf("Passed.\n");
+    }
+  }
+
+bailout:
+  free(srcBuf);
+  free(decBuf);
+  free(refDecBuf);
+  tj3Free(jpegBuf);
+  tj3Destroy(handle);
+  tj3Destroy(handle2);
+}
+
+
+/* Verify that TJPARAM_BYTESREAD reports a prefix of a progressive JPEG image
+   that, when decompressed with the same scan budget, produces the same pixels
+   as decompressing the whole JPEG image with that scan budget */
+
+static void scanBudgetTest(void)
+{
+  int w = 131, h = 197, i, scanBudget, bytesRead;
+  void *srcBuf = NULL, *decBuf = NULL, *refDecBuf = NULL;
+  unsigned char *jpegBuf = NULL, *prefixBuf = NULL;
+  size_t jpegSize = 0;
+  tjhandle handle = NULL, handle2 = NULL;
+
+  if ((handle = tj3Init(TJINIT_COMPRESS)) == NULL)
+    THROW_TJ(NULL);
+  if ((handle2 = tj3Init(TJINIT_DECOMPRESS)) == NULL)
+    THROW_TJ(NULL);
+  TRY_TJ(handle, tj3Set(handle, TJPARAM_NOREALLOC, !alloc));
+  TRY_TJ(handle, tj3Set(handle, TJPARAM_QUALITY, 95));
+  TRY_TJ(handle, tj3Set(handle, TJPARAM_SUBSAMP, TJSAMP_420));
+  TRY_TJ(handle, tj3Set(handle, TJPARAM_PROGRESSIVE, 1));
+
+  if ((srcBuf = malloc(w * h * 4 * sampleSize)) == NULL ||
+      (decBuf = malloc(w * h * 4 * sampleSize)) == NULL ||
+      (refDecBuf = malloc(w * h * 4 * sampleSize)) == NULL)
+    THROW("Memory allocation failure");
+  for (i = 0; i < w * h * 4; i++)
+    setVal(srcBuf, i, random() % (maxSample + 1));
+  TRY_TJ(handle, threadTestCompress(handle, srcBuf, w, h, &jpegBuf,
+                                    &jpegSize));
+
+  printf("Scan budget ... ");
+  for (scanBudget = 0; scanBudget <= 3; scanBudget++) {
+    TRY_TJ(handle2, tj3Set(handle2, TJPARAM_SCANBUDGET, scanBudget));
+    TRY_TJ(handle2, threadTestDecompress(handle2, jpegBuf, jpegSize,
+                                         refDecBuf));
+    bytesRead = tj3Get(handle2, TJPARAM_BYTESREAD);
+    if (scanBudget == 0 ? bytesRead != (int)jpegSize :
+        bytesRead <= 0 || bytesRead >= (int)jpegSize)
+      THROW("Incorrect number of JPEG bytes read");
+
+    /* Decompress the prefix from an exact-sized buffer, so that reading
+       beyond it would be detected by memory checkers. */
+    free(prefixBuf);
+    if ((prefixBuf = (unsigned char *)malloc(bytesRead)) == NULL)
+      THROW("Memory allocation failure");
+    memcpy(prefixBuf, jpegBuf, bytesRead);
+    TRY_TJ(handle2, threadTestDecompress(handle2, prefixBuf, bytesRead,
+                                         decBuf));
+    if (tj3Get(handle2, TJPARAM_BYTESREAD) != bytesRead)
+      THROW("Incorrect number of JPEG bytes read from prefix");
+    if (memcmp(decBuf, refDecBuf, w * h * 4 * sampleSize))
+      THROW("Decompressing the prefix produced a different image");
+  }
+  printf("Passed.\n");
+
+bailout:
+  free(srcBuf);
+  free(decBuf);
+  free(refDecBuf);
+  free(prefixBuf);
+  tj3Free(jpegBuf);
+  tj3Destroy(handle);
+  tj3Destroy(handle2);
+}
+
+
+/* Verify that transforming a JPEG image in parallel bands produces the same
+   JPEG image as transforming it serially */
+
+static void transformThreadTest(void)
+{
+  static const int subsamps[3] = { TJSAMP_444, TJSAMP_420, TJSAMP_GRAY };
+  int w = 131, h = 197, numThreads = 3, i, j, op, crop;
+  void *srcBuf = NULL;
+  unsigned char *jpegBuf = NULL, *dstBuf = NULL, *refBuf = NULL;
+  size_t jpegSize = 0, dstSize = 0, refSize = 0;
+  tjhandle handle = NULL, handle2 = NULL;
+  tjtransform xform;
+
+  if ((handle = tj3Init(TJINIT_COMPRESS)) == NULL)
+    THROW_TJ(NULL);
+  if ((handle2 = tj3Init(TJINIT_TRANSFORM)) == NULL)
+    THROW_TJ(NULL);
+  TRY_TJ(handle, tj3Set(handle, TJPARAM_NOREALLOC, !alloc));
+  TRY_TJ(handle, tj3Set(handle, TJPARAM_QUALITY, 95));
+
+  if ((srcBuf = malloc(w * h * 4 * sampleSize)) == NULL)
+    THROW("Memory allocation failure");
+  for (i = 0; i < w * h * 4; i++)
+    setVal(srcBuf, i, random() % (maxSample + 1));
+
+  for (i = 0; i < 3; i++) {
+    printf("Multithreaded transform %s ... ", subNameLong[subsamps[i]]);
+
+    TRY_TJ(handle, tj3Set(handle, TJPARAM_SUBSAMP, subsamps[i]));
+    TRY_TJ(handle, threadTestCompress(handle, srcBuf, w, h, &jpegBuf,
+                                      &jpegSize));
+
+    for (op = 0; op < TJ_NUMXOP; op++) {
+      for (crop = 0; crop <= 1; crop++) {
+        memset(&xform, 0, sizeof(tjtransform));
+        xform.op = op;
+        if (crop) {
+          /* 32 is a multiple of the MCU width and height of every
+             subsampling level, so the region is valid for all operations. */
+          xform.options = TJXOPT_CROP;
+          xform.r.x = 32;  xform.r.y = 32;  xform.r.w = 64;  xform.r.h = 96;
+        }
+
+        for (j = 0; j < 2; j++) {
+          unsigned char **buf = j ? &dstBuf : &refBuf;
+          size_t *size = j ? &dstSize : &refSize;
+
+          tj3Free(*buf);
+          *buf = NULL;  *size = 0;
+          TRY_TJ(handle2, tj3Set(handle2, TJPARAM_NUMTHREADS,
+                                 j ? numThreads : 1));
+          TRY_TJ(handle2, tj3Transform(handle2, jpegBuf, jpegSize, 1, buf,
+                                       size, &xform));
+        }
+        if (dstSize != refSize || memcmp(dstBuf, refBuf, refSize)) {
+          printf("\nOperation %d%s\n", op, crop ? " with cropping" : "");
+          THROW("Multithreaded and single-threaded transforms differ");
+        }
+      }
+    }
+    printf("Passed.\n");
+  }
+
+bailout:
+  free(srcBuf);
+  tj3Free(jpegBuf);
+  tj3Free(dstBuf);
+  tj3Free(refBuf);
+  tj3Destroy(handle);
+  tj3Destroy(handle2);
+}
+
+
+/* Verify that compressing a series of images with a warm compression context
+   produces the same JPEG images as compressing them with a cold one, both when
+   the parameters stay the same from one image to the next and when they
+   change */
+
+static void warmContextTest(void)
+{
+  static const struct {
+    int w, h, subsamp, quality, optimize, progressive;
+  } images[] = {
+    { 48, 48, TJSAMP_420, 95, 0, 0 },
+    { 48, 48, TJSAMP_420, 95, 0, 0 },
+    { 48, 48, TJSAMP_420, 75, 0, 0 },
+    { 131, 97, TJSAMP_444, 75, 1, 0 },
+    { 131, 97, TJSAMP_444, 75, 1, 0 },
+    { 17, 23, TJSAMP_GRAY, 50, 0, 1 },
+    { 131, 97, TJSAMP_422, 95, 0, 1 },
+    { 48, 48, TJSAMP_420, 95, 0, 0 }
+  };
+  int maxW = 131, maxH = 97, i, numImages = sizeof(images) / sizeof(images[0]);
+  void *srcBuf = NULL;
+  unsigned char *dstBuf = NULL, *refBuf = NULL;
+  size_t dstSize = 0, refSize = 0;
+  tjhandle handle = NULL, handle2 = NULL;
+
+  if ((handle = tj3Init(TJINIT_COMPRESS)) == NULL)
+    THROW_TJ(NULL);
+  if ((handle2 = tj3Init(TJINIT_COMPRESS)) == NULL)
+    THROW_TJ(NULL);
+  TRY_TJ(handle, tj3Set(handle, TJPARAM_NOREALLOC, !alloc));
+  TRY_TJ(handle2, tj3Set(handle2, TJPARAM_NOREALLOC, !alloc));
+  TRY_TJ(handle, tj3Set(handle, TJPARAM_WARMCONTEXT, 1));
+  if (lossless) {
+    TRY_TJ(handle, tj3Set(handle, TJPARAM_LOSSLESS, lossless));
+    TRY_TJ(handle2, tj3Set(handle2, TJPARAM_LOSSLESS, lossless));
+  }
+
+  if ((srcBuf = malloc(maxW * maxH * 4 * sampleSize)) == NULL)
+    THROW("Memory allocation failure");
+  for (i = 0; i < maxW * maxH * 4; i++)
+    setVal(srcBuf, i, random() % (maxSample + 1));
+
+  printf("Warm compression context ... ");
+  for (i = 0; i < numImages; i++) {
+    tjhandle h;
+
+    for (h = handle; h != NULL; h = (h == handle ? handle2 : NULL)) {
+      TRY_TJ(h, tj3Set(h, TJPARAM_SUBSAMP, lossless ? TJSAMP_444 :
+                                           images[i].subsamp));
+      if (!lossless) {
+        TRY_TJ(h, tj3Set(h, TJPARAM_QUALITY, images[i].quality));
+        TRY_TJ(h, tj3Set(h, TJPARAM_PROGRESSIVE, images[i].progressive));
+      }
+      TRY_TJ(h, tj3Set(h, TJPARAM_OPTIMIZE, images[i].optimize));
+    }
+    TRY_TJ(handle, threadTestCompress(handle, srcBuf, images[i].w,
+                                      images[i].h, &dstBuf, &dstSize));
+    TRY_TJ(handle2, threadTestCompress(handle2, srcBuf, images[i].w,
+                                       images[i].h, &refBuf, &refSize));
+    if (dstSize != refSize || memcmp(dstBuf, refBuf, refSize))
+      THROW("JPEG images compressed with warm and cold contexts differ");
+  }
+  printf("Passed.\n");
+
+bailout:
+  free(srcBuf);
+  tj3Free(dstBuf);
+  tj3Free(refBuf);
+  tj3Destroy(handle);
+  tj3Destroy(handle2);
+}
+
+
 static void rgb_to_cmyk(int r, int g, int b, int *c, int *m, int *y, int *k)
 {
   double ctmp = 1.0 - ((double)r / (double)maxSample);
@@ -1202,6 +1642,13 @@ int main(int argc, char *argv[])
     doTest(35, 39, _4sampleFormats, 4, TJSAMP_GRAY, "test");
   }
   bufSizeTest();
+  if (!lossless && !doYUV) {
+    threadTest();
+    reducedDecompTest();
+    scanBudgetTest();
+    transformThreadTest();
+  }
+  if (!doYUV) warmContextTest();
   if (doYUV) {
     printf("\n--------------------\n\n");
     doTest(48, 48, _onlyRGB, 1, TJSAMP_444, "test_yuv0");
@@ -24,6 +24,7 @@
 #include "jpeglib.h"
 #include "transupp.h"           /* My own external interface */
 #include "jpegapicomp.h"
+#include "jthread.h"
 #include <ctype.h>              /* to declare isdigit() */
 
 
@@ -85,9 +86,67 @@
  * 6. All the routines assume that the source and destination buffers are
  *    padded out to a full iMCU boundary.  This is true, although for the
  *    source buffer it is an undocumented property of jdcoefct.c.
+ * 7. The rotate, flip, transpose, and plain crop routines process a band of
+ *    destination iMCU rows at a time, so that independent bands can be
+ *    transformed by several threads at once.  Since the memory manager may
+ *    be called only from one thread, the virtual arrays are then accessed
+ *    through row tables that are set up beforehand (see run_transform()).
+ *    The same routines can also produce a single iMCU row of a single
+ *    component on demand, so that a streamed transform needs no destination
+ *    arrays at all (see start_streaming()).
  */
 
 
+/* Parameters of a banded transform */
+
+typedef struct transform_job transform_job;
+
+typedef void (*transform_ptr) (transform_job *job, JDIMENSION start_iMCU_row,
+                               JDIMENSION end_iMCU_row);
+
+struct transform_job {
+  j_decompress_ptr srcinfo;
+  j_compress_ptr dstinfo;
+  JDIMENSION x_crop_offset, y_crop_offset;
+  jvirt_barray_ptr *src_coef_arrays;
+  jvirt_barray_ptr *dst_coef_arrays;
+  transform_ptr transform;
+  int first_ci, last_ci;        /* range of components to process */
+  /* Complete row tables for each component, or NULL if the virtual arrays
+   * are to be accessed through the memory manager
+   */
+  JBLOCKARRAY src_rows[MAX_COMPONENTS];
+  JBLOCKARRAY dst_rows[MAX_COMPONENTS];
+};
+
+
+/* Access num_rows block rows of a source or destination array, starting at
+ * start_row.
+ */
+
+LOCAL(JBLOCKARRAY)
+src_blocks(transform_job *job, int ci, JDIMENSION start_row,
+           JDIMENSION num_rows, boolean writable)
+{
+  if (job->src_rows[ci] != NULL)
+    return job->src_rows[ci] + start_row;
+  return (*job->srcinfo->mem->access_virt_barray)
+    ((j_common_ptr)job->srcinfo, job->src_coef_arrays[ci], start_row,
+     num_rows, writable);
+}
+
+LOCAL(JBLOCKARRAY)
+dst_blocks(transform_job *job, int ci, JDIMENSION start_row,
+           JDIMENSION num_rows)
+{
+  if (job->dst_rows[ci] != NULL)
+    return job->dst_rows[ci] + start_row;
+  return (*job->srcinfo->mem->access_virt_barray)
+    ((j_common_ptr)job->srcinfo, job->dst_coef_arrays[ci], start_row,
+     num_rows, TRUE);
+}
+
+
 LOCAL(void)
 dequant_comp(j_decompress_ptr cinfo, jpeg_component_info *compptr,
              jvirt_barray_ptr coef_array, JQUANT_TBL *qtblptr1)
@@ -276,13 +335,13 @@ do_drop(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
 
 
 LOCAL(void)
-do_crop(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
-        JDIMENSION x_crop_offset, JDIMENSION y_crop_offset,
-        jvirt_barray_ptr *src_coef_arrays,
-        jvirt_barray_ptr *dst_coef_arrays)
+do_crop(transform_job *job, JDIMENSION start_iMCU_row, JDIMENSION end_iMCU_row)
 /* Crop.  This is only used when no rotate/flip is requested with the crop. */
 {
-  JDIMENSION dst_blk_y, x_crop_blocks, y_crop_blocks;
+  j_compress_ptr dstinfo = job->dstinfo;
+  JDIMENSION x_crop_offset = job->x_crop_offset;
+  JDIMENSION y_crop_offset = job->y_crop_offset;
+  JDIMENSION dst_blk_y, x_crop_blocks, y_crop_blocks, end_blk_y;
   int ci, offset_y;
   JBLOCKARRAY src_buffer, dst_buffer;
   jpeg_component_info *compptr;
@@ -290,18 +349,18 @@ do_crop(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
   /* We simply have to copy the right amount of data (the destination's
    * image size) starting at the given X and Y offsets in the source.
    */
-  for (ci = 0; ci < dstinfo->num_components; ci++) {
+  for (ci = job->first_ci; ci <= job->last_ci; ci++) {
     compptr = dstinfo->comp_info + ci;
     x_crop_blocks = x_crop_offset * compptr->h_samp_factor;
     y_crop_blocks = y_crop_offset * compptr->v_samp_factor;
-    for (dst_blk_y = 0; dst_blk_y < compptr->height_in_blocks;
-         dst_blk_y += compptr->v_samp_factor) {
-      dst_buffer = (*srcinfo->mem->access_virt_barray)
-        ((j_common_ptr)srcinfo, dst_coef_arrays[ci], dst_blk_y,
-         (JDIMENSION)compptr->v_samp_factor, TRUE);
-      src_buffer = (*srcinfo->mem->access_virt_barray)
-        ((j_common_ptr)srcinfo, src_coef_arrays[ci], dst_blk_y + y_crop_blocks,
-         (JDIMENSION)compptr->v_samp_factor, FALSE);
+    end_blk_y = MIN(end_iMCU_row * compptr->v_samp_factor,
+                    compptr->height_in_blocks);
+    for (dst_blk_y = start_iMCU_row * compptr->v_samp_factor;
+         dst_blk_y < end_blk_y; dst_blk_y += compptr->v_samp_factor) {
+      dst_buffer = dst_blocks(job, ci, dst_blk_y,
+                              (JDIMENSION)compptr->v_samp_factor);
+      src_buffer = src_blocks(job, ci, dst_blk_y + y_crop_blocks,
+                              (JDIMENSION)compptr->v_samp_factor, FALSE);
       for (offset_y = 0; offset_y < compptr->v_samp_factor; offset_y++) {
         jcopy_block_row(src_buffer[offset_y] + x_crop_blocks,
                         dst_buffer[offset_y], compptr->width_in_blocks);
@@ -725,13 +784,16 @@ do_reflect(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
 
 
 LOCAL(void)
-do_flip_h_no_crop(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
-                  JDIMENSION x_crop_offset, jvirt_barray_ptr *src_coef_arrays)
+do_flip_h_no_crop(transform_job *job, JDIMENSION start_iMCU_row,
+                  JDIMENSION end_iMCU_row)
 /* Horizontal flip; done in-place, so no separate dest array is required.
  * NB: this only works when y_crop_offset is zero.
  */
 {
-  JDIMENSION MCU_cols, comp_width, blk_x, blk_y, x_crop_blocks;
+  j_decompress_ptr srcinfo = job->srcinfo;
+  j_compress_ptr dstinfo = job->dstinfo;
+  JDIMENSION x_crop_offset = job->x_crop_offset;
+  JDIMENSION MCU_cols, comp_width, blk_x, blk_y, x_crop_blocks, end_blk_y;
   int ci, k, offset_y;
   JBLOCKARRAY buffer;
   JCOEFPTR ptr1, ptr2;
@@ -746,15 +808,16 @@ do_flip_h_no_crop(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
   MCU_cols = srcinfo->output_width /
              (dstinfo->max_h_samp_factor * dstinfo_min_DCT_h_scaled_size);
 
-  for (ci = 0; ci < dstinfo->num_components; ci++) {
+  for (ci = job->first_ci; ci <= job->last_ci; ci++) {
     compptr = dstinfo->comp_info + ci;
     comp_width = MCU_cols * compptr->h_samp_factor;
     x_crop_blocks = x_crop_offset * compptr->h_samp_factor;
-    for (blk_y = 0; blk_y < compptr->height_in_blocks;
+    end_blk_y = MIN(end_iMCU_row * compptr->v_samp_factor,
+                    compptr->height_in_blocks);
+    for (blk_y = start_iMCU_row * compptr->v_samp_factor; blk_y < end_blk_y;
          blk_y += compptr->v_samp_factor) {
-      buffer = (*srcinfo->mem->access_virt_barray)
-        ((j_common_ptr)srcinfo, src_coef_arrays[ci], blk_y,
-         (JDIMENSION)compptr->v_samp_factor, TRUE);
+      buffer = src_blocks(job, ci, blk_y, (JDIMENSION)compptr->v_samp_factor,
+                          TRUE);
       for (offset_y = 0; offset_y < compptr->v_samp_factor; offset_y++) {
         /* Do the mirroring */
         for (blk_x = 0; blk_x * 2 < comp_width; blk_x++) {
@@ -790,13 +853,15 @@ do_flip_h_no_crop(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
 
 
 LOCAL(void)
-do_flip_h(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
-          JDIMENSION x_crop_offset, JDIMENSION y_crop_offset,
-          jvirt_barray_ptr *src_coef_arrays,
-          jvirt_barray_ptr *dst_coef_arrays)
+do_flip_h(transform_job *job, JDIMENSION start_iMCU_row,
+          JDIMENSION end_iMCU_row)
 /* Horizontal flip in general cropping case */
 {
-  JDIMENSION MCU_cols, comp_width, dst_blk_x, dst_blk_y;
+  j_decompress_ptr srcinfo = job->srcinfo;
+  j_compress_ptr dstinfo = job->dstinfo;
+  JDIMENSION x_crop_offset = job->x_crop_offset;
+  JDIMENSION y_crop_offset = job->y_crop_offset;
+  JDIMENSION MCU_cols, comp_width, dst_blk_x, dst_blk_y, end_blk_y;
   JDIMENSION x_crop_blocks, y_crop_blocks;
   int ci, k, offset_y;
   JBLOCKARRAY src_buffer, dst_buffer;
@@ -811,19 +876,19 @@ do_flip_h(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
   MCU_cols = srcinfo->output_width /
              (dstinfo->max_h_samp_factor * dstinfo_min_DCT_h_scaled_size);
 
-  for (ci = 0; ci < dstinfo->num_components; ci++) {
+  for (ci = job->first_ci; ci <= job->last_ci; ci++) {
     compptr = dstinfo->comp_info + ci;
     comp_width = MCU_cols * compptr->h_samp_factor;
     x_crop_blocks = x_crop_offset * compptr->h_samp_factor;
     y_crop_blocks = y_crop_offset * compptr->v_samp_factor;
-    for (dst_blk_y = 0; dst_blk_y < compptr->height_in_blocks;
-         dst_blk_y += compptr->v_samp_factor) {
-      dst_buffer = (*srcinfo->mem->access_virt_barray)
-        ((j_common_ptr)srcinfo, dst_coef_arrays[ci], dst_blk_y,
-         (JDIMENSION)compptr->v_samp_factor, TRUE);
-      src_buffer = (*srcinfo->mem->access_virt_barray)
-        ((j_common_ptr)srcinfo, src_coef_arrays[ci], dst_blk_y + y_crop_blocks,
-         (JDIMENSION)compptr->v_samp_factor, FALSE);
+    end_blk_y = MIN(end_iMCU_row * compptr->v_samp_factor,
+                    compptr->height_in_blocks);
+    for (dst_blk_y = start_iMCU_row * compptr->v_samp_factor;
+         dst_blk_y < end_blk_y; dst_blk_y += compptr->v_samp_factor) {
+      dst_buffer = dst_blocks(job, ci, dst_blk_y,
+                              (JDIMENSION)compptr->v_samp_factor);
+      src_buffer = src_blocks(job, ci, dst_blk_y + y_crop_blocks,
+                              (JDIMENSION)compptr->v_samp_factor, FALSE);
       for (offset_y = 0; offset_y < compptr->v_samp_factor; offset_y++) {
         dst_row_ptr = dst_buffer[offset_y];
         src_row_ptr = src_buffer[offset_y];
@@ -852,13 +917,15 @@ do_flip_h(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
 
 
 LOCAL(void)
-do_flip_v(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
-          JDIMENSION x_crop_offset, JDIMENSION y_crop_offset,
-          jvirt_barray_ptr *src_coef_arrays,
-          jvirt_barray_ptr *dst_coef_arrays)
+do_flip_v(transform_job *job, JDIMENSION start_iMCU_row,
+          JDIMENSION end_iMCU_row)
 /* Vertical flip */
 {
-  JDIMENSION MCU_rows, comp_height, dst_blk_x, dst_blk_y;
+  j_decompress_ptr srcinfo = job->srcinfo;
+  j_compress_ptr dstinfo = job->dstinfo;
+  JDIMENSION x_crop_offset = job->x_crop_offset;
+  JDIMENSION y_crop_offset = job->y_crop_offset;
+  JDIMENSION MCU_rows, comp_height, dst_blk_x, dst_blk_y, end_blk_y;
   JDIMENSION x_crop_blocks, y_crop_blocks;
   int ci, i, j, offset_y;
   JBLOCKARRAY src_buffer, dst_buffer;
@@ -876,29 +943,27 @@ do_flip_v(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
   MCU_rows = srcinfo->output_height /
              (dstinfo->max_v_samp_factor * dstinfo_min_DCT_v_scaled_size);
 
-  for (ci = 0; ci < dstinfo->num_components; ci++) {
+  for (ci = job->first_ci; ci <= job->last_ci; ci++) {
     compptr = dstinfo->comp_info + ci;
     comp_height = MCU_rows * compptr->v_samp_factor;
     x_crop_blocks = x_crop_offset * compptr->h_samp_factor;
     y_crop_blocks = y_crop_offset * compptr->v_samp_factor;
-    for (dst_blk_y = 0; dst_blk_y < compptr->height_in_blocks;
-         dst_blk_y += compptr->v_samp_factor) {
-      dst_buffer = (*srcinfo->mem->access_virt_barray)
-        ((j_common_ptr)srcinfo, dst_coef_arrays[ci], dst_blk_y,
-         (JDIMENSION)compptr->v_samp_factor, TRUE);
+    end_blk_y = MIN(end_iMCU_row * compptr->v_samp_factor,
+                    compptr->height_in_blocks);
+    for (dst_blk_y = start_iMCU_row * compptr->v_samp_factor;
+         dst_blk_y < end_blk_y; dst_blk_y += compptr->v_samp_factor) {
+      dst_buffer = dst_blocks(job, ci, dst_blk_y,
+                              (JDIMENSION)compptr->v_samp_factor);
       if (y_crop_blocks + dst_blk_y < comp_height) {
         /* Row is within the mirrorable area. */
-        src_buffer = (*srcinfo->mem->access_virt_barray)
-          ((j_common_ptr)srcinfo, src_coef_arrays[ci],
-           comp_height - y_crop_blocks - dst_blk_y -
-           (JDIMENSION)compptr->v_samp_factor,
-           (JDIMENSION)compptr->v_samp_factor, FALSE);
+        src_buffer = src_blocks(job, ci,
+                                comp_height - y_crop_blocks - dst_blk_y -
+                                (JDIMENSION)compptr->v_samp_factor,
+                                (JDIMENSION)compptr->v_samp_factor, FALSE);
       } else {
         /* Bottom-edge blocks will be copied verbatim. */
-        src_buffer = (*srcinfo->mem->access_virt_barray)
-          ((j_common_ptr)srcinfo, src_coef_arrays[ci],
-           dst_blk_y + y_crop_blocks,
-           (JDIMENSION)compptr->v_samp_factor, FALSE);
+        src_buffer = src_blocks(job, ci, dst_blk_y + y_crop_blocks,
+                                (JDIMENSION)compptr->v_samp_factor, FALSE);
       }
       for (offset_y = 0; offset_y < compptr->v_samp_factor; offset_y++) {
         if (y_crop_blocks + dst_blk_y < comp_height) {
@@ -931,13 +996,14 @@ do_flip_v(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
 
 
 LOCAL(void)
-do_transpose(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
-             JDIMENSION x_crop_offset, JDIMENSION y_crop_offset,
-             jvirt_barray_ptr *src_coef_arrays,
-             jvirt_barray_ptr *dst_coef_arrays)
+do_transpose(transform_job *job, JDIMENSION start_iMCU_row,
+             JDIMENSION end_iMCU_row)
 /* Transpose source into destination */
 {
-  JDIMENSION dst_blk_x, dst_blk_y, x_crop_blocks, y_crop_blocks;
+  j_compress_ptr dstinfo = job->dstinfo;
+  JDIMENSION x_crop_offset = job->x_crop_offset;
+  JDIMENSION y_crop_offset = job->y_crop_offset;
+  JDIMENSION dst_blk_x, dst_blk_y, x_crop_blocks, y_crop_blocks, end_blk_y;
   int ci, i, j, offset_x, offset_y;
   JBLOCKARRAY src_buffer, dst_buffer;
   JCOEFPTR src_ptr, dst_ptr;
@@ -948,22 +1014,21 @@ do_transpose(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
    * Partial iMCUs at the edges require no special treatment; we simply
    * process all the available DCT blocks for every component.
    */
-  for (ci = 0; ci < dstinfo->num_components; ci++) {
+  for (ci = job->first_ci; ci <= job->last_ci; ci++) {
     compptr = dstinfo->comp_info + ci;
     x_crop_blocks = x_crop_offset * compptr->h_samp_factor;
     y_crop_blocks = y_crop_offset * compptr->v_samp_factor;
-    for (dst_blk_y = 0; dst_blk_y < compptr->height_in_blocks;
-         dst_blk_y += compptr->v_samp_factor) {
-      dst_buffer = (*srcinfo->mem->access_virt_barray)
-        ((j_common_ptr)srcinfo, dst_coef_arrays[ci], dst_blk_y,
-         (JDIMENSION)compptr->v_samp_factor, TRUE);
+    end_blk_y = MIN(end_iMCU_row * compptr->v_samp_factor,
+                    compptr->height_in_blocks);
+    for (dst_blk_y = start_iMCU_row * compptr->v_samp_factor;
+         dst_blk_y < end_blk_y; dst_blk_y += compptr->v_samp_factor) {
+      dst_buffer = dst_blocks(job, ci, dst_blk_y,
+                              (JDIMENSION)compptr->v_samp_factor);
       for (offset_y = 0; offset_y < compptr->v_samp_factor; offset_y++) {
         for (dst_blk_x = 0; dst_blk_x < compptr->width_in_blocks;
              dst_blk_x += compptr->h_samp_factor) {
-          src_buffer = (*srcinfo->mem->access_virt_barray)
-            ((j_common_ptr)srcinfo, src_coef_arrays[ci],
-             dst_blk_x + x_crop_blocks,
-             (JDIMENSION)compptr->h_samp_factor, FALSE);
+          src_buffer = src_blocks(job, ci, dst_blk_x + x_crop_blocks,
+                                  (JDIMENSION)compptr->h_samp_factor, FALSE);
           for (offset_x = 0; offset_x < compptr->h_samp_factor; offset_x++) {
             dst_ptr = dst_buffer[offset_y][dst_blk_x + offset_x];
             src_ptr =
@@ -980,17 +1045,19 @@ do_transpose(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
 
 
 LOCAL(void)
-do_rot_90(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
-          JDIMENSION x_crop_offset, JDIMENSION y_crop_offset,
-          jvirt_barray_ptr *src_coef_arrays,
-          jvirt_barray_ptr *dst_coef_arrays)
+do_rot_90(transform_job *job, JDIMENSION start_iMCU_row,
+          JDIMENSION end_iMCU_row)
 /* 90 degree rotation is equivalent to
  *   1. Transposing the image;
  *   2. Horizontal mirroring.
  * These two steps are merged into a single processing routine.
  */
 {
-  JDIMENSION MCU_cols, comp_width, dst_blk_x, dst_blk_y;
+  j_decompress_ptr srcinfo = job->srcinfo;
+  j_compress_ptr dstinfo = job->dstinfo;
+  JDIMENSION x_crop_offset = job->x_crop_offset;
+  JDIMENSION y_crop_offset = job->y_crop_offset;
+  JDIMENSION MCU_cols, comp_width, dst_blk_x, dst_blk_y, end_blk_y;
   JDIMENSION x_crop_blocks, y_crop_blocks;
   int ci, i, j, offset_x, offset_y;
   JBLOCKARRAY src_buffer, dst_buffer;
@@ -1004,32 +1071,30 @@ do_rot_90(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
   MCU_cols = srcinfo->output_height /
              (dstinfo->max_h_samp_factor * dstinfo_min_DCT_h_scaled_size);
 
-  for (ci = 0; ci < dstinfo->num_components; ci++) {
+  for (ci = job->first_ci; ci <= job->last_ci; ci++) {
     compptr = dstinfo->comp_info + ci;
     comp_width = MCU_cols * compptr->h_samp_factor;
     x_crop_blocks = x_crop_offset * compptr->h_samp_factor;
     y_crop_blocks = y_crop_offset * compptr->v_samp_factor;
-    for (dst_blk_y = 0; dst_blk_y < compptr->height_in_blocks;
-         dst_blk_y += compptr->v_samp_factor) {
-      dst_buffer = (*srcinfo->mem->access_virt_barray)
-        ((j_common_ptr)srcinfo, dst_coef_arrays[ci], dst_blk_y,
-         (JDIMENSION)compptr->v_samp_factor, TRUE);
+    end_blk_y = MIN(end_iMCU_row * compptr->v_samp_factor,
+                    compptr->height_in_blocks);
+    for (dst_blk_y = start_iMCU_row * compptr->v_samp_factor;
+         dst_blk_y < end_blk_y; dst_blk_y += compptr->v_samp_factor) {
+      dst_buffer = dst_blocks(job, ci, dst_blk_y,
+                              (JDIMENSION)compptr->v_samp_factor);
       for (offset_y = 0; offset_y < compptr->v_samp_factor; offset_y++) {
         for (dst_blk_x = 0; dst_blk_x < compptr->width_in_blocks;
              dst_blk_x += compptr->h_samp_factor) {
           if (x_crop_blocks + dst_blk_x < comp_width) {
             /* Block is within the mirrorable area. */
-            src_buffer = (*srcinfo->mem->access_virt_barray)
-              ((j_common_ptr)srcinfo, src_coef_arrays[ci],
-               comp_width - x_crop_blocks - dst_blk_x -
-               (JDIMENSION)compptr->h_samp_factor,
-               (JDIMENSION)compptr->h_samp_factor, FALSE);
+            src_buffer = src_blocks(job, ci,
+                                    comp_width - x_crop_blocks - dst_blk_x -
+                                    (JDIMENSION)compptr->h_samp_factor,
+                                    (JDIMENSION)compptr->h_samp_factor, FALSE);
           } else {
             /* Edge blocks are transposed but not mirrored. */
-            src_buffer = (*srcinfo->mem->access_virt_barray)
-              ((j_common_ptr)srcinfo, src_coef_arrays[ci],
-               dst_blk_x + x_crop_blocks,
-               (JDIMENSION)compptr->h_samp_factor, FALSE);
+            src_buffer = src_blocks(job, ci, dst_blk_x + x_crop_blocks,
+                                    (JDIMENSION)compptr->h_samp_factor, FALSE);
           }
           for (offset_x = 0; offset_x < compptr->h_samp_factor; offset_x++) {
             dst_ptr = dst_buffer[offset_y][dst_blk_x + offset_x];
@@ -1061,17 +1126,19 @@ do_rot_90(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
 
 
 LOCAL(void)
-do_rot_270(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
-           JDIMENSION x_crop_offset, JDIMENSION y_crop_offset,
-           jvirt_barray_ptr *src_coef_arrays,
-           jvirt_barray_ptr *dst_coef_arrays)
+do_rot_270(transform_job *job, JDIMENSION start_iMCU_row,
+           JDIMENSION end_iMCU_row)
 /* 270 degree rotation is equivalent to
  *   1. Horizontal mirroring;
  *   2. Transposing the image.
  * These two steps are merged into a single processing routine.
  */
 {
-  JDIMENSION MCU_rows, comp_height, dst_blk_x, dst_blk_y;
+  j_decompress_ptr srcinfo = job->srcinfo;
+  j_compress_ptr dstinfo = job->dstinfo;
+  JDIMENSION x_crop_offset = job->x_crop_offset;
+  JDIMENSION y_crop_offset = job->y_crop_offset;
+  JDIMENSION MCU_rows, comp_height, dst_blk_x, dst_blk_y, end_blk_y;
   JDIMENSION x_crop_blocks, y_crop_blocks;
   int ci, i, j, offset_x, offset_y;
   JBLOCKARRAY src_buffer, dst_buffer;
@@ -1085,23 +1152,22 @@ do_rot_270(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
   MCU_rows = srcinfo->output_width /
              (dstinfo->max_v_samp_factor * dstinfo_min_DCT_v_scaled_size);
 
-  for (ci = 0; ci < dstinfo->num_components; ci++) {
+  for (ci = job->first_ci; ci <= job->last_ci; ci++) {
     compptr = dstinfo->comp_info + ci;
     comp_height = MCU_rows * compptr->v_samp_factor;
     x_crop_blocks = x_crop_offset * compptr->h_samp_factor;
     y_crop_blocks = y_crop_offset * compptr->v_samp_factor;
-    for (dst_blk_y = 0; dst_blk_y < compptr->height_in_blocks;
-         dst_blk_y += compptr->v_samp_factor) {
-      dst_buffer = (*srcinfo->mem->access_virt_barray)
-        ((j_common_ptr)srcinfo, dst_coef_arrays[ci], dst_blk_y,
-         (JDIMENSION)compptr->v_samp_factor, TRUE);
+    end_blk_y = MIN(end_iMCU_row * compptr->v_samp_factor,
+                    compptr->height_in_blocks);
+    for (dst_blk_y = start_iMCU_row * compptr->v_samp_factor;
+         dst_blk_y < end_blk_y; dst_blk_y += compptr->v_samp_factor) {
+      dst_buffer = dst_blocks(job, ci, dst_blk_y,
+                              (JDIMENSION)compptr->v_samp_factor);
       for (offset_y = 0; offset_y < compptr->v_samp_factor; offset_y++) {
         for (dst_blk_x = 0; dst_blk_x < compptr->width_in_blocks;
              dst_blk_x += compptr->h_samp_factor) {
-          src_buffer = (*srcinfo->mem->access_virt_barray)
-            ((j_common_ptr)srcinfo, src_coef_arrays[ci],
-             dst_blk_x + x_crop_blocks,
-             (JDIMENSION)compptr->h_samp_factor, FALSE);
+          src_buffer = src_blocks(job, ci, dst_blk_x + x_crop_blocks,
+                                  (JDIMENSION)compptr->h_samp_factor, FALSE);
           for (offset_x = 0; offset_x < compptr->h_samp_factor; offset_x++) {
             dst_ptr = dst_buffer[offset_y][dst_blk_x + offset_x];
             if (y_crop_blocks + dst_blk_y < comp_height) {
@@ -1132,17 +1198,20 @@ do_rot_270(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
 
 
 LOCAL(void)
-do_rot_180(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
-           JDIMENSION x_crop_offset, JDIMENSION y_crop_offset,
-           jvirt_barray_ptr *src_coef_arrays,
-           jvirt_barray_ptr *dst_coef_arrays)
+do_rot_180(transform_job *job, JDIMENSION start_iMCU_row,
+           JDIMENSION end_iMCU_row)
 /* 180 degree rotation is equivalent to
  *   1. Vertical mirroring;
  *   2. Horizontal mirroring.
  * These two steps are merged into a single processing routine.
  */
 {
-  JDIMENSION MCU_cols, MCU_rows, comp_width, comp_height, dst_blk_x, dst_blk_y;
+  j_decompress_ptr srcinfo = job->srcinfo;
+  j_compress_ptr dstinfo = job->dstinfo;
+  JDIMENSION x_crop_offset = job->x_crop_offset;
+  JDIMENSION y_crop_offset = job->y_crop_offset;
+  JDIMENSION MCU_cols, MCU_rows, comp_width, comp_height, dst_blk_x, dst_blk_y,
+             end_blk_y;
   JDIMENSION x_crop_blocks, y_crop_blocks;
   int ci, i, j, offset_y;
   JBLOCKARRAY src_buffer, dst_buffer;
@@ -1155,30 +1224,28 @@ do_rot_180(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
   MCU_rows = srcinfo->output_height /
              (dstinfo->max_v_samp_factor * dstinfo_min_DCT_v_scaled_size);
 
-  for (ci = 0; ci < dstinfo->num_components; ci++) {
+  for (ci = job->first_ci; ci <= job->last_ci; ci++) {
     compptr = dstinfo->comp_info + ci;
     comp_width = MCU_cols * compptr->h_samp_factor;
     comp_height = MCU_rows * compptr->v_samp_factor;
     x_crop_blocks = x_crop_offset * compptr->h_samp_factor;
     y_crop_blocks = y_crop_offset * compptr->v_samp_factor;
-    for (dst_blk_y = 0; dst_blk_y < compptr->height_in_blocks;
-         dst_blk_y += compptr->v_samp_factor) {
-      dst_buffer = (*srcinfo->mem->access_virt_barray)
-        ((j_common_ptr)srcinfo, dst_coef_arrays[ci], dst_blk_y,
-         (JDIMENSION)compptr->v_samp_factor, TRUE);
+    end_blk_y = MIN(end_iMCU_row * compptr->v_samp_factor,
+                    compptr->height_in_blocks);
+    for (dst_blk_y = start_iMCU_row * compptr->v_samp_factor;
+         dst_blk_y < end_blk_y; dst_blk_y += compptr->v_samp_factor) {
+      dst_buffer = dst_blocks(job, ci, dst_blk_y,
+                              (JDIMENSION)compptr->v_samp_factor);
       if (y_crop_blocks + dst_blk_y < comp_height) {
         /* Row is within the vertically mirrorable area. */
-        src_buffer = (*srcinfo->mem->access_virt_barray)
-          ((j_common_ptr)srcinfo, src_coef_arrays[ci],
-           comp_height - y_crop_blocks - dst_blk_y -
-           (JDIMENSION)compptr->v_samp_factor,
-           (JDIMENSION)compptr->v_samp_factor, FALSE);
+        src_buffer = src_blocks(job, ci,
+                                comp_height - y_crop_blocks - dst_blk_y -
+                                (JDIMENSION)compptr->v_samp_factor,
+                                (JDIMENSION)compptr->v_samp_factor, FALSE);
       } else {
         /* Bottom-edge rows are only mirrored horizontally. */
-        src_buffer = (*srcinfo->mem->access_virt_barray)
-          ((j_common_ptr)srcinfo, src_coef_arrays[ci],
-           dst_blk_y + y_crop_blocks,
-           (JDIMENSION)compptr->v_samp_factor, FALSE);
+        src_buffer = src_blocks(job, ci, dst_blk_y + y_crop_blocks,
+                                (JDIMENSION)compptr->v_samp_factor, FALSE);
       }
       for (offset_y = 0; offset_y < compptr->v_samp_factor; offset_y++) {
         dst_row_ptr = dst_buffer[offset_y];
@@ -1243,10 +1310,8 @@ do_rot_180(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
 
 
 LOCAL(void)
-do_transverse(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
-              JDIMENSION x_crop_offset, JDIMENSION y_crop_offset,
-              jvirt_barray_ptr *src_coef_arrays,
-              jvirt_barray_ptr *dst_coef_arrays)
+do_transverse(transform_job *job, JDIMENSION start_iMCU_row,
+              JDIMENSION end_iMCU_row)
 /* Transverse transpose is equivalent to
  *   1. 180 degree rotation;
  *   2. Transposition;
@@ -1257,7 +1322,12 @@ do_transverse(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
  * These steps are merged into a single processing routine.
  */
 {
-  JDIMENSION MCU_cols, MCU_rows, comp_width, comp_height, dst_blk_x, dst_blk_y;
+  j_decompress_ptr srcinfo = job->srcinfo;
+  j_compress_ptr dstinfo = job->dstinfo;
+  JDIMENSION x_crop_offset = job->x_crop_offset;
+  JDIMENSION y_crop_offset = job->y_crop_offset;
+  JDIMENSION MCU_cols, MCU_rows, comp_width, comp_height, dst_blk_x, dst_blk_y,
+             end_blk_y;
   JDIMENSION x_crop_blocks, y_crop_blocks;
   int ci, i, j, offset_x, offset_y;
   JBLOCKARRAY src_buffer, dst_buffer;
@@ -1269,32 +1339,30 @@ do_transverse(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
   MCU_rows = srcinfo->output_width /
              (dstinfo->max_v_samp_factor * dstinfo_min_DCT_v_scaled_size);
 
-  for (ci = 0; ci < dstinfo->num_components; ci++) {
+  for (ci = job->first_ci; ci <= job->last_ci; ci++) {
     compptr = dstinfo->comp_info + ci;
     comp_width = MCU_cols * compptr->h_samp_factor;
     comp_height = MCU_rows * compptr->v_samp_factor;
     x_crop_blocks = x_crop_offset * compptr->h_samp_factor;
     y_crop_blocks = y_crop_offset * compptr->v_samp_factor;
-    for (dst_blk_y = 0; dst_blk_y < compptr->height_in_blocks;
-         dst_blk_y += compptr->v_samp_factor) {
-      dst_buffer = (*srcinfo->mem->access_virt_barray)
-        ((j_common_ptr)srcinfo, dst_coef_arrays[ci], dst_blk_y,
-         (JDIMENSION)compptr->v_samp_factor, TRUE);
+    end_blk_y = MIN(end_iMCU_row * compptr->v_samp_factor,
+                    compptr->height_in_blocks);
+    for (dst_blk_y = start_iMCU_row * compptr->v_samp_factor;
+         dst_blk_y < end_blk_y; dst_blk_y += compptr->v_samp_factor) {
+      dst_buffer = dst_blocks(job, ci, dst_blk_y,
+                              (JDIMENSION)compptr->v_samp_factor);
       for (offset_y = 0; offset_y < compptr->v_samp_factor; offset_y++) {
         for (dst_blk_x = 0; dst_blk_x < compptr->width_in_blocks;
              dst_blk_x += compptr->h_samp_factor) {
           if (x_crop_blocks + dst_blk_x < comp_width) {
             /* Block is within the mirrorable area. */
-            src_buffer = (*srcinfo->mem->access_virt_barray)
-              ((j_common_ptr)srcinfo, src_coef_arrays[ci],
-               comp_width - x_crop_blocks - dst_blk_x -
-               (JDIMENSION)compptr->h_samp_factor,
-               (JDIMENSION)compptr->h_samp_factor, FALSE);
+            src_buffer = src_blocks(job, ci,
+                                    comp_width - x_crop_blocks - dst_blk_x -
+                                    (JDIMENSION)compptr->h_samp_factor,
+                                    (JDIMENSION)compptr->h_samp_factor, FALSE);
           } else {
-            src_buffer = (*srcinfo->mem->access_virt_barray)
-              ((j_common_ptr)srcinfo, src_coef_arrays[ci],
-               dst_blk_x + x_crop_blocks,
-               (JDIMENSION)compptr->h_samp_factor, FALSE);
+            src_buffer = src_blocks(job, ci, dst_blk_x + x_crop_blocks,
+                                    (JDIMENSION)compptr->h_samp_factor, FALSE);
           }
           for (offset_x = 0; offset_x < compptr->h_samp_factor; offset_x++) {
             dst_ptr = dst_buffer[offset_y][dst_blk_x + offset_x];
@@ -1357,6 +1425,142 @@ do_transverse(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
 }
 
 
+/* Build a table of all num_rows block rows of a virtual array, accessing the
+ * array chunk_rows rows at a time in normal scan order.
+ */
+
+LOCAL(JBLOCKARRAY)
+prefetch_block_rows(j_decompress_ptr srcinfo, jvirt_barray_ptr array,
+                    JDIMENSION num_rows, JDIMENSION chunk_rows,
+                    boolean writable)
+{
+  JBLOCKARRAY rows, buffer;
+  JDIMENSION row, offset;
+
+  rows = (JBLOCKARRAY)(*srcinfo->mem->alloc_small)
+    ((j_common_ptr)srcinfo, JPOOL_IMAGE, (size_t)num_rows * sizeof(JBLOCKROW));
+  for (row = 0; row < num_rows; row += chunk_rows) {
+    buffer = (*srcinfo->mem->access_virt_barray)
+      ((j_common_ptr)srcinfo, array, row, chunk_rows, writable);
+    for (offset = 0; offset < chunk_rows; offset++)
+      rows[row + offset] = buffer[offset];
+  }
+  return rows;
+}
+
+
+METHODDEF(void)
+transform_task(void *arg, int task, int worker)
+{
+  transform_job *job = (transform_job *)arg;
+
+  (*job->transform) (job, (JDIMENSION)task, (JDIMENSION)task + 1);
+}
+
+
+/* Run a banded transform routine over all destination iMCU rows.  If the
+ * destination object allows more than one thread and the virtual arrays are
+ * held entirely in memory, then each iMCU row is handed to a worker thread as
+ * a separate task.  The routines never write to a source block that another
+ * band reads, so the result is the same either way.
+ */
+
+LOCAL(void)
+run_transform(transform_job *job, boolean src_writable)
+{
+  j_decompress_ptr srcinfo = job->srcinfo;
+  j_compress_ptr dstinfo = job->dstinfo;
+  jpeg_component_info *compptr;
+  int ci, num_workers;
+
+  job->first_ci = 0;
+  job->last_ci = dstinfo->num_components - 1;
+  for (ci = 0; ci < MAX_COMPONENTS; ci++)
+    job->src_rows[ci] = job->dst_rows[ci] = NULL;
+
+  num_workers =
+    jthread_clamp_workers(jpeg_c_get_int_param(dstinfo, JINT_NUM_THREADS),
+                          (int)dstinfo->total_iMCU_rows);
+  if (num_workers < 2 || !jmem_virt_arrays_resident((j_common_ptr)srcinfo)) {
+    (*job->transform) (job, 0, dstinfo->total_iMCU_rows);
+    return;
+  }
+
+  /* Align the virtual arrays up front, since that can't be done by more than
+   * one thread at a time.
+   */
+  for (ci = 0; ci < dstinfo->num_components; ci++) {
+    compptr = srcinfo->comp_info + ci;
+    job->src_rows[ci] = prefetch_block_rows(srcinfo, job->src_coef_arrays[ci],
+      (JDIMENSION)jround_up((long)compptr->height_in_blocks,
+                            (long)compptr->v_samp_factor),
+      (JDIMENSION)compptr->v_samp_factor, src_writable);
+    if (job->dst_coef_arrays != NULL) {
+      compptr = dstinfo->comp_info + ci;
+      job->dst_rows[ci] = prefetch_block_rows(srcinfo,
+        job->dst_coef_arrays[ci],
+        (JDIMENSION)jround_up((long)compptr->height_in_blocks,
+                              (long)compptr->v_samp_factor),
+        (JDIMENSION)compptr->v_samp_factor, TRUE);
+    }
+  }
+
+  jthread_run(job, transform_task, (int)dstinfo->total_iMCU_rows,
+              num_workers);
+}
+
+
+/* Coefficient source for a streamed transform: produce one iMCU row of one
+ * destination component directly into the compressor's buffer.
+ */
+
+METHODDEF(void)
+stream_transform_rows(j_compress_ptr cinfo, void *client_data, int ci,
+                      JDIMENSION iMCU_row, JBLOCKARRAY rows)
+{
+  transform_job *job = (transform_job *)client_data;
+  int v_samp_factor = cinfo->comp_info[ci].v_samp_factor;
+  int offset_y;
+
+  for (offset_y = 0; offset_y < v_samp_factor; offset_y++)
+    job->dst_rows[ci][iMCU_row * v_samp_factor + offset_y] = rows[offset_y];
+  job->first_ci = job->last_ci = ci;
+  (*job->transform) (job, iMCU_row, iMCU_row + 1);
+}
+
+
+/* Hand a banded transform routine to the compressor as its coefficient
+ * source.  The destination row tables cover the whole image but are pointed
+ * at the compressor's buffer one iMCU row at a time.
+ */
+
+LOCAL(void)
+start_streaming(transform_job *job)
+{
+  j_decompress_ptr srcinfo = job->srcinfo;
+  j_compress_ptr dstinfo = job->dstinfo;
+  transform_job *stream_job;
+  jpeg_component_info *compptr;
+  int ci;
+
+  /* The job must outlive jtransform_execute_transform(). */
+  stream_job = (transform_job *)(*srcinfo->mem->alloc_small)
+    ((j_common_ptr)srcinfo, JPOOL_IMAGE, sizeof(transform_job));
+  *stream_job = *job;
+  for (ci = 0; ci < MAX_COMPONENTS; ci++)
+    stream_job->src_rows[ci] = stream_job->dst_rows[ci] = NULL;
+  for (ci = 0; ci < dstinfo->num_components; ci++) {
+    compptr = dstinfo->comp_info + ci;
+    stream_job->dst_rows[ci] = (JBLOCKARRAY)(*srcinfo->mem->alloc_small)
+      ((j_common_ptr)srcinfo, JPOOL_IMAGE,
+       (size_t)dstinfo->total_iMCU_rows * compptr->v_samp_factor *
+       sizeof(JBLOCKROW));
+  }
+
+  jpeg_set_coef_source(dstinfo, stream_transform_rows, stream_job);
+}
+
+
 /* Parse an unsigned integer: subroutine for jtransform_parse_crop_spec.
  * Returns TRUE if valid integer found, FALSE if not.
  * *strptr is advanced over the digit string, and *result is set to its value.
@@ -1788,6 +1992,19 @@ jtransform_request_workspace(j_decompress_ptr srcinfo,
     break;
   }
 
+  /* A streamed transform produces each destination iMCU row from the source
+   * arrays when the compressor asks for it, so it needs no workspace.  The
+   * routines that extend the image beyond the source can't do that.
+   */
+  info->stream_coefs = FALSE;
+  if (need_workspace && info->streaming &&
+      (info->transform != JXFORM_NONE ||
+       (info->output_width <= srcinfo->output_width &&
+        info->output_height <= srcinfo->output_height))) {
+    need_workspace = FALSE;
+    info->stream_coefs = TRUE;
+  }
+
   /* Allocate workspace if needed.
    * Note that we allocate arrays padded out to the next iMCU boundary,
    * so that transform routines need not worry about missing edge blocks.
@@ -2164,6 +2381,16 @@ jtransform_execute_transform(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
                              jpeg_transform_info *info)
 {
   jvirt_barray_ptr *dst_coef_arrays = info->workspace_coef_arrays;
+  transform_job job;
+  boolean src_writable = FALSE;
+
+  job.srcinfo = srcinfo;
+  job.dstinfo = dstinfo;
+  job.x_crop_offset = info->x_crop_offset;
+  job.y_crop_offset = info->y_crop_offset;
+  job.src_coef_arrays = src_coef_arrays;
+  job.dst_coef_arrays = dst_coef_arrays;
+  job.transform = NULL;
 
   /* Note: conditions tested here should match those in switch statement
    * in jtransform_request_workspace()
@@ -2187,40 +2414,33 @@ jtransform_execute_transform(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
                          info->x_crop_offset, info->y_crop_offset,
                          src_coef_arrays, dst_coef_arrays);
     } else if (info->x_crop_offset != 0 || info->y_crop_offset != 0)
-      do_crop(srcinfo, dstinfo, info->x_crop_offset, info->y_crop_offset,
-              src_coef_arrays, dst_coef_arrays);
+      job.transform = do_crop;
     break;
   case JXFORM_FLIP_H:
     if (info->y_crop_offset != 0 || info->slow_hflip)
-      do_flip_h(srcinfo, dstinfo, info->x_crop_offset, info->y_crop_offset,
-                src_coef_arrays, dst_coef_arrays);
-    else
-      do_flip_h_no_crop(srcinfo, dstinfo, info->x_crop_offset,
-                        src_coef_arrays);
+      job.transform = do_flip_h;
+    else {
+      job.transform = do_flip_h_no_crop;
+      src_writable = TRUE;
+    }
     break;
   case JXFORM_FLIP_V:
-    do_flip_v(srcinfo, dstinfo, info->x_crop_offset, info->y_crop_offset,
-              src_coef_arrays, dst_coef_arrays);
+    job.transform = do_flip_v;
     break;
   case JXFORM_TRANSPOSE:
-    do_transpose(srcinfo, dstinfo, info->x_crop_offset, info->y_crop_offset,
-                 src_coef_arrays, dst_coef_arrays);
+    job.transform = do_transpose;
     break;
   case JXFORM_TRANSVERSE:
-    do_transverse(srcinfo, dstinfo, info->x_crop_offset, info->y_crop_offset,
-                  src_coef_arrays, dst_coef_arrays);
+    job.transform = do_transverse;
     break;
   case JXFORM_ROT_90:
-    do_rot_90(srcinfo, dstinfo, info->x_crop_offset, info->y_crop_offset,
-              src_coef_arrays, dst_coef_arrays);
+    job.transform = do_rot_90;
     break;
   case JXFORM_ROT_180:
-    do_rot_180(srcinfo, dstinfo, info->x_crop_offset, info->y_crop_offset,
-               src_coef_arrays, dst_coef_arrays);
+    job.transform = do_rot_180;
     break;
   case JXFORM_ROT_270:
-    do_rot_270(srcinfo, dstinfo, info->x_crop_offset, info->y_crop_offset,
-               src_coef_arrays, dst_coef_arrays);
+    job.transform = do_rot_270;
     break;
   case JXFORM_WIPE:
     if (info->crop_width_set == JCROP_REFLECT &&
@@ -2247,6 +2467,13 @@ jtransform_execute_transform(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
               info->drop_width, info->drop_height);
     break;
   }
+
+  if (job.transform != NULL) {
+    if (info->stream_coefs)
+      start_streaming(&job);
+    else
+      run_transform(&job, src_writable);
+  }
 }
 
 /* jtransform_perfect_transform
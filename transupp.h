@@ -148,6 +148,14 @@ typedef struct {
                           coefficients in tact (necessary if other transformed
                           images must be generated from the same set of
                           coefficients. */
+  boolean streaming;   /* If TRUE, transformations that would otherwise
+                          need a workspace copy of the image instead supply
+                          the compressor with each transformed iMCU row on
+                          demand (see jpeg_set_coef_source()), which halves
+                          the memory required.  The source coefficients must
+                          then remain available until jpeg_finish_compress()
+                          returns, and the destination coefficients can't be
+                          accessed directly. */
 
   /* Crop parameters: application need not set these unless crop is TRUE.
    * These can be filled in by jtransform_parse_crop_spec().
@@ -168,6 +176,7 @@ typedef struct {
   /* Internal workspace: caller should not touch these */
   int num_components;           /* # of components in workspace */
   jvirt_barray_ptr *workspace_coef_arrays; /* workspace for transformations */
+  boolean stream_coefs;         /* TRUE if coefficients are streamed */
   JDIMENSION output_width;      /* cropped destination dimensions */
   JDIMENSION output_height;
   JDIMENSION x_crop_offset;     /* destination crop offsets measured in iMCUs */
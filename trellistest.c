@@ -0,0 +1,153 @@
+/*
+ * trellistest.c
+ *
+ * Copyright (C) 2026, Mozilla Corporation.
+ * For conditions of distribution and use, see the accompanying README.ijg
+ * file.
+ *
+ * This program runs trellis quantization (quantize_trellis()) on rows of
+ * random DCT blocks, using various quantization tables, and writes the
+ * quantized blocks to a file.  The file must be identical whether the
+ * rate/distortion search uses the SIMD or the C implementation, so the test
+ * suite runs this program twice, once with JSIMD_NOTRELLIS=1, and compares
+ * the output files.
+ *
+ * Usage: trellistest <output file>
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+#include "jchuff.h"
+#include <setjmp.h>
+
+
+#define NUM_BLOCKS  64
+#define NUM_ROWS  4
+
+#define THROW(msg) { \
+  printf("ERROR in line %d: %s\n", __LINE__, msg); \
+  retval = -1;  goto bailout; \
+}
+
+
+struct my_error_mgr {
+  struct jpeg_error_mgr pub;
+  jmp_buf setjmp_buffer;
+};
+
+typedef struct my_error_mgr *my_error_ptr;
+
+static void my_error_exit(j_common_ptr cinfo)
+{
+  my_error_ptr myerr = (my_error_ptr)cinfo->err;
+
+  (*cinfo->err->output_message) (cinfo);
+  longjmp(myerr->setjmp_buffer, 1);
+}
+
+
+static unsigned int seed = 1;
+
+static int random_int(int max)
+{
+  seed = seed * 1103515245 + 12345;
+  return (int)((seed >> 16) % (unsigned int)(2 * max + 1)) - max;
+}
+
+
+/*
+ * Fill a row of blocks with random DCT coefficients, scaled up by 8 as the
+ * output of the forward DCT is.  The amplitude varies from block to block and
+ * falls off with frequency, so that the search sees both sparse and dense
+ * blocks.
+ */
+
+static void random_block_row(JBLOCKROW src)
+{
+  int bi, i, amplitude;
+
+  for (bi = 0; bi < NUM_BLOCKS; bi++) {
+    amplitude = 8 << (bi % 11);
+    src[bi][0] = (JCOEF)random_int(8 * 1023);
+    for (i = 1; i < DCTSIZE2; i++)
+      src[bi][i] = (JCOEF)random_int(amplitude * 8 / (8 + i));
+  }
+}
+
+
+int main(int argc, char **argv)
+{
+  static const int qualities[] = { 5, 25, 50, 75, 90, 100 };
+  struct jpeg_compress_struct cinfo;
+  struct my_error_mgr jerr;
+  JBLOCK src[NUM_ROWS][NUM_BLOCKS], coef[NUM_ROWS][NUM_BLOCKS];
+  c_derived_tbl *dctbl = NULL, *actbl = NULL;
+  double norm_src[DCTSIZE2], norm_coef[DCTSIZE2];
+  JCOEF last_dc;
+  FILE *outfile = NULL;
+  int q, eob_opt, row;
+  volatile int retval = 0;
+
+  if (argc < 2) {
+    printf("USAGE: %s <output file>\n", argv[0]);
+    return 1;
+  }
+  if ((outfile = fopen(argv[1], "wb")) == NULL) {
+    printf("ERROR: Could not open %s for writing\n", argv[1]);
+    return -1;
+  }
+
+  cinfo.err = jpeg_std_error(&jerr.pub);
+  jerr.pub.error_exit = my_error_exit;
+  if (setjmp(jerr.setjmp_buffer)) {
+    retval = -1;  goto bailout;
+  }
+
+  jpeg_create_compress(&cinfo);
+  cinfo.image_width = NUM_BLOCKS * DCTSIZE;
+  cinfo.image_height = NUM_ROWS * DCTSIZE;
+  cinfo.input_components = 1;
+  cinfo.in_color_space = JCS_GRAYSCALE;
+  jpeg_set_defaults(&cinfo);
+
+  /* Set up just enough of the compressor state for quantize_trellis(). */
+  cinfo.comp_info[0].width_in_blocks = NUM_BLOCKS;
+  cinfo.total_iMCU_rows = NUM_ROWS;
+  cinfo.Ss = 0;
+  cinfo.Se = DCTSIZE2 - 1;
+
+  for (q = 0; q < (int)(sizeof(qualities) / sizeof(int)); q++) {
+    for (eob_opt = 0; eob_opt <= 1; eob_opt++) {
+      printf("Quality %d, EOB optimization %s ... ", qualities[q],
+             eob_opt ? "on" : "off");
+      jpeg_set_quality(&cinfo, qualities[q], TRUE);
+      cinfo.master->trellis_eob_opt = eob_opt;
+      jinit_trellis_quantizer(&cinfo);
+      jpeg_make_c_derived_tbl(&cinfo, TRUE, 0, &dctbl);
+      jpeg_make_c_derived_tbl(&cinfo, FALSE, 0, &actbl);
+
+      memset(norm_src, 0, sizeof(norm_src));
+      memset(norm_coef, 0, sizeof(norm_coef));
+      last_dc = 0;
+      for (row = 0; row < NUM_ROWS; row++) {
+        random_block_row(src[row]);
+        quantize_trellis(&cinfo, dctbl, actbl, coef[row], src[row],
+                         NUM_BLOCKS, cinfo.quant_tbl_ptrs[0], norm_src,
+                         norm_coef, &last_dc, row > 0 ? coef[row - 1] : NULL,
+                         row > 0 ? src[row - 1] : NULL, 0);
+      }
+      if (fwrite(coef, sizeof(coef), 1, outfile) != 1)
+        THROW("Could not write output file");
+      printf("Done.\n");
+    }
+  }
+
+bailout:
+  jpeg_destroy_compress(&cinfo);
+  if (outfile && fclose(outfile) != 0 && retval == 0) {
+    printf("ERROR: Could not write %s\n", argv[1]);
+    retval = -1;
+  }
+  return retval;
+}
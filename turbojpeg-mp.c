@@ -67,6 +67,47 @@
 
 /******************************** Compressor *********************************/
 
+/* Compress (job->finish == FALSE) or finish compressing (job->finish == TRUE)
+   one stripe of a striped compression job.  See compressStripes() in
+   turbojpeg.c. */
+
+static void GET_NAME(compressStripe, BITS_IN_JSAMPLE) (void *arg, int task,
+                                                       int worker)
+{
+  tjstripejob *job = (tjstripejob *)arg;
+  tjstripe *stripe = &job->stripes[task];
+  j_compress_ptr cinfo = &stripe->cinfo;
+  _JSAMPROW *row_pointer = (_JSAMPROW *)job->rowPointers + stripe->startRow;
+
+  if (setjmp(stripe->jerr.setjmp_buffer)) {
+    /* If we get here, the JPEG code has signaled an error. */
+    stripe->failed = TRUE;
+    return;
+  }
+
+  if (job->finish) {
+    jpeg_finish_compress(cinfo);
+    return;
+  }
+
+  initStripe(job->this, stripe);
+  cinfo->image_width = job->width;
+  cinfo->image_height = stripe->numRows;
+  cinfo->data_precision = BITS_IN_JSAMPLE;
+  setCompDefaults(job->this, cinfo, job->pixelFormat);
+  cinfo->restart_in_rows = job->restartRows;
+  jpeg_mem_dest_tj(cinfo, &stripe->jpegBuf, &stripe->jpegSize, TRUE);
+
+  jpeg_start_compress(cinfo, TRUE);
+  while (cinfo->next_scanline < cinfo->image_height)
+    _jpeg_write_scanlines(cinfo, &row_pointer[cinfo->next_scanline],
+                          cinfo->image_height - cinfo->next_scanline);
+  /* If the Huffman tables are being optimized, then the statistics of all
+     stripes must be merged before the stripes can be finished. */
+  if (!cinfo->optimize_coding)
+    jpeg_finish_compress(cinfo);
+}
+
 /* TurboJPEG 3+ */
 DLLEXPORT int GET_NAME(tj3Compress, BITS_IN_JSAMPLE)
   (tjhandle handle, const _JSAMPLE *srcBuf, int width, int pitch, int height,
@@ -76,8 +117,10 @@ DLLEXPORT int GET_NAME(tj3Compress, BITS_IN_JSAMPLE)
   int i, retval = 0;
   boolean alloc = TRUE;
   _JSAMPROW *row_pointer = NULL;
+  tjstripejob job;
 
   GET_CINSTANCE(handle)
+  job.stripes = NULL;
   if ((this->init & COMPRESS) == 0)
     THROW("Instance has not been initialized for compression");
 
@@ -105,20 +148,40 @@ DLLEXPORT int GET_NAME(tj3Compress, BITS_IN_JSAMPLE)
   cinfo->image_height = height;
   cinfo->data_precision = BITS_IN_JSAMPLE;
 
-  setCompDefaults(this, pixelFormat);
+  setCompDefaults(this, cinfo, pixelFormat);
   if (this->noRealloc) {
     alloc = FALSE;
     *jpegSize = tj3JPEGBufSize(width, height, this->subsamp);
   }
   jpeg_mem_dest_tj(cinfo, jpegBuf, jpegSize, alloc);
 
-  jpeg_start_compress(cinfo, TRUE);
   for (i = 0; i < height; i++) {
     if (this->bottomUp)
       row_pointer[i] = (_JSAMPROW)&srcBuf[(height - i - 1) * (size_t)pitch];
     else
       row_pointer[i] = (_JSAMPROW)&srcBuf[i * (size_t)pitch];
   }
+
+  if ((job.numStripes = planStripes(this, cinfo, width, height, &job)) > 0) {
+    if ((job.stripes = (tjstripe *)calloc(job.numStripes,
+                                          sizeof(tjstripe))) == NULL)
+      THROW("Memory allocation failure");
+    job.this = this;
+    job.width = width;
+    job.pixelFormat = pixelFormat;
+    job.rowPointers = (void *)row_pointer;
+    for (i = 0; i < job.numStripes; i++) {
+      job.stripes[i].startRow = i * job.stripeHeight;
+      job.stripes[i].numRows = min(job.stripeHeight,
+                                   height - i * job.stripeHeight);
+      job.stripes[i].firstInterval = i * job.stripeIntervals;
+    }
+    retval = compressStripes(this, &job,
+                             GET_NAME(compressStripe, BITS_IN_JSAMPLE), alloc);
+    goto bailout;
+  }
+
+  jpeg_start_compress(cinfo, TRUE);
   while (cinfo->next_scanline < cinfo->image_height)
     _jpeg_write_scanlines(cinfo, &row_pointer[cinfo->next_scanline],
                           cinfo->image_height - cinfo->next_scanline);
@@ -130,6 +193,7 @@ bailout:
   if (cinfo->global_state > CSTATE_START || retval == -1)
     jpeg_abort_compress(cinfo);
   free(row_pointer);
+  free(job.stripes);
   if (this->jerr.warning) retval = -1;
   return retval;
 }
@@ -137,6 +201,98 @@ bailout:
 
 /******************************* Decompressor ********************************/
 
+#if BITS_IN_JSAMPLE != 16
+
+/* Decompress one stripe of a striped decompression job.  See
+   decompressStripes() in turbojpeg.c. */
+
+static void GET_NAME(decompressStripe, BITS_IN_JSAMPLE) (void *arg, int task,
+                                                         int worker)
+{
+  tjdstripejob *job = (tjdstripejob *)arg;
+  tjdstripe *stripe = &job->stripes[task];
+  j_decompress_ptr dinfo = &stripe->dinfo;
+  _JSAMPROW *row_pointer = (_JSAMPROW *)job->rowPointers + stripe->startRow;
+  _JSAMPROW scratch;
+
+  if (setjmp(stripe->jerr.setjmp_buffer)) {
+    /* If we get here, the JPEG code has signaled an error. */
+    stripe->failed = TRUE;
+    return;
+  }
+
+  initDecompStripe(job->this, stripe);
+  jpeg_start_decompress(dinfo);
+
+  /* Discard the rows that were decompressed only to provide context for
+     upsampling. */
+  scratch = (_JSAMPROW)(*dinfo->mem->alloc_large)
+    ((j_common_ptr)dinfo, JPOOL_IMAGE,
+     dinfo->output_width * dinfo->out_color_components * sizeof(_JSAMPLE));
+  while ((int)dinfo->output_scanline < stripe->skipRows)
+    _jpeg_read_scanlines(dinfo, &scratch, 1);
+
+  while ((int)dinfo->output_scanline < stripe->skipRows + stripe->numRows)
+    _jpeg_read_scanlines(dinfo, &row_pointer[dinfo->output_scanline -
+                                             stripe->skipRows],
+                         stripe->skipRows + stripe->numRows -
+                         dinfo->output_scanline);
+
+  if (dinfo->output_scanline == dinfo->output_height)
+    jpeg_finish_decompress(dinfo);
+  else
+    jpeg_abort_decompress(dinfo);
+}
+
+
+/* Decompress a 1/8-scale image and reduce it to the destination image
+   dimensions, setting each destination pixel to the average of the pixels that
+   it covers.  This is used with scaling factors smaller than 1/8, for which the
+   library reconstructs the image from the DC coefficients alone. */
+
+static void GET_NAME(decompressReduced, BITS_IN_JSAMPLE)
+  (j_decompress_ptr dinfo, _JSAMPROW *row_pointer, int dstWidth,
+   int dstHeight)
+{
+  int srcWidth = dinfo->output_width, srcHeight = dinfo->output_height;
+  int nc = dinfo->output_components, x, y, c, sx, sx0, sx1, sy1, rows, count;
+  unsigned long long *sum;
+  _JSAMPROW inbuf;
+
+  inbuf = (_JSAMPROW)(*dinfo->mem->alloc_large)
+    ((j_common_ptr)dinfo, JPOOL_IMAGE,
+     (size_t)srcWidth * nc * sizeof(_JSAMPLE));
+  sum = (unsigned long long *)(*dinfo->mem->alloc_large)
+    ((j_common_ptr)dinfo, JPOOL_IMAGE,
+     (size_t)dstWidth * nc * sizeof(unsigned long long));
+
+  for (y = 0; y < dstHeight; y++) {
+    /* Since the source image is at least as large as the destination image,
+       each destination pixel covers at least one source pixel. */
+    sy1 = (int)((long long)(y + 1) * srcHeight / dstHeight);
+    rows = sy1 - (int)dinfo->output_scanline;
+    memset(sum, 0, (size_t)dstWidth * nc * sizeof(unsigned long long));
+    while ((int)dinfo->output_scanline < sy1) {
+      _jpeg_read_scanlines(dinfo, &inbuf, 1);
+      for (x = 0, sx = 0; x < dstWidth; x++) {
+        sx1 = (int)((long long)(x + 1) * srcWidth / dstWidth);
+        for (; sx < sx1; sx++)
+          for (c = 0; c < nc; c++)
+            sum[x * nc + c] += inbuf[sx * nc + c];
+      }
+    }
+    for (x = 0, sx0 = 0; x < dstWidth; x++, sx0 = sx1) {
+      sx1 = (int)((long long)(x + 1) * srcWidth / dstWidth);
+      count = (sx1 - sx0) * rows;
+      for (c = 0; c < nc; c++)
+        row_pointer[y][x * nc + c] =
+          (_JSAMPLE)((sum[x * nc + c] + count / 2) / count);
+    }
+  }
+}
+
+#endif
+
 /* TurboJPEG 3+ */
 DLLEXPORT int GET_NAME(tj3Decompress, BITS_IN_JSAMPLE)
   (tjhandle handle, const unsigned char *jpegBuf, size_t jpegSize,
@@ -148,6 +304,8 @@ DLLEXPORT int GET_NAME(tj3Decompress, BITS_IN_JSAMPLE)
   int croppedHeight, i, retval = 0;
 #if BITS_IN_JSAMPLE != 16
   int scaledWidth;
+  volatile boolean reduce = FALSE;
+  tjdstripejob job;
 #endif
   struct my_progress_mgr progress;
 
@@ -192,10 +350,26 @@ DLLEXPORT int GET_NAME(tj3Decompress, BITS_IN_JSAMPLE)
 
   dinfo->scale_num = this->scalingFactor.num;
   dinfo->scale_denom = this->scalingFactor.denom;
+  jpeg_d_set_int_param(dinfo, JINT_NUM_THREADS, this->numThreads);
+  jpeg_d_set_int_param(dinfo, JINT_SCAN_BUDGET, this->scanBudget);
+  jpeg_d_set_int_param(dinfo, JINT_CHECKPOINT_INTERVAL,
+                       this->croppingRegion.x != 0 ||
+                       this->croppingRegion.y != 0 ||
+                       this->croppingRegion.w != 0 ||
+                       this->croppingRegion.h != 0 ? CHECKPOINT_INTERVAL : 0);
 
   jpeg_start_decompress(dinfo);
 
 #if BITS_IN_JSAMPLE != 16
+  if (!dinfo->master->lossless &&
+      BEYOND_IDCT_SCALING(this->scalingFactor)) {
+    if (this->croppingRegion.x != 0 || this->croppingRegion.y != 0 ||
+        this->croppingRegion.w != 0 || this->croppingRegion.h != 0)
+      THROW("Scaling factors smaller than 1/8 cannot be used with\n"
+            "partial decompression");
+    reduce = TRUE;
+  }
+
   if (this->croppingRegion.x != 0 ||
       (this->croppingRegion.w != 0 && this->croppingRegion.w != scaledWidth)) {
     JDIMENSION crop_x = this->croppingRegion.x;
@@ -213,13 +387,16 @@ DLLEXPORT int GET_NAME(tj3Decompress, BITS_IN_JSAMPLE)
   }
 #endif
 
-  if (pitch == 0) pitch = dinfo->output_width * tjPixelSize[pixelFormat];
-
   croppedHeight = dinfo->output_height;
 #if BITS_IN_JSAMPLE != 16
+  if (reduce) {
+    if (pitch == 0) pitch = scaledWidth * tjPixelSize[pixelFormat];
+    croppedHeight = TJSCALED(dinfo->image_height, this->scalingFactor);
+  }
   if (this->croppingRegion.y != 0 || this->croppingRegion.h != 0)
     croppedHeight = this->croppingRegion.h;
 #endif
+  if (pitch == 0) pitch = dinfo->output_width * tjPixelSize[pixelFormat];
   if ((row_pointer =
        (_JSAMPROW *)malloc(sizeof(_JSAMPROW) * croppedHeight)) == NULL)
     THROW("Memory allocation failure");
@@ -235,7 +412,22 @@ DLLEXPORT int GET_NAME(tj3Decompress, BITS_IN_JSAMPLE)
   }
 
 #if BITS_IN_JSAMPLE != 16
-  if (this->croppingRegion.y != 0 || this->croppingRegion.h != 0) {
+  job.stripes = NULL;
+  if ((job.numStripes = planDecompStripes(this, dinfo, jpegBuf, jpegSize,
+                                          &job)) > 0) {
+    job.this = this;
+    job.rowPointers = (void *)row_pointer;
+    retval = decompressStripes(this, &job,
+                               GET_NAME(decompressStripe, BITS_IN_JSAMPLE));
+    free(job.stripes);
+    if (!retval) this->bytesRead = jpegSize;
+    goto bailout;
+  }
+
+  if (reduce)
+    GET_NAME(decompressReduced, BITS_IN_JSAMPLE) (dinfo, row_pointer,
+                                                  scaledWidth, croppedHeight);
+  else if (this->croppingRegion.y != 0 || this->croppingRegion.h != 0) {
     if (this->croppingRegion.y != 0) {
       JDIMENSION lines = _jpeg_skip_scanlines(dinfo, this->croppingRegion.y);
 
@@ -271,6 +463,7 @@ DLLEXPORT int GET_NAME(tj3Decompress, BITS_IN_JSAMPLE)
                            dinfo->output_height - dinfo->output_scanline);
   }
   jpeg_finish_decompress(dinfo);
+  this->bytesRead = jpegSize - dinfo->src->bytes_in_buffer;
 
 bailout:
   if (dinfo->global_state > DSTATE_START) jpeg_abort_decompress(dinfo);
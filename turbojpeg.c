@@ -47,10 +47,12 @@
 #include "transupp.h"
 #include "./jpegapicomp.h"
 #include "./cdjpeg.h"
+#include "./jthread.h"
 
 extern void jpeg_mem_dest_tj(j_compress_ptr, unsigned char **, size_t *,
                              boolean);
 extern void jpeg_mem_src_tj(j_decompress_ptr, const unsigned char *, size_t);
+extern long *jpeg_huff_stats(j_compress_ptr, boolean, int);
 
 #define PAD(v, p)  ((v + (p) - 1) & (~((p) - 1)))
 #define IS_POW2(x)  (((x) & (x - 1)) == 0)
@@ -139,6 +141,10 @@ typedef struct _tjinstance {
   tjregion croppingRegion;
   int maxMemory;
   int maxPixels;
+  int numThreads;
+  boolean warmContext;
+  int scanBudget;
+  size_t bytesRead;
 } tjinstance;
 
 static tjhandle _tjInitCompress(tjinstance *this);
@@ -197,6 +203,18 @@ static const tjscalingfactor sf[NUMSF] = {
   { 1, 8 }
 };
 
+/* Scaling factors smaller than 1/8 are not in the list above, since they are
+   not implemented by the IDCT.  The image is instead decompressed at 1/8 scale
+   using only the DC coefficients and then reduced further by averaging (see
+   tj3Decompress*().) */
+#define BEYOND_IDCT_SCALING(scalingFactor) \
+  ((long long)(scalingFactor).num * DCTSIZE < (scalingFactor).denom)
+
+/* Minimum number of MCUs between the random access points that the
+   decompressor may use to seek past the MCUs outside of the cropping region
+   (see JINT_CHECKPOINT_INTERVAL in README-mozilla.txt) */
+#define CHECKPOINT_INTERVAL  16
+
 static J_COLOR_SPACE pf2cs[TJ_NUMPF] = {
   JCS_EXT_RGB, JCS_EXT_BGR, JCS_EXT_RGBX, JCS_EXT_BGRX, JCS_EXT_XBGR,
   JCS_EXT_XRGB, JCS_GRAYSCALE, JCS_EXT_RGBA, JCS_EXT_BGRA, JCS_EXT_ABGR,
@@ -327,25 +345,27 @@ static int getPixelFormat(int pixelSize, int flags)
   return -1;
 }
 
-static void setCompDefaults(tjinstance *this, int pixelFormat)
+static void setCompDefaults(tjinstance *this, j_compress_ptr cinfo,
+                            int pixelFormat)
 {
   int subsamp = this->subsamp;
 
-  this->cinfo.in_color_space = pf2cs[pixelFormat];
-  this->cinfo.input_components = tjPixelSize[pixelFormat];
-  jpeg_c_set_int_param(&this->cinfo, JINT_COMPRESS_PROFILE, JCP_FASTEST);
-  jpeg_set_defaults(&this->cinfo);
+  cinfo->in_color_space = pf2cs[pixelFormat];
+  cinfo->input_components = tjPixelSize[pixelFormat];
+  jpeg_c_set_int_param(cinfo, JINT_COMPRESS_PROFILE, JCP_FASTEST);
+  jpeg_set_defaults(cinfo);
+  jpeg_c_set_bool_param(cinfo, JBOOLEAN_WARM_CONTEXT, this->warmContext);
 
-  this->cinfo.restart_interval = this->restartIntervalBlocks;
-  this->cinfo.restart_in_rows = this->restartIntervalRows;
-  this->cinfo.X_density = (UINT16)this->xDensity;
-  this->cinfo.Y_density = (UINT16)this->yDensity;
-  this->cinfo.density_unit = (UINT8)this->densityUnits;
-  this->cinfo.mem->max_memory_to_use = (long)this->maxMemory * 1048576L;
+  cinfo->restart_interval = this->restartIntervalBlocks;
+  cinfo->restart_in_rows = this->restartIntervalRows;
+  cinfo->X_density = (UINT16)this->xDensity;
+  cinfo->Y_density = (UINT16)this->yDensity;
+  cinfo->density_unit = (UINT8)this->densityUnits;
+  cinfo->mem->max_memory_to_use = (long)this->maxMemory * 1048576L;
 
   if (this->lossless) {
 #ifdef C_LOSSLESS_SUPPORTED
-    jpeg_enable_lossless(&this->cinfo, this->losslessPSV, this->losslessPt);
+    jpeg_enable_lossless(cinfo, this->losslessPSV, this->losslessPt);
 #endif
     if (pixelFormat == TJPF_GRAY)
       subsamp = TJSAMP_GRAY;
@@ -354,46 +374,46 @@ static void setCompDefaults(tjinstance *this, int pixelFormat)
     return;
   }
 
-  jpeg_set_quality(&this->cinfo, this->quality, TRUE);
-  this->cinfo.dct_method = this->fastDCT ? JDCT_FASTEST : JDCT_ISLOW;
+  jpeg_set_quality(cinfo, this->quality, TRUE);
+  cinfo->dct_method = this->fastDCT ? JDCT_FASTEST : JDCT_ISLOW;
 
   switch (this->colorspace) {
   case TJCS_RGB:
-    jpeg_set_colorspace(&this->cinfo, JCS_RGB);  break;
+    jpeg_set_colorspace(cinfo, JCS_RGB);  break;
   case TJCS_YCbCr:
-    jpeg_set_colorspace(&this->cinfo, JCS_YCbCr);  break;
+    jpeg_set_colorspace(cinfo, JCS_YCbCr);  break;
   case TJCS_GRAY:
-    jpeg_set_colorspace(&this->cinfo, JCS_GRAYSCALE);  break;
+    jpeg_set_colorspace(cinfo, JCS_GRAYSCALE);  break;
   case TJCS_CMYK:
-    jpeg_set_colorspace(&this->cinfo, JCS_CMYK);  break;
+    jpeg_set_colorspace(cinfo, JCS_CMYK);  break;
   case TJCS_YCCK:
-    jpeg_set_colorspace(&this->cinfo, JCS_YCCK);  break;
+    jpeg_set_colorspace(cinfo, JCS_YCCK);  break;
   default:
     if (subsamp == TJSAMP_GRAY)
-      jpeg_set_colorspace(&this->cinfo, JCS_GRAYSCALE);
+      jpeg_set_colorspace(cinfo, JCS_GRAYSCALE);
     else if (pixelFormat == TJPF_CMYK)
-      jpeg_set_colorspace(&this->cinfo, JCS_YCCK);
+      jpeg_set_colorspace(cinfo, JCS_YCCK);
     else
-      jpeg_set_colorspace(&this->cinfo, JCS_YCbCr);
+      jpeg_set_colorspace(cinfo, JCS_YCbCr);
   }
 
-  if (this->cinfo.data_precision == 8)
-    this->cinfo.optimize_coding = this->optimize;
+  if (cinfo->data_precision == 8)
+    cinfo->optimize_coding = this->optimize;
 #ifdef C_PROGRESSIVE_SUPPORTED
-  if (this->progressive) jpeg_simple_progression(&this->cinfo);
+  if (this->progressive) jpeg_simple_progression(cinfo);
 #endif
-  this->cinfo.arith_code = this->arithmetic;
+  cinfo->arith_code = this->arithmetic;
 
-  this->cinfo.comp_info[0].h_samp_factor = tjMCUWidth[subsamp] / 8;
-  this->cinfo.comp_info[1].h_samp_factor = 1;
-  this->cinfo.comp_info[2].h_samp_factor = 1;
-  if (this->cinfo.num_components > 3)
-    this->cinfo.comp_info[3].h_samp_factor = tjMCUWidth[subsamp] / 8;
-  this->cinfo.comp_info[0].v_samp_factor = tjMCUHeight[subsamp] / 8;
-  this->cinfo.comp_info[1].v_samp_factor = 1;
-  this->cinfo.comp_info[2].v_samp_factor = 1;
-  if (this->cinfo.num_components > 3)
-    this->cinfo.comp_info[3].v_samp_factor = tjMCUHeight[subsamp] / 8;
+  cinfo->comp_info[0].h_samp_factor = tjMCUWidth[subsamp] / 8;
+  cinfo->comp_info[1].h_samp_factor = 1;
+  cinfo->comp_info[2].h_samp_factor = 1;
+  if (cinfo->num_components > 3)
+    cinfo->comp_info[3].h_samp_factor = tjMCUWidth[subsamp] / 8;
+  cinfo->comp_info[0].v_samp_factor = tjMCUHeight[subsamp] / 8;
+  cinfo->comp_info[1].v_samp_factor = 1;
+  cinfo->comp_info[2].v_samp_factor = 1;
+  if (cinfo->num_components > 3)
+    cinfo->comp_info[3].v_samp_factor = tjMCUHeight[subsamp] / 8;
 }
 
 
@@ -561,6 +581,7 @@ DLLEXPORT tjhandle tj3Init(int initType)
   this->xDensity = 1;
   this->yDensity = 1;
   this->scalingFactor = TJUNSCALED;
+  this->numThreads = 1;
 
   switch (initType) {
   case TJINIT_COMPRESS:  return _tjInitCompress(this);
@@ -790,6 +811,24 @@ DLLEXPORT int tj3Set(tjhandle handle, int param, int value)
   case TJPARAM_MAXPIXELS:
     SET_PARAM(maxPixels, 0, -1);
     break;
+  case TJPARAM_NUMTHREADS:
+    SET_PARAM(numThreads, 1, -1);
+    break;
+  case TJPARAM_WARMCONTEXT:
+    if (!(this->init & COMPRESS))
+      THROW("TJPARAM_WARMCONTEXT is not applicable to decompression instances.");
+    SET_BOOL_PARAM(warmContext);
+    break;
+  case TJPARAM_SCANBUDGET:
+    if (!(this->init & DECOMPRESS))
+      THROW("TJPARAM_SCANBUDGET is not applicable to compression instances.");
+    SET_PARAM(scanBudget, 0, -1);
+    break;
+  case TJPARAM_BYTESREAD:
+    if (!(this->init & DECOMPRESS))
+      THROW("TJPARAM_BYTESREAD is not applicable to compression instances.");
+    THROW("TJPARAM_BYTESREAD is read-only in decompression instances.");
+    break;
   default:
     THROW("Invalid parameter");
   }
@@ -856,6 +895,14 @@ DLLEXPORT int tj3Get(tjhandle handle, int param)
     return this->maxMemory;
   case TJPARAM_MAXPIXELS:
     return this->maxPixels;
+  case TJPARAM_NUMTHREADS:
+    return this->numThreads;
+  case TJPARAM_WARMCONTEXT:
+    return this->warmContext;
+  case TJPARAM_SCANBUDGET:
+    return this->scanBudget;
+  case TJPARAM_BYTESREAD:
+    return (int)min(this->bytesRead, (size_t)INT_MAX);
   }
 
   return -1;
@@ -1154,6 +1201,532 @@ DLLEXPORT tjhandle tjInitCompress(void)
 }
 
 
+/*
+ * Striped compression:  If TJPARAM_NUMTHREADS > 1, then the image is split into
+ * horizontal stripes whose heights are multiples of the restart interval, and
+ * each stripe is compressed by a separate libjpeg instance.  The stripes are
+ * then stitched together, with their restart markers renumbered and a restart
+ * marker inserted between each pair of stripes.  The result is identical to
+ * the image that a single libjpeg instance would generate with the same
+ * restart interval.  If the Huffman tables are optimized, then the statistics
+ * of all stripes are merged before any stripe generates its tables.
+ */
+
+typedef struct {
+  struct jpeg_compress_struct cinfo;
+  struct my_error_mgr jerr;
+  unsigned char *jpegBuf;
+  size_t jpegSize;
+  int startRow, numRows;        /* source rows covered by this stripe */
+  int firstInterval;            /* index of the stripe's first restart
+                                   interval within the whole image */
+  boolean failed;
+  char errStr[JMSG_LENGTH_MAX];
+} tjstripe;
+
+typedef struct {
+  tjinstance *this;
+  tjstripe *stripes;
+  int numStripes;
+  int width, pixelFormat;
+  int stripeHeight;             /* height of each stripe (except the last) */
+  int restartRows, stripeIntervals;  /* restart intervals per stripe */
+  boolean finish;               /* TRUE = finish compressing the stripes */
+  void *rowPointers;            /* _JSAMPROW array for the whole image */
+} tjstripejob;
+
+/* The libjpeg instance of each stripe stores its messages in the errStr[]
+   buffer to which client_data points, since the thread-local errStr[] buffer
+   of a worker thread cannot be read by the calling thread. */
+
+static void my_stripe_output_message(j_common_ptr cinfo)
+{
+  (*cinfo->err->format_message) (cinfo, (char *)cinfo->client_data);
+}
+
+/* Determine whether the image can be compressed in stripes and, if so, set
+   job->stripeHeight, job->restartRows, and job->stripeIntervals.  cinfo must
+   have been initialized with setCompDefaults().  Returns the number of
+   stripes, or 0 if the image should be compressed serially. */
+
+static int planStripes(tjinstance *this, j_compress_ptr cinfo, int width,
+                       int height, tjstripejob *job)
+{
+  int ci, maxH = 1, maxV = 1, mcusPerRow, mcuRows, stripeRows, numStripes;
+  int intervalRows = this->restartIntervalRows;
+
+  if (this->numThreads < 2 || this->lossless || this->progressive ||
+      this->arithmetic || this->restartIntervalBlocks != 0 ||
+      width > JPEG_MAX_DIMENSION || height > JPEG_MAX_DIMENSION)
+    return 0;
+
+  for (ci = 0; ci < cinfo->num_components; ci++) {
+    maxH = max(maxH, cinfo->comp_info[ci].h_samp_factor);
+    maxV = max(maxV, cinfo->comp_info[ci].v_samp_factor);
+  }
+  /* A single-component scan has one block per MCU regardless of the sampling
+     factors, so the MCU rows would not line up with the iMCU rows. */
+  if (cinfo->num_components == 1 && (maxH != 1 || maxV != 1))
+    return 0;
+
+  mcusPerRow = (width + maxH * DCTSIZE - 1) / (maxH * DCTSIZE);
+  mcuRows = (height + maxV * DCTSIZE - 1) / (maxV * DCTSIZE);
+  stripeRows = (mcuRows + this->numThreads - 1) / this->numThreads;
+
+  /* The restart interval (in MCUs) is limited to 65535, and libjpeg silently
+     clamps it, which would cause the intervals not to line up with the
+     stripes. */
+  if (intervalRows == 0)
+    intervalRows = min(stripeRows, 65535 / mcusPerRow);
+  else if ((long)intervalRows * mcusPerRow > 65535L)
+    return 0;
+  stripeRows = (stripeRows + intervalRows - 1) / intervalRows * intervalRows;
+
+  numStripes = (mcuRows + stripeRows - 1) / stripeRows;
+  if (numStripes < 2 || jthread_clamp_workers(this->numThreads, numStripes) < 2)
+    return 0;
+
+  job->stripeHeight = stripeRows * maxV * DCTSIZE;
+  job->restartRows = intervalRows;
+  job->stripeIntervals = stripeRows / intervalRows;
+  return numStripes;
+}
+
+/* Set up the error handler and libjpeg instance for a stripe */
+
+static void initStripe(tjinstance *this, tjstripe *stripe)
+{
+  stripe->cinfo.err = jpeg_std_error(&stripe->jerr.pub);
+  stripe->jerr.pub.error_exit = my_error_exit;
+  stripe->jerr.pub.output_message = my_stripe_output_message;
+  stripe->jerr.emit_message = stripe->jerr.pub.emit_message;
+  stripe->jerr.pub.emit_message = my_emit_message;
+  stripe->jerr.pub.addon_message_table = turbojpeg_message_table;
+  stripe->jerr.pub.first_addon_message = JMSG_FIRSTADDONCODE;
+  stripe->jerr.pub.last_addon_message = JMSG_LASTADDONCODE;
+  stripe->jerr.stopOnWarning = this->jerr.stopOnWarning;
+
+  jpeg_create_compress(&stripe->cinfo);
+  stripe->cinfo.client_data = (void *)stripe->errStr;
+}
+
+/* Sum the Huffman statistics of all stripes, so that all stripes generate
+   the same (optimal) Huffman tables */
+
+static void mergeStripeStats(tjstripe *stripes, int numStripes)
+{
+  int isDC, tbl, i, k;
+
+  for (isDC = 0; isDC <= 1; isDC++) {
+    for (tbl = 0; tbl < NUM_HUFF_TBLS; tbl++) {
+      long *total = jpeg_huff_stats(&stripes[0].cinfo, isDC, tbl);
+
+      if (total == NULL) continue;
+      for (i = 1; i < numStripes; i++) {
+        long *counts = jpeg_huff_stats(&stripes[i].cinfo, isDC, tbl);
+
+        for (k = 0; counts && k < 257; k++)
+          total[k] += counts[k];
+      }
+      for (i = 1; i < numStripes; i++) {
+        long *counts = jpeg_huff_stats(&stripes[i].cinfo, isDC, tbl);
+
+        if (counts) memcpy(counts, total, 257 * sizeof(long));
+      }
+    }
+  }
+}
+
+/* Return the offset of the entropy-coded data of the first scan in a JPEG
+   image, or 0 if the image could not be parsed.  If sofOffset is non-NULL,
+   then it receives the offset of the image height field in the SOF marker (or
+   0 if the image has no sequential Huffman SOF marker.) */
+
+static size_t findScanData(const unsigned char *buf, size_t size,
+                           size_t *sofOffset)
+{
+  size_t pos = 2;
+
+  if (sofOffset) *sofOffset = 0;
+  if (size < 4 || buf[0] != 0xFF || buf[1] != 0xD8)
+    return 0;
+
+  while (pos + 4 <= size && buf[pos] == 0xFF) {
+    int marker = buf[pos + 1];
+
+    if (marker == 0xFF) {               /* fill byte */
+      pos++;
+      continue;
+    }
+    if (marker == 0x01 || (marker >= JPEG_RST0 && marker <= JPEG_RST0 + 7)) {
+      pos += 2;                         /* marker without parameters */
+      continue;
+    }
+    if ((marker == 0xC0 || marker == 0xC1) && sofOffset)
+      *sofOffset = pos + 5;
+    pos += 2 + ((buf[pos + 2] << 8) | buf[pos + 3]);
+    if (marker == 0xDA)
+      return pos < size ? pos : 0;
+  }
+  return 0;
+}
+
+static void writeJPEGData(j_compress_ptr cinfo, const unsigned char *data,
+                          size_t size)
+{
+  struct jpeg_destination_mgr *dest = cinfo->dest;
+
+  while (size > 0) {
+    size_t n;
+
+    if (dest->free_in_buffer == 0 && !(*dest->empty_output_buffer) (cinfo))
+      ERREXIT(cinfo, JERR_CANT_SUSPEND);
+    n = min(size, dest->free_in_buffer);
+    memcpy(dest->next_output_byte, data, n);
+    dest->next_output_byte += n;
+    dest->free_in_buffer -= n;
+    data += n;
+    size -= n;
+  }
+}
+
+/* Compress the stripes described by job in parallel and write the stitched
+   JPEG image to the destination manager of the TurboJPEG instance.  The
+   caller must have allocated (and zeroed) job->stripes. */
+
+static int compressStripes(tjinstance *this, tjstripejob *job,
+                           jthread_task_ptr compressStripe, boolean alloc)
+{
+  j_compress_ptr cinfo = &this->cinfo;
+  tjstripe *stripes = job->stripes;
+  size_t sofOffset = 0, scanOffset, end, k;
+  unsigned char marker[2];
+  int i, retval = 0;
+
+  job->finish = FALSE;
+  jthread_run(job, compressStripe, job->numStripes, this->numThreads);
+  for (i = 0; i < job->numStripes; i++) {
+    if (stripes[i].jerr.warning) {
+      SNPRINTF(errStr, JMSG_LENGTH_MAX, "%s", stripes[i].errStr);
+      this->jerr.warning = TRUE;
+    }
+    if (stripes[i].failed) {
+      SNPRINTF(errStr, JMSG_LENGTH_MAX, "%s", stripes[i].errStr);
+      retval = -1;  goto bailout;
+    }
+  }
+
+  if (stripes[0].cinfo.optimize_coding) {
+    mergeStripeStats(stripes, job->numStripes);
+    job->finish = TRUE;
+    jthread_run(job, compressStripe, job->numStripes, this->numThreads);
+    for (i = 0; i < job->numStripes; i++) {
+      if (stripes[i].jerr.warning) {
+        SNPRINTF(errStr, JMSG_LENGTH_MAX, "%s", stripes[i].errStr);
+        this->jerr.warning = TRUE;
+      }
+      if (stripes[i].failed) {
+        SNPRINTF(errStr, JMSG_LENGTH_MAX, "%s", stripes[i].errStr);
+        retval = -1;  goto bailout;
+      }
+    }
+  }
+
+  if (setjmp(this->jerr.setjmp_buffer)) {
+    /* If we get here, the JPEG code has signaled an error. */
+    if (alloc) (*cinfo->dest->term_destination) (cinfo);
+    retval = -1;  goto bailout;
+  }
+
+  (*cinfo->dest->init_destination) (cinfo);
+  for (i = 0; i < job->numStripes; i++) {
+    unsigned char *buf = stripes[i].jpegBuf;
+
+    if ((scanOffset = findScanData(buf, stripes[i].jpegSize,
+                                   i == 0 ? &sofOffset : NULL)) == 0 ||
+        (i == 0 && sofOffset == 0) || buf[stripes[i].jpegSize - 2] != 0xFF ||
+        buf[stripes[i].jpegSize - 1] != 0xD9)
+      ERREXIT(cinfo, JERR_BAD_LENGTH);
+    end = stripes[i].jpegSize - 2;
+
+    if (i == 0) {
+      /* The header of the first stripe becomes the header of the image. */
+      buf[sofOffset] = (unsigned char)(cinfo->image_height >> 8);
+      buf[sofOffset + 1] = (unsigned char)(cinfo->image_height & 0xFF);
+      writeJPEGData(cinfo, buf, end);
+      continue;
+    }
+
+    /* Renumber the stripe's restart markers.  libjpeg stuffs a zero byte
+       after any 0xFF data byte, so 0xFF is followed either by 0x00 or by a
+       marker code. */
+    for (k = scanOffset; k + 1 < end; k++) {
+      if (buf[k] == 0xFF) {
+        k++;
+        if (buf[k] >= JPEG_RST0 && buf[k] <= JPEG_RST0 + 7)
+          buf[k] = (unsigned char)(JPEG_RST0 +
+                                   ((buf[k] - JPEG_RST0 +
+                                     stripes[i].firstInterval) & 7));
+      }
+    }
+    marker[0] = 0xFF;
+    marker[1] = (unsigned char)(JPEG_RST0 +
+                                ((stripes[i].firstInterval - 1) & 7));
+    writeJPEGData(cinfo, marker, 2);
+    writeJPEGData(cinfo, buf + scanOffset, end - scanOffset);
+  }
+  marker[0] = 0xFF;  marker[1] = 0xD9;
+  writeJPEGData(cinfo, marker, 2);
+  (*cinfo->dest->term_destination) (cinfo);
+
+bailout:
+  for (i = 0; i < job->numStripes; i++) {
+    if (stripes[i].cinfo.global_state > CSTATE_START)
+      (*stripes[i].cinfo.dest->term_destination) (&stripes[i].cinfo);
+    jpeg_destroy_compress(&stripes[i].cinfo);
+    free(stripes[i].jpegBuf);
+  }
+  return retval;
+}
+
+
+/*
+ * Striped decompression:  If TJPARAM_NUMTHREADS > 1 and a sequential Huffman
+ * JPEG image has restart intervals that span whole MCU rows, then the
+ * restart markers are indexed, and the image is split into horizontal stripes
+ * that each consist of one or more restart intervals.  Each stripe is
+ * re-wrapped as a standalone JPEG image (the headers of the original image,
+ * with the SOF height patched and the restart markers renumbered) and
+ * decompressed by a separate libjpeg instance directly into the destination
+ * buffer.  If fancy upsampling needs context from adjacent rows, then each
+ * stripe also decompresses the restart intervals above and below it and
+ * discards the extra rows, so the output is identical to the output of a
+ * single libjpeg instance.
+ */
+
+typedef struct {
+  struct jpeg_decompress_struct dinfo;
+  struct my_error_mgr jerr;
+  unsigned char *jpegBuf;       /* standalone JPEG image for this stripe */
+  size_t jpegSize;
+  int startRow, numRows;        /* destination rows covered by this stripe */
+  int skipRows;                 /* context rows to discard at the top */
+  boolean failed;
+  char errStr[JMSG_LENGTH_MAX];
+} tjdstripe;
+
+typedef struct {
+  tjinstance *this;
+  tjdstripe *stripes;
+  int numStripes;
+  void *rowPointers;            /* _JSAMPROW array for the whole image */
+} tjdstripejob;
+
+/* Find the restart markers in the scan that begins at scanStart.  Returns TRUE
+   if the scan consists of exactly numIntervals restart intervals with
+   correctly numbered restart markers and is followed by an EOI marker, in
+   which case markerPos[k] receives the offset of the marker that terminates
+   restart interval k. */
+
+static boolean indexRestartIntervals(const unsigned char *buf, size_t size,
+                                     size_t scanStart, size_t *markerPos,
+                                     int numIntervals)
+{
+  size_t pos = scanStart;
+  int k = 0;
+
+  while (pos + 1 < size) {
+    const unsigned char *ptr = memchr(&buf[pos], 0xFF, size - 1 - pos);
+    int marker;
+
+    if (ptr == NULL) break;
+    pos = ptr - buf;
+    marker = buf[pos + 1];
+    if (marker == 0x00) {               /* stuffed zero byte */
+      pos += 2;
+      continue;
+    }
+    if (marker == 0xFF) {               /* fill byte */
+      pos++;
+      continue;
+    }
+    if (marker == JPEG_RST0 + (k & 7) && k < numIntervals - 1) {
+      markerPos[k++] = pos;
+      pos += 2;
+      continue;
+    }
+    if (marker == 0xD9 && k == numIntervals - 1) {
+      markerPos[k] = pos;
+      return TRUE;
+    }
+    break;                              /* unexpected marker */
+  }
+  return FALSE;
+}
+
+/* Determine whether the image can be decompressed in stripes and, if so,
+   allocate and set up job->stripes.  dinfo must have been started with
+   jpeg_start_decompress().  Returns the number of stripes, or 0 if the image
+   should be decompressed serially. */
+
+static int planDecompStripes(tjinstance *this, j_decompress_ptr dinfo,
+                             const unsigned char *jpegBuf, size_t jpegSize,
+                             tjdstripejob *job)
+{
+  int ci, i, k, intervalRows, numIntervals, stripeIntervals, numStripes;
+  int mcuRowHeight, scale = dinfo->min_DCT_scaled_size;
+  boolean context = FALSE;
+  size_t scanStart, sofOffset, *markerPos = NULL;
+
+  if (this->numThreads < 2 || dinfo->progressive_mode || dinfo->arith_code ||
+      dinfo->master->lossless || dinfo->restart_interval == 0 ||
+      dinfo->comps_in_scan != dinfo->num_components ||
+      dinfo->restart_interval % dinfo->MCUs_per_row != 0 ||
+      this->croppingRegion.x != 0 || this->croppingRegion.y != 0 ||
+      this->croppingRegion.w != 0 || this->croppingRegion.h != 0 ||
+      BEYOND_IDCT_SCALING(this->scalingFactor))
+    return 0;
+
+  /* The stripes must begin on iMCU row boundaries. */
+  mcuRowHeight = dinfo->comps_in_scan == 1 ?
+                 DCTSIZE * dinfo->max_v_samp_factor /
+                 dinfo->cur_comp_info[0]->v_samp_factor :
+                 DCTSIZE * dinfo->max_v_samp_factor;
+  intervalRows = (int)dinfo->restart_interval / dinfo->MCUs_per_row *
+                 mcuRowHeight;
+  if (intervalRows % (DCTSIZE * dinfo->max_v_samp_factor) != 0)
+    return 0;
+  numIntervals = (dinfo->image_height + intervalRows - 1) / intervalRows;
+  stripeIntervals = (numIntervals + this->numThreads - 1) / this->numThreads;
+  numStripes = (numIntervals + stripeIntervals - 1) / stripeIntervals;
+  if (numStripes < 2 || jthread_clamp_workers(this->numThreads, numStripes) < 2)
+    return 0;
+
+  if ((scanStart = findScanData(jpegBuf, jpegSize, &sofOffset)) == 0 ||
+      sofOffset == 0)
+    return 0;
+  if ((markerPos = (size_t *)malloc(sizeof(size_t) * numIntervals)) == NULL)
+    return 0;
+  if (!indexRestartIntervals(jpegBuf, jpegSize, scanStart, markerPos,
+                             numIntervals))
+    goto bailout;
+
+  for (ci = 0; ci < dinfo->num_components; ci++) {
+    if (dinfo->comp_info[ci].v_samp_factor != dinfo->max_v_samp_factor)
+      context = dinfo->do_fancy_upsampling;
+  }
+
+  if ((job->stripes = (tjdstripe *)calloc(numStripes,
+                                          sizeof(tjdstripe))) == NULL)
+    goto bailout;
+  for (i = 0; i < numStripes; i++) {
+    tjdstripe *stripe = &job->stripes[i];
+    int first = i * stripeIntervals;
+    int last = min(first + stripeIntervals, numIntervals) - 1;
+    int decodeFirst = (context && first > 0) ? first - 1 : first;
+    int decodeLast = (context && last < numIntervals - 1) ? last + 1 : last;
+    int height = min(dinfo->image_height,
+                     (JDIMENSION)(decodeLast + 1) * intervalRows) -
+                 decodeFirst * intervalRows;
+    size_t dataStart = decodeFirst ? markerPos[decodeFirst - 1] + 2 :
+                                     scanStart;
+    size_t dataSize = markerPos[decodeLast] - dataStart;
+    unsigned char *buf;
+
+    stripe->startRow = first * intervalRows / DCTSIZE * scale;
+    stripe->numRows = (last == numIntervals - 1 ? (int)dinfo->output_height :
+                       (last + 1) * intervalRows / DCTSIZE * scale) -
+                      stripe->startRow;
+    stripe->skipRows = (first - decodeFirst) * intervalRows / DCTSIZE * scale;
+
+    stripe->jpegSize = scanStart + dataSize + 2;
+    if ((buf = stripe->jpegBuf = (unsigned char *)malloc(stripe->jpegSize)) ==
+        NULL)
+      goto bailout;
+    memcpy(buf, jpegBuf, scanStart);
+    buf[sofOffset] = (unsigned char)(height >> 8);
+    buf[sofOffset + 1] = (unsigned char)(height & 0xFF);
+    memcpy(&buf[scanStart], &jpegBuf[dataStart], dataSize);
+    for (k = decodeFirst; k < decodeLast; k++)
+      buf[scanStart + markerPos[k] - dataStart + 1] =
+        (unsigned char)(JPEG_RST0 + ((k - decodeFirst) & 7));
+    buf[stripe->jpegSize - 2] = 0xFF;
+    buf[stripe->jpegSize - 1] = 0xD9;
+  }
+
+  free(markerPos);
+  return numStripes;
+
+bailout:
+  if (job->stripes) {
+    for (i = 0; i < numStripes; i++)
+      free(job->stripes[i].jpegBuf);
+    free(job->stripes);
+    job->stripes = NULL;
+  }
+  free(markerPos);
+  return 0;
+}
+
+/* Set up the error handler and libjpeg instance for a decompression stripe,
+   and read the stripe's JPEG header */
+
+static void initDecompStripe(tjinstance *this, tjdstripe *stripe)
+{
+  j_decompress_ptr dinfo = &stripe->dinfo;
+
+  dinfo->err = jpeg_std_error(&stripe->jerr.pub);
+  stripe->jerr.pub.error_exit = my_error_exit;
+  stripe->jerr.pub.output_message = my_stripe_output_message;
+  stripe->jerr.emit_message = stripe->jerr.pub.emit_message;
+  stripe->jerr.pub.emit_message = my_emit_message;
+  stripe->jerr.pub.addon_message_table = turbojpeg_message_table;
+  stripe->jerr.pub.first_addon_message = JMSG_FIRSTADDONCODE;
+  stripe->jerr.pub.last_addon_message = JMSG_LASTADDONCODE;
+  stripe->jerr.stopOnWarning = this->jerr.stopOnWarning;
+
+  jpeg_create_decompress(dinfo);
+  dinfo->client_data = (void *)stripe->errStr;
+  dinfo->mem->max_memory_to_use = (long)this->maxMemory * 1048576L;
+
+  jpeg_mem_src_tj(dinfo, stripe->jpegBuf, stripe->jpegSize);
+  jpeg_read_header(dinfo, TRUE);
+  dinfo->out_color_space = this->dinfo.out_color_space;
+  dinfo->do_fancy_upsampling = this->dinfo.do_fancy_upsampling;
+  dinfo->dct_method = this->dinfo.dct_method;
+  dinfo->scale_num = this->dinfo.scale_num;
+  dinfo->scale_denom = this->dinfo.scale_denom;
+}
+
+/* Decompress the stripes described by job in parallel */
+
+static int decompressStripes(tjinstance *this, tjdstripejob *job,
+                             jthread_task_ptr decompressStripe)
+{
+  tjdstripe *stripes = job->stripes;
+  int i, retval = 0;
+
+  jthread_run(job, decompressStripe, job->numStripes, this->numThreads);
+  for (i = 0; i < job->numStripes; i++) {
+    if (stripes[i].jerr.warning) {
+      SNPRINTF(errStr, JMSG_LENGTH_MAX, "%s", stripes[i].errStr);
+      this->jerr.warning = TRUE;
+    }
+    if (stripes[i].failed) {
+      SNPRINTF(errStr, JMSG_LENGTH_MAX, "%s", stripes[i].errStr);
+      retval = -1;
+      break;
+    }
+  }
+
+  for (i = 0; i < job->numStripes; i++) {
+    jpeg_destroy_decompress(&stripes[i].dinfo);
+    free(stripes[i].jpegBuf);
+  }
+  return retval;
+}
+
+
 /* tj3Compress*() is implemented in turbojpeg-mp.c */
 #define BITS_IN_JSAMPLE  8
 #include "turbojpeg-mp.c"
@@ -1266,7 +1839,7 @@ DLLEXPORT int tj3CompressFromYUVPlanes8(tjhandle handle,
     alloc = FALSE;  *jpegSize = tj3JPEGBufSize(width, height, this->subsamp);
   }
   jpeg_mem_dest_tj(cinfo, jpegBuf, jpegSize, alloc);
-  setCompDefaults(this, TJPF_RGB);
+  setCompDefaults(this, cinfo, TJPF_RGB);
   cinfo->raw_data_in = TRUE;
 
   jpeg_start_compress(cinfo, TRUE);
@@ -1511,7 +2084,7 @@ DLLEXPORT int tj3EncodeYUVPlanes8(tjhandle handle, const unsigned char *srcBuf,
   cinfo->image_height = height;
   cinfo->data_precision = 8;
 
-  setCompDefaults(this, pixelFormat);
+  setCompDefaults(this, cinfo, pixelFormat);
 
   /* Execute only the parts of jpeg_start_compress() that we need.  If we
      were to call the whole jpeg_start_compress() function, then it would try
@@ -1902,7 +2475,8 @@ DLLEXPORT int tj3SetScalingFactor(tjhandle handle,
     if (scalingFactor.num == sf[i].num && scalingFactor.denom == sf[i].denom)
       break;
   }
-  if (i >= NUMSF)
+  if (i >= NUMSF &&
+      (scalingFactor.num < 1 || !BEYOND_IDCT_SCALING(scalingFactor)))
     THROW("Unsupported scaling factor");
 
   this->scalingFactor = scalingFactor;
@@ -1935,6 +2509,9 @@ DLLEXPORT int tj3SetCroppingRegion(tjhandle handle, tjregion croppingRegion)
     THROW("JPEG header has not yet been read");
   if (this->precision == 16 || this->lossless)
     THROW("Cannot partially decompress lossless JPEG images");
+  if (BEYOND_IDCT_SCALING(this->scalingFactor))
+    THROW("Scaling factors smaller than 1/8 cannot be used with\n"
+          "partial decompression");
   if (this->subsamp == TJSAMP_UNKNOWN)
     THROW("Could not determine subsampling level of JPEG image");
 
@@ -2088,6 +2665,9 @@ DLLEXPORT int tj3DecompressToYUVPlanes8(tjhandle handle,
 
   if (dinfo->num_components > 3)
     THROW("JPEG image must have 3 or fewer components");
+  if (BEYOND_IDCT_SCALING(this->scalingFactor))
+    THROW("Scaling factors smaller than 1/8 cannot be used when\n"
+          "decompressing into YUV planes");
 
   dinfo->scale_num = this->scalingFactor.num;
   dinfo->scale_denom = this->scalingFactor.denom;
@@ -2136,6 +2716,9 @@ DLLEXPORT int tj3DecompressToYUVPlanes8(tjhandle handle,
   dinfo->do_fancy_upsampling = !this->fastUpsample;
   dinfo->dct_method = this->fastDCT ? JDCT_FASTEST : JDCT_ISLOW;
   dinfo->raw_data_out = TRUE;
+  jpeg_d_set_int_param(dinfo, JINT_NUM_THREADS, this->numThreads);
+  jpeg_d_set_int_param(dinfo, JINT_SCAN_BUDGET, this->scanBudget);
+  jpeg_d_set_int_param(dinfo, JINT_CHECKPOINT_INTERVAL, 0);
 
   dinfo->mem->max_memory_to_use = (long)this->maxMemory * 1048576L;
 
@@ -2182,6 +2765,7 @@ DLLEXPORT int tj3DecompressToYUVPlanes8(tjhandle handle,
     }
   }
   jpeg_finish_decompress(dinfo);
+  this->bytesRead = jpegSize - dinfo->src->bytes_in_buffer;
 
 bailout:
   if (dinfo->global_state > DSTATE_START) jpeg_abort_decompress(dinfo);
@@ -2703,6 +3287,9 @@ DLLEXPORT int tj3Transform(tjhandle handle, const unsigned char *jpegBuf,
 
   if (dinfo->global_state <= DSTATE_INHEADER)
     jpeg_mem_src_tj(dinfo, jpegBuf, jpegSize);
+  /* Lossless transformation must read every scan. */
+  jpeg_d_set_int_param(dinfo, JINT_SCAN_BUDGET, 0);
+  jpeg_d_set_int_param(dinfo, JINT_CHECKPOINT_INTERVAL, 0);
 
   for (i = 0; i < n; i++) {
     if (t[i].op < 0 || t[i].op >= TJ_NUMXOP)
@@ -2801,6 +3388,7 @@ DLLEXPORT int tj3Transform(tjhandle handle, const unsigned char *jpegBuf,
     if (!(t[i].options & TJXOPT_NOOUTPUT))
       jpeg_mem_dest_tj(cinfo, &dstBufs[i], &dstSizes[i], alloc);
     jpeg_copy_critical_parameters(dinfo, cinfo);
+    jpeg_c_set_int_param(cinfo, JINT_NUM_THREADS, this->numThreads);
     dstcoefs = jtransform_adjust_parameters(dinfo, cinfo, srccoefs, &xinfo[i]);
     if (this->optimize || t[i].options & TJXOPT_OPTIMIZE)
       cinfo->optimize_coding = TRUE;
@@ -909,7 +909,94 @@ enum TJPARAM {
    * - maximum number of pixels that the decompression, transform, and image
    * loading functions will process *[default: `0` (no limit)]*
    */
-  TJPARAM_MAXPIXELS
+  TJPARAM_MAXPIXELS,
+  /**
+   * Number of threads [lossy compression, decompression, and lossless
+   * transformation]
+   *
+   * If this parameter is greater than 1, then the packed-pixel compression
+   * functions split the image into horizontal stripes and compress the
+   * stripes in parallel.  Each stripe begins with a restart marker, so the
+   * JPEG image is identical to the image that would be generated by
+   * compressing serially with #TJPARAM_RESTARTROWS set to the stripe height
+   * (or to the value of #TJPARAM_RESTARTROWS, if it is set and the stripe
+   * height is a multiple of it.)  If #TJPARAM_OPTIMIZE is set, then the
+   * Huffman statistics of all stripes are merged, so the Huffman tables are
+   * still optimal for the whole image.  This has no effect with progressive,
+   * arithmetic, or lossless JPEG compression, if #TJPARAM_RESTARTBLOCKS is
+   * set, or if the image is too small to be split into at least two stripes.
+   *
+   * The packed-pixel decompression functions use the restart markers in a
+   * sequential Huffman-coded JPEG image to decompress horizontal stripes of
+   * the image in parallel, if the restart interval is a whole number of MCU
+   * rows.  (Images compressed with this parameter, or with
+   * #TJPARAM_RESTARTROWS, meet that requirement.)  The decompressed image is
+   * identical to the image that would be decompressed serially.  This has no
+   * effect if a cropping region is specified or if the JPEG image does not
+   * have at least two restart intervals.  If a sequential Huffman-coded JPEG
+   * image has no restart markers, then the decompression functions instead
+   * split the entropy-coded data at arbitrary byte offsets, decode the pieces
+   * speculatively in parallel, and resynchronize them, which also yields an
+   * identical decompressed image.
+   *
+   * The lossless transform functions rotate, flip, transpose, or crop
+   * horizontal bands of the DCT coefficients in parallel.  The transformed
+   * JPEG images are identical to the images that would be generated serially.
+   *
+   * This parameter has no effect if TurboJPEG was built without thread
+   * support.
+   *
+   * **Value**
+   * - maximum number of threads that the compression, decompression, and
+   * transform functions will use *[default: `1`]*
+   */
+  TJPARAM_NUMTHREADS,
+  /**
+   * Warm compression context [compression only]
+   *
+   * If this parameter is set, then the memory used to compress an image is
+   * retained by the TurboJPEG instance and reused for the next image, and the
+   * Huffman encoding tables and quantization divisors derived from the
+   * Huffman and quantization tables are retained and reused as long as the
+   * tables do not change.  This reduces the per-image setup overhead when
+   * compressing a series of images with the same dimensions and parameters,
+   * such as thumbnails or video frames.  The JPEG images are identical to the
+   * images that would be generated without this parameter.  The memory used
+   * to compress one image is retained until the next image is compressed or
+   * the instance is destroyed.
+   *
+   * **Value**
+   * - `0` *[default]* Release the working memory after each image.
+   * - `1` Retain the working memory and derived tables across images.
+   */
+  TJPARAM_WARMCONTEXT,
+  /**
+   * Progressive scan budget [lossy decompression only]
+   *
+   * If this parameter is set, then the decompression functions stop reading a
+   * progressive JPEG image after the specified number of scans, as if the
+   * image ended there, and estimate the missing AC coefficients using block
+   * smoothing.  This produces a low-quality preview of the image from a
+   * prefix of the JPEG image, without parsing the remaining scans.  Use
+   * #TJPARAM_BYTESREAD to determine how much of the JPEG image was read.
+   * Unlike #TJPARAM_SCANLIMIT, exceeding the budget is not an error.  This
+   * parameter has no effect on single-scan JPEG images.
+   *
+   * **Value**
+   * - maximum number of progressive JPEG scans that the decompression
+   * functions will decode *[default: `0` (no limit)]*
+   */
+  TJPARAM_SCANBUDGET,
+  /**
+   * Number of JPEG bytes read [decompression only, read-only]
+   *
+   * **Value**
+   * - the number of bytes of the JPEG image that were read by the most recent
+   * successful call to one of the decompression functions.  This is less than
+   * the size of the JPEG image if #TJPARAM_SCANBUDGET caused the
+   * decompression functions to stop reading early.
+   */
+  TJPARAM_BYTESREAD
 };
 
 
@@ -1759,6 +1846,14 @@ DLLEXPORT tjscalingfactor *tj3GetScalingFactors(int *numScalingFactors);
  * since the IDCT algorithm is not used with those images.  Note also that
  * #TJPARAM_FASTDCT is ignored when decompression scaling is enabled.
  *
+ * Any scaling factor smaller than 1/8 (such as 1/16 or 3/64) can also be
+ * specified when decompressing a lossy JPEG image into a packed-pixel image
+ * without cropping.  In that case, the JPEG image is reconstructed at 1/8
+ * scale from its DC coefficients alone (which allows the AC scans of a
+ * progressive JPEG image to be skipped), and each pixel in the destination
+ * image is the average of the pixels that it covers in the 1/8-scale image.
+ * This is useful for generating thumbnails.
+ *
  * @return 0 if successful, or -1 if an error occurred (see #tj3GetErrorStr().)
  */
 DLLEXPORT int tj3SetScalingFactor(tjhandle handle,
@@ -1783,6 +1878,11 @@ DLLEXPORT int tj3SetScalingFactor(tjhandle handle,
  * <tt>#TJUNCROPPED</tt>, the JPEG header must be read (see
  * #tj3DecompressHeader()) prior to calling this function.
  *
+ * If the JPEG image is a single-scan Huffman-coded image with restart
+ * markers, then the MCUs above and to either side of the cropping region are
+ * skipped without being entropy-decoded.  This makes cropping a small region
+ * from a large image much faster.
+ *
  * @return 0 if successful, or -1 if an error occurred (see #tj3GetErrorStr().)
  */
 DLLEXPORT int tj3SetCroppingRegion(tjhandle handle, tjregion croppingRegion);